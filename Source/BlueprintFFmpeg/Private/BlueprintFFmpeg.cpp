@@ -2,17 +2,34 @@
 
 #include "BlueprintFFmpeg.h"
 
+#include "FFmpegEncoderPool.h"
+#include "FFmpegMemory.h"
+#include "HAL/IConsoleManager.h"
+
 #define LOCTEXT_NAMESPACE "FBlueprintFFmpegModule"
 
 void FBlueprintFFmpegModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+
+	// report memory of FFmpeg encoding, alongside LLM tags under BlueprintFFmpeg
+	MemReportCommand = IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("FFmpeg.MemReport"),
+		TEXT("Write memory held by FFmpeg encoding to the log."),
+		FConsoleCommandDelegate::CreateStatic(&FFFmpegMemory::LogReport));
 }
 
 void FBlueprintFFmpegModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FFFmpegEncoderPool::Get().Empty();
+
+	if (MemReportCommand)
+	{
+		IConsoleManager::Get().UnregisterConsoleObject(MemReportCommand);
+		MemReportCommand = nullptr;
+	}
 }
 
 #undef LOCTEXT_NAMESPACE
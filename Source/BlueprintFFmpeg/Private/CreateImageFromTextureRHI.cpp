@@ -0,0 +1,291 @@
+
+#include "CreateImageFromTextureRHI.h"
+
+#include "LogFFmpegEncoder.h"
+#include "RHIUtilities.h"
+#include "RenderingThread.h"
+
+#include <mutex>
+
+namespace CreateImageFromTextureRHIImpl {
+/**
+ * Pool of copies released by ReleaseTextureSnapshot
+ */
+struct FSnapshotPool {
+	std::mutex             Mutex;
+	TArray<FTextureRHIRef> Snapshots;
+
+	static FSnapshotPool& Get() {
+		static FSnapshotPool Pool;
+		return Pool;
+	}
+};
+
+// copies kept in the pool at most
+constexpr int32 MaxPooledSnapshots = 4;
+
+/**
+ * Pool of staging textures released by FTextureBandReader
+ */
+struct FReadbackPool {
+	std::mutex                                 Mutex;
+	TArray<TUniquePtr<FRHIGPUTextureReadback>> Readbacks;
+
+	static FReadbackPool& Get() {
+		static FReadbackPool Pool;
+		return Pool;
+	}
+};
+
+// staging textures kept in the pool at most
+constexpr int32 MaxPooledReadbacks = 4;
+
+/**
+ * @return   pooled copy of the size and format of Desc, or a new one.
+ *           called on the render thread.
+ */
+FTextureRHIRef AcquireSnapshot(const FRHITextureDesc& Desc) {
+	{
+		auto&           Pool = FSnapshotPool::Get();
+		std::lock_guard Lock(Pool.Mutex);
+
+		const auto& Index = Pool.Snapshots.IndexOfByPredicate(
+		    [&](const FTextureRHIRef& Snapshot) {
+			    const auto& SnapshotDesc = Snapshot->GetDesc();
+			    return SnapshotDesc.Extent == Desc.Extent &&
+			           SnapshotDesc.Format == Desc.Format;
+		    });
+		if (INDEX_NONE != Index) {
+			auto Snapshot = MoveTemp(Pool.Snapshots[Index]);
+			Pool.Snapshots.RemoveAtSwap(Index);
+			return Snapshot;
+		}
+	}
+
+	return RHICreateTexture(
+	    FRHITextureCreateDesc::Create2D(TEXT("FFmpegSnapshot"), Desc.Extent,
+	                                    Desc.Format)
+	        .SetFlags(ETextureCreateFlags::ShaderResource)
+	        .SetInitialState(ERHIAccess::CopyDest));
+}
+} // namespace CreateImageFromTextureRHIImpl
+
+bool ReadTextureRHIIntoImage(FTextureRHIRef TextureRHI, const FIntRect Rect,
+                             const bool bReadFloat, FImage& Image) {
+	// get PixelFormat
+	const auto& PixelFormat = TextureRHI->GetDesc().Format;
+
+	// float textures keep their precision and linearity if requested
+	const auto& bFloat = bReadFloat && (PF_FloatRGBA == PixelFormat ||
+	                                    PF_A32B32G32R32F == PixelFormat);
+
+	// resize Image, keeping its allocation
+	Image.SizeX      = Rect.Width();
+	Image.SizeY      = Rect.Height();
+	Image.NumSlices  = 1;
+	Image.Format =
+	    bFloat ? ERawImageFormat::RGBA16F : ERawImageFormat::BGRA8;
+	Image.GammaSpace = bFloat ? EGammaSpace::Linear : EGammaSpace::sRGB;
+	Image.RawData.Reset();
+	Image.RawData.AddUninitialized(Image.GetImageSizeBytes());
+
+	// copy color array to Image, unless pixels are missing
+	const auto& CopyColors = [&](const auto& ColorArray) {
+		if (Rect.Area() != ColorArray.Num()) {
+			UE_LOG(LogFFmpegEncoder, Error,
+			       TEXT("Read %d of %d pixels of a texture."), ColorArray.Num(),
+			       Rect.Area());
+			Image.SizeX = 0;
+			Image.SizeY = 0;
+			Image.RawData.Reset();
+			return false;
+		}
+		FMemory::Memcpy(Image.RawData.GetData(), ColorArray.GetData(),
+		                ColorArray.NumBytes());
+		return true;
+	};
+	if (bFloat) {
+		return CopyColors(
+		    ReadTextureRHI<FFloat16Color>(MoveTemp(TextureRHI), Rect));
+	}
+	return CopyColors(ReadTextureRHI<FColor>(MoveTemp(TextureRHI), Rect));
+}
+
+TUniquePtr<FTextureBandReader>
+    FTextureBandReader::Create(FTextureRHIRef TextureRHI,
+                               const bool     bReadFloat) {
+	using namespace CreateImageFromTextureRHIImpl;
+
+	const auto& PixelFormat = TextureRHI->GetDesc().Format;
+
+	// formats laid out as images, without the conversion of ReadSurfaceData
+	TUniquePtr<FTextureBandReader> Reader(new FTextureBandReader());
+	if (PF_B8G8R8A8 == PixelFormat) {
+		Reader->Format     = ERawImageFormat::BGRA8;
+		Reader->GammaSpace = EGammaSpace::sRGB;
+	} else if (bReadFloat && PF_FloatRGBA == PixelFormat) {
+		Reader->Format     = ERawImageFormat::RGBA16F;
+		Reader->GammaSpace = EGammaSpace::Linear;
+	} else {
+		return nullptr;
+	}
+	Reader->BytesPerPixel = GPixelFormats[PixelFormat].BlockBytes;
+	Reader->TextureRHI    = MoveTemp(TextureRHI);
+
+	// staging texture of earlier bands and frames, or a new one
+	{
+		auto&           Pool = FReadbackPool::Get();
+		std::lock_guard Lock(Pool.Mutex);
+		if (!Pool.Readbacks.IsEmpty()) {
+			Reader->Readback = Pool.Readbacks.Pop();
+		}
+	}
+	if (!Reader->Readback) {
+		Reader->Readback =
+		    MakeUnique<FRHIGPUTextureReadback>(TEXT("FFmpegTextureBand"));
+	}
+
+	return Reader;
+}
+
+bool FTextureBandReader::ReadIntoImage(const FIntRect& Rect, FImage& Image) {
+	const auto& Extent = TextureRHI->GetDesc().Extent;
+	if (bTimedOut || Rect.IsEmpty() || Rect.Min.X < 0 || Rect.Min.Y < 0 ||
+	    Rect.Max.X > Extent.X || Rect.Max.Y > Extent.Y) {
+		return false;
+	}
+
+	// regions are copied at the largest size so far, shifted inside the
+	// texture, so that a shorter last band reuses the staging texture
+	CopySize = CopySize.ComponentMax(Rect.Size());
+	const FIntPoint CopyMin(FMath::Min(Rect.Min.X, Extent.X - CopySize.X),
+	                        FMath::Min(Rect.Min.Y, Extent.Y - CopySize.Y));
+	const auto&     Offset = Rect.Min - CopyMin;
+
+	// resize Image, keeping its allocation
+	Image.SizeX      = Rect.Width();
+	Image.SizeY      = Rect.Height();
+	Image.NumSlices  = 1;
+	Image.Format     = Format;
+	Image.GammaSpace = GammaSpace;
+	Image.RawData.Reset();
+	Image.RawData.AddUninitialized(Image.GetImageSizeBytes());
+
+	// On Render Thread, copy on the GPU and submit without waiting for it
+	ENQUEUE_RENDER_COMMAND(CopyTextureBand)
+	([this, CopyMin,
+	  CopySize = CopySize](FRHICommandListImmediate& RHICmdList) {
+		RHICmdList.Transition(FRHITransitionInfo(
+		    TextureRHI, ERHIAccess::Unknown, ERHIAccess::CopySrc));
+		Readback->EnqueueCopy(RHICmdList, TextureRHI,
+		                      FIntVector(CopyMin.X, CopyMin.Y, 0), 0,
+		                      FIntVector(CopySize.X, CopySize.Y, 1));
+		RHICmdList.ImmediateFlush(EImmediateFlushType::DispatchToRHIThread);
+	});
+
+	// poll the fence of the copy, and copy the rows out once it signals
+	const auto& RowBytes = static_cast<int64>(Rect.Width()) * BytesPerPixel;
+	const auto& DeadlineSeconds = FPlatformTime::Seconds() + TimeoutSeconds;
+	while (true) {
+		bool           bReady = false;
+		bool           bRead  = false;
+		TPromise<void> Poll_Promise;
+		auto           Poll_Future = Poll_Promise.GetFuture();
+
+		// On Render Thread, where the staging texture is mapped
+		ENQUEUE_RENDER_COMMAND(PollTextureBand)
+		([&](FRHICommandListImmediate&) {
+			bReady = Readback->IsReady();
+			if (bReady) {
+				int32       RowPitchInPixels = 0;
+				const auto& Data =
+				    static_cast<const uint8*>(Readback->Lock(RowPitchInPixels));
+				if (nullptr != Data) {
+					// copy row by row, skipping the padding of the pitch
+					const auto& RowPitch =
+					    static_cast<int64>(RowPitchInPixels) * BytesPerPixel;
+					auto Destination = Image.RawData.GetData();
+					for (int32 Row = 0; Row < Rect.Height(); ++Row) {
+						FMemory::Memcpy(Destination + Row * RowBytes,
+						                Data + (Offset.Y + Row) * RowPitch +
+						                    Offset.X * BytesPerPixel,
+						                RowBytes);
+					}
+					Readback->Unlock();
+					bRead = true;
+				}
+			}
+
+			// delivers on promise
+			Poll_Promise.SetValue();
+		});
+		Poll_Future.Wait();
+
+		if (bReady) {
+			return bRead;
+		}
+		if (FPlatformTime::Seconds() > DeadlineSeconds) {
+			UE_LOG(LogFFmpegEncoder, Error,
+			       TEXT("Timed out reading back a band of a texture."));
+			bTimedOut = true;
+			return false;
+		}
+		FPlatformProcess::SleepNoStats(PollSeconds);
+	}
+}
+
+FTextureBandReader::~FTextureBandReader() {
+	using namespace CreateImageFromTextureRHIImpl;
+
+	if (!Readback) {
+		return;
+	}
+
+	// a copy that timed out may still be written, so it is released after
+	// commands enqueued so far instead of being reused
+	if (bTimedOut) {
+		ENQUEUE_RENDER_COMMAND(ReleaseTextureBand)
+		([Readback = MoveTemp(Readback)](FRHICommandListImmediate&) {});
+		return;
+	}
+
+	auto&           Pool = FReadbackPool::Get();
+	std::lock_guard Lock(Pool.Mutex);
+	if (Pool.Readbacks.Num() < MaxPooledReadbacks) {
+		Pool.Readbacks.Add(MoveTemp(Readback));
+	}
+}
+
+TSharedFuture<FTextureRHIRef>
+    SnapshotTextureRHIAsync(FTextureRHIRef TextureRHI) {
+	using namespace CreateImageFromTextureRHIImpl;
+
+	// make promise to store the copy
+	auto Snapshot_Promise = MakeShared<TPromise<FTextureRHIRef>>();
+	auto Snapshot_Future  = Snapshot_Promise->GetFuture().Share();
+
+	// On Render Thread, after rendering enqueued so far
+	ENQUEUE_RENDER_COMMAND(SnapshotTexture)
+	([TextureRHI = MoveTemp(TextureRHI),
+	  Snapshot_Promise](FRHICommandListImmediate& RHICmdList) {
+		auto Snapshot = AcquireSnapshot(TextureRHI->GetDesc());
+
+		// copy on the GPU, reads of Snapshot come after it
+		TransitionAndCopyTexture(RHICmdList, TextureRHI, Snapshot, {});
+
+		// delivers on promise
+		Snapshot_Promise->SetValue(MoveTemp(Snapshot));
+	});
+
+	return Snapshot_Future;
+}
+
+void ReleaseTextureSnapshot(FTextureRHIRef&& Snapshot) {
+	using namespace CreateImageFromTextureRHIImpl;
+
+	auto&           Pool = FSnapshotPool::Get();
+	std::lock_guard Lock(Pool.Mutex);
+	if (Pool.Snapshots.Num() < MaxPooledSnapshots) {
+		Pool.Snapshots.Add(MoveTemp(Snapshot));
+	}
+}
@@ -0,0 +1,457 @@
+
+#include "FFmpegAudioEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+}
+
+#pragma region helpers
+namespace FFmpegAudioEncoderImpl {
+// audio lagging behind video by more than this is padded with silence
+constexpr double UnderrunSeconds = 0.2;
+
+// samples captured further than this from their place on the track are
+// moved to it, and jitter below it is ignored
+constexpr double ResyncSeconds = 0.02;
+
+// sample frames per encoded frame of codecs taking frames of any size
+constexpr int32 VariableFrameSize = 1024;
+
+/**
+ * @return   encoder of AudioCodec. nullptr if not found.
+ */
+const AVCodec* FindEncoder(const FFmpegAudioCodec AudioCodec) {
+	switch (AudioCodec) {
+	case FFmpegAudioCodec::AAC:
+		return avcodec_find_encoder(AV_CODEC_ID_AAC);
+	case FFmpegAudioCodec::Opus:
+		// libopus is preferred over the experimental native encoder
+		if (const auto& Codec = avcodec_find_encoder_by_name("libopus")) {
+			return Codec;
+		}
+		return avcodec_find_encoder(AV_CODEC_ID_OPUS);
+	case FFmpegAudioCodec::PCM:
+		return avcodec_find_encoder(AV_CODEC_ID_PCM_S16LE);
+	default:
+		return nullptr;
+	}
+}
+
+/**
+ * @return   sample format of Codec that float samples are converted into.
+ *           AV_SAMPLE_FMT_NONE if none is supported.
+ */
+AVSampleFormat PickSampleFormat(const AVCodec& Codec) {
+	constexpr AVSampleFormat Preferred[] = {
+	    AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16P,
+	    AV_SAMPLE_FMT_S16};
+	if (nullptr == Codec.sample_fmts) {
+		return AV_SAMPLE_FMT_FLT;
+	}
+	for (const auto& Format : Preferred) {
+		for (auto It = Codec.sample_fmts; *It != AV_SAMPLE_FMT_NONE; ++It) {
+			if (*It == Format) {
+				return Format;
+			}
+		}
+	}
+	return AV_SAMPLE_FMT_NONE;
+}
+
+/**
+ * @return   Sample in 16-bit
+ */
+FORCEINLINE int16 ToS16(const float Sample) {
+	return static_cast<int16>(
+	    FMath::RoundToInt32(FMath::Clamp(Sample, -1.0f, 1.0f) * 32767.0f));
+}
+} // namespace FFmpegAudioEncoderImpl
+#pragma endregion
+
+void FFFmpegPCMRing::Init(const int32 NumFrames, const int32 InNumChannels) {
+	NumChannels = FMath::Max(1, InNumChannels);
+	Buffer.SetNumZeroed(FMath::Max(1, NumFrames) * NumChannels);
+	PushedSamples = 0;
+	PoppedSamples = 0;
+}
+
+int32 FFFmpegPCMRing::Push(TConstArrayView<float> Samples) {
+	const auto& Capacity = static_cast<uint64>(Buffer.Num());
+	const auto& Pushed   = PushedSamples.load(std::memory_order_relaxed);
+	const auto& Popped   = PoppedSamples.load(std::memory_order_acquire);
+
+	// whole sample frames that fit
+	auto Count = static_cast<int32>(
+	    FMath::Min<uint64>(Samples.Num(), Capacity - (Pushed - Popped)));
+	Count -= Count % NumChannels;
+
+	// copy in up to two runs around the end of Buffer
+	const auto& Start = static_cast<int32>(Pushed % Capacity);
+	const auto& First = FMath::Min(Count, Buffer.Num() - Start);
+	FMemory::Memcpy(Buffer.GetData() + Start, Samples.GetData(),
+	                First * sizeof(float));
+	FMemory::Memcpy(Buffer.GetData(), Samples.GetData() + First,
+	                (Count - First) * sizeof(float));
+
+	// publish the samples to the consumer
+	PushedSamples.store(Pushed + Count, std::memory_order_release);
+	return Count;
+}
+
+int32 FFFmpegPCMRing::PushSilence(const int32 NumFrames) {
+	const auto& Capacity = static_cast<uint64>(Buffer.Num());
+	const auto& Pushed   = PushedSamples.load(std::memory_order_relaxed);
+	const auto& Popped   = PoppedSamples.load(std::memory_order_acquire);
+
+	// whole sample frames that fit
+	auto Count = static_cast<int32>(FMath::Min<uint64>(
+	    static_cast<uint64>(FMath::Max(0, NumFrames)) * NumChannels,
+	    Capacity - (Pushed - Popped)));
+	Count -= Count % NumChannels;
+
+	// zero in up to two runs around the end of Buffer
+	const auto& Start = static_cast<int32>(Pushed % Capacity);
+	const auto& First = FMath::Min(Count, Buffer.Num() - Start);
+	FMemory::Memzero(Buffer.GetData() + Start, First * sizeof(float));
+	FMemory::Memzero(Buffer.GetData(), (Count - First) * sizeof(float));
+
+	// publish the samples to the consumer
+	PushedSamples.store(Pushed + Count, std::memory_order_release);
+	return Count / NumChannels;
+}
+
+int32 FFFmpegPCMRing::Pop(TArrayView<float> Samples) {
+	const auto& Capacity = static_cast<uint64>(Buffer.Num());
+	const auto& Popped   = PoppedSamples.load(std::memory_order_relaxed);
+	const auto& Pushed   = PushedSamples.load(std::memory_order_acquire);
+
+	// the producer pushes whole sample frames only
+	const auto& Count = static_cast<int32>(
+	    FMath::Min<uint64>(Samples.Num(), Pushed - Popped));
+
+	// copy out in up to two runs around the end of Buffer
+	const auto& Start = static_cast<int32>(Popped % Capacity);
+	const auto& First = FMath::Min(Count, Buffer.Num() - Start);
+	FMemory::Memcpy(Samples.GetData(), Buffer.GetData() + Start,
+	                First * sizeof(float));
+	FMemory::Memcpy(Samples.GetData() + First, Buffer.GetData(),
+	                (Count - First) * sizeof(float));
+
+	// give the space back to the producer
+	PoppedSamples.store(Popped + Count, std::memory_order_release);
+	return Count;
+}
+
+int32 FFFmpegPCMRing::Num() const {
+	return static_cast<int32>(PushedSamples.load(std::memory_order_acquire) -
+	                          PoppedSamples.load(std::memory_order_relaxed));
+}
+
+FFFmpegAudioEncoder::~FFFmpegAudioEncoder() {
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Codec, -TrackedBytes,
+	                     MemoryUsage);
+	av_packet_free(&Packet);
+	av_frame_free(&Frame);
+	avcodec_free_context(&CodecContext);
+}
+
+bool FFFmpegAudioEncoder::Open(const FFFmpegEncoderConfig& Config,
+                               FString&                    ErrorMessage) {
+	using namespace FFmpegAudioEncoderImpl;
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		av_packet_free(&Packet);
+		av_frame_free(&Frame);
+		avcodec_free_context(&CodecContext);
+		return false;
+	};
+
+	const auto& Codec = FindEncoder(Config.AudioCodec);
+	if (nullptr == Codec) {
+		return Failure(TEXT("Audio codec is not found."));
+	}
+
+	const auto& SampleFormat = PickSampleFormat(*Codec);
+	if (AV_SAMPLE_FMT_NONE == SampleFormat) {
+		return Failure(FString::Printf(
+		    TEXT("%s takes no sample format converted from float."),
+		    UTF8_TO_TCHAR(Codec->name)));
+	}
+
+	CodecContext = avcodec_alloc_context3(Codec);
+	if (nullptr == CodecContext) {
+		return Failure(TEXT("Failed to allocate audio codec context."));
+	}
+
+	// pts counts sample frames
+	NumChannels                = Config.AudioChannels;
+	SampleRate                 = Config.AudioSampleRate;
+	CodecContext->sample_fmt   = SampleFormat;
+	CodecContext->sample_rate  = SampleRate;
+	CodecContext->bit_rate     = Config.AudioBitRate;
+	CodecContext->time_base    = {1, SampleRate};
+	CodecContext->flags       |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	av_channel_layout_default(&CodecContext->ch_layout, NumChannels);
+
+	// the native Opus encoder is experimental
+	CodecContext->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+	if (avcodec_open2(CodecContext, Codec, nullptr) < 0) {
+		return Failure(FString::Printf(
+		    TEXT("Failed to open %s with %d Hz and %d channels."),
+		    UTF8_TO_TCHAR(Codec->name), SampleRate, NumChannels));
+	}
+
+	// frames are as large as the codec takes
+	FrameSize = CodecContext->frame_size > 0 ? CodecContext->frame_size
+	                                         : VariableFrameSize;
+
+	Frame  = av_frame_alloc();
+	Packet = av_packet_alloc();
+	if (nullptr == Frame || nullptr == Packet) {
+		return Failure(TEXT("Failed to allocate audio frame."));
+	}
+	Frame->format      = CodecContext->sample_fmt;
+	Frame->sample_rate = SampleRate;
+	Frame->nb_samples  = FrameSize;
+	if (av_channel_layout_copy(&Frame->ch_layout, &CodecContext->ch_layout) <
+	        0 ||
+	    av_frame_get_buffer(Frame, 0) < 0) {
+		return Failure(TEXT("Failed to allocate audio frame."));
+	}
+
+	// allocate everything up front, so that submission never allocates
+	{
+		LLM_SCOPE_BYTAG(BlueprintFFmpeg_Codec);
+		Ring.Init(FMath::CeilToInt32(Config.AudioBufferSeconds * SampleRate),
+		          NumChannels);
+		Pending.SetNumZeroed(FrameSize * NumChannels);
+	}
+	MemoryUsage  = FFFmpegMemory::GetScopeUsage();
+	TrackedBytes = Ring.GetAllocatedSize() + Pending.GetAllocatedSize();
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Codec, TrackedBytes,
+	                     MemoryUsage);
+
+	return true;
+}
+
+bool FFFmpegAudioEncoder::AddSamples(TConstArrayView<float> InterleavedSamples,
+                                     const double           CaptureSeconds) {
+	using namespace FFmpegAudioEncoderImpl;
+
+	int64 LateFrames = 0;
+	if (CaptureSeconds < 0.0) {
+		// late by the silence the encode thread padded for them
+		const auto& Owed = OwedFrames.load(std::memory_order_relaxed);
+		LateFrames =
+		    FMath::Min<int64>(Owed, InterleavedSamples.Num() / NumChannels);
+		OwedFrames.fetch_sub(LateFrames, std::memory_order_relaxed);
+	} else {
+		// placed at the capture time on the track, which is after the
+		// samples and silence submitted so far, and the silence the encode
+		// thread padded
+		OwedFrames.store(0, std::memory_order_relaxed);
+		const auto& Position =
+		    SubmittedFrames.load(std::memory_order_relaxed) +
+		    SilentFrames.load(std::memory_order_relaxed);
+		const auto& Offset =
+		    FMath::RoundToInt64(CaptureSeconds * SampleRate) - Position;
+
+		if (Offset > ResyncSeconds * SampleRate) {
+			// captured after a gap, which is kept as silence
+			const auto& Silent = Ring.PushSilence(
+			    static_cast<int32>(FMath::Min<int64>(Offset, MAX_int32)));
+			SilentFrames.fetch_add(Silent, std::memory_order_relaxed);
+		} else if (-Offset > ResyncSeconds * SampleRate) {
+			// captured at a time already encoded, such as padded silence
+			LateFrames = FMath::Min<int64>(
+			    -Offset, InterleavedSamples.Num() / NumChannels);
+		}
+	}
+	InterleavedSamples = InterleavedSamples.RightChop(LateFrames * NumChannels);
+
+	const auto& Pushed  = Ring.Push(InterleavedSamples);
+	const auto& Dropped = InterleavedSamples.Num() - Pushed +
+	                      LateFrames * NumChannels;
+
+	SubmittedFrames.fetch_add(Pushed / NumChannels, std::memory_order_relaxed);
+	if (Dropped > 0) {
+		DroppedFrames.fetch_add(Dropped / NumChannels,
+		                        std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+bool FFFmpegAudioEncoder::Encode(
+    const double                         VideoSeconds,
+    TFunctionRef<bool(AVPacket& Packet)> WritePacket) {
+	using namespace FFmpegAudioEncoderImpl;
+
+	// encode every full frame that was submitted
+	if (!EncodeSubmitted(WritePacket)) {
+		return false;
+	}
+
+	// the ring ran dry behind the video, so keep the track in step by
+	// padding it with silence up to the video
+	const auto& PendingFrames = NumPending / NumChannels;
+	const auto& AudioSeconds =
+	    static_cast<double>(EncodedFrames + PendingFrames) / SampleRate;
+	if (VideoSeconds - AudioSeconds > UnderrunSeconds) {
+		Underruns.fetch_add(1, std::memory_order_relaxed);
+
+		auto MissingFrames =
+		    FMath::CeilToInt64((VideoSeconds - AudioSeconds) * SampleRate);
+		SilentFrames.fetch_add(MissingFrames, std::memory_order_relaxed);
+		OwedFrames.fetch_add(MissingFrames, std::memory_order_relaxed);
+		while (MissingFrames > 0) {
+			const auto& FreeFrames = FrameSize - NumPending / NumChannels;
+			const auto& Frames     = static_cast<int32>(
+			    FMath::Min<int64>(MissingFrames, FreeFrames));
+			FMemory::Memzero(Pending.GetData() + NumPending,
+			                 Frames * NumChannels * sizeof(float));
+			NumPending    += Frames * NumChannels;
+			MissingFrames -= Frames;
+			if (NumPending < Pending.Num()) {
+				break;
+			}
+			if (!EncodeSamples(Pending.GetData(), FrameSize, WritePacket)) {
+				return false;
+			}
+			NumPending = 0;
+		}
+	}
+
+	// time of the audio track ahead of the video
+	const auto& SubmittedSeconds =
+	    static_cast<double>(SubmittedFrames.load(std::memory_order_relaxed) +
+	                        SilentFrames.load(std::memory_order_relaxed)) /
+	    SampleRate;
+	DriftSeconds.store(SubmittedSeconds - VideoSeconds,
+	                   std::memory_order_relaxed);
+
+	return true;
+}
+
+bool FFFmpegAudioEncoder::Flush(
+    TFunctionRef<bool(AVPacket& Packet)> WritePacket) {
+	// take the rest of the ring
+	if (!EncodeSubmitted(WritePacket)) {
+		return false;
+	}
+
+	// the last frame is padded with silence for codecs of a fixed size
+	if (NumPending > 0) {
+		auto NumFrames = NumPending / NumChannels;
+		if (0 == (CodecContext->codec->capabilities &
+		          (AV_CODEC_CAP_SMALL_LAST_FRAME |
+		           AV_CODEC_CAP_VARIABLE_FRAME_SIZE))) {
+			FMemory::Memzero(Pending.GetData() + NumPending,
+			                 (Pending.Num() - NumPending) * sizeof(float));
+			NumFrames = FrameSize;
+		}
+		if (!EncodeSamples(Pending.GetData(), NumFrames, WritePacket)) {
+			return false;
+		}
+		NumPending = 0;
+	}
+
+	// drain the encoder
+	if (avcodec_send_frame(CodecContext, nullptr) != 0) {
+		return false;
+	}
+	return ReceivePackets(WritePacket);
+}
+
+void FFFmpegAudioEncoder::GetStats(FFFmpegEncoderStats& Stats) const {
+	Stats.AudioDriftMilliseconds =
+	    DriftSeconds.load(std::memory_order_relaxed) * 1000.0;
+	Stats.AudioUnderruns     = Underruns.load(std::memory_order_relaxed);
+	Stats.AudioSilentSamples = SilentFrames.load(std::memory_order_relaxed);
+	Stats.AudioDroppedSamples = DroppedFrames.load(std::memory_order_relaxed);
+}
+
+bool FFFmpegAudioEncoder::EncodeSubmitted(
+    TFunctionRef<bool(AVPacket& Packet)> WritePacket) {
+	while (true) {
+		NumPending +=
+		    Ring.Pop(TArrayView<float>(Pending).RightChop(NumPending));
+		if (NumPending < Pending.Num()) {
+			return true;
+		}
+		if (!EncodeSamples(Pending.GetData(), FrameSize, WritePacket)) {
+			return false;
+		}
+		NumPending = 0;
+	}
+}
+
+bool FFFmpegAudioEncoder::EncodeSamples(
+    const float* Samples, const int32 NumFrames,
+    TFunctionRef<bool(AVPacket& Packet)> WritePacket) {
+	using namespace FFmpegAudioEncoderImpl;
+
+	// the encoder may still reference the previous frame
+	if (av_frame_make_writable(Frame) < 0) {
+		return false;
+	}
+	Frame->nb_samples = NumFrames;
+
+	// deinterleave or convert into the sample format of the codec
+	switch (CodecContext->sample_fmt) {
+	case AV_SAMPLE_FMT_FLTP:
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel) {
+			auto Plane =
+			    reinterpret_cast<float*>(Frame->extended_data[Channel]);
+			for (int32 Index = 0; Index < NumFrames; ++Index) {
+				Plane[Index] = Samples[Index * NumChannels + Channel];
+			}
+		}
+		break;
+	case AV_SAMPLE_FMT_FLT:
+		FMemory::Memcpy(Frame->extended_data[0], Samples,
+		                NumFrames * NumChannels * sizeof(float));
+		break;
+	case AV_SAMPLE_FMT_S16P:
+		for (int32 Channel = 0; Channel < NumChannels; ++Channel) {
+			auto Plane =
+			    reinterpret_cast<int16*>(Frame->extended_data[Channel]);
+			for (int32 Index = 0; Index < NumFrames; ++Index) {
+				Plane[Index] = ToS16(Samples[Index * NumChannels + Channel]);
+			}
+		}
+		break;
+	default: {
+		auto Data = reinterpret_cast<int16*>(Frame->extended_data[0]);
+		for (int32 Index = 0; Index < NumFrames * NumChannels; ++Index) {
+			Data[Index] = ToS16(Samples[Index]);
+		}
+		break;
+	}
+	}
+
+	// pts counts sample frames
+	Frame->pts     = EncodedFrames;
+	EncodedFrames += NumFrames;
+
+	if (avcodec_send_frame(CodecContext, Frame) != 0) {
+		return false;
+	}
+	return ReceivePackets(WritePacket);
+}
+
+bool FFFmpegAudioEncoder::ReceivePackets(
+    TFunctionRef<bool(AVPacket& Packet)> WritePacket) {
+	while (avcodec_receive_packet(CodecContext, Packet) == 0) {
+		const auto& bWritten = WritePacket(*Packet);
+		av_packet_unref(Packet);
+		if (!bWritten) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,553 @@
+
+#include "FFmpegColorConversion.h"
+
+#include "Async/ParallelFor.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#pragma region helpers
+namespace FFmpegColorConversionImpl {
+// rows converted by a task of ConvertLinearImage. must be even.
+constexpr int32 RowsPerTask = 32;
+
+/**
+ * Converts linear RGBA pixels to quantized limited range YUV.
+ * Works on 2x2 blocks, the unit of 4:2:0 chroma subsampling.
+ */
+class FLinearToYUVKernel {
+public:
+	FLinearToYUVKernel(const FFmpegColorTransfer InColorTransfer,
+	                   const FFmpegToneMapping InToneMapping,
+	                   const float PaperWhiteNits, const int32 BitDepth)
+	    : ColorTransfer(InColorTransfer), ToneMapping(InToneMapping),
+	      PQScale(VectorSetFloat1(PaperWhiteNits / 10000.0f)) {
+		// HDR10 uses BT.2020 matrix, SDR uses BT.709 matrix
+		const bool  bBT2020 = ColorTransfer == FFmpegColorTransfer::PQ;
+		const float Kr      = bBT2020 ? 0.2627f : 0.2126f;
+		const float Kb      = bBT2020 ? 0.0593f : 0.0722f;
+
+		LumaWeights = MakeVectorRegisterFloat(Kr, 1.0f - Kr - Kb, Kb, 0.0f);
+		CbScale     = 0.5f / (1.0f - Kb);
+		CrScale     = 0.5f / (1.0f - Kr);
+
+		// limited range codes scale with bit depth
+		const float CodeScale = static_cast<float>(1 << (BitDepth - 8));
+		LumaOffset            = 16.0f * CodeScale;
+		LumaRange             = 219.0f * CodeScale;
+		ChromaOffset          = 128.0f * CodeScale;
+		ChromaRange           = 224.0f * CodeScale;
+		MaxCode               = (1 << BitDepth) - 1;
+	}
+
+	/**
+	 * @param Pixels   linear RGBA of top-left, top-right, bottom-left and
+	 *                 bottom-right pixels.
+	 */
+	FORCEINLINE void ConvertBlock(const VectorRegister4Float (&Pixels)[4],
+	                              int32 (&OutLuma)[4], int32& OutCb,
+	                              int32& OutCr) const {
+		// chroma is computed from the mean of non-linear values
+		VectorRegister4Float Sum = VectorZero();
+
+		for (int32 Index = 0; Index < 4; ++Index) {
+			const auto Encoded = Encode(Pixels[Index]);
+			OutLuma[Index]     = Quantize(Luma(Encoded), LumaOffset, LumaRange);
+			Sum                = VectorAdd(Sum, Encoded);
+		}
+
+		const auto  Mean     = VectorMultiply(Sum, VectorSetFloat1(0.25f));
+		const float MeanLuma = Luma(Mean);
+
+		OutCb = Quantize((VectorGetComponent(Mean, 2) - MeanLuma) * CbScale,
+		                 ChromaOffset, ChromaRange);
+		OutCr = Quantize((VectorGetComponent(Mean, 0) - MeanLuma) * CrScale,
+		                 ChromaOffset, ChromaRange);
+	}
+
+private:
+	// linear RGBA to non-linear R'G'B' in [0, 1]
+	FORCEINLINE VectorRegister4Float Encode(VectorRegister4Float Value) const {
+		Value = VectorMax(Value, VectorZero());
+
+		if (ColorTransfer == FFmpegColorTransfer::PQ) {
+			// BT.709 primaries to BT.2020 primaries
+			Value = VectorMultiplyAdd(
+			    VectorReplicate(Value, 0), BT709ToBT2020[0],
+			    VectorMultiplyAdd(
+			        VectorReplicate(Value, 1), BT709ToBT2020[1],
+			        VectorMultiply(VectorReplicate(Value, 2), BT709ToBT2020[2])));
+
+			return EncodePQ(Value);
+		}
+
+		Value = ToneMap(Value);
+
+		return ColorTransfer == FFmpegColorTransfer::SRGB ? EncodeSRGB(Value)
+		                                                  : EncodeBT709(Value);
+	}
+
+	FORCEINLINE VectorRegister4Float
+	    ToneMap(const VectorRegister4Float& Value) const {
+		switch (ToneMapping) {
+		case FFmpegToneMapping::Reinhard:
+			// x / (1 + x)
+			return VectorDivide(Value, VectorAdd(Value, VectorOne()));
+		case FFmpegToneMapping::ACES: {
+			// Narkowicz fit: x(2.51x + 0.03) / (x(2.43x + 0.59) + 0.14)
+			const auto Numerator = VectorMultiply(
+			    Value, VectorMultiplyAdd(Value, VectorSetFloat1(2.51f),
+			                             VectorSetFloat1(0.03f)));
+			const auto Denominator = VectorMultiplyAdd(
+			    Value,
+			    VectorMultiplyAdd(Value, VectorSetFloat1(2.43f),
+			                      VectorSetFloat1(0.59f)),
+			    VectorSetFloat1(0.14f));
+			return VectorDivide(Numerator, Denominator);
+		}
+		default:
+			return Value;
+		}
+	}
+
+	static FORCEINLINE VectorRegister4Float
+	    EncodeSRGB(const VectorRegister4Float& Value) {
+		const auto Linear = VectorMultiply(Value, VectorSetFloat1(12.92f));
+		const auto Curve =
+		    VectorMultiplyAdd(VectorPow(Value, VectorSetFloat1(1.0f / 2.4f)),
+		                      VectorSetFloat1(1.055f), VectorSetFloat1(-0.055f));
+		const auto IsLinear = VectorCompareLE(Value, VectorSetFloat1(0.0031308f));
+		return VectorMin(VectorSelect(IsLinear, Linear, Curve), VectorOne());
+	}
+
+	static FORCEINLINE VectorRegister4Float
+	    EncodeBT709(const VectorRegister4Float& Value) {
+		const auto Linear = VectorMultiply(Value, VectorSetFloat1(4.5f));
+		const auto Curve =
+		    VectorMultiplyAdd(VectorPow(Value, VectorSetFloat1(0.45f)),
+		                      VectorSetFloat1(1.099f), VectorSetFloat1(-0.099f));
+		const auto IsLinear = VectorCompareLT(Value, VectorSetFloat1(0.018f));
+		return VectorMin(VectorSelect(IsLinear, Linear, Curve), VectorOne());
+	}
+
+	FORCEINLINE VectorRegister4Float
+	    EncodePQ(const VectorRegister4Float& Value) const {
+		// SMPTE ST 2084 constants
+		constexpr float M1 = 0.1593017578125f;
+		constexpr float M2 = 78.84375f;
+		constexpr float C1 = 0.8359375f;
+		constexpr float C2 = 18.8515625f;
+		constexpr float C3 = 18.6875f;
+
+		// normalize to 10000 nits
+		const auto Luminance =
+		    VectorMin(VectorMultiply(Value, PQScale), VectorOne());
+		const auto Power = VectorPow(Luminance, VectorSetFloat1(M1));
+		const auto Ratio = VectorDivide(
+		    VectorMultiplyAdd(Power, VectorSetFloat1(C2), VectorSetFloat1(C1)),
+		    VectorMultiplyAdd(Power, VectorSetFloat1(C3), VectorOne()));
+		return VectorPow(Ratio, VectorSetFloat1(M2));
+	}
+
+	FORCEINLINE float Luma(const VectorRegister4Float& Encoded) const {
+		return VectorGetComponent(VectorDot3(Encoded, LumaWeights), 0);
+	}
+
+	FORCEINLINE int32 Quantize(const float Value, const float Offset,
+	                           const float Range) const {
+		return FMath::Clamp(FMath::RoundToInt(Offset + Value * Range), 0,
+		                    MaxCode);
+	}
+
+private:
+	// columns of BT.709 to BT.2020 matrix (ITU-R BT.2087)
+	inline static const VectorRegister4Float BT709ToBT2020[3] = {
+	    MakeVectorRegisterFloat(0.6274f, 0.0691f, 0.0164f, 0.0f),
+	    MakeVectorRegisterFloat(0.3293f, 0.9195f, 0.0880f, 0.0f),
+	    MakeVectorRegisterFloat(0.0433f, 0.0114f, 0.8956f, 0.0f)};
+
+	FFmpegColorTransfer  ColorTransfer;
+	FFmpegToneMapping    ToneMapping;
+	VectorRegister4Float PQScale;
+	VectorRegister4Float LumaWeights;
+	float                CbScale;
+	float                CrScale;
+	float                LumaOffset;
+	float                LumaRange;
+	float                ChromaOffset;
+	float                ChromaRange;
+	int32                MaxCode;
+};
+
+/**
+ * Color properties tagged on frames and streams
+ */
+struct FColorProperties {
+	AVColorPrimaries              Primaries;
+	AVColorTransferCharacteristic Transfer;
+	AVColorSpace                  Matrix;
+};
+
+FColorProperties ColorPropertiesOf(const FFmpegColorTransfer ColorTransfer) {
+	switch (ColorTransfer) {
+	case FFmpegColorTransfer::BT709:
+		return {AVCOL_PRI_BT709, AVCOL_TRC_BT709, AVCOL_SPC_BT709};
+	case FFmpegColorTransfer::PQ:
+		return {AVCOL_PRI_BT2020, AVCOL_TRC_SMPTE2084, AVCOL_SPC_BT2020_NCL};
+	default:
+		return {AVCOL_PRI_BT709, AVCOL_TRC_IEC61966_2_1, AVCOL_SPC_BT709};
+	}
+}
+
+template <ERawImageFormat::Type SrcFormat>
+FORCEINLINE VectorRegister4Float LoadPixel(const uint8* Row, const int32 X) {
+	if constexpr (SrcFormat == ERawImageFormat::RGBA32F) {
+		return VectorLoad(reinterpret_cast<const float*>(Row) + X * 4);
+	} else {
+		alignas(16) float Pixel[4];
+		FPlatformMath::VectorLoadHalf(
+		    Pixel, reinterpret_cast<const uint16*>(Row) + X * 4);
+		return VectorLoadAligned(Pixel);
+	}
+}
+
+/**
+ * Source whose pixels map one to one onto the destination
+ */
+template <ERawImageFormat::Type SrcFormat>
+struct TDirectSource {
+	const uint8* Rows;
+	int64        Stride;
+
+	FORCEINLINE VectorRegister4Float Sample(const int32 X, const int32 Y) const {
+		return LoadPixel<SrcFormat>(Rows + Y * Stride, X);
+	}
+};
+
+/**
+ * Source resampled bilinearly onto the destination, so that scaling is fused
+ * with the color conversion.
+ */
+template <ERawImageFormat::Type SrcFormat>
+struct TBilinearSource {
+	const uint8* Rows;
+	int64        Stride;
+	int32        Width;
+	int32        Height;
+	float        ScaleX;
+	float        ScaleY;
+
+	FORCEINLINE VectorRegister4Float Sample(const int32 X, const int32 Y) const {
+		// map destination pixel center onto source
+		const float SrcX =
+		    FMath::Clamp((X + 0.5f) * ScaleX - 0.5f, 0.0f, Width - 1.0f);
+		const float SrcY =
+		    FMath::Clamp((Y + 0.5f) * ScaleY - 0.5f, 0.0f, Height - 1.0f);
+
+		const int32 X0 = FMath::FloorToInt(SrcX);
+		const int32 Y0 = FMath::FloorToInt(SrcY);
+		const int32 X1 = FMath::Min(X0 + 1, Width - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Height - 1);
+
+		const auto WeightX = VectorSetFloat1(SrcX - X0);
+		const auto WeightY = VectorSetFloat1(SrcY - Y0);
+
+		const uint8* Top    = Rows + Y0 * Stride;
+		const uint8* Bottom = Rows + Y1 * Stride;
+
+		const auto TopLeft  = LoadPixel<SrcFormat>(Top, X0);
+		const auto BotLeft  = LoadPixel<SrcFormat>(Bottom, X0);
+		const auto TopMixed = VectorMultiplyAdd(
+		    VectorSubtract(LoadPixel<SrcFormat>(Top, X1), TopLeft), WeightX,
+		    TopLeft);
+		const auto BotMixed = VectorMultiplyAdd(
+		    VectorSubtract(LoadPixel<SrcFormat>(Bottom, X1), BotLeft), WeightX,
+		    BotLeft);
+
+		return VectorMultiplyAdd(VectorSubtract(BotMixed, TopMixed), WeightY,
+		                         TopMixed);
+	}
+};
+
+template <typename Sample_T>
+FORCEINLINE void StoreSample(uint8* Plane, const int32 LineSize, const int32 X,
+                             const int32 Y, const int32 Value) {
+	reinterpret_cast<Sample_T*>(Plane + static_cast<int64>(Y) * LineSize)[X] =
+	    static_cast<Sample_T>(Value);
+}
+
+/**
+ * Convert rows [RowBegin, RowEnd) of a Width wide destination region.
+ * @tparam Sample_T   uint8 for 8-bit, uint16 for 10-bit formats
+ * @tparam bSemiPlanar   whether chroma is interleaved in data[1] (P010)
+ * @tparam Shift   left shift of codes (6 for P010)
+ */
+template <typename Source_T, typename Sample_T, bool bSemiPlanar, int32 Shift>
+void ConvertRows(const FLinearToYUVKernel& Kernel, const Source_T& Source,
+                 const int32 Width, const int32 RowBegin, const int32 RowEnd,
+                 const FIntPoint DstOrigin, AVFrame& Frame) {
+	for (int32 Row = RowBegin; Row < RowEnd; Row += 2) {
+		// the last odd row is paired with itself
+		const bool  bHasBottom = Row + 1 < RowEnd;
+		const int32 Bottom     = bHasBottom ? Row + 1 : Row;
+		const int32 DstY       = DstOrigin.Y + Row;
+
+		for (int32 Column = 0; Column < Width; Column += 2) {
+			// the last odd column is paired with itself
+			const bool  bHasRight = Column + 1 < Width;
+			const int32 Right     = bHasRight ? Column + 1 : Column;
+			const int32 DstX      = DstOrigin.X + Column;
+
+			const VectorRegister4Float Pixels[4] = {
+			    Source.Sample(Column, Row), Source.Sample(Right, Row),
+			    Source.Sample(Column, Bottom), Source.Sample(Right, Bottom)};
+
+			int32 Luma[4];
+			int32 Cb;
+			int32 Cr;
+			Kernel.ConvertBlock(Pixels, Luma, Cb, Cr);
+
+			// store luma
+			StoreSample<Sample_T>(Frame.data[0], Frame.linesize[0], DstX, DstY,
+			                      Luma[0] << Shift);
+			if (bHasRight) {
+				StoreSample<Sample_T>(Frame.data[0], Frame.linesize[0], DstX + 1,
+				                      DstY, Luma[1] << Shift);
+			}
+			if (bHasBottom) {
+				StoreSample<Sample_T>(Frame.data[0], Frame.linesize[0], DstX,
+				                      DstY + 1, Luma[2] << Shift);
+				if (bHasRight) {
+					StoreSample<Sample_T>(Frame.data[0], Frame.linesize[0], DstX + 1,
+					                      DstY + 1, Luma[3] << Shift);
+				}
+			}
+
+			// store chroma
+			const int32 ChromaX = DstX / 2;
+			const int32 ChromaY = DstY / 2;
+			if constexpr (bSemiPlanar) {
+				StoreSample<Sample_T>(Frame.data[1], Frame.linesize[1], ChromaX * 2,
+				                      ChromaY, Cb << Shift);
+				StoreSample<Sample_T>(Frame.data[1], Frame.linesize[1],
+				                      ChromaX * 2 + 1, ChromaY, Cr << Shift);
+			} else {
+				StoreSample<Sample_T>(Frame.data[1], Frame.linesize[1], ChromaX,
+				                      ChromaY, Cb << Shift);
+				StoreSample<Sample_T>(Frame.data[2], Frame.linesize[2], ChromaX,
+				                      ChromaY, Cr << Shift);
+			}
+		}
+	}
+}
+
+template <typename Source_T>
+void ConvertRows(const FLinearToYUVKernel& Kernel, const Source_T& Source,
+                 const int32 Width, const int32 RowBegin, const int32 RowEnd,
+                 const FIntPoint DstOrigin, AVFrame& Frame) {
+	switch (Frame.format) {
+	case AV_PIX_FMT_YUV420P:
+		return ConvertRows<Source_T, uint8, false, 0>(
+		    Kernel, Source, Width, RowBegin, RowEnd, DstOrigin, Frame);
+	case AV_PIX_FMT_YUV420P10LE:
+		return ConvertRows<Source_T, uint16, false, 0>(
+		    Kernel, Source, Width, RowBegin, RowEnd, DstOrigin, Frame);
+	case AV_PIX_FMT_P010LE:
+		return ConvertRows<Source_T, uint16, true, 6>(
+		    Kernel, Source, Width, RowBegin, RowEnd, DstOrigin, Frame);
+	default:
+		checkNoEntry();
+	}
+}
+
+/**
+ * Convert a destination region in parallel bands of rows.
+ */
+template <typename Source_T>
+void ConvertRegion(const FLinearToYUVKernel& Kernel, const Source_T& Source,
+                   const FIntRect& DstRegion, const EParallelForFlags Flags,
+                   AVFrame& Frame) {
+	const auto& Width    = DstRegion.Width();
+	const auto& Height   = DstRegion.Height();
+	const auto& NumTasks = FMath::DivideAndRoundUp(Height, RowsPerTask);
+
+	ParallelFor(
+	    NumTasks,
+	    [&](const int32 TaskIndex) {
+		    const auto& RowBegin = TaskIndex * RowsPerTask;
+		    const auto& RowEnd   = FMath::Min(RowBegin + RowsPerTask, Height);
+
+		    ConvertRows(Kernel, Source, Width, RowBegin, RowEnd, DstRegion.Min,
+		                Frame);
+	    },
+	    Flags);
+}
+} // namespace FFmpegColorConversionImpl
+#pragma endregion
+
+FFFmpegColorConversion::FFFmpegColorConversion(
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig)
+    : ColorTransfer(FFmpegEncoderConfig.ColorTransfer),
+      ToneMapping(FFmpegEncoderConfig.ToneMapping),
+      PaperWhiteNits(FFmpegEncoderConfig.PaperWhiteNits),
+      ParallelForFlags(FFmpegEncoderConfig.GetConversionParallelForFlags()) {}
+
+AVPixelFormat
+    FFFmpegColorConversion::PixelFormatOf(FFmpegPixelFormat PixelFormat) noexcept {
+	switch (PixelFormat) {
+	case FFmpegPixelFormat::YUV420P:
+		return AV_PIX_FMT_YUV420P;
+	case FFmpegPixelFormat::YUV420P10:
+		return AV_PIX_FMT_YUV420P10LE;
+	case FFmpegPixelFormat::P010:
+		return AV_PIX_FMT_P010LE;
+	default:
+		return AV_PIX_FMT_NONE;
+	}
+}
+
+bool FFFmpegColorConversion::IsFloatFormat(
+    ERawImageFormat::Type Format) noexcept {
+	switch (Format) {
+	case ERawImageFormat::RGBA16F:
+	case ERawImageFormat::RGBA32F:
+	case ERawImageFormat::R16F:
+	case ERawImageFormat::R32F:
+	case ERawImageFormat::BGRE8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool FFFmpegColorConversion::CanConvertTo(AVPixelFormat PixelFormat) noexcept {
+	return PixelFormat == AV_PIX_FMT_YUV420P ||
+	       PixelFormat == AV_PIX_FMT_YUV420P10LE ||
+	       PixelFormat == AV_PIX_FMT_P010LE;
+}
+
+bool FFFmpegColorConversion::RequiresLinearConversion(
+    ERawImageFormat::Type SrcFormat, AVPixelFormat DstFormat) const {
+	// HDR output needs primaries conversion that swscale doesn't do
+	return CanConvertTo(DstFormat) &&
+	       (IsFloatFormat(SrcFormat) ||
+	        ColorTransfer == FFmpegColorTransfer::PQ);
+}
+
+void FFFmpegColorConversion::SetColorProperties(AVFrame& Frame) const {
+	const auto& Properties =
+	    FFmpegColorConversionImpl::ColorPropertiesOf(ColorTransfer);
+
+	Frame.color_range     = AVCOL_RANGE_MPEG;
+	Frame.color_primaries = Properties.Primaries;
+	Frame.color_trc       = Properties.Transfer;
+	Frame.colorspace      = Properties.Matrix;
+}
+
+void FFFmpegColorConversion::SetColorProperties(
+    AVCodecContext& CodecContext) const {
+	const auto& Properties =
+	    FFmpegColorConversionImpl::ColorPropertiesOf(ColorTransfer);
+
+	CodecContext.color_range     = AVCOL_RANGE_MPEG;
+	CodecContext.color_primaries = Properties.Primaries;
+	CodecContext.color_trc       = Properties.Transfer;
+	CodecContext.colorspace      = Properties.Matrix;
+}
+
+void FFFmpegColorConversion::SetColorProperties(SwsContext& SwsContext) const {
+	const auto& Coefficients = sws_getCoefficients(
+	    ColorTransfer == FFmpegColorTransfer::PQ ? SWS_CS_BT2020
+	                                             : SWS_CS_ITU709);
+
+	// full range RGB to limited range YUV, brightness, contrast and saturation
+	// are left as they are.
+	sws_setColorspaceDetails(&SwsContext, Coefficients, 1, Coefficients, 0, 0,
+	                         1 << 16, 1 << 16);
+}
+
+void FFFmpegColorConversion::ConvertLinearImage(const FImage& Image,
+                                                AVFrame&      Frame) const {
+	return ConvertLinearImage(Image,
+	                          FIntRect(0, 0, Image.GetWidth(), Image.GetHeight()),
+	                          Frame, FIntRect(0, 0, Frame.width, Frame.height));
+}
+
+void FFFmpegColorConversion::ConvertLinearImage(const FImage&   Image,
+                                                const FIntRect& SrcRegion,
+                                                AVFrame&        Frame,
+                                                const FIntRect& DstRegion) const {
+	using namespace FFmpegColorConversionImpl;
+
+	// 4:2:0 blocks must not straddle the origin
+	check(DstRegion.Min.X % 2 == 0 && DstRegion.Min.Y % 2 == 0);
+	check(CanConvertTo(static_cast<AVPixelFormat>(Frame.format)));
+
+	const FLinearToYUVKernel Kernel(
+	    ColorTransfer, ToneMapping, PaperWhiteNits,
+	    Frame.format == AV_PIX_FMT_YUV420P ? 8 : 10);
+
+	const auto& BytesPerPixel = Image.GetBytesPerPixel();
+	const auto& SrcStride = static_cast<int64>(Image.GetWidth()) * BytesPerPixel;
+	const auto& SrcRows   = Image.RawData.GetData() +
+	                      SrcRegion.Min.Y * SrcStride +
+	                      SrcRegion.Min.X * BytesPerPixel;
+
+	// resample only if the size changes
+	const bool bScaled = SrcRegion.Size() != DstRegion.Size();
+
+	const auto& Convert = [&]<ERawImageFormat::Type SrcFormat>() {
+		if (bScaled) {
+			const TBilinearSource<SrcFormat> Source{
+			    SrcRows,
+			    SrcStride,
+			    SrcRegion.Width(),
+			    SrcRegion.Height(),
+			    static_cast<float>(SrcRegion.Width()) / DstRegion.Width(),
+			    static_cast<float>(SrcRegion.Height()) / DstRegion.Height()};
+			ConvertRegion(Kernel, Source, DstRegion, ParallelForFlags, Frame);
+		} else {
+			const TDirectSource<SrcFormat> Source{SrcRows, SrcStride};
+			ConvertRegion(Kernel, Source, DstRegion, ParallelForFlags, Frame);
+		}
+	};
+
+	switch (Image.Format) {
+	case ERawImageFormat::RGBA16F:
+		return Convert.template operator()<ERawImageFormat::RGBA16F>();
+	case ERawImageFormat::RGBA32F:
+		return Convert.template operator()<ERawImageFormat::RGBA32F>();
+	default:
+		checkf(false, TEXT("Only RGBA16F and RGBA32F can be converted."));
+	}
+}
+
+void FFFmpegColorConversion::ConvertLinearRows(
+    const uint8* SrcRows, const int64 SrcStride,
+    const ERawImageFormat::Type SrcFormat, const int32 Width,
+    const int32 NumRows, const FIntPoint DstOrigin, AVFrame& Frame) const {
+	using namespace FFmpegColorConversionImpl;
+
+	// 4:2:0 blocks must not straddle the origin
+	check(DstOrigin.X % 2 == 0 && DstOrigin.Y % 2 == 0);
+	check(CanConvertTo(static_cast<AVPixelFormat>(Frame.format)));
+
+	const FLinearToYUVKernel Kernel(
+	    ColorTransfer, ToneMapping, PaperWhiteNits,
+	    Frame.format == AV_PIX_FMT_YUV420P ? 8 : 10);
+
+	switch (SrcFormat) {
+	case ERawImageFormat::RGBA16F:
+		return ConvertRows(
+		    Kernel, TDirectSource<ERawImageFormat::RGBA16F>{SrcRows, SrcStride},
+		    Width, 0, NumRows, DstOrigin, Frame);
+	case ERawImageFormat::RGBA32F:
+		return ConvertRows(
+		    Kernel, TDirectSource<ERawImageFormat::RGBA32F>{SrcRows, SrcStride},
+		    Width, 0, NumRows, DstOrigin, Frame);
+	default:
+		checkf(false, TEXT("Only RGBA16F and RGBA32F can be converted."));
+	}
+}
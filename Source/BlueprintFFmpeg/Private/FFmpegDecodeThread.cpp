@@ -0,0 +1,388 @@
+
+#include "FFmpegDecodeThread.h"
+
+#include "FFmpegUtils.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+FImage FFFmpegDecodedImagePool::Acquire(const int32 Width,
+                                        const int32 Height) {
+	{
+		std::lock_guard Lock(Mutex);
+
+		const auto& Index =
+		    Images.IndexOfByPredicate([&](const FImage& Image) {
+			    return Image.GetWidth() == Width && Image.GetHeight() == Height;
+		    });
+		if (INDEX_NONE != Index) {
+			auto Image = MoveTemp(Images[Index]);
+			Images.RemoveAtSwap(Index);
+			return Image;
+		}
+	}
+
+	return FImage(Width, Height, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+}
+
+void FFFmpegDecodedImagePool::Release(FImage&& Image) {
+	std::lock_guard Lock(Mutex);
+	if (Images.Num() < MaxPooledImages) {
+		Images.Add(MoveTemp(Image));
+	}
+}
+
+void FFFmpegDecodeThread::Open(const FFFmpegDecoderConfig& FFmpegDecoderConfig,
+                               const FString&              InputFilePath,
+                               FFmpegDecoderOpenResult&    Result,
+                               FString&                    ErrorMessage) {
+	// helper function to finish with success
+	const auto& Success = [&]() {
+		Result = FFmpegDecoderOpenResult::Success;
+	};
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		Result = FFmpegDecoderOpenResult::Failure;
+	};
+
+	// Open function must be called only once.
+	checkf(!bOpened, TEXT("Open function has already been called once."));
+
+	// Mark as opened
+	bOpened = true;
+
+	// copy Config
+	Config = FFmpegDecoderConfig;
+
+	// open input
+	const auto& Path = StringCast<UTF8CHAR>(*InputFilePath);
+	if (avformat_open_input(&FormatContext,
+	                        reinterpret_cast<const char*>(Path.Get()), nullptr,
+	                        nullptr) < 0) {
+		return Failure(FString::Printf(TEXT("Failed to open %s."),
+		                               *InputFilePath));
+	}
+	if (avformat_find_stream_info(FormatContext, nullptr) < 0) {
+		return Failure("Failed to find stream information.");
+	}
+
+	// find the first video stream
+	StreamIndex = av_find_best_stream(FormatContext, AVMEDIA_TYPE_VIDEO, -1, -1,
+	                                  nullptr, 0);
+	if (StreamIndex < 0) {
+		return Failure("No video stream is found.");
+	}
+	const auto& Stream = FormatContext->streams[StreamIndex];
+
+	// open decoder, which decodes frames and slices in parallel
+	CodecContext = UFFmpegUtils::OpenVideoDecoder(*Stream, Config.Threads);
+	if (nullptr == CodecContext) {
+		return Failure("Failed to open decoder.");
+	}
+
+	// size of decoded images
+	Size = FIntPoint(Config.Width > 0 ? Config.Width : CodecContext->width,
+	                 Config.Height > 0 ? Config.Height : CodecContext->height);
+
+	// timing of input media
+	FrameRate =
+	    av_q2d(av_guess_frame_rate(FormatContext, Stream, nullptr));
+	Duration = AV_NOPTS_VALUE == FormatContext->duration
+	               ? 0.0
+	               : static_cast<double>(FormatContext->duration) /
+	                     AV_TIME_BASE;
+
+	// create decode thread
+	Thread = FRunnableThread::Create(this, TEXT("FFmpeg decode thread"));
+	if (nullptr == Thread) {
+		return Failure("Failed to create decode thread.");
+	}
+
+	// finish as success
+	return Success();
+}
+
+void FFFmpegDecodeThread::Close() {
+	// Open function must be called
+	ensureMsgf(bOpened, TEXT("You called Close function even though you didn't "
+	                         "call Open function."));
+
+	// and Close function must not be called.
+	checkf(!bClosed, TEXT("Close function has already been called once."));
+
+	// Mark as closed
+	bClosed = true;
+
+	// stop background thread
+	Stop();
+}
+
+FFmpegDecoderReadFrameResult
+    FFFmpegDecodeThread::ReadFrame(FFFmpegDecodedFrame& Frame,
+                                   const bool           bWait) {
+	using enum FFmpegDecoderReadFrameResult;
+
+	std::unique_lock lk(Frames_mutex);
+
+	// wait for the decode thread if requested
+	if (bWait) {
+		ReadFrame_cv.wait(lk, [&]() {
+			return !Frames.IsEmpty() || bEndOfStream || !bRunning;
+		});
+	}
+
+	// if nothing is decoded ahead
+	if (Frames.IsEmpty()) {
+		return bEndOfStream || !bRunning ? EndOfStream : NotReady;
+	}
+
+	// take the first frame
+	auto& Prefetched = Frames.First();
+	DecodeAheadSeconds += FPlatformTime::Seconds() - Prefetched.DecodedAt;
+	++ReadFrames;
+	Frame = MoveTemp(Prefetched.Frame);
+	Frames.PopFirst();
+
+	// notify the decode thread that the queue has room
+	DecodeThread_cv.notify_one();
+
+	return Success;
+}
+
+void FFFmpegDecodeThread::ReleaseImage(FImage&& Image) {
+	ImagePool->Release(MoveTemp(Image));
+}
+
+void FFFmpegDecodeThread::Seek(const double Seconds) {
+	std::lock_guard lk(Frames_mutex);
+
+	// discard frames decoded ahead
+	for (auto& Prefetched : Frames) {
+		ImagePool->Release(MoveTemp(Prefetched.Frame.Image));
+	}
+	Frames.Reset();
+
+	// frames being decoded are discarded by the generation
+	SeekSeconds = FMath::Max(Seconds, 0.0);
+	++SeekGeneration;
+	bEndOfStream = false;
+
+	// notify the decode thread to seek
+	DecodeThread_cv.notify_one();
+}
+
+FFFmpegDecoderStats FFFmpegDecodeThread::GetStats() {
+	std::lock_guard lk(Frames_mutex);
+
+	FFFmpegDecoderStats Stats;
+	Stats.DecodedFrames = DecodedFrames;
+	Stats.DecodeFramesPerSecond =
+	    DecodeSeconds > 0.0 ? DecodedFrames / DecodeSeconds : 0.0;
+	Stats.PrefetchedFrames = Frames.Num();
+	Stats.DecodeAheadMilliseconds =
+	    ReadFrames > 0 ? DecodeAheadSeconds * 1000.0 / ReadFrames : 0.0;
+	return Stats;
+}
+
+TSharedRef<FFFmpegDecodedImagePool, ESPMode::ThreadSafe>
+    FFFmpegDecodeThread::GetImagePool() const {
+	return ImagePool;
+}
+
+FIntPoint FFFmpegDecodeThread::GetSize() const {
+	return Size;
+}
+
+double FFFmpegDecodeThread::GetDuration() const {
+	return Duration;
+}
+
+double FFFmpegDecodeThread::GetFrameRate() const {
+	return FrameRate;
+}
+
+FFFmpegDecodeThread::~FFFmpegDecodeThread() {
+	if (Thread) {
+		// wait to finish thread
+		Thread->Kill(true);
+
+		// release memory for Thread
+		delete Thread;
+	}
+
+	// free resources
+	avcodec_free_context(&CodecContext);
+	avformat_close_input(&FormatContext);
+}
+
+#pragma region Run on the new thread functions
+
+uint32 FFFmpegDecodeThread::Run() {
+	AVPacket* Packet  = av_packet_alloc();
+	AVFrame*  Decoded = av_frame_alloc();
+
+	// timestamps of the stream
+	const auto& Stream   = FormatContext->streams[StreamIndex];
+	const auto& TimeBase = av_q2d(Stream->time_base);
+	const auto& StartPts =
+	    AV_NOPTS_VALUE == Stream->start_time ? 0 : Stream->start_time;
+
+	// frames before this are decoded but discarded after seeking
+	double SkipUntil  = 0.0;
+	uint64 Generation = 0;
+	bool   bDraining  = false;
+	double BusySince  = FPlatformTime::Seconds();
+
+	while (nullptr != Packet && nullptr != Decoded) {
+		// take seek request, waiting while the whole stream is decoded
+		std::optional<double> Seek;
+		{
+			std::unique_lock lk(Frames_mutex);
+			DecodeThread_cv.wait(lk, [&]() {
+				return !bRunning || SeekSeconds.has_value() || !bEndOfStream;
+			});
+			Seek       = SeekSeconds;
+			Generation = SeekGeneration;
+			SeekSeconds.reset();
+		}
+		if (!bRunning) {
+			break;
+		}
+
+		// seek to the keyframe before Seek, then decode up to it
+		if (Seek) {
+			av_seek_frame(FormatContext, StreamIndex,
+			              StartPts + static_cast<int64>(*Seek / TimeBase),
+			              AVSEEK_FLAG_BACKWARD);
+			avcodec_flush_buffers(CodecContext);
+			SkipUntil = *Seek - (FrameRate > 0.0 ? 0.5 / FrameRate : 0.0);
+			bDraining = false;
+			BusySince = FPlatformTime::Seconds();
+		}
+
+		// read next packet of the stream, or drain the decoder at the end
+		if (!bDraining) {
+			if (av_read_frame(FormatContext, Packet) < 0) {
+				bDraining = true;
+				avcodec_send_packet(CodecContext, nullptr);
+			} else {
+				if (Packet->stream_index == StreamIndex &&
+				    avcodec_send_packet(CodecContext, Packet) < 0) {
+					UE_LOG(LogFFmpegEncoder, Warning,
+					       TEXT("Failed to decode a packet."));
+				}
+				av_packet_unref(Packet);
+			}
+		}
+
+		// receive all decoded frames
+		int ReceiveResult = 0;
+		while ((ReceiveResult = avcodec_receive_frame(CodecContext, Decoded)) ==
+		       0) {
+			FFFmpegDecodedFrame Frame;
+			Frame.Seconds = AV_NOPTS_VALUE == Decoded->best_effort_timestamp
+			                    ? 0.0
+			                    : (Decoded->best_effort_timestamp - StartPts) *
+			                          TimeBase;
+
+			// skip frames before the seek target
+			if (Frame.Seconds < SkipUntil) {
+				av_frame_unref(Decoded);
+				continue;
+			}
+
+			// convert into a pooled image, through the scaler of this thread
+			Frame.Image            = ImagePool->Acquire(Size.X, Size.Y);
+			const auto& bConverted = UFFmpegUtils::ConvertFrameIntoImage(
+			    *Decoded, Frame.Image, Config.ScaleFilter);
+			av_frame_unref(Decoded);
+			if (!bConverted) {
+				UE_LOG(LogFFmpegEncoder, Warning,
+				       TEXT("Failed to convert a decoded frame."));
+				ImagePool->Release(MoveTemp(Frame.Image));
+				continue;
+			}
+
+			// count time spent until now, excluding waits for the queue
+			{
+				std::lock_guard lk(Frames_mutex);
+				DecodeSeconds += FPlatformTime::Seconds() - BusySince;
+				++DecodedFrames;
+			}
+
+			// stop receiving if seeking or stopping
+			const auto& bContinue = Prefetch(MoveTemp(Frame), Generation);
+			BusySince             = FPlatformTime::Seconds();
+			if (!bContinue) {
+				break;
+			}
+		}
+
+		// the whole stream is decoded
+		if (AVERROR_EOF == ReceiveResult) {
+			std::lock_guard lk(Frames_mutex);
+			if (Generation == SeekGeneration) {
+				bEndOfStream = true;
+				ReadFrame_cv.notify_all();
+			}
+		}
+	}
+
+	// wake readers waiting for frames
+	{
+		std::lock_guard lk(Frames_mutex);
+		bEndOfStream = true;
+		ReadFrame_cv.notify_all();
+	}
+
+	// free resources
+	av_frame_free(&Decoded);
+	av_packet_free(&Packet);
+
+	return 0;
+}
+
+bool FFFmpegDecodeThread::Prefetch(FFFmpegDecodedFrame&& Frame,
+                                   const uint64          Generation) {
+	std::unique_lock lk(Frames_mutex);
+
+	// wait while the queue is full
+	DecodeThread_cv.wait(lk, [&]() {
+		return !bRunning || Generation != SeekGeneration ||
+		       Frames.Num() < Config.PrefetchFrames;
+	});
+
+	// discard Frame if it was decoded before seeking
+	if (!bRunning || Generation != SeekGeneration) {
+		ImagePool->Release(MoveTemp(Frame.Image));
+		return false;
+	}
+
+	// queue Frame
+	Frames.EmplaceLast(FPrefetchedFrame{MoveTemp(Frame),
+	                                    FPlatformTime::Seconds()});
+
+	// notify readers that a frame is ready
+	ReadFrame_cv.notify_one();
+
+	return true;
+}
+
+#pragma endregion
+
+void FFFmpegDecodeThread::Stop() {
+	// stop running
+	bRunning = false;
+
+	// notify the decode thread and readers to finish
+	{
+		std::lock_guard lk(Frames_mutex);
+		DecodeThread_cv.notify_all();
+		ReadFrame_cv.notify_all();
+	}
+}
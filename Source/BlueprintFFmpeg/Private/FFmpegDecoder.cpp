@@ -0,0 +1,74 @@
+
+#include "FFmpegDecoder.h"
+
+void UFFmpegDecoder::Open(const FFFmpegDecoderConfig& FFmpegDecoderConfig,
+                          const FString&              InputFilePath,
+                          FFmpegDecoderOpenResult&    Result,
+                          FString&                    ErrorMessage) {
+	// open thread
+	return FFmpegDecodeThread.Open(FFmpegDecoderConfig, InputFilePath, Result,
+	                               ErrorMessage);
+}
+
+void UFFmpegDecoder::Close() {
+	// close thread
+	return FFmpegDecodeThread.Close();
+}
+
+void UFFmpegDecoder::ReadFrameToTexture(UTexture2D*& Texture, float& Seconds,
+                                        FFmpegDecoderReadFrameResult& Result) {
+	// take the next frame
+	FFFmpegDecodedFrame Frame;
+	Result = FFmpegDecodeThread.ReadFrame(Frame);
+	if (FFmpegDecoderReadFrameResult::Success != Result) {
+		return;
+	}
+
+	// create texture of the size of decoded images on first use
+	const auto& Size = FFmpegDecodeThread.GetSize();
+	if (nullptr == FrameTexture) {
+		FrameTexture = UTexture2D::CreateTransient(Size.X, Size.Y, PF_B8G8R8A8);
+		FrameTexture->SRGB = true;
+		FrameTexture->UpdateResource();
+	}
+
+	// upload from the image, which is recycled once the upload is done
+	auto Image  = new FImage(MoveTemp(Frame.Image));
+	auto Region = new FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y);
+	FrameTexture->UpdateTextureRegions(
+	    0, 1, Region, Size.X * 4, 4, Image->RawData.GetData(),
+	    [ImagePool = FFmpegDecodeThread.GetImagePool(),
+	     Image](uint8*, const FUpdateTextureRegion2D* Regions) {
+		    ImagePool->Release(MoveTemp(*Image));
+		    delete Image;
+		    delete Regions;
+	    });
+
+	Texture = FrameTexture;
+	Seconds = Frame.Seconds;
+}
+
+void UFFmpegDecoder::Seek(const float Seconds) {
+	return FFmpegDecodeThread.Seek(Seconds);
+}
+
+FFFmpegDecoderStats UFFmpegDecoder::GetStats() {
+	return FFmpegDecodeThread.GetStats();
+}
+
+float UFFmpegDecoder::GetDuration() const {
+	return FFmpegDecodeThread.GetDuration();
+}
+
+float UFFmpegDecoder::GetFrameRate() const {
+	return FFmpegDecodeThread.GetFrameRate();
+}
+
+FFmpegDecoderReadFrameResult
+    UFFmpegDecoder::ReadFrame(FFFmpegDecodedFrame& Frame, const bool bWait) {
+	return FFmpegDecodeThread.ReadFrame(Frame, bWait);
+}
+
+void UFFmpegDecoder::ReleaseImage(FImage&& Image) {
+	return FFmpegDecodeThread.ReleaseImage(MoveTemp(Image));
+}
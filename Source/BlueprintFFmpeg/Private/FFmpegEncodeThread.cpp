@@ -1,22 +1,29 @@
 
 #include "FFmpegEncodeThread.h"
 
+#include "Async/ParallelFor.h"
 #include "ImageUtils.h"
 #include "Tasks/Task.h"
 
-#include <tuple>
-
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavcodec/codec.h>
-#include <libavformat/avformat.h>
-#include <libavformat/avio.h>
 }
 
 void FFFmpegEncodeThread::Open(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
                                const FString&              OutputFilePath,
                                FFmpegEncoderOpenResult&    Result,
                                FString&                    ErrorMessage) {
+	// mux into the file
+	return Open(FFmpegEncoderConfig,
+	            MakeShared<FFFmpegFileOutputSink>(OutputFilePath), Result,
+	            ErrorMessage);
+}
+
+void FFFmpegEncodeThread::Open(
+    const FFFmpegEncoderConfig&   FFmpegEncoderConfig,
+    TSharedRef<IFFmpegOutputSink> InOutputSink, FFmpegEncoderOpenResult& Result,
+    FString& ErrorMessage) {
 	// helper function to finish with success
 	const auto& Success = [&]() {
 		Result = FFmpegEncoderOpenResult::Success;
@@ -38,15 +45,95 @@ void FFFmpegEncodeThread::Open(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
 	// copy Config
 	Config = FFmpegEncoderConfig;
 
-	// copy OutputFilePath
-	VideoPath = OutputFilePath;
+	// keep OutputSink
+	OutputSink = MoveTemp(InOutputSink);
+
+	// open encoder as Config, so that invalid settings fail here instead of
+	// on the encode thread, and the first frames don't wait for it
+	OpenStartCycles = FPlatformTime::Cycles64();
+	CodecContext =
+	    FFFmpegEncoderPool::Get().Acquire(Config, bPrewarmed, ErrorMessage);
+	if (nullptr == CodecContext) {
+		return Failure(ErrorMessage);
+	}
+
+	// build the filter graph for frames of the encoder
+	if (!Config.FilterGraph.IsEmpty()) {
+		FilterGraph = MakeUnique<FFFmpegFilterGraph>();
+		if (!FilterGraph->Open(*CodecContext, Config.FilterGraph,
+		                       Config.FilterThreads, ErrorMessage)) {
+			FFFmpegEncoderPool::Get().Release(CodecContext, Config);
+			return Failure(ErrorMessage);
+		}
+	}
+
+	// open the audio encoder, whose stream follows the video stream. its
+	// buffers are counted for this encoder
+	TArray<const AVCodecContext*, TInlineAllocator<2>> CodecContexts = {
+	    CodecContext};
+	if (FFmpegAudioCodec::None != Config.AudioCodec) {
+		FFFmpegMemoryScope MemoryScope(MemoryUsage);
+		AudioEncoder = MakeUnique<FFFmpegAudioEncoder>();
+		if (!AudioEncoder->Open(Config, ErrorMessage)) {
+			AudioEncoder.Reset();
+			FFFmpegEncoderPool::Get().Release(CodecContext, Config);
+			return Failure(ErrorMessage);
+		}
+		CodecContexts.Add(AudioEncoder->GetCodecContext());
+	}
+
+	// open output
+	if (!OutputSink->Open(CodecContexts)) {
+		AudioEncoder.Reset();
+		FFFmpegEncoderPool::Get().Release(CodecContext, Config);
+		return Failure("Failed to open output.");
+	}
+	OpenSeconds =
+	    FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - OpenStartCycles);
+
+	// average sub-frames for motion blur if configured
+	if (Config.SubFramesPerFrame > 1) {
+		Accumulator = MakeShared<FFFmpegFrameAccumulator, ESPMode::ThreadSafe>(
+		    Config.GetConversionParallelForFlags());
+	}
+
+	// compose sources into tiles if configured
+	MosaicRects = Config.GetMosaicTileRects();
+	MosaicImages.SetNum(MosaicRects.Num());
+	MosaicTilesAdded.Init(false, MosaicRects.Num());
+
+	// record a trace of the added images if configured, without failing to
+	// encode if it can't be created
+	if (!Config.TraceFilePath.IsEmpty()) {
+		TraceRecorder = MakeShared<FFFmpegTraceRecorder, ESPMode::ThreadSafe>();
+		if (!TraceRecorder->Open(Config.TraceFilePath, Config,
+		                         Config.bTracePayload)) {
+			UE_LOG(LogFFmpegEncoder, Warning, TEXT("Failed to create %s."),
+			       *Config.TraceFilePath);
+			TraceRecorder.Reset();
+		}
+	}
 
-	// create encode thread
-	Thread = FRunnableThread::Create(this, TEXT("FFmpeg encode thread"));
+	// create encode thread, placed as configured. codec threads were
+	// created by FFFmpegEncoderPool on a thread placed the same way
+	Thread = FRunnableThread::Create(this, TEXT("FFmpeg encode thread"), 0,
+	                                 Config.GetEncodeThreadPriority(),
+	                                 Config.GetEncodeAffinityMask());
 	if (nullptr == Thread) {
+		OutputSink->Close();
+		FFFmpegEncoderPool::Get().Release(CodecContext, Config);
+		AudioEncoder.Reset();
+		FilterGraph.Reset();
+		TraceRecorder.Reset();
 		return Failure("Failed to create encode thread.");
 	}
 
+	// publish the stats of Open to GetStats
+	{
+		std::lock_guard Stats_lk(Stats_mutex);
+		bStatsPublished = true;
+	}
+
 	// finish as success
 	return Success();
 }
@@ -59,6 +146,20 @@ void FFFmpegEncodeThread::Close() {
 	// and Close function must not be called.
 	checkf(!bClosed, TEXT("Close function has already been called once."));
 
+	// encode the sub-frames of the last output frame added so far
+	if (bOpened && SubFrameIndex > 0) {
+		FFmpegEncoderAddFrameResult Result;
+		FString                     ErrorMessage;
+		ResolveSubFrames(Result, ErrorMessage);
+	}
+
+	// encode the mosaic of the tiles added so far
+	if (bOpened && MosaicTilesAdded.Contains(true)) {
+		FFmpegEncoderAddFrameResult Result;
+		FString                     ErrorMessage;
+		ResolveMosaic(Result, ErrorMessage);
+	}
+
 	// Mark as closed
 	bClosed = true;
 
@@ -120,6 +221,16 @@ void FFFmpegEncodeThread::AddFrame(const FString&               ImagePath,
 	// and Close function must not be called.
 	checkf(!bClosed, checkfMesClosed_AddFrame);
 
+	// images are traced as loaded
+	TGuardValue<FFmpegTraceSource> TraceSourceGuard(
+	    TraceSource, FFmpegTraceSource::ImageFile);
+
+	// sub-frames outside the shutter are not loaded
+	if (Accumulator && Config.GetShutterWeight(SubFrameIndex) <= 0.0f) {
+		return AddFrame(UE::Tasks::MakeCompletedTask<FImage>(), Result,
+		                ErrorMessage);
+	}
+
 	// Load image from ImagePath
 	FImage      Image;
 	const auto& SuccessToLoadImage = FImageUtils::LoadImage(*ImagePath, Image);
@@ -145,113 +256,615 @@ void FFFmpegEncodeThread::AddFrame(const TTask_Image&           ImageTask,
 	// and Close function must not be called.
 	checkf(!bClosed, checkfMesClosed_AddFrame);
 
+	TraceImage(ImageTask);
+
+	// only output frames are converted when accumulating sub-frames
+	if (Accumulator) {
+		return AddSubFrame(ImageTask, Result, ErrorMessage);
+	}
+
 	// launch CreateFrame task
 	auto FrameTask = UE::Tasks::Launch(
 	    UE_SOURCE_LOCATION,
-	    [&, ImageTask = ImageTask, FrameIndex = FrameIndex, Width = Config.Width,
-	     Height = Config.Height]() mutable {
+	    [ImageTask = ImageTask, FrameIndex = FrameIndex.load(),
+	     Config = Config, MemoryUsage = MemoryUsage]() mutable {
+		    FFFmpegMemoryScope MemoryScope(MemoryUsage);
 		    return UFFmpegUtils::CreateFrame(MoveTemp(ImageTask).GetResult(),
-		                                     FrameIndex, Width, Height);
+		                                     FrameIndex, Config);
 	    },
-	    ImageTask, LowLevelTasks::ETaskPriority::BackgroundNormal);
+	    ImageTask, Config.GetConversionTaskPriority());
 
 	return AddFrame(MoveTemp(FrameTask), Result, ErrorMessage);
 }
 
-FFFmpegEncodeThread::~FFFmpegEncodeThread() {
-	if (Thread) {
-		// wait to finish thread
-		Thread->Kill(true);
+void FFFmpegEncodeThread::AddFrames(TConstArrayView<FString>     ImagePaths,
+                                    FFmpegEncoderAddFrameResult& Result,
+                                    FString&                     ErrorMessage) {
+	// images are traced as loaded
+	TGuardValue<FFmpegTraceSource> TraceSourceGuard(
+	    TraceSource, FFmpegTraceSource::ImageFile);
+
+	// sub-frames are loaded in parallel and accumulated in order, except
+	// those outside the shutter, which are not loaded
+	if (Accumulator) {
+		Result = FFmpegEncoderAddFrameResult::Success;
+		for (const auto& ImagePath : ImagePaths) {
+			if (Config.GetShutterWeight(SubFrameIndex) <= 0.0f) {
+				AddFrame(UE::Tasks::MakeCompletedTask<FImage>(), Result,
+				         ErrorMessage);
+				if (FFmpegEncoderAddFrameResult::Failure == Result) {
+					return;
+				}
+				continue;
+			}
+			auto ImageTask = UE::Tasks::Launch(
+			    UE_SOURCE_LOCATION,
+			    [ImagePath = ImagePath]() {
+				    FImage Image;
+				    if (!FImageUtils::LoadImage(*ImagePath, Image)) {
+					    UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to load %s."),
+					           *ImagePath);
+				    }
+				    return Image;
+			    },
+			    Config.GetConversionTaskPriority());
+			AddFrame(ImageTask, Result, ErrorMessage);
+			if (FFmpegEncoderAddFrameResult::Failure == Result) {
+				return;
+			}
+		}
+		return;
+	}
 
-		// release memory for Thread
-		delete Thread;
+	// images are traced once loaded
+	TArray<FFFmpegTraceEvent> TraceEvents;
+	if (TraceRecorder) {
+		for (int32 Index = 0; Index < ImagePaths.Num(); ++Index) {
+			TraceEvents.Add(BeginTrace());
+		}
 	}
+
+	// images are loaded in parallel too
+	return AddFrameBatch(
+	    ImagePaths.Num(),
+	    [ImagePaths = TArray<FString>(ImagePaths), Config = Config,
+	     TraceRecorder = TraceRecorder, TraceEvents = MoveTemp(TraceEvents)](
+	        const int32 BatchIndex, const int64_t FrameIndex) {
+		    FImage Image;
+		    if (!FImageUtils::LoadImage(*ImagePaths[BatchIndex], Image)) {
+			    UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to load %s."),
+			           *ImagePaths[BatchIndex]);
+			    return FFFmpegFrameThreadSafeSharedPtr(nullptr);
+		    }
+		    if (TraceRecorder) {
+			    auto Event         = TraceEvents[BatchIndex];
+			    Event.ReadySeconds = TraceRecorder->Now();
+			    TraceRecorder->Record(Event, &Image);
+		    }
+		    return UFFmpegUtils::CreateFrame(Image, FrameIndex, Config);
+	    },
+	    {}, Result, ErrorMessage);
 }
 
-#pragma region Run on the new thread functions
+void FFFmpegEncodeThread::AddFrames(TArray<FImage>&&             Images,
+                                    FFmpegEncoderAddFrameResult& Result,
+                                    FString&                     ErrorMessage) {
+	// sub-frames are accumulated in order
+	if (Accumulator) {
+		Result = FFmpegEncoderAddFrameResult::Success;
+		for (auto& Image : Images) {
+			AddFrame(UE::Tasks::MakeCompletedTask<FImage>(MoveTemp(Image)),
+			         Result, ErrorMessage);
+			if (FFmpegEncoderAddFrameResult::Failure == Result) {
+				return;
+			}
+		}
+		return;
+	}
 
-uint32 FFFmpegEncodeThread::Run() {
-	using enum FFmpegEncoderThreadResult;
+	// images are ready now, and traced by the tasks of the batch
+	TArray<FFFmpegTraceEvent> TraceEvents;
+	if (TraceRecorder) {
+		for (int32 Index = 0; Index < Images.Num(); ++Index) {
+			TraceEvents.Add(BeginTrace());
+			TraceEvents.Last().ReadySeconds = TraceEvents.Last().Seconds;
+		}
+	}
 
-#pragma region Open
-	// get Codec
-	const auto& CodecH264 = avcodec_find_encoder(AV_CODEC_ID_H264);
-	if (nullptr == CodecH264) {
-		return static_cast<uint32>(CodecH264IsNotFound);
+	// images are shared by the tasks of the batch
+	const auto& NumImages = Images.Num();
+	return AddFrameBatch(
+	    NumImages,
+	    [Images = MakeShared<TArray<FImage>, ESPMode::ThreadSafe>(
+	         MoveTemp(Images)),
+	     Config = Config, TraceRecorder = TraceRecorder,
+	     TraceEvents = MoveTemp(TraceEvents)](const int32   BatchIndex,
+	                                          const int64_t FrameIndex) {
+		    if (TraceRecorder) {
+			    TraceRecorder->Record(TraceEvents[BatchIndex],
+			                          &(*Images)[BatchIndex]);
+		    }
+		    return UFFmpegUtils::CreateFrame((*Images)[BatchIndex], FrameIndex,
+		                                     Config);
+	    },
+	    {}, Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::AddFrames(TConstArrayView<TTask_Image> ImageTasks,
+                                    FFmpegEncoderAddFrameResult& Result,
+                                    FString&                     ErrorMessage) {
+	// sub-frames are accumulated in order
+	if (Accumulator) {
+		Result = FFmpegEncoderAddFrameResult::Success;
+		for (const auto& ImageTask : ImageTasks) {
+			AddFrame(ImageTask, Result, ErrorMessage);
+			if (FFmpegEncoderAddFrameResult::Failure == Result) {
+				return;
+			}
+		}
+		return;
 	}
 
-	// get Codec Context
-	auto ContextH264 = avcodec_alloc_context3(CodecH264);
-	if (nullptr == ContextH264) {
-		return static_cast<uint32>(FailedToAllocateCodecContext);
+	for (const auto& ImageTask : ImageTasks) {
+		TraceImage(ImageTask);
+	}
+
+	// frames are created once their images are
+	return AddFrameBatch(
+	    ImageTasks.Num(),
+	    [ImageTasks = TArray<TTask_Image>(ImageTasks),
+	     Config     = Config](const int32 BatchIndex, const int64_t FrameIndex) {
+		    return UFFmpegUtils::CreateFrame(
+		        ImageTasks[BatchIndex].GetResult(), FrameIndex, Config);
+	    },
+	    TArray<UE::Tasks::FTask>(ImageTasks), Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::AddFrames(TConstArrayView<TTask_Frame> Frames,
+                                    FFmpegEncoderAddFrameResult& Result,
+                                    FString&                     ErrorMessage) {
+	// Open function must be called
+	checkf(bOpened, checkfMesNotOpened_AddFrame);
+
+	// and Close function must not be called.
+	checkf(!bClosed, checkfMesClosed_AddFrame);
+
+	// enqueue frames
+	for (const auto& Frame : Frames) {
+		if (!FrameTasks.Enqueue({Frame, {}})) {
+			ErrorMessage = TEXT("Failed to enqueue the frame.");
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+			Result = FFmpegEncoderAddFrameResult::Failure;
+			return;
+		}
 	}
+	FrameIndex += Frames.Num();
 
-	// get from Config
-	const auto& [Width, Height, FrameRate, BitRate] =
-	    std::tie(Config.Width, Config.Height, Config.FrameRate, Config.BitRate);
+	// notify once for all frames
+	NotifyEnqueued();
 
-	// FrameRate as Rational
-	const auto FrameRateAsRational = av_d2q(FrameRate, INT_MAX);
+	Result = FFmpegEncoderAddFrameResult::Success;
+}
 
-	// set Codec Context settings
-	ContextH264->width     = Width;
-	ContextH264->height    = Height;
-	ContextH264->bit_rate  = BitRate;
-	ContextH264->time_base = av_inv_q(FrameRateAsRational);
-	ContextH264->framerate = FrameRateAsRational;
+void FFFmpegEncodeThread::AddMosaicTile(
+    const int32 TileIndex, const UTextureRenderTarget2D* TextureRenderTarget,
+    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage) {
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		Result = FFmpegEncoderAddFrameResult::Failure;
+	};
 
-	ContextH264->gop_size     = 300;
-	ContextH264->max_b_frames = 12;
-	ContextH264->pix_fmt      = AV_PIX_FMT_YUV420P;
+	// check TextureRenderTarget
+	check(nullptr != TextureRenderTarget);
+
+	// get TextureResource
+	const auto& TextureResource = TextureRenderTarget->GetResource();
 
-	// set CRF quality value
-	AVDictionary* EncodeOptions = nullptr;
-	av_dict_set(&EncodeOptions, "crf", "18", 0);
-	if (avcodec_open2(ContextH264, CodecH264, &EncodeOptions) != 0) {
-		return static_cast<uint32>(FailedToInitializeCodecContext);
+	// check TextureResource
+	if (nullptr == TextureResource) {
+		return Failure("TextureResource is nullptr");
 	}
-	av_dict_free(&EncodeOptions);
 
-	// open output file
-	auto         OutputFilePathInUTF8 = StringCast<UTF8CHAR>(*VideoPath);
-	AVIOContext* IOContext            = nullptr;
-	if (avio_open(&IOContext,
-	              reinterpret_cast<const char*>(OutputFilePathInUTF8.Get()),
-	              AVIO_FLAG_WRITE) < 0) {
-		return static_cast<uint32>(FailedToInitializeIOContext);
+	// get RHITexture
+	const auto& RHITexture = TextureResource->GetTexture2DRHI();
+
+	// check TextureResource
+	if (nullptr == RHITexture) {
+		return Failure("RHITexture is nullptr");
 	}
 
-	// allocate memory to FormatContext
-	AVFormatContext* FormatContext = nullptr;
-	if (avformat_alloc_output_context2(
-	        &FormatContext, nullptr, nullptr,
-	        reinterpret_cast<const char*>(OutputFilePathInUTF8.Get())) < 0) {
-		return static_cast<uint32>(FailedToAllocateFormatContext);
+	// launch task to create image, in float if output media needs precision
+	auto ImageTask = CreateImageFromTextureRHIAsync(FTextureRHIRef(RHITexture),
+	                                                Config.IsHighPrecision());
+
+	// images are traced as read back
+	TGuardValue<FFmpegTraceSource> TraceSourceGuard(
+	    TraceSource, FFmpegTraceSource::RenderTarget);
+
+	return AddMosaicTile(TileIndex, MoveTemp(ImageTask), Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::AddMosaicTile(const int32                  TileIndex,
+                                        const FString&               ImagePath,
+                                        FFmpegEncoderAddFrameResult& Result,
+                                        FString& ErrorMessage) {
+	// load in parallel with the other tiles
+	auto ImageTask = UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [ImagePath = ImagePath]() {
+		    FImage Image;
+		    if (!FImageUtils::LoadImage(*ImagePath, Image)) {
+			    UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to load %s."),
+			           *ImagePath);
+		    }
+		    return Image;
+	    },
+	    Config.GetConversionTaskPriority());
+
+	// images are traced as loaded
+	TGuardValue<FFmpegTraceSource> TraceSourceGuard(
+	    TraceSource, FFmpegTraceSource::ImageFile);
+
+	return AddMosaicTile(TileIndex, MoveTemp(ImageTask), Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::AddMosaicTile(const int32                  TileIndex,
+                                        const TTask_Image&           ImageTask,
+                                        FFmpegEncoderAddFrameResult& Result,
+                                        FString& ErrorMessage) {
+	// helper function to finish with success
+	const auto& Success = [&]() {
+		Result = FFmpegEncoderAddFrameResult::Success;
+	};
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		Result = FFmpegEncoderAddFrameResult::Failure;
+	};
+
+	// Open function must be called
+	checkf(bOpened, checkfMesNotOpened_AddFrame);
+
+	// and Close function must not be called.
+	checkf(!bClosed, checkfMesClosed_AddFrame);
+
+	// check TileIndex
+	if (!MosaicRects.IsValidIndex(TileIndex)) {
+		return Failure(FString::Printf(TEXT("Tile %d is not in the mosaic "
+		                                    "of %d tiles."),
+		                               TileIndex, MosaicRects.Num()));
 	}
 
-	// set FormatContext to output to specified output file
-	FormatContext->pb = IOContext;
+	TraceImage(ImageTask, TileIndex);
+
+	// the source of the tile is ahead of the others
+	if (MosaicTilesAdded[TileIndex]) {
+		// keep waiting for the others with the latest image of the tile
+		if (FFmpegMosaicSyncPolicy::WaitForAll == Config.MosaicSyncPolicy) {
+			MosaicImages[TileIndex] = ImageTask;
+			return Success();
+		}
 
-	// add new stream to file
-	const auto& Stream = avformat_new_stream(FormatContext, CodecH264);
-	if (nullptr == Stream) {
-		return static_cast<uint32>(FailedToAddANewStream);
+		// add the mosaic without the late tiles
+		ResolveMosaic(Result, ErrorMessage);
+		if (FFmpegEncoderAddFrameResult::Failure == Result) {
+			return;
+		}
 	}
 
-	// set Stream information
-	Stream->sample_aspect_ratio = ContextH264->sample_aspect_ratio;
-	Stream->time_base           = ContextH264->time_base;
+	MosaicImages[TileIndex]     = ImageTask;
+	MosaicTilesAdded[TileIndex] = true;
 
-	// set parameter from codec context h264
-	if (avcodec_parameters_from_context(Stream->codecpar, ContextH264) != 0) {
-		return static_cast<uint32>(FailedToSetCodecParameters);
+	// add the mosaic once every tile is added
+	if (MosaicTilesAdded.CountSetBits() == MosaicRects.Num()) {
+		return ResolveMosaic(Result, ErrorMessage);
 	}
+	return Success();
+}
+
+void FFFmpegEncodeThread::AddFrameBatch(
+    const int32 NumFrames,
+    TFunction<FFFmpegFrameThreadSafeSharedPtr(int32   BatchIndex,
+                                              int64_t FrameIndex)>
+                             CreateFrame,
+    TArray<UE::Tasks::FTask> Prerequisites, FFmpegEncoderAddFrameResult& Result,
+    FString& ErrorMessage) {
+	// helper function to finish with success
+	const auto& Success = [&]() {
+		Result = FFmpegEncoderAddFrameResult::Success;
+	};
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		Result = FFmpegEncoderAddFrameResult::Failure;
+	};
+
+	// Open function must be called
+	checkf(bOpened, checkfMesNotOpened_AddFrame);
 
-	// write header to output file
-	if (avformat_write_header(FormatContext, nullptr) != 0) {
-		return static_cast<uint32>(FailedToWriteHeader);
+	// and Close function must not be called.
+	checkf(!bClosed, checkfMesClosed_AddFrame);
+
+	// reserve a contiguous range of indices
+	const auto FirstFrameIndex = FrameIndex.load();
+	FrameIndex += NumFrames;
+
+	// shared by the tasks of the batch
+	const auto& SharedCreateFrame =
+	    MakeShared<decltype(CreateFrame), ESPMode::ThreadSafe>(
+	        MoveTemp(CreateFrame));
+
+	// chunks are created one after another, each in parallel, so that the
+	// encode thread can start on the first chunk while the rest are created
+	UE::Tasks::FTask PreviousChunk;
+	for (int32 ChunkStart = 0; ChunkStart < NumFrames;
+	     ChunkStart += FramesPerBatchTask) {
+		const auto& ChunkSize =
+		    FMath::Min(FramesPerBatchTask, NumFrames - ChunkStart);
+
+		// previous chunk keeps the order of creation
+		auto ChunkPrerequisites = Prerequisites;
+		if (PreviousChunk.IsValid()) {
+			ChunkPrerequisites.Add(PreviousChunk);
+		}
+
+		// launch task to create the frames of the chunk
+		auto ChunkTask = UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [SharedCreateFrame, ChunkStart, ChunkSize, FirstFrameIndex,
+		     Flags       = Config.GetConversionParallelForFlags(),
+		     MemoryUsage = MemoryUsage]() {
+			    TArray<FFFmpegFrameThreadSafeSharedPtr> Frames;
+			    Frames.SetNum(ChunkSize);
+			    ParallelFor(
+			        ChunkSize,
+			        [&](const int32 Index) {
+				        FFFmpegMemoryScope MemoryScope(MemoryUsage);
+				        Frames[Index] = (*SharedCreateFrame)(
+				            ChunkStart + Index,
+				            FirstFrameIndex + ChunkStart + Index);
+			        },
+			        Flags);
+			    return Frames;
+		    },
+		    ChunkPrerequisites, Config.GetConversionTaskPriority());
+		PreviousChunk = ChunkTask;
+
+		// enqueue chunk
+		if (!FrameTasks.Enqueue({{}, MoveTemp(ChunkTask)})) {
+			return Failure("Failed to enqueue the frames.");
+		}
 	}
-#pragma endregion
+
+	// notify once for the whole batch
+	NotifyEnqueued();
+
+	return Success();
+}
+
+void FFFmpegEncodeThread::AddSubFrame(const TTask_Image&           ImageTask,
+                                      FFmpegEncoderAddFrameResult& Result,
+                                      FString& ErrorMessage) {
+	// accumulate after the previous sub-frame, unless the shutter is closed
+	const auto& Weight = Config.GetShutterWeight(SubFrameIndex);
+	if (Weight > 0.0f) {
+		TArray<UE::Tasks::FTask> Prerequisites = {ImageTask};
+		if (AccumulateTask.IsValid()) {
+			Prerequisites.Add(AccumulateTask);
+		}
+		AccumulateTask = UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [Accumulator = Accumulator, ImageTask = ImageTask, Weight]() {
+			    Accumulator->Accumulate(ImageTask.GetResult(), Weight);
+		    },
+		    Prerequisites, Config.GetConversionTaskPriority());
+	}
+
+	// wait for the rest of the output frame
+	if (++SubFrameIndex < Config.SubFramesPerFrame) {
+		Result = FFmpegEncoderAddFrameResult::Success;
+		return;
+	}
+
+	return ResolveSubFrames(Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::ResolveSubFrames(
+    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage) {
+	// launch task to convert the mean once the sub-frames are accumulated
+	TArray<UE::Tasks::FTask> Prerequisites;
+	if (AccumulateTask.IsValid()) {
+		Prerequisites.Add(AccumulateTask);
+	}
+	auto FrameTask = UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [Accumulator = Accumulator, FrameIndex = FrameIndex.load(),
+	     Config = Config, MemoryUsage = MemoryUsage]() {
+		    FFFmpegMemoryScope MemoryScope(MemoryUsage);
+		    return UFFmpegUtils::CreateFrame(
+		        Accumulator->Resolve(Config.Width, Config.Height), FrameIndex,
+		        Config);
+	    },
+	    Prerequisites, Config.GetConversionTaskPriority());
+
+	// sub-frames of the next output frame are accumulated after resolving
+	AccumulateTask = FrameTask;
+	SubFrameIndex  = 0;
+
+	return AddFrame(MoveTemp(FrameTask), Result, ErrorMessage);
+}
+
+void FFFmpegEncodeThread::ResolveMosaic(FFmpegEncoderAddFrameResult& Result,
+                                        FString& ErrorMessage) {
+	// late tiles hold their last image, or are left black
+	const auto& bHoldLast =
+	    FFmpegMosaicSyncPolicy::HoldLast == Config.MosaicSyncPolicy;
+	TArray<TTask_Image>      TileImages;
+	TArray<UE::Tasks::FTask> Prerequisites;
+	TileImages.SetNum(MosaicRects.Num());
+	for (int32 Index = 0; Index < MosaicRects.Num(); ++Index) {
+		if ((MosaicTilesAdded[Index] || bHoldLast) &&
+		    MosaicImages[Index].IsValid()) {
+			TileImages[Index] = MosaicImages[Index];
+			Prerequisites.Add(TileImages[Index]);
+		}
+	}
+
+	// launch task to convert the tiles into one frame once they are read
+	auto FrameTask = UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [TileImages = MoveTemp(TileImages), MosaicRects = MosaicRects,
+	     FrameIndex = FrameIndex.load(), Config = Config,
+	     MemoryUsage = MemoryUsage]() {
+		    FFFmpegMemoryScope    MemoryScope(MemoryUsage);
+		    TArray<const FImage*> Images;
+		    for (const auto& TileImage : TileImages) {
+			    Images.Add(TileImage.IsValid() ? &TileImage.GetResult()
+			                                   : nullptr);
+		    }
+		    return UFFmpegUtils::CreateMosaicFrame(Images, MosaicRects,
+		                                           FrameIndex, Config);
+	    },
+	    Prerequisites, Config.GetConversionTaskPriority());
+
+	// tiles of the next output frame are added after resolving
+	MosaicTilesAdded.Init(false, MosaicRects.Num());
+
+	return AddFrame(MoveTemp(FrameTask), Result, ErrorMessage);
+}
+
+FFFmpegTraceEvent FFFmpegEncodeThread::BeginTrace(const int32 TileIndex) {
+	FFFmpegTraceEvent Event;
+	Event.Index     = TraceIndex++;
+	Event.Seconds   = TraceRecorder->Now();
+	Event.Source    = TraceSource;
+	Event.TileIndex = TileIndex;
+	return Event;
+}
+
+void FFFmpegEncodeThread::TraceImage(const TTask_Image& ImageTask,
+                                     const int32        TileIndex) {
+	if (!TraceRecorder) {
+		return;
+	}
+
+	// record once the image is read back or loaded
+	UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [TraceRecorder = TraceRecorder, Event = BeginTrace(TileIndex),
+	     ImageTask = ImageTask]() mutable {
+		    Event.ReadySeconds = TraceRecorder->Now();
+		    TraceRecorder->Record(Event, &ImageTask.GetResult());
+	    },
+	    ImageTask, Config.GetConversionTaskPriority());
+}
+
+void FFFmpegEncodeThread::TraceImage(const FIntPoint             Size,
+                                     const ERawImageFormat::Type Format) {
+	if (!TraceRecorder) {
+		return;
+	}
+
+	auto Event         = BeginTrace();
+	Event.ReadySeconds = Event.Seconds;
+	Event.Width        = Size.X;
+	Event.Height       = Size.Y;
+	Event.Format       = Format;
+	Event.GammaSpace   = ERawImageFormat::GetDefaultGammaSpace(Format);
+	TraceRecorder->Record(Event, nullptr);
+}
+
+void FFFmpegEncodeThread::NotifyEnqueued() {
+	std::lock_guard lk(FrameTasks_mutex);
+	NotifiedSeconds = FPlatformTime::Seconds();
+	EncodeThread_cv.notify_one();
+}
+
+bool FFFmpegEncodeThread::AddAudio(TConstArrayView<float> InterleavedSamples,
+                                   const double           CaptureSeconds) {
+	// the audio track is disabled
+	if (!AudioEncoder) {
+		return false;
+	}
+
+	// taken by the encode thread on its next wake
+	return AudioEncoder->AddSamples(InterleavedSamples, CaptureSeconds);
+}
+
+FFFmpegEncoderStats FFFmpegEncodeThread::GetStats() {
+	std::lock_guard lk(Stats_mutex);
+
+	FFFmpegEncoderStats Stats;
+	Stats.EncodedFrames = EncodedFrames;
+	Stats.PendingFrames = FrameIndex - ProcessedFrames;
+	Stats.EncodeFramesPerSecond =
+	    EncodeSeconds > 0.0 ? EncodedFrames / EncodeSeconds : 0.0;
+	Stats.WakeLatencyMilliseconds =
+	    NumWakes > 0 ? WakeLatencySeconds * 1000.0 / NumWakes : 0.0;
+	Stats.ConversionWaitMilliseconds =
+	    ProcessedFrames > 0 ? ConversionWaitSeconds * 1000.0 / ProcessedFrames
+	                        : 0.0;
+	Stats.FirstPacketMilliseconds = FirstPacketSeconds * 1000.0;
+	Stats.Memory                  = MemoryUsage->GetStats();
+
+	// the setting and the encoders are known once Open succeeds
+	if (!bStatsPublished) {
+		return Stats;
+	}
+	Stats.EncodeAffinityMask =
+	    static_cast<int64>(Config.GetEncodeAffinityMask());
+	Stats.OpenMilliseconds = OpenSeconds * 1000.0;
+	Stats.bPrewarmed       = bPrewarmed;
+	if (AudioEncoder) {
+		AudioEncoder->GetStats(Stats);
+	}
+	return Stats;
+}
+
+const FFFmpegEncoderConfig& FFFmpegEncodeThread::GetConfig() const {
+	return Config;
+}
+
+bool FFFmpegEncodeThread::IsOpen() const {
+	// the encode thread is created once everything is opened
+	return nullptr != Thread && !bClosed;
+}
+
+void FFFmpegEncodeThread::WaitForCompletion() {
+	// Close function must be called, or the thread never finishes
+	checkf(bClosed, TEXT("Before calling this function, Close function must "
+	                     "be called."));
+
+	if (Thread) {
+		Thread->WaitForCompletion();
+	}
+}
+
+FFFmpegEncodeThread::~FFFmpegEncodeThread() {
+	if (Thread) {
+		// wait to finish thread
+		Thread->Kill(true);
+
+		// release memory for Thread
+		delete Thread;
+	}
+
+	// the encode thread failed or never ran
+	if (nullptr != CodecContext) {
+		avcodec_free_context(&CodecContext);
+	}
+}
+
+#pragma region Run on the new thread functions
+
+uint32 FFFmpegEncodeThread::Run() {
+	using enum FFmpegEncoderThreadResult;
 
 #pragma region AddFrame
 	auto ReceiveAllPendingPackets = [&]() {
@@ -262,17 +875,23 @@ uint32 FFFmpegEncodeThread::Run() {
 		}
 
 		// receive a Packet
-		while (avcodec_receive_packet(ContextH264, Packet) == 0) {
+		while (avcodec_receive_packet(CodecContext, Packet) == 0) {
 			check(Packet->size != 0);
 
-			// set stream index of this packet from stream
-			Packet->stream_index = Stream->index;
+			// the video stream is the first codec of OutputSink
+			Packet->stream_index = 0;
 
-			// rescale
-			av_packet_rescale_ts(Packet, ContextH264->time_base, Stream->time_base);
+			// time from Open to the first packet
+			if (0 != OpenStartCycles) {
+				const auto& Seconds = FPlatformTime::ToSeconds64(
+				    FPlatformTime::Cycles64() - OpenStartCycles);
+				OpenStartCycles = 0;
+				std::lock_guard Stats_lk(Stats_mutex);
+				FirstPacketSeconds = Seconds;
+			}
 
-			// write Packet to output media file
-			if (av_interleaved_write_frame(FormatContext, Packet) != 0) {
+			// write Packet to output
+			if (!OutputSink->WritePacket(*Packet)) {
 				return FailedToWritePacket;
 			}
 
@@ -287,49 +906,178 @@ uint32 FFFmpegEncodeThread::Run() {
 		return Success;
 	};
 
+	// frame filtered by FilterGraph, from the pools of the graph
+	AVFrame* FilteredFrame = FilterGraph ? av_frame_alloc() : nullptr;
+	if (FilterGraph && nullptr == FilteredFrame) {
+		return static_cast<uint32>(FailedToFilterFrame);
+	}
+
+	auto EncodeFrame = [&](AVFrame& Frame) {
+		// start a new GOP where OutputSink asks for it
+		if (OutputSink->TakeKeyframeRequest()) {
+			Frame.pict_type = AV_PICTURE_TYPE_I;
+		}
+
+		// stamp the time of sending, which packets carry to OutputSink
+		const auto& SendCycles =
+		    static_cast<UPTRINT>(FPlatformTime::Cycles64());
+		Frame.opaque = reinterpret_cast<void*>(SendCycles);
+
+		// send a frame
+		if (avcodec_send_frame(CodecContext, &Frame) != 0) {
+			return FailedToSendFrame;
+		}
+
+		// Receive all packets
+		return ReceiveAllPendingPackets();
+	};
+
+	auto EncodeAllFilteredFrames = [&]() {
+		while (FilterGraph->ReceiveFrame(*FilteredFrame)) {
+			// picture types passed through filters are not forced on the
+			// encoder
+			FilteredFrame->pict_type = AV_PICTURE_TYPE_NONE;
+
+			const auto& EncodeResult = EncodeFrame(*FilteredFrame);
+			av_frame_unref(FilteredFrame);
+			if (EncodeResult != Success) {
+				return EncodeResult;
+			}
+		}
+		return Success;
+	};
+
+	// audio packets go to the stream after the video stream
+	auto WriteAudioPacket = [&](AVPacket& Packet) {
+		Packet.stream_index = 1;
+		return OutputSink->WritePacket(Packet);
+	};
+
+	// encode audio submitted so far, in step with the video encoded so far
+	auto EncodeAudio = [&]() {
+		const auto& VideoSeconds =
+		    static_cast<double>(EncodedFrames) / Config.FrameRate;
+		return AudioEncoder->Encode(VideoSeconds, WriteAudioPacket)
+		           ? Success
+		           : FailedToWritePacket;
+	};
+
 	// Loop while the status is in running or FrameTasks is not empty.
 	while (true) {
 		{
-			// Wait for finish or enqueue to FrameTasks
+			// Wait for finish or enqueue to FrameTasks. audio is drained
+			// at intervals while no frame comes.
 			std::unique_lock lk(FrameTasks_mutex);
-			EncodeThread_cv.wait(
-			    lk, [&]() { return !bRunning || !FrameTasks.IsEmpty(); });
+			const auto& bIdle     = bRunning && FrameTasks.IsEmpty();
+			const auto& Predicate = [&]() {
+				return !bRunning || !FrameTasks.IsEmpty();
+			};
+			if (AudioEncoder) {
+				EncodeThread_cv.wait_for(
+				    lk, std::chrono::milliseconds(AudioPollMilliseconds),
+				    Predicate);
+			} else {
+				EncodeThread_cv.wait(lk, Predicate);
+			}
+
+			// delay of being scheduled after woken up
+			if (bIdle && !FrameTasks.IsEmpty()) {
+				const auto& WakeSeconds = FPlatformTime::Seconds();
+				std::lock_guard Stats_lk(Stats_mutex);
+				WakeLatencySeconds += WakeSeconds - NotifiedSeconds;
+				++NumWakes;
+			}
+		}
+
+		// read before FrameTasks, so that frames enqueued before stopping
+		// are not missed
+		const bool bStillRunning = bRunning;
+
+		// drain audio
+		if (AudioEncoder) {
+			const auto& AudioResult = EncodeAudio();
+			if (AudioResult != Success) {
+				return static_cast<uint32>(AudioResult);
+			}
 		}
 
 		// if FrameTasks is empty
 		if (FrameTasks.IsEmpty()) {
+			// woken up to drain audio
+			if (AudioEncoder && bStillRunning) {
+				continue;
+			}
+
 			// should be in the finish state.
-			check(!bRunning);
+			check(!bStillRunning);
 
 			// finish
 			break;
 		}
 
-		// dequeue next frame task
-		TTask_Frame FrameTask;
-		FrameTasks.Dequeue(FrameTask);
-
-		// get a frame pending encoding
-		const auto& Frame = FrameTask.GetResult();
-
-		// send a frame
-		if (avcodec_send_frame(ContextH264, Frame.Get()) != 0) {
-			return static_cast<uint32>(FailedToSendFrame);
+		// dequeue next frame task or batch
+		FQueuedFrames QueuedFrames;
+		FrameTasks.Dequeue(QueuedFrames);
+
+		// get frames pending encoding, waiting for conversion tasks
+		const auto& WaitStartSeconds = FPlatformTime::Seconds();
+		TArray<FFFmpegFrameThreadSafeSharedPtr> Frames;
+		if (QueuedFrames.Frame.IsValid()) {
+			Frames.Add(QueuedFrames.Frame.GetResult());
+		} else {
+			Frames = MoveTemp(QueuedFrames.Frames.GetResult());
 		}
+		const auto& EncodeStartSeconds = FPlatformTime::Seconds();
 
-		// Receive all packets
-		const auto& ReceiveResult = ReceiveAllPendingPackets();
+		int32 NumEncoded = 0;
+		for (const auto& Frame : Frames) {
+			// skip frames that failed to be created
+			if (!Frame) {
+				continue;
+			}
 
-		// failed to receive packets
-		if (ReceiveResult != Success) {
-			return static_cast<uint32>(ReceiveResult);
+			// filter the frame in order, or encode it as it is
+			if (FilterGraph) {
+				if (!FilterGraph->SendFrame(Frame.Get())) {
+					return static_cast<uint32>(FailedToFilterFrame);
+				}
+				const auto& FilterResult = EncodeAllFilteredFrames();
+				if (FilterResult != Success) {
+					return static_cast<uint32>(FilterResult);
+				}
+			} else {
+				const auto& EncodeResult = EncodeFrame(*Frame);
+				if (EncodeResult != Success) {
+					return static_cast<uint32>(EncodeResult);
+				}
+			}
+			++NumEncoded;
 		}
+
+		// update stats
+		const auto& EncodeEndSeconds = FPlatformTime::Seconds();
+		std::lock_guard Stats_lk(Stats_mutex);
+		EncodedFrames         += NumEncoded;
+		ProcessedFrames       += Frames.Num();
+		EncodeSeconds         += EncodeEndSeconds - EncodeStartSeconds;
+		ConversionWaitSeconds += EncodeStartSeconds - WaitStartSeconds;
 	}
 #pragma endregion
 
 #pragma region Close
+	// flush frames held by filters
+	if (FilterGraph) {
+		if (!FilterGraph->SendFrame(nullptr)) {
+			return static_cast<uint32>(FailedToFilterFrame);
+		}
+		const auto& FilterResult = EncodeAllFilteredFrames();
+		if (FilterResult != Success) {
+			return static_cast<uint32>(FilterResult);
+		}
+	}
+
 	// notify that encoding is finished
-	if (avcodec_send_frame(ContextH264, nullptr) != 0) {
+	if (avcodec_send_frame(CodecContext, nullptr) != 0) {
 		return static_cast<int32>(FailedToFlushSendFrame);
 	}
 
@@ -341,15 +1089,28 @@ uint32 FFFmpegEncodeThread::Run() {
 		return static_cast<uint32>(ReceiveResult);
 	}
 
-	// write trailer to output file
-	if (av_write_trailer(FormatContext) != 0) {
-		return static_cast<int32>(FailedToWriteTrailer);
+	// encode the rest of audio up to the end of the video, and drain it
+	if (AudioEncoder) {
+		const auto& AudioResult = EncodeAudio();
+		if (AudioResult != Success) {
+			return static_cast<uint32>(AudioResult);
+		}
+		if (!AudioEncoder->Flush(WriteAudioPacket)) {
+			return static_cast<uint32>(FailedToFlushSendFrame);
+		}
+	}
+
+	// finalize output
+	if (!OutputSink->Close()) {
+		return static_cast<int32>(FailedToCloseOutput);
 	}
 
 	// free resources
-	avcodec_free_context(&ContextH264);
-	avformat_free_context(FormatContext);
-	avio_closep(&IOContext);
+	av_frame_free(&FilteredFrame);
+	FilterGraph.Reset();
+
+	// give back the encoder, which may start the next clip
+	FFFmpegEncoderPool::Get().Release(CodecContext, Config);
 #pragma endregion
 
 	return static_cast<uint32>(Success);
@@ -1,15 +1,213 @@
 
 #include "FFmpegEncoder.h"
 
+#include "FFmpegKeyframeIndex.h"
+#include "Tasks/Task.h"
+
 void UFFmpegEncoder::Open(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
                           const FString&              OutputFilePath,
                           FFmpegEncoderOpenResult&    Result,
                           FString&                    ErrorMessage) {
+	// record a proxy, transcoded to OutputFilePath once it is finished
+	if (FFmpegProxyCodec::None != FFmpegEncoderConfig.ProxyCodec) {
+		// the transcode keeps only the video of the proxy
+		if (FFmpegAudioCodec::None != FFmpegEncoderConfig.AudioCodec) {
+			ErrorMessage = TEXT("ProxyCodec can't be used with AudioCodec.");
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+			Result = FFmpegEncoderOpenResult::Failure;
+			return;
+		}
+
+		const auto& ProxyFilePath =
+		    FFFmpegTranscodeJob::ProxyFilePathOf(OutputFilePath);
+		TranscodeJob = MakeShared<FFFmpegTranscodeJob>(
+		    ProxyFilePath, OutputFilePath, FFmpegEncoderConfig);
+		RotatingSink = MakeShared<FFFmpegRotatingOutputSink>(
+		    ProxyFilePath, 0.0, 0,
+		    [TranscodeJob = TranscodeJob.ToSharedRef(),
+		     bTranscodeOnClose = FFmpegEncoderConfig.bTranscodeOnClose](
+		        const FString&) {
+			    TranscodeJob->MarkProxyFinished();
+			    if (bTranscodeOnClose) {
+				    TranscodeJob->Start();
+			    }
+		    });
+
+		// open thread
+		return FFmpegEncodeThread.Open(FFmpegEncoderConfig,
+		                               RotatingSink.ToSharedRef(), Result,
+		                               ErrorMessage);
+	}
+
+	// index keyframes of each file once it is finished, in the background
+	// so that the encode thread doesn't wait for scanning the file
+	FFFmpegRotatingOutputSink::FRotatedCallback OnRotated;
+	if (FFmpegEncoderConfig.bWriteKeyframeIndex) {
+		OnRotated = [](const FString& FinishedFilePath) {
+			UE::Tasks::Launch(
+			    UE_SOURCE_LOCATION,
+			    [FinishedFilePath]() {
+				    FFFmpegKeyframeIndex KeyframeIndex;
+				    if (KeyframeIndex.Build(FinishedFilePath)) {
+					    KeyframeIndex.Save();
+				    }
+			    },
+			    LowLevelTasks::ETaskPriority::BackgroundLow);
+		};
+	}
+
+	// mux into OutputFilePath, and following files when rotated
+	RotatingSink = MakeShared<FFFmpegRotatingOutputSink>(
+	    OutputFilePath, FFmpegEncoderConfig.RotationSeconds,
+	    static_cast<int64>(FFmpegEncoderConfig.RotationMegabytes) * 1024 * 1024,
+	    MoveTemp(OnRotated));
+
 	// open thread
-	return FFmpegEncodeThread.Open(FFmpegEncoderConfig, OutputFilePath, Result,
+	return FFmpegEncodeThread.Open(FFmpegEncoderConfig,
+	                               RotatingSink.ToSharedRef(), Result,
 	                               ErrorMessage);
 }
 
+void UFFmpegEncoder::Open(const FFFmpegEncoderConfig&   FFmpegEncoderConfig,
+                          TSharedRef<IFFmpegOutputSink> OutputSink,
+                          FFmpegEncoderOpenResult&      Result,
+                          FString&                      ErrorMessage) {
+	// open thread
+	return FFmpegEncodeThread.Open(FFmpegEncoderConfig, MoveTemp(OutputSink),
+	                               Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::OpenReplay(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+                                const float                 ReplaySeconds,
+                                const int32                 MaxReplayMegabytes,
+                                FFmpegEncoderOpenResult&    Result,
+                                FString&                    ErrorMessage) {
+	// keep packets in memory
+	ReplaySink = MakeShared<FFFmpegReplayOutputSink>(
+	    ReplaySeconds, MaxReplayMegabytes > 0
+	                       ? static_cast<int64>(MaxReplayMegabytes) * 1024 * 1024
+	                       : MAX_int64);
+
+	// open thread
+	return FFmpegEncodeThread.Open(FFmpegEncoderConfig, ReplaySink.ToSharedRef(),
+	                               Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::OpenStream(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+                                const FString&              Url,
+                                const FFFmpegStreamConfig&  StreamConfig,
+                                FFmpegEncoderOpenResult&    Result,
+                                FString&                    ErrorMessage) {
+	// send muxed bytes as they are encoded
+	StreamSink = MakeShared<FFFmpegStreamOutputSink>(Url, StreamConfig);
+
+	// open thread
+	return FFmpegEncodeThread.Open(FFmpegEncoderConfig, StreamSink.ToSharedRef(),
+	                               Result, ErrorMessage);
+}
+
+FFFmpegStreamStats UFFmpegEncoder::GetStreamStats() {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	return StreamSink ? StreamSink->GetStats() : FFFmpegStreamStats();
+}
+
+bool UFFmpegEncoder::SaveReplay(const FString& OutputFilePath,
+                                const float    Seconds) {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	// OpenReplay function must be called
+	if (!ReplaySink) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("SaveReplay requires OpenReplay to be called."));
+		return false;
+	}
+
+	// mux in the background
+	const auto& SaveTask = ReplaySink->Save(OutputFilePath, Seconds);
+	return !SaveTask.IsCompleted() || SaveTask.GetResult();
+}
+
+void UFFmpegEncoder::RotateOutput() {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	// Open function with OutputFilePath must be called
+	if (!RotatingSink) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("RotateOutput requires Open with OutputFilePath."));
+		return;
+	}
+
+	// split at the next frame
+	RotatingSink->Rotate();
+}
+
+void UFFmpegEncoder::TranscodeProxy(
+    const FString& ProxyFilePath, const FString& OutputFilePath,
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig) {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	// a job in flight would be orphaned, so it must finish or be canceled
+	if (TranscodeJob && !TranscodeJob->IsFinished()) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("TranscodeProxy requires the transcode in flight to "
+		            "finish or be canceled."));
+		return;
+	}
+
+	// the proxy is already finished
+	TranscodeJob = MakeShared<FFFmpegTranscodeJob>(ProxyFilePath, OutputFilePath,
+	                                               FFmpegEncoderConfig);
+	TranscodeJob->MarkProxyFinished();
+	TranscodeJob->Start();
+}
+
+void UFFmpegEncoder::StartTranscode() {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	// Open function with ProxyCodec must be called
+	if (!TranscodeJob) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("StartTranscode requires Open with ProxyCodec."));
+		return;
+	}
+
+	// begins once the proxy is closed
+	TranscodeJob->Start();
+}
+
+void UFFmpegEncoder::CancelTranscode() {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	if (TranscodeJob) {
+		TranscodeJob->Cancel();
+	}
+}
+
+float UFFmpegEncoder::GetTranscodeProgress() const {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	return TranscodeJob ? TranscodeJob->GetProgress() : 0.0f;
+}
+
+bool UFFmpegEncoder::IsTranscodeSucceeded() const {
+	// Open must not be running on a task
+	checkf(OrderedTask.IsCompleted(), checkfMesInFlight);
+
+	return TranscodeJob && TranscodeJob->IsSucceeded();
+}
+
+FFFmpegEncoderStats UFFmpegEncoder::GetStats() {
+	return FFmpegEncodeThread.GetStats();
+}
+
 void UFFmpegEncoder::Close() {
 	// close thread
 	return FFmpegEncodeThread.Close();
@@ -32,3 +230,87 @@ void UFFmpegEncoder::AddFrame(const TTask_Image&           ImageTask,
                               FString&                     ErrorMessage) {
 	return FFmpegEncodeThread.AddFrame(ImageTask, Result, ErrorMessage);
 }
+
+void UFFmpegEncoder::AddFramesFromImagePaths(
+    const TArray<FString>& ImagePaths, FFmpegEncoderAddFrameResult& Result,
+    FString& ErrorMessage) {
+	return FFmpegEncodeThread.AddFrames(ImagePaths, Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::AddFrames(TArray<FImage>&&             Images,
+                               FFmpegEncoderAddFrameResult& Result,
+                               FString&                     ErrorMessage) {
+	return FFmpegEncodeThread.AddFrames(MoveTemp(Images), Result,
+	                                    ErrorMessage);
+}
+
+void UFFmpegEncoder::AddFrames(TConstArrayView<TTask_Image> ImageTasks,
+                               FFmpegEncoderAddFrameResult& Result,
+                               FString&                     ErrorMessage) {
+	return FFmpegEncodeThread.AddFrames(ImageTasks, Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::AddFrames(TConstArrayView<TTask_Frame> Frames,
+                               FFmpegEncoderAddFrameResult& Result,
+                               FString&                     ErrorMessage) {
+	return FFmpegEncodeThread.AddFrames(Frames, Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::AddMosaicTileFromRenderTarget(
+    const int32 TileIndex, const UTextureRenderTarget2D* TextureRenderTarget,
+    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage) {
+	return FFmpegEncodeThread.AddMosaicTile(TileIndex, TextureRenderTarget,
+	                                        Result, ErrorMessage);
+}
+
+void UFFmpegEncoder::AddMosaicTileFromImagePath(
+    const int32 TileIndex, const FString& ImagePath,
+    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage) {
+	return FFmpegEncodeThread.AddMosaicTile(TileIndex, ImagePath, Result,
+	                                        ErrorMessage);
+}
+
+void UFFmpegEncoder::AddMosaicTile(const int32                  TileIndex,
+                                   const TTask_Image&           ImageTask,
+                                   FFmpegEncoderAddFrameResult& Result,
+                                   FString&                     ErrorMessage) {
+	return FFmpegEncodeThread.AddMosaicTile(TileIndex, ImageTask, Result,
+	                                        ErrorMessage);
+}
+
+bool UFFmpegEncoder::AddAudio(TConstArrayView<float> InterleavedSamples,
+                              const double           CaptureSeconds) {
+	return FFmpegEncodeThread.AddAudio(InterleavedSamples, CaptureSeconds);
+}
+
+const FFFmpegEncoderConfig& UFFmpegEncoder::GetConfig() const {
+	return FFmpegEncodeThread.GetConfig();
+}
+
+bool UFFmpegEncoder::IsOpen() const {
+	return FFmpegEncodeThread.IsOpen();
+}
+
+UE::Tasks::FTask
+    UFFmpegEncoder::LaunchInOrder(TUniqueFunction<void()>&& Body) {
+	check(IsInGameThread());
+
+	// after the previous call, in the background as it may wait for files
+	TArray<UE::Tasks::FTask> Prerequisites;
+	if (OrderedTask.IsValid()) {
+		Prerequisites.Add(OrderedTask);
+	}
+	OrderedTask = UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION, MoveTemp(Body), Prerequisites,
+	    LowLevelTasks::ETaskPriority::BackgroundNormal);
+	return OrderedTask;
+}
+
+void UFFmpegEncoder::WaitForCompletion() {
+	return FFmpegEncodeThread.WaitForCompletion();
+}
+
+bool UFFmpegEncoder::IsReadyForFinishDestroy() {
+	// tasks launched by LaunchInOrder refer to this encoder
+	return Super::IsReadyForFinishDestroy() && OrderedTask.IsCompleted();
+}
@@ -0,0 +1,209 @@
+
+#include "FFmpegEncoderAsyncAction.h"
+
+#include "Async/Async.h"
+#include "ImageUtils.h"
+#include "LogFFmpegEncoder.h"
+#include "Tasks/Task.h"
+
+UFFmpegEncoderAsyncAction*
+    UFFmpegEncoderAsyncAction::OpenAsync(
+        UObject* WorldContextObject, UFFmpegEncoder* Encoder,
+        const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+        const FString&              OutputFilePath) {
+	return Create(
+	    WorldContextObject, Encoder,
+	    [FFmpegEncoderConfig, OutputFilePath](
+	        UFFmpegEncoderAsyncAction& Action, UFFmpegEncoder& Target) {
+		    // open the encoder and the output in the background
+		    return Target.LaunchInOrder([&Action, &Target, FFmpegEncoderConfig,
+		                                 OutputFilePath]() {
+			    FFmpegEncoderOpenResult Result;
+			    Target.Open(FFmpegEncoderConfig, OutputFilePath, Result,
+			                Action.ErrorMessage);
+			    Action.bSucceeded = FFmpegEncoderOpenResult::Success == Result;
+		    });
+	    });
+}
+
+UFFmpegEncoderAsyncAction*
+    UFFmpegEncoderAsyncAction::AddFrameFromImagePathAsync(
+        UObject* WorldContextObject, UFFmpegEncoder* Encoder,
+        const FString& ImagePath) {
+	return Create(
+	    WorldContextObject, Encoder,
+	    [ImagePath](UFFmpegEncoderAsyncAction& Action, UFFmpegEncoder& Target) {
+		    // load in parallel with the calls before
+		    auto ImageTask = UE::Tasks::Launch(
+		        UE_SOURCE_LOCATION,
+		        [ImagePath]() {
+			        FImage Image;
+			        FImageUtils::LoadImage(*ImagePath, Image);
+			        return Image;
+		        },
+		        LowLevelTasks::ETaskPriority::BackgroundNormal);
+
+		    // add in order, once the encoder is opened
+		    return Target.LaunchInOrder(
+		        [&Action, &Target, ImageTask = MoveTemp(ImageTask)]() {
+			        if (!Target.IsOpen()) {
+				        return Action.Fail(TEXT("Encoder is not opened."));
+			        }
+			        if (0 == ImageTask.GetResult().GetNumPixels()) {
+				        return Action.Fail(TEXT("Failed to load image."));
+			        }
+
+			        FFmpegEncoderAddFrameResult Result;
+			        Target.AddFrame(ImageTask, Result, Action.ErrorMessage);
+			        Action.bSucceeded =
+			            FFmpegEncoderAddFrameResult::Success == Result;
+		        });
+	    });
+}
+
+UFFmpegEncoderAsyncAction*
+    UFFmpegEncoderAsyncAction::AddFrameFromRenderTargetAsync(
+        UObject* WorldContextObject, UFFmpegEncoder* Encoder,
+        const UTextureRenderTarget2D* TextureRenderTarget) {
+	return Create(
+	    WorldContextObject, Encoder,
+	    [TextureRenderTarget](UFFmpegEncoderAsyncAction& Action,
+	                          UFFmpegEncoder& Target) -> UE::Tasks::FTask {
+		    // get RHITexture on the game thread
+		    const auto& TextureResource =
+		        nullptr != TextureRenderTarget
+		            ? TextureRenderTarget->GetResource()
+		            : nullptr;
+		    if (nullptr == TextureResource ||
+		        nullptr == TextureResource->GetTexture2DRHI()) {
+			    Action.Fail(TEXT("RHITexture is nullptr"));
+			    return {};
+		    }
+
+		    // copy now, so that the frame is read as rendered so far
+		    auto Snapshot_Future = SnapshotTextureRHIAsync(
+		        FTextureRHIRef(TextureResource->GetTexture2DRHI()));
+
+		    // read back in order, once the precision of the encoder is known
+		    return Target.LaunchInOrder([&Action, &Target,
+		                                 Snapshot_Future =
+		                                     MoveTemp(Snapshot_Future)]() {
+			    if (!Target.IsOpen()) {
+				    auto Snapshot = Snapshot_Future.Get();
+				    ReleaseTextureSnapshot(MoveTemp(Snapshot));
+				    return Action.Fail(TEXT("Encoder is not opened."));
+			    }
+
+			    const auto& Config     = Target.GetConfig();
+			    const auto& bReadFloat = Config.IsHighPrecision();
+			    auto        ImageTask  = UE::Tasks::Launch(
+			        UE_SOURCE_LOCATION,
+			        [Snapshot_Future, bReadFloat]() {
+				        auto   Snapshot = Snapshot_Future.Get();
+				        FImage Image;
+				        ReadTextureRHIIntoImage(
+				            Snapshot,
+				            FIntRect(FIntPoint::ZeroValue,
+				                     Snapshot->GetDesc().Extent),
+				            bReadFloat, Image);
+				        ReleaseTextureSnapshot(MoveTemp(Snapshot));
+				        return Image;
+			        },
+			        Config.GetConversionTaskPriority());
+
+			    FFmpegEncoderAddFrameResult Result;
+			    Target.AddFrame(ImageTask, Result, Action.ErrorMessage);
+			    Action.bSucceeded =
+			        FFmpegEncoderAddFrameResult::Success == Result;
+		    });
+	    });
+}
+
+UFFmpegEncoderAsyncAction*
+    UFFmpegEncoderAsyncAction::CloseAsync(UObject*        WorldContextObject,
+                                          UFFmpegEncoder* Encoder) {
+	return Create(
+	    WorldContextObject, Encoder,
+	    [](UFFmpegEncoderAsyncAction& Action, UFFmpegEncoder& Target) {
+		    // close, and wait for the rest of frames to be written
+		    return Target.LaunchInOrder([&Action, &Target]() {
+			    if (!Target.IsOpen()) {
+				    return Action.Fail(TEXT("Encoder is not opened."));
+			    }
+
+			    Target.Close();
+			    Target.WaitForCompletion();
+			    Action.bSucceeded = true;
+		    });
+	    });
+}
+
+void UFFmpegEncoderAsyncAction::Activate() {
+	const auto& StartCycles = FPlatformTime::Cycles64();
+
+	// start the call, unless it fails on the game thread
+	if (nullptr == TargetEncoder) {
+		Fail(TEXT("Encoder is nullptr"));
+	} else {
+		Task = Start(*this, *TargetEncoder);
+	}
+	Start = nullptr;
+
+	// execute the pins on the game thread once the call is finished
+	if (Task.IsValid()) {
+		TArray<UE::Tasks::FTask> Prerequisites = {Task};
+		Task = UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [WeakThis = TWeakObjectPtr<UFFmpegEncoderAsyncAction>(this)]() {
+			    AsyncTask(ENamedThreads::GameThread, [WeakThis]() {
+				    if (const auto& This = WeakThis.Get()) {
+					    This->Finish();
+				    }
+			    });
+		    },
+		    Prerequisites);
+	}
+
+	GameThreadMicroseconds = static_cast<float>(
+	    FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() -
+	                                    StartCycles) *
+	    1000.0);
+
+	// failed on the game thread
+	if (!Task.IsValid()) {
+		Finish();
+	}
+}
+
+bool UFFmpegEncoderAsyncAction::IsReadyForFinishDestroy() {
+	// Task refers to this action
+	return Super::IsReadyForFinishDestroy() && Task.IsCompleted();
+}
+
+UFFmpegEncoderAsyncAction*
+    UFFmpegEncoderAsyncAction::Create(UObject*        WorldContextObject,
+                                      UFFmpegEncoder* Encoder,
+                                      FStartFunction  InStart) {
+	const auto& Action = NewObject<UFFmpegEncoderAsyncAction>();
+	Action->TargetEncoder = Encoder;
+	Action->Start         = MoveTemp(InStart);
+
+	// keep alive until finished
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UFFmpegEncoderAsyncAction::Fail(const FString& Message) {
+	bSucceeded   = false;
+	ErrorMessage = Message;
+	UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+}
+
+void UFFmpegEncoderAsyncAction::Finish() {
+	if (bSucceeded) {
+		OnSuccess.Broadcast(ErrorMessage, GameThreadMicroseconds);
+	} else {
+		OnFailure.Broadcast(ErrorMessage, GameThreadMicroseconds);
+	}
+	SetReadyToDestroy();
+}
@@ -1,2 +1,102 @@
 
 #include "FFmpegEncoderConfig.h"
+
+bool FFFmpegEncoderConfig::IsHighPrecision() const {
+	return PixelFormat != FFmpegPixelFormat::YUV420P ||
+	       ColorTransfer == FFmpegColorTransfer::PQ;
+}
+
+float FFFmpegEncoderConfig::GetShutterWeight(
+    const int32 SubFrameIndex) const {
+	// box shutter unless a weight is given for each sub-frame
+	if (ShutterWeights.Num() != SubFramesPerFrame) {
+		return 1.0f;
+	}
+
+	return FMath::Max(0.0f, ShutterWeights[SubFrameIndex]);
+}
+
+TArray<FIntRect> FFFmpegEncoderConfig::GetMosaicTileRects() const {
+	TArray<FIntRect> Rects;
+	if (MosaicTiles <= 0) {
+		return Rects;
+	}
+
+	const auto& Columns =
+	    MosaicColumns > 0
+	        ? FMath::Min(MosaicColumns, MosaicTiles)
+	        : FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(MosaicTiles)));
+	const auto& Rows = FMath::DivideAndRoundUp(MosaicTiles, Columns);
+
+	// even sizes keep 4:2:0 chroma of each tile whole, and the remainder
+	// at the right and bottom is left black
+	const auto& TileWidth  = (Width / Columns) & ~1;
+	const auto& TileHeight = (Height / Rows) & ~1;
+
+	Rects.Reserve(MosaicTiles);
+	for (int32 Index = 0; Index < MosaicTiles; ++Index) {
+		const FIntPoint Min((Index % Columns) * TileWidth,
+		                    (Index / Columns) * TileHeight);
+		Rects.Emplace(Min, Min + FIntPoint(TileWidth, TileHeight));
+	}
+	return Rects;
+}
+
+EThreadPriority FFFmpegEncoderConfig::GetEncodeThreadPriority() const {
+	switch (EncodeThreadPriority) {
+	case FFmpegThreadPriority::Lowest:
+		return TPri_Lowest;
+	case FFmpegThreadPriority::Normal:
+		return TPri_Normal;
+	case FFmpegThreadPriority::AboveNormal:
+		return TPri_AboveNormal;
+	default:
+		return TPri_BelowNormal;
+	}
+}
+
+uint64 FFFmpegEncoderConfig::GetEncodeAffinityMask() const {
+	if (0 != EncodeAffinityMask) {
+		return static_cast<uint64>(EncodeAffinityMask);
+	}
+
+	// cores of this machine
+	const auto& NumCores = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	const auto& AllCores =
+	    NumCores >= 64 ? MAX_uint64 : (static_cast<uint64>(1) << NumCores) - 1;
+
+	// leave out the cores the game, render and RHI threads are pinned to
+	const auto& Reserved = FPlatformAffinity::GetMainGameMask() |
+	                       FPlatformAffinity::GetRenderingThreadMask() |
+	                       FPlatformAffinity::GetRHIThreadMask();
+	const auto& Unreserved = AllCores & ~Reserved;
+	if (0 != Unreserved && AllCores != Unreserved) {
+		return Unreserved;
+	}
+
+	// they aren't pinned on most desktop platforms, so leave the first two
+	// cores free for them when there are enough
+	return NumCores > 4 ? AllCores & ~static_cast<uint64>(0b11)
+	                    : FPlatformAffinity::GetNoAffinityMask();
+}
+
+LowLevelTasks::ETaskPriority
+    FFFmpegEncoderConfig::GetConversionTaskPriority() const {
+	switch (ConversionPriority) {
+	case FFmpegTaskPriority::BackgroundLow:
+		return LowLevelTasks::ETaskPriority::BackgroundLow;
+	case FFmpegTaskPriority::BackgroundHigh:
+		return LowLevelTasks::ETaskPriority::BackgroundHigh;
+	case FFmpegTaskPriority::Normal:
+		return LowLevelTasks::ETaskPriority::Normal;
+	default:
+		return LowLevelTasks::ETaskPriority::BackgroundNormal;
+	}
+}
+
+EParallelForFlags FFFmpegEncoderConfig::GetConversionParallelForFlags() const {
+	// stay on background workers unless conversion is in the foreground
+	return FFmpegTaskPriority::Normal == ConversionPriority
+	           ? EParallelForFlags::None
+	           : EParallelForFlags::BackgroundPriority;
+}
@@ -0,0 +1,222 @@
+
+#include "FFmpegEncoderPool.h"
+
+#include "FFmpegUtils.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#pragma region helpers
+namespace FFmpegEncoderPoolImpl {
+/**
+ * Runnable calling a function once, on a thread of its own
+ */
+class FCallRunnable: public FRunnable {
+public:
+	explicit FCallRunnable(TUniqueFunction<void()> InFunction)
+	    : Function(MoveTemp(InFunction)) {}
+
+	virtual uint32 Run() override {
+		Function();
+		return 0;
+	}
+
+private:
+	TUniqueFunction<void()> Function;
+};
+} // namespace FFmpegEncoderPoolImpl
+#pragma endregion
+
+FFFmpegEncoderPool& FFFmpegEncoderPool::Get() {
+	static FFFmpegEncoderPool Pool;
+	return Pool;
+}
+
+void FFFmpegEncoderPool::Prewarm(const FFFmpegEncoderConfig& Config,
+                                 const int32                 NumEncoders) {
+	const auto& Key = KeyOf(Config);
+
+	std::lock_guard lk(Entries_mutex);
+	auto& Entry       = Entries.FindOrAdd(Key);
+	Entry.Config      = Config;
+	Entry.NumEncoders = FMath::Max(0, NumEncoders);
+
+	// free encoders beyond the new number
+	while (Entry.CodecContexts.Num() > Entry.NumEncoders) {
+		auto CodecContext = Entry.CodecContexts.Pop();
+		avcodec_free_context(&CodecContext);
+	}
+
+	Refill(Key, Entry);
+}
+
+AVCodecContext*
+    FFFmpegEncoderPool::Acquire(const FFFmpegEncoderConfig& Config,
+                                bool& bPrewarmed, FString& ErrorMessage) {
+	const auto& Key = KeyOf(Config);
+
+	// take a warm encoder, and warm another for the next clip
+	{
+		std::lock_guard lk(Entries_mutex);
+		if (auto* Entry = Entries.Find(Key);
+		    Entry && !Entry->CodecContexts.IsEmpty()) {
+			const auto& CodecContext = Entry->CodecContexts.Pop();
+			Refill(Key, *Entry);
+			bPrewarmed = true;
+			return CodecContext;
+		}
+	}
+
+	// open now
+	bPrewarmed = false;
+	return Open(Config, ErrorMessage);
+}
+
+void FFFmpegEncoderPool::Release(AVCodecContext*&            CodecContext,
+                                 const FFFmpegEncoderConfig& Config) {
+	if (nullptr == CodecContext) {
+		return;
+	}
+
+	// encoders that can be reset after draining start the next clip as they
+	// are, where warm ones are short
+	if (CodecContext->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH) {
+		std::lock_guard lk(Entries_mutex);
+		if (auto* Entry = Entries.Find(KeyOf(Config));
+		    Entry && Entry->CodecContexts.Num() + Entry->NumOpening <
+		                 Entry->NumEncoders) {
+			avcodec_flush_buffers(CodecContext);
+			Entry->CodecContexts.Add(CodecContext);
+			CodecContext = nullptr;
+			return;
+		}
+	}
+
+	avcodec_free_context(&CodecContext);
+}
+
+void FFFmpegEncoderPool::Empty() {
+	// stop refilling, and wait for encoders being opened
+	TArray<UE::Tasks::FTask> Tasks;
+	{
+		std::lock_guard lk(Entries_mutex);
+		for (auto& [Key, Entry] : Entries) {
+			Entry.NumEncoders = 0;
+		}
+		Tasks = MoveTemp(OpenTasks);
+	}
+	UE::Tasks::Wait(Tasks);
+
+	// free warm encoders
+	std::lock_guard lk(Entries_mutex);
+	for (auto& [Key, Entry] : Entries) {
+		for (auto& CodecContext : Entry.CodecContexts) {
+			avcodec_free_context(&CodecContext);
+		}
+	}
+	Entries.Reset();
+}
+
+void FFFmpegEncoderPool::Refill(const FString& Key, FEntry& Entry) {
+	// forget finished tasks
+	OpenTasks.RemoveAll(
+	    [](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); });
+
+	// open in the background, behind frame conversion
+	for (; Entry.CodecContexts.Num() + Entry.NumOpening < Entry.NumEncoders;
+	     ++Entry.NumOpening) {
+		OpenTasks.Add(UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [this, Key, Config = Entry.Config]() {
+			    FString ErrorMessage;
+			    auto    CodecContext = Open(Config, ErrorMessage);
+
+			    // keep it unless the pool no longer needs it
+			    std::lock_guard lk(Entries_mutex);
+			    auto*           Entry = Entries.Find(Key);
+			    if (nullptr != Entry) {
+				    --Entry->NumOpening;
+			    }
+			    if (nullptr == CodecContext) {
+				    return;
+			    }
+			    if (nullptr != Entry &&
+			        Entry->CodecContexts.Num() < Entry->NumEncoders) {
+				    Entry->CodecContexts.Add(CodecContext);
+				    return;
+			    }
+			    avcodec_free_context(&CodecContext);
+		    },
+		    LowLevelTasks::ETaskPriority::BackgroundLow));
+	}
+}
+
+FString FFFmpegEncoderPool::KeyOf(const FFFmpegEncoderConfig& Config) {
+	// settings read by UFFmpegUtils::OpenVideoEncoder and OpenProxyEncoder,
+	// and the placement of the codec threads created by opening
+	return FString::Printf(
+	    TEXT("%d/%d/%dx%d@%g/%d/%g/%s/%d/%d/%d/%d/%d/%d/%llx"),
+	    static_cast<int32>(Config.Codec), static_cast<int32>(Config.ProxyCodec),
+	    Config.Width, Config.Height, Config.FrameRate, Config.BitRate,
+	    Config.Crf, *Config.Preset, Config.MaxBFrames,
+	    Config.bLowLatency ? 1 : 0, Config.Threads,
+	    static_cast<int32>(Config.PixelFormat),
+	    static_cast<int32>(Config.ColorTransfer),
+	    static_cast<int32>(Config.EncodeThreadPriority),
+	    Config.GetEncodeAffinityMask());
+}
+
+AVCodecContext*
+    FFFmpegEncoderPool::Open(const FFFmpegEncoderConfig& Config,
+                             FString&                    ErrorMessage) {
+	using namespace FFmpegEncoderPoolImpl;
+
+	// open on a thread placed as the encode thread, so that codec threads
+	// created by opening, such as those of libx264, inherit its placement
+	// where the platform does
+	AVCodecContext* CodecContext = nullptr;
+
+	FCallRunnable Runnable(
+	    [&]() { CodecContext = OpenOnThisThread(Config, ErrorMessage); });
+	const auto& Thread = FRunnableThread::Create(
+	    &Runnable, TEXT("FFmpeg open thread"), 0,
+	    Config.GetEncodeThreadPriority(), Config.GetEncodeAffinityMask());
+
+	// open here if threads can't be created
+	if (nullptr == Thread) {
+		return OpenOnThisThread(Config, ErrorMessage);
+	}
+	Thread->WaitForCompletion();
+	delete Thread;
+	return CodecContext;
+}
+
+AVCodecContext*
+    FFFmpegEncoderPool::OpenOnThisThread(const FFFmpegEncoderConfig& Config,
+                                         FString& ErrorMessage) {
+	// the cheap proxy codec is encoded instead if set
+	if (FFmpegProxyCodec::None != Config.ProxyCodec) {
+		const auto& CodecContext = UFFmpegUtils::OpenProxyEncoder(Config);
+		if (nullptr == CodecContext) {
+			ErrorMessage = TEXT("Failed to open the proxy encoder.");
+		}
+		return CodecContext;
+	}
+
+	const auto& Codec = UFFmpegUtils::FindVideoEncoder(Config.Codec);
+	if (nullptr == Codec) {
+		ErrorMessage = TEXT("Codec is not found.");
+		return nullptr;
+	}
+
+	const auto& CodecContext = UFFmpegUtils::OpenVideoEncoder(*Codec, Config);
+	if (nullptr == CodecContext) {
+		ErrorMessage = FString::Printf(
+		    TEXT("Failed to open %s with the size, rate and pixel format."),
+		    UTF8_TO_TCHAR(Codec->name));
+	}
+	return CodecContext;
+}
@@ -0,0 +1,345 @@
+
+#include "FFmpegEncoderSweep.h"
+
+#include "Algo/AnyOf.h"
+#include "Async/ParallelFor.h"
+#include "FFmpegUtils.h"
+#include "HAL/PlatformMemory.h"
+#include "LogFFmpegEncoder.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <Windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <sys/resource.h>
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+}
+
+#pragma region helpers
+namespace FFmpegEncoderSweepImpl {
+/**
+ * @return   CPU time spent by this process, in seconds.
+ */
+double ProcessCpuSeconds() {
+#if PLATFORM_WINDOWS
+	FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &CreationTime, &ExitTime,
+	                     &KernelTime, &UserTime)) {
+		return 0.0;
+	}
+
+	// FILETIME counts 100 ns
+	const auto& ToSeconds = [](const FILETIME& Time) {
+		return (static_cast<uint64>(Time.dwHighDateTime) << 32 |
+		        Time.dwLowDateTime) *
+		       1e-7;
+	};
+	return ToSeconds(KernelTime) + ToSeconds(UserTime);
+#else
+	rusage Usage;
+	if (getrusage(RUSAGE_SELF, &Usage) != 0) {
+		return 0.0;
+	}
+
+	const auto& ToSeconds = [](const timeval& Time) {
+		return Time.tv_sec + Time.tv_usec * 1e-6;
+	};
+	return ToSeconds(Usage.ru_utime) + ToSeconds(Usage.ru_stime);
+#endif
+}
+
+/**
+ * @return   luma samples of Frame normalized to [0, 1].
+ */
+TArray<float> LumaOf(const AVFrame& Frame) {
+	TArray<float> Luma;
+	Luma.SetNumUninitialized(Frame.width * Frame.height);
+
+	// luma is the first component of YUV formats
+	const auto& Descriptor =
+	    av_pix_fmt_desc_get(static_cast<AVPixelFormat>(Frame.format));
+	const auto& Component = Descriptor->comp[0];
+	const auto& Scale     = 1.0f / ((1 << Component.depth) - 1);
+
+	for (int32 Y = 0; Y < Frame.height; ++Y) {
+		const auto& Row = Frame.data[Component.plane] +
+		                  static_cast<int64>(Y) * Frame.linesize[Component.plane];
+		for (int32 X = 0; X < Frame.width; ++X) {
+			const auto& Sample =
+			    Component.step == 1
+			        ? Row[X]
+			        : reinterpret_cast<const uint16*>(Row)[X] >> Component.shift;
+			Luma[Y * Frame.width + X] = Sample * Scale;
+		}
+	}
+
+	return Luma;
+}
+
+/**
+ * @return   mean squared error of A against B.
+ */
+double MeanSquaredError(const TArray<float>& A, const TArray<float>& B) {
+	double Sum = 0.0;
+	for (int32 Index = 0; Index < A.Num(); ++Index) {
+		Sum += FMath::Square(A[Index] - B[Index]);
+	}
+	return Sum / FMath::Max(A.Num(), 1);
+}
+
+/**
+ * @return   SSIM of A against B, averaged over 8x8 windows with stride 4.
+ */
+double StructuralSimilarity(const TArray<float>& A, const TArray<float>& B,
+                            const int32 Width, const int32 Height) {
+	constexpr int32  WindowSize = 8;
+	constexpr int32  Stride     = 4;
+	constexpr double C1         = 0.01 * 0.01;
+	constexpr double C2         = 0.03 * 0.03;
+
+	double Sum        = 0.0;
+	int32  NumWindows = 0;
+	for (int32 Top = 0; Top + WindowSize <= Height; Top += Stride) {
+		for (int32 Left = 0; Left + WindowSize <= Width; Left += Stride) {
+			// moments of the window
+			double SumA = 0.0, SumB = 0.0, SumAA = 0.0, SumBB = 0.0, SumAB = 0.0;
+			for (int32 Y = Top; Y < Top + WindowSize; ++Y) {
+				for (int32 X = Left; X < Left + WindowSize; ++X) {
+					const double SampleA = A[Y * Width + X];
+					const double SampleB = B[Y * Width + X];
+					SumA += SampleA;
+					SumB += SampleB;
+					SumAA += SampleA * SampleA;
+					SumBB += SampleB * SampleB;
+					SumAB += SampleA * SampleB;
+				}
+			}
+
+			constexpr double N          = WindowSize * WindowSize;
+			const auto&      MeanA      = SumA / N;
+			const auto&      MeanB      = SumB / N;
+			const auto&      VarianceA  = SumAA / N - MeanA * MeanA;
+			const auto&      VarianceB  = SumBB / N - MeanB * MeanB;
+			const auto&      Covariance = SumAB / N - MeanA * MeanB;
+
+			Sum += (2.0 * MeanA * MeanB + C1) * (2.0 * Covariance + C2) /
+			       ((MeanA * MeanA + MeanB * MeanB + C1) *
+			        (VarianceA + VarianceB + C2));
+			++NumWindows;
+		}
+	}
+
+	return NumWindows > 0 ? Sum / NumWindows : 1.0;
+}
+} // namespace FFmpegEncoderSweepImpl
+#pragma endregion
+
+bool FFFmpegEncoderSweep::Measure(
+    TConstArrayView<FFFmpegFrameThreadSafeSharedPtr> SourceFrames,
+    const FFFmpegEncoderConfig& Config, FFFmpegSweepResult& Result) {
+	using namespace FFmpegEncoderSweepImpl;
+
+	Result        = FFFmpegSweepResult();
+	Result.Config = Config;
+
+	// open encoder as Config
+	const auto& Codec = UFFmpegUtils::FindVideoEncoder(Config.Codec);
+	if (nullptr == Codec) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Encoder of %s is not found."),
+		       *UEnum::GetValueAsString(Config.Codec));
+		return false;
+	}
+	auto Encoder = UFFmpegUtils::OpenVideoEncoder(*Codec, Config);
+	if (nullptr == Encoder) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to open %s with preset %s."),
+		       UTF8_TO_TCHAR(Codec->name), *Config.Preset);
+		return false;
+	}
+
+	// packets are kept to be decoded after timing
+	TArray<AVPacket*> Packets;
+	AVPacket*         Packet = av_packet_alloc();
+	int64             Bytes  = 0;
+
+	const auto& ReceivePackets = [&]() {
+		while (avcodec_receive_packet(Encoder, Packet) == 0) {
+			Bytes += Packet->size;
+			Packets.Add(av_packet_clone(Packet));
+			av_packet_unref(Packet);
+		}
+	};
+
+	// encode all frames, sampling memory after each one
+	const auto& BaseMemory    = FPlatformMemory::GetStats().UsedPhysical;
+	auto        PeakMemory    = BaseMemory;
+	const auto& StartCpu      = ProcessCpuSeconds();
+	const auto& StartSeconds  = FPlatformTime::Seconds();
+	auto        bEncodeFailed = false;
+	for (const auto& Frame : SourceFrames) {
+		if (avcodec_send_frame(Encoder, Frame.Get()) != 0) {
+			bEncodeFailed = true;
+			break;
+		}
+		ReceivePackets();
+		PeakMemory =
+		    FMath::Max(PeakMemory, FPlatformMemory::GetStats().UsedPhysical);
+	}
+	if (!bEncodeFailed && avcodec_send_frame(Encoder, nullptr) == 0) {
+		ReceivePackets();
+	}
+	const auto& ElapsedSeconds = FPlatformTime::Seconds() - StartSeconds;
+	const auto& CpuSeconds     = ProcessCpuSeconds() - StartCpu;
+
+	// open decoder of the encoded stream
+	const auto& DecoderCodec = avcodec_find_decoder(Encoder->codec_id);
+	auto        Decoder      = avcodec_alloc_context3(DecoderCodec);
+	const auto& bDecoderOpened =
+	    nullptr != DecoderCodec && nullptr != Decoder &&
+	    avcodec_open2(Decoder, DecoderCodec, nullptr) == 0;
+
+	// compare decoded frames with source frames of the same pts
+	AVFrame* DecodedFrame = av_frame_alloc();
+	double   SumMse       = 0.0;
+	double   SumSsim      = 0.0;
+	int32    NumCompared  = 0;
+
+	const auto& CompareFrames = [&]() {
+		while (avcodec_receive_frame(Decoder, DecodedFrame) == 0) {
+			const auto& Index = DecodedFrame->best_effort_timestamp;
+			if (SourceFrames.IsValidIndex(Index)) {
+				const auto& Source  = LumaOf(*SourceFrames[Index]);
+				const auto& Decoded = LumaOf(*DecodedFrame);
+				SumMse += MeanSquaredError(Decoded, Source);
+				SumSsim += StructuralSimilarity(Decoded, Source,
+				                                DecodedFrame->width,
+				                                DecodedFrame->height);
+				++NumCompared;
+			}
+			av_frame_unref(DecodedFrame);
+		}
+	};
+
+	if (bDecoderOpened) {
+		for (const auto& EncodedPacket : Packets) {
+			if (avcodec_send_packet(Decoder, EncodedPacket) == 0) {
+				CompareFrames();
+			}
+		}
+		avcodec_send_packet(Decoder, nullptr);
+		CompareFrames();
+	}
+
+	// free resources
+	for (auto& EncodedPacket : Packets) {
+		av_packet_free(&EncodedPacket);
+	}
+	av_packet_free(&Packet);
+	av_frame_free(&DecodedFrame);
+	avcodec_free_context(&Decoder);
+	avcodec_free_context(&Encoder);
+
+	if (bEncodeFailed || NumCompared != SourceFrames.Num()) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to encode and decode %d frames, %d were compared."),
+		       SourceFrames.Num(), NumCompared);
+		return false;
+	}
+
+	// fill Result
+	const auto& Mse              = SumMse / NumCompared;
+	const auto& DurationSeconds  = SourceFrames.Num() / Config.FrameRate;
+	Result.EncodeFramesPerSecond = static_cast<float>(
+	    SourceFrames.Num() / FMath::Max(ElapsedSeconds, 1e-9));
+	Result.CpuSeconds          = static_cast<float>(CpuSeconds);
+	Result.PeakMemoryMegabytes = (PeakMemory - BaseMemory) / (1024.0f * 1024.0f);
+	Result.KilobitsPerSecond =
+	    static_cast<float>(Bytes * 8 / DurationSeconds / 1000.0);
+	Result.PsnrY =
+	    Mse > 0.0 ? static_cast<float>(10.0 * FMath::LogX(10.0, 1.0 / Mse))
+	              : 100.0f;
+	Result.SsimY = static_cast<float>(SumSsim / NumCompared);
+
+	return true;
+}
+
+void FFFmpegEncoderSweep::MarkParetoFront(
+    TArrayView<FFFmpegSweepResult> Results) {
+	// A dominates B if A is no worse in all objectives and better in one
+	const auto& Dominates = [](const FFFmpegSweepResult& A,
+	                           const FFFmpegSweepResult& B) {
+		const auto& bNoWorse =
+		    A.EncodeFramesPerSecond >= B.EncodeFramesPerSecond &&
+		    A.SsimY >= B.SsimY && A.KilobitsPerSecond <= B.KilobitsPerSecond;
+		const auto& bBetter =
+		    A.EncodeFramesPerSecond > B.EncodeFramesPerSecond ||
+		    A.SsimY > B.SsimY || A.KilobitsPerSecond < B.KilobitsPerSecond;
+		return bNoWorse && bBetter;
+	};
+
+	for (auto& Result : Results) {
+		Result.bParetoOptimal = !Algo::AnyOf(
+		    Results, [&](const auto& Other) { return Dominates(Other, Result); });
+	}
+}
+
+FString
+    FFFmpegEncoderSweep::ToCsv(TConstArrayView<FFFmpegSweepResult> Results) {
+	FString Csv = TEXT("Codec,Preset,Crf,MaxBFrames,Threads,Width,Height,"
+	                   "EncodeFps,CpuSeconds,PeakMemoryMB,Kbps,PsnrY,SsimY,"
+	                   "Pareto\n");
+
+	for (const auto& Result : Results) {
+		const auto& Config = Result.Config;
+		Csv += FString::Printf(
+		    TEXT("%s,%s,%g,%d,%d,%d,%d,%.2f,%.3f,%.1f,%.1f,%.3f,%.5f,%d\n"),
+		    *StaticEnum<FFmpegVideoCodec>()->GetNameStringByValue(
+		        static_cast<int64>(Config.Codec)),
+		    *Config.Preset, Config.Crf, Config.MaxBFrames, Config.Threads,
+		    Config.Width, Config.Height, Result.EncodeFramesPerSecond,
+		    Result.CpuSeconds, Result.PeakMemoryMegabytes,
+		    Result.KilobitsPerSecond, Result.PsnrY, Result.SsimY,
+		    Result.bParetoOptimal ? 1 : 0);
+	}
+
+	return Csv;
+}
+
+FImage FFFmpegEncoderSweep::CreateSyntheticImage(const int32 Width,
+                                                 const int32 Height,
+                                                 const int32 Index) {
+	FImage Image(Width, Height, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	const auto& Colors = Image.AsBGRA8();
+
+	// a square moving over a scrolling gradient, and a band of noise
+	const auto& BoxSize = FMath::Max(Height / 4, 1);
+	const auto& BoxLeft = (Index * 8) % FMath::Max(Width - BoxSize, 1);
+	const auto& BoxTop  = (Height - BoxSize) / 2;
+
+	ParallelFor(Height, [&](const int32 Y) {
+		for (int32 X = 0; X < Width; ++X) {
+			auto& Color = Colors[Y * Width + X];
+			if (X >= BoxLeft && X < BoxLeft + BoxSize && Y >= BoxTop &&
+			    Y < BoxTop + BoxSize) {
+				// checkered box with sharp edges
+				const auto& bChecker = ((X - BoxLeft) / 8 + (Y - BoxTop) / 8) & 1;
+				Color = bChecker ? FColor::White : FColor(32, 64, 192);
+			} else if (Y >= Height * 7 / 8) {
+				// noise that changes every frame
+				const auto& Noise = static_cast<uint8>(
+				    FCrc::MemCrc32(&X, sizeof(X), Y * 7919 + Index) & 0xFF);
+				Color = FColor(Noise, Noise, Noise);
+			} else {
+				// gradient scrolling horizontally
+				Color = FColor((X + Index * 4) * 255 / Width % 256,
+				               Y * 255 / Height, 128);
+			}
+		}
+	});
+
+	return Image;
+}
@@ -0,0 +1,127 @@
+
+#include "FFmpegFilterGraph.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+}
+
+FFFmpegFilterGraph::~FFFmpegFilterGraph() {
+	Close();
+}
+
+bool FFFmpegFilterGraph::Open(const AVCodecContext& CodecContext,
+                              const FString& Filters, const int32 Threads,
+                              FString& ErrorMessage) {
+	AVFilterInOut* Inputs  = nullptr;
+	AVFilterInOut* Outputs = nullptr;
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		avfilter_inout_free(&Inputs);
+		avfilter_inout_free(&Outputs);
+		Close();
+		return false;
+	};
+
+	Graph = avfilter_graph_alloc();
+	if (nullptr == Graph) {
+		return Failure(TEXT("Failed to allocate filter graph."));
+	}
+
+	// filters process slices of each frame in parallel
+	Graph->nb_threads  = Threads;
+	Graph->thread_type = AVFILTER_THREAD_SLICE;
+
+	// frames enter in the format and time base of the encoder
+	const auto& SourceArgs = FString::Printf(
+	    TEXT("video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=1/1"),
+	    CodecContext.width, CodecContext.height,
+	    static_cast<int32>(CodecContext.pix_fmt), CodecContext.time_base.num,
+	    CodecContext.time_base.den);
+	const auto SourceArgsInUTF8 = StringCast<UTF8CHAR>(*SourceArgs);
+	if (avfilter_graph_create_filter(
+	        &Source, avfilter_get_by_name("buffer"), "in",
+	        reinterpret_cast<const char*>(SourceArgsInUTF8.Get()), nullptr,
+	        Graph) < 0 ||
+	    avfilter_graph_create_filter(&Sink, avfilter_get_by_name("buffersink"),
+	                                 "out", nullptr, nullptr, Graph) < 0) {
+		return Failure(TEXT("Failed to create buffer filters."));
+	}
+
+	// Filters run between the buffers, and frames leave in the pixel format
+	// of the encoder
+	const auto& Description = FString::Printf(
+	    TEXT("%s,format=%s"), *Filters,
+	    UTF8_TO_TCHAR(av_get_pix_fmt_name(CodecContext.pix_fmt)));
+	const auto DescriptionInUTF8 = StringCast<UTF8CHAR>(*Description);
+
+	Outputs = avfilter_inout_alloc();
+	Inputs  = avfilter_inout_alloc();
+	if (nullptr == Outputs || nullptr == Inputs) {
+		return Failure(TEXT("Failed to allocate filter pads."));
+	}
+	Outputs->name       = av_strdup("in");
+	Outputs->filter_ctx = Source;
+	Outputs->pad_idx    = 0;
+	Outputs->next       = nullptr;
+	Inputs->name        = av_strdup("out");
+	Inputs->filter_ctx  = Sink;
+	Inputs->pad_idx     = 0;
+	Inputs->next        = nullptr;
+
+	if (avfilter_graph_parse_ptr(
+	        Graph, reinterpret_cast<const char*>(DescriptionInUTF8.Get()),
+	        &Inputs, &Outputs, nullptr) < 0 ||
+	    avfilter_graph_config(Graph, nullptr) < 0) {
+		return Failure(
+		    FString::Printf(TEXT("Failed to build filter graph \"%s\"."),
+		                    *Filters));
+	}
+	avfilter_inout_free(&Inputs);
+	avfilter_inout_free(&Outputs);
+
+	// the encoder is opened for the size of output media
+	if (av_buffersink_get_w(Sink) != CodecContext.width ||
+	    av_buffersink_get_h(Sink) != CodecContext.height) {
+		return Failure(FString::Printf(
+		    TEXT("Filter graph \"%s\" must keep the size of output media."),
+		    *Filters));
+	}
+
+	// frames leave with pts in the time base of the encoder, 1 / FrameRate,
+	// so filters that change the time base or the rate are refused
+	const auto& FrameRate = av_buffersink_get_frame_rate(Sink);
+	if (av_cmp_q(av_buffersink_get_time_base(Sink), CodecContext.time_base) ||
+	    (FrameRate.num > 0 &&
+	     av_cmp_q(FrameRate, av_inv_q(CodecContext.time_base)))) {
+		return Failure(FString::Printf(
+		    TEXT("Filter graph \"%s\" must keep the frame rate of output "
+		         "media."),
+		    *Filters));
+	}
+
+	return true;
+}
+
+bool FFFmpegFilterGraph::SendFrame(const AVFrame* Frame) {
+	// the graph references the buffers of Frame, which stays as it is
+	return av_buffersrc_add_frame_flags(Source, const_cast<AVFrame*>(Frame),
+	                                    AV_BUFFERSRC_FLAG_KEEP_REF) >= 0;
+}
+
+bool FFFmpegFilterGraph::ReceiveFrame(AVFrame& Frame) {
+	return av_buffersink_get_frame(Sink, &Frame) >= 0;
+}
+
+void FFFmpegFilterGraph::Close() {
+	// filters are freed with the graph
+	avfilter_graph_free(&Graph);
+	Source = nullptr;
+	Sink   = nullptr;
+}
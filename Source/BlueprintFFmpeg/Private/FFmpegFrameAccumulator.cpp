@@ -0,0 +1,181 @@
+
+#include "FFmpegFrameAccumulator.h"
+
+#include "LogFFmpegEncoder.h"
+
+#pragma region helpers
+namespace FFmpegFrameAccumulatorImpl {
+FORCEINLINE VectorRegister4Float LoadRGBA32F(const uint8* Row, const int32 X) {
+	return VectorLoad(reinterpret_cast<const float*>(Row) + X * 4);
+}
+
+FORCEINLINE VectorRegister4Float LoadRGBA16F(const uint8* Row, const int32 X) {
+	alignas(16) float Pixel[4];
+	FPlatformMath::VectorLoadHalf(
+	    Pixel, reinterpret_cast<const uint16*>(Row) + X * 4);
+	return VectorLoadAligned(Pixel);
+}
+
+FORCEINLINE VectorRegister4Float LoadSRGBBGRA8(const uint8* Row,
+                                               const int32  X) {
+	// the curve is looked up, alpha is linear
+	const uint8* Pixel = Row + X * 4;
+	return MakeVectorRegisterFloat(FLinearColor::sRGBToLinearTable[Pixel[2]],
+	                               FLinearColor::sRGBToLinearTable[Pixel[1]],
+	                               FLinearColor::sRGBToLinearTable[Pixel[0]],
+	                               Pixel[3] / 255.0f);
+}
+
+FORCEINLINE VectorRegister4Float LoadLinearBGRA8(const uint8* Row,
+                                                 const int32  X) {
+	// BGRA to RGBA, normalized
+	return VectorMultiply(
+	    VectorSwizzle(VectorLoadByte4(Row + X * 4), 2, 1, 0, 3),
+	    VectorSetFloat1(1.0f / 255.0f));
+}
+
+/**
+ * Add rows [RowBegin, RowEnd) of an image to Sums, weighted by Weight.
+ * @param bFirst   whether Sums are overwritten instead of added to.
+ */
+template <VectorRegister4Float (*Load)(const uint8*, int32)>
+void AccumulateRows(const uint8* Rows, const int64 Stride, const int32 Width,
+                    const int32 RowBegin, const int32 RowEnd,
+                    const VectorRegister4Float Weight, const bool bFirst,
+                    VectorRegister4Float* Sums) {
+	for (int32 Y = RowBegin; Y < RowEnd; ++Y) {
+		const uint8*          Row    = Rows + Y * Stride;
+		VectorRegister4Float* RowSum = Sums + static_cast<int64>(Y) * Width;
+
+		if (bFirst) {
+			for (int32 X = 0; X < Width; ++X) {
+				RowSum[X] = VectorMultiply(Load(Row, X), Weight);
+			}
+		} else {
+			for (int32 X = 0; X < Width; ++X) {
+				RowSum[X] = VectorMultiplyAdd(Load(Row, X), Weight, RowSum[X]);
+			}
+		}
+	}
+}
+} // namespace FFmpegFrameAccumulatorImpl
+#pragma endregion
+
+FFFmpegFrameAccumulator::FFFmpegFrameAccumulator(
+    const EParallelForFlags ParallelForFlags)
+    : ParallelForFlags(ParallelForFlags) {}
+
+bool FFFmpegFrameAccumulator::Accumulate(const FImage& Image,
+                                         const float   Weight) {
+	using namespace FFmpegFrameAccumulatorImpl;
+
+	const auto& Width  = Image.GetWidth();
+	const auto& Height = Image.GetHeight();
+	if (Width <= 0 || Height <= 0 || Weight <= 0.0f) {
+		return false;
+	}
+
+	// the first sub-frame decides the size of the frame
+	const auto& bFirst = WeightSum <= 0.0f;
+	if (bFirst) {
+		if (Width != SumWidth || Height != SumHeight) {
+			Sums.SetNumUninitialized(Width * Height);
+			SumWidth  = Width;
+			SumHeight = Height;
+		}
+	} else if (Width != SumWidth || Height != SumHeight) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Sub-frame of %dx%d differs from %dx%d of the frame."), Width,
+		       Height, SumWidth, SumHeight);
+		return false;
+	}
+
+	// formats read directly, or linearized first
+	FImage        LinearImage;
+	const FImage* Source = &Image;
+	auto*         Rows   = &AccumulateRows<&LoadRGBA32F>;
+	switch (Image.Format) {
+	case ERawImageFormat::RGBA32F:
+		break;
+	case ERawImageFormat::RGBA16F:
+		Rows = &AccumulateRows<&LoadRGBA16F>;
+		break;
+	case ERawImageFormat::BGRA8:
+		if (EGammaSpace::sRGB == Image.GammaSpace) {
+			Rows = &AccumulateRows<&LoadSRGBBGRA8>;
+			break;
+		}
+		if (EGammaSpace::Linear == Image.GammaSpace) {
+			Rows = &AccumulateRows<&LoadLinearBGRA8>;
+			break;
+		}
+		[[fallthrough]];
+	default:
+		Image.CopyTo(LinearImage, ERawImageFormat::RGBA32F, EGammaSpace::Linear);
+		Source = &LinearImage;
+		break;
+	}
+
+	// add rows in parallel
+	const auto& Stride =
+	    static_cast<int64>(Width) * Source->GetBytesPerPixel();
+	const auto& WeightVector = VectorSetFloat1(Weight);
+	ParallelFor(
+	    FMath::DivideAndRoundUp(Height, RowsPerTask),
+	    [&](const int32 TaskIndex) {
+		    const auto& RowBegin = TaskIndex * RowsPerTask;
+		    Rows(Source->RawData.GetData(), Stride, Width, RowBegin,
+		         FMath::Min(RowBegin + RowsPerTask, Height), WeightVector,
+		         bFirst, Sums.GetData());
+	    },
+	    ParallelForFlags);
+
+	WeightSum += Weight;
+	return true;
+}
+
+const FImage& FFFmpegFrameAccumulator::Resolve(const int32 Width,
+                                              const int32 Height) {
+	// helper function to allocate Resolved only when its size changes
+	const auto& Reallocate = [&](const int32 ImageWidth,
+	                             const int32 ImageHeight) {
+		if (Resolved.GetWidth() != ImageWidth ||
+		    Resolved.GetHeight() != ImageHeight) {
+			Resolved.Init(ImageWidth, ImageHeight, ERawImageFormat::RGBA32F,
+			              EGammaSpace::Linear);
+		}
+	};
+
+	// black if the shutter was closed for all sub-frames
+	if (WeightSum <= 0.0f) {
+		Reallocate(Width, Height);
+		FMemory::Memzero(Resolved.RawData.GetData(), Resolved.RawData.Num());
+		return Resolved;
+	}
+
+	Reallocate(SumWidth, SumHeight);
+
+	// divide by the total weight in parallel
+	const auto&                 Scale = VectorSetFloat1(1.0f / WeightSum);
+	const VectorRegister4Float* Sum   = Sums.GetData();
+
+	float* Pixels = reinterpret_cast<float*>(Resolved.RawData.GetData());
+	ParallelFor(
+	    FMath::DivideAndRoundUp(SumHeight, RowsPerTask),
+	    [&](const int32 TaskIndex) {
+		    const auto& Begin =
+		        static_cast<int64>(TaskIndex) * RowsPerTask * SumWidth;
+		    const auto& End = FMath::Min(
+		        Begin + static_cast<int64>(RowsPerTask) * SumWidth,
+		        static_cast<int64>(SumWidth) * SumHeight);
+		    for (int64 Index = Begin; Index < End; ++Index) {
+			    VectorStore(VectorMultiply(Sum[Index], Scale),
+			                Pixels + Index * 4);
+		    }
+	    },
+	    ParallelForFlags);
+
+	// the next frame overwrites Sums
+	WeightSum = 0.0f;
+	return Resolved;
+}
@@ -0,0 +1,242 @@
+
+#include "FFmpegFrameTrace.h"
+
+#include "FFmpegEncodeThread.h"
+#include "FFmpegEncoderSweep.h"
+#include "HAL/FileManager.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/Compression.h"
+
+FArchive& operator<<(FArchive& Ar, FFFmpegTraceEvent& Event) {
+	// enums are stored as bytes
+	auto Source     = static_cast<uint8>(Event.Source);
+	auto Format     = static_cast<uint8>(Event.Format);
+	auto GammaSpace = static_cast<uint8>(Event.GammaSpace);
+
+	Ar << Event.Index << Event.Seconds << Event.ReadySeconds << Source
+	   << Event.TileIndex << Event.Width << Event.Height << Format
+	   << GammaSpace << Event.PayloadSize;
+
+	if (Ar.IsLoading()) {
+		Event.Source     = static_cast<FFmpegTraceSource>(Source);
+		Event.Format     = static_cast<ERawImageFormat::Type>(Format);
+		Event.GammaSpace = static_cast<EGammaSpace>(GammaSpace);
+	}
+	return Ar;
+}
+
+bool FFFmpegTraceRecorder::Open(const FString&              Path,
+                                const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+                                const bool                  bInRecordPayload) {
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*Path));
+	if (!Writer) {
+		return false;
+	}
+	StartCycles    = FPlatformTime::Cycles64();
+	bRecordPayload = bInRecordPayload;
+
+	// header, followed by events until the end
+	uint32  Magic   = FFFmpegTrace::Magic;
+	int32   Version = FFFmpegTrace::Version;
+	FString ConfigText;
+	FFFmpegEncoderConfig::StaticStruct()->ExportText(
+	    ConfigText, &FFmpegEncoderConfig, nullptr, nullptr, PPF_None, nullptr);
+	*Writer << Magic << Version << ConfigText;
+	return true;
+}
+
+double FFFmpegTraceRecorder::Now() const {
+	return FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+}
+
+void FFFmpegTraceRecorder::Record(FFFmpegTraceEvent Event,
+                                  const FImage*     Image) {
+	// compress outside of the lock, so that tasks recording in parallel
+	// don't wait for each other
+	TArray<uint8> Payload;
+	if (nullptr != Image) {
+		Event.Width      = Image->GetWidth();
+		Event.Height     = Image->GetHeight();
+		Event.Format     = Image->Format;
+		Event.GammaSpace = Image->GammaSpace;
+
+		const auto& RawSize = Image->RawData.Num();
+		if (bRecordPayload && RawSize > 0 && RawSize <= MAX_int32) {
+			auto CompressedSize = FCompression::CompressMemoryBound(
+			    NAME_LZ4, static_cast<int32>(RawSize));
+			Payload.SetNumUninitialized(CompressedSize);
+			if (FCompression::CompressMemory(NAME_LZ4, Payload.GetData(),
+			                                 CompressedSize,
+			                                 Image->RawData.GetData(),
+			                                 static_cast<int32>(RawSize))) {
+				Payload.SetNum(CompressedSize);
+			} else {
+				Payload.Reset();
+			}
+		}
+	}
+	Event.PayloadSize = Payload.Num();
+
+	std::lock_guard Lock(Writer_mutex);
+	*Writer << Event;
+	Writer->Serialize(Payload.GetData(), Payload.Num());
+}
+
+bool FFFmpegTrace::Load(const FString& InPath, FString& ErrorMessage) {
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		return false;
+	};
+
+	Path = InPath;
+	Events.Reset();
+
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+	if (!Reader) {
+		return Failure(FString::Printf(TEXT("Failed to open %s."), *Path));
+	}
+
+	uint32  FileMagic   = 0;
+	int32   FileVersion = 0;
+	FString ConfigText;
+	*Reader << FileMagic << FileVersion;
+	if (Magic != FileMagic || Version != FileVersion) {
+		return Failure(
+		    FString::Printf(TEXT("%s is not a trace of this version."), *Path));
+	}
+	*Reader << ConfigText;
+	FFFmpegEncoderConfig::StaticStruct()->ImportText(
+	    *ConfigText, &Config, nullptr, PPF_None, GLog,
+	    FFFmpegEncoderConfig::StaticStruct()->GetName());
+
+	// events are written as their images are ready, and the last may be
+	// cut off by a crash
+	while (Reader->Tell() < Reader->TotalSize()) {
+		FFFmpegTraceEvent Event;
+		*Reader << Event;
+		Event.PayloadOffset = Reader->Tell();
+		if (Reader->IsError() || Event.PayloadSize < 0 ||
+		    Event.PayloadOffset + Event.PayloadSize > Reader->TotalSize()) {
+			break;
+		}
+		Reader->Seek(Event.PayloadOffset + Event.PayloadSize);
+		Events.Add(MoveTemp(Event));
+	}
+
+	Events.Sort([](const FFFmpegTraceEvent& A, const FFFmpegTraceEvent& B) {
+		return A.Index < B.Index;
+	});
+	return true;
+}
+
+const FFFmpegEncoderConfig& FFFmpegTrace::GetConfig() const {
+	return Config;
+}
+
+TConstArrayView<FFFmpegTraceEvent> FFFmpegTrace::GetEvents() const {
+	return Events;
+}
+
+bool FFFmpegTrace::ReadImage(const FFFmpegTraceEvent& Event,
+                             FImage&                  Image) const {
+	const auto& Width  = Event.Width > 0 ? Event.Width : Config.Width;
+	const auto& Height = Event.Height > 0 ? Event.Height : Config.Height;
+
+	// recorded pixels
+	if (Event.PayloadSize > 0) {
+		TArray<uint8>        Payload;
+		TUniquePtr<FArchive> Reader(
+		    IFileManager::Get().CreateFileReader(*Path));
+		if (Reader) {
+			Payload.SetNumUninitialized(Event.PayloadSize);
+			Reader->Seek(Event.PayloadOffset);
+			Reader->Serialize(Payload.GetData(), Payload.Num());
+		}
+
+		Image.Init(Width, Height, Event.Format, Event.GammaSpace);
+		if (Reader && !Reader->IsError() &&
+		    FCompression::UncompressMemory(
+		        NAME_LZ4, Image.RawData.GetData(),
+		        static_cast<int32>(Image.RawData.Num()), Payload.GetData(),
+		        Payload.Num())) {
+			return true;
+		}
+		UE_LOG(LogFFmpegEncoder, Warning,
+		       TEXT("Failed to read pixels of image %lld of %s."), Event.Index,
+		       *Path);
+	}
+
+	// an image of the same size and format
+	Image = FFFmpegEncoderSweep::CreateSyntheticImage(
+	    Width, Height, static_cast<int32>(Event.Index));
+	Image.ChangeFormat(Event.Format, Event.GammaSpace);
+	return false;
+}
+
+bool FFFmpegTrace::Replay(const FString& OutputFilePath, const float TimeScale,
+                          FFFmpegEncoderStats& Stats,
+                          FString&             ErrorMessage) const {
+	// recorded setting, without recording again
+	auto ReplayConfig = Config;
+	ReplayConfig.TraceFilePath.Empty();
+
+	// encode on a thread of its own, and wait for it on destruction
+	auto EncodeThread = MakeUnique<FFFmpegEncodeThread>();
+
+	FFmpegEncoderOpenResult OpenResult;
+	EncodeThread->Open(ReplayConfig, OutputFilePath, OpenResult, ErrorMessage);
+	if (FFmpegEncoderOpenResult::Success != OpenResult) {
+		return false;
+	}
+
+	// helper function to wait until the recorded time
+	const auto& StartSeconds = FPlatformTime::Seconds();
+
+	const auto& WaitUntil = [&](const double Seconds) {
+		const auto& WaitSeconds =
+		    StartSeconds + Seconds * TimeScale - FPlatformTime::Seconds();
+		if (WaitSeconds > 0.0) {
+			FPlatformProcess::SleepNoStats(static_cast<float>(WaitSeconds));
+		}
+	};
+
+	for (const auto& Event : Events) {
+		WaitUntil(Event.Seconds);
+
+		// ready after the recorded readback or loading
+		const auto& DelaySeconds =
+		    (Event.ReadySeconds - Event.Seconds) * TimeScale;
+		auto ImageTask = UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [this, Event, DelaySeconds]() {
+			    if (DelaySeconds > 0.0) {
+				    FPlatformProcess::SleepNoStats(
+				        static_cast<float>(DelaySeconds));
+			    }
+			    FImage Image;
+			    ReadImage(Event, Image);
+			    return Image;
+		    },
+		    ReplayConfig.GetConversionTaskPriority());
+
+		FFmpegEncoderAddFrameResult AddFrameResult;
+		if (INDEX_NONE != Event.TileIndex) {
+			EncodeThread->AddMosaicTile(Event.TileIndex, ImageTask,
+			                            AddFrameResult, ErrorMessage);
+		} else {
+			EncodeThread->AddFrame(ImageTask, AddFrameResult, ErrorMessage);
+		}
+		if (FFmpegEncoderAddFrameResult::Success != AddFrameResult) {
+			EncodeThread->Close();
+			return false;
+		}
+	}
+
+	// wait for all frames to be written
+	EncodeThread->Close();
+	EncodeThread->WaitForCompletion();
+	Stats = EncodeThread->GetStats();
+	return true;
+}
@@ -0,0 +1,223 @@
+
+#include "FFmpegGopCache.h"
+
+#include "Async/ParallelFor.h"
+#include "FFmpegEncodeThread.h"
+#include "FFmpegStreamCopy.h"
+#include "HAL/FileManager.h"
+#include "Hash/xxhash.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#pragma region helpers
+namespace FFmpegGopCacheImpl {
+// changed when cached GOPs are no longer compatible with the encoder
+constexpr const TCHAR CacheVersion[] = TEXT("1");
+
+/**
+ * @return   hash of the contents of each file of Paths, read in parallel.
+ *           files that fail to be read hash as empty.
+ */
+TArray<FXxHash64> HashFiles(TConstArrayView<FString> Paths) {
+	TArray<FXxHash64> Hashes;
+	Hashes.SetNum(Paths.Num());
+	ParallelFor(Paths.Num(), [&](const int32 Index) {
+		TArray64<uint8> Data;
+		FFileHelper::LoadFileToArray(Data, *Paths[Index], FILEREAD_Silent);
+		Hashes[Index] = FXxHash64::HashBuffer(Data.GetData(), Data.Num());
+	});
+	return Hashes;
+}
+
+/**
+ * @return   hash of all settings of Config, which frames and packets
+ *           depend on.
+ */
+FXxHash64 HashConfig(const FFFmpegEncoderConfig& Config) {
+	FString Text = CacheVersion;
+	FFFmpegEncoderConfig::StaticStruct()->ExportText(
+	    Text, &Config, nullptr, nullptr, PPF_None, nullptr);
+	return FXxHash64::HashBuffer(*Text, Text.Len() * sizeof(TCHAR));
+}
+
+// codec threads of each GOP encoded at once, when picked automatically
+constexpr int32 ThreadsPerGop = 4;
+
+/**
+ * Encode of a GOP into Path through a file beside it, so that an
+ * interrupted encode never leaves a GOP in the cache.
+ */
+struct FGopEncode {
+	FString                         Path;
+	FString                         TempPath;
+	TUniquePtr<FFFmpegEncodeThread> EncodeThread;
+	bool                            bAdded = false;
+	FString                         ErrorMessage;
+
+	/**
+	 * Open an encoder and add ImagePaths to it, which are encoded on its
+	 * thread while other GOPs are started.
+	 */
+	void Start(TConstArrayView<FString>    ImagePaths,
+	           const FFFmpegEncoderConfig& Config) {
+		TempPath = FPaths::GetPath(Path) /
+		           FString::Printf(TEXT("~%s"), *FPaths::GetCleanFilename(Path));
+		EncodeThread = MakeUnique<FFFmpegEncodeThread>();
+
+		FFmpegEncoderOpenResult OpenResult;
+		EncodeThread->Open(Config, TempPath, OpenResult, ErrorMessage);
+		if (FFmpegEncoderOpenResult::Success != OpenResult) {
+			EncodeThread.Reset();
+			return;
+		}
+
+		FFmpegEncoderAddFrameResult AddFrameResult;
+		EncodeThread->AddFrames(ImagePaths, AddFrameResult, ErrorMessage);
+		bAdded = FFmpegEncoderAddFrameResult::Success == AddFrameResult;
+	}
+
+	/**
+	 * Wait for the encoder to finish, and move its file into Path.
+	 * @return   whether Path was written.
+	 */
+	bool Finish() {
+		// wait for the encode thread on destruction
+		if (EncodeThread) {
+			EncodeThread->Close();
+			EncodeThread.Reset();
+		}
+
+		auto& FileManager = IFileManager::Get();
+		if (!bAdded || FileManager.FileSize(*TempPath) <= 0 ||
+		    !FileManager.Move(*Path, *TempPath)) {
+			FileManager.Delete(*TempPath);
+			if (ErrorMessage.IsEmpty()) {
+				ErrorMessage = FString::Printf(
+				    TEXT("Failed to encode GOP into %s."), *Path);
+			}
+			return false;
+		}
+		return true;
+	}
+};
+} // namespace FFmpegGopCacheImpl
+#pragma endregion
+
+bool EncodeImagesWithGopCache(TConstArrayView<FString>    ImagePaths,
+                              const FFFmpegEncoderConfig& Config,
+                              const FString&              CacheDirectory,
+                              const int32                 FramesPerGop,
+                              const FString&              OutputPath,
+                              FFFmpegGopCacheResult&      Result,
+                              FString&                    ErrorMessage) {
+	using namespace FFmpegGopCacheImpl;
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		return false;
+	};
+
+	Result = {};
+	if (ImagePaths.IsEmpty() || FramesPerGop <= 0) {
+		return Failure(TEXT("Nothing to encode."));
+	}
+
+	// each GOP is encoded from its first frame, so filters would see
+	// timestamps and frame numbers restarting at every GOP
+	if (!Config.FilterGraph.IsEmpty()) {
+		return Failure(TEXT("FilterGraph is not supported by the GOP cache."));
+	}
+
+	// GOPs have no audio to encode, and would overwrite each other's trace
+	auto GopConfig          = Config;
+	GopConfig.AudioCodec    = FFmpegAudioCodec::None;
+	GopConfig.TraceFilePath = FString();
+	if (!IFileManager::Get().MakeDirectory(*CacheDirectory, true)) {
+		return Failure(FString::Printf(TEXT("Failed to create %s."),
+		                               *CacheDirectory));
+	}
+
+	// GOPs are stored in the container of the output, so that they can be
+	// copied into it
+	const auto& Extension   = FPaths::GetExtension(OutputPath, true);
+	const auto& ConfigHash  = HashConfig(GopConfig);
+	const auto& ImageHashes = HashFiles(ImagePaths);
+
+	const auto& NumGops =
+	    FMath::DivideAndRoundUp(ImagePaths.Num(), FramesPerGop);
+	TArray<FFFmpegStreamCopyRange> Ranges;
+	TArray<int32>                  MissingGops;
+	Ranges.SetNum(NumGops);
+	for (int32 GopIndex = 0; GopIndex < NumGops; ++GopIndex) {
+		const auto& Start = GopIndex * FramesPerGop;
+		const auto& Count = FMath::Min(FramesPerGop, ImagePaths.Num() - Start);
+
+		// key of the settings and the images of the GOP in order
+		FXxHash64Builder Builder;
+		Builder.Update(&ConfigHash.Hash, sizeof(ConfigHash.Hash));
+		for (int32 Index = Start; Index < Start + Count; ++Index) {
+			Builder.Update(&ImageHashes[Index].Hash,
+			               sizeof(ImageHashes[Index].Hash));
+		}
+		const auto& Path =
+		    CacheDirectory / FString::Printf(TEXT("%016llx%s"),
+		                                     Builder.Finalize().Hash,
+		                                     *Extension);
+		Ranges[GopIndex].InputPath = Path;
+
+		// reuse the GOP, or encode it on a miss
+		if (IFileManager::Get().FileExists(*Path)) {
+			++Result.ReusedGops;
+		} else {
+			MissingGops.Add(GopIndex);
+		}
+	}
+
+	// missing GOPs are encoded in waves sharing the cores, each GOP with
+	// ThreadsPerGop codec threads unless configured
+	if (GopConfig.Threads <= 0) {
+		GopConfig.Threads = ThreadsPerGop;
+	}
+	const auto& GopsPerWave =
+	    FMath::Max(1, FPlatformMisc::NumberOfCoresIncludingHyperthreads() /
+	                      GopConfig.Threads);
+	for (int32 WaveStart = 0; WaveStart < MissingGops.Num();
+	     WaveStart += GopsPerWave) {
+		const auto& WaveEnd =
+		    FMath::Min(WaveStart + GopsPerWave, MissingGops.Num());
+
+		TArray<FGopEncode> Encodes;
+		for (int32 Index = WaveStart; Index < WaveEnd; ++Index) {
+			const auto& Start = MissingGops[Index] * FramesPerGop;
+			const auto& Count =
+			    FMath::Min(FramesPerGop, ImagePaths.Num() - Start);
+
+			auto& Encode = Encodes.AddDefaulted_GetRef();
+			Encode.Path  = Ranges[MissingGops[Index]].InputPath;
+			Encode.Start(ImagePaths.Slice(Start, Count), GopConfig);
+		}
+
+		// wait for the whole wave even after a failure
+		FString WaveErrorMessage;
+		for (auto& Encode : Encodes) {
+			if (Encode.Finish()) {
+				++Result.EncodedGops;
+			} else if (WaveErrorMessage.IsEmpty()) {
+				WaveErrorMessage = Encode.ErrorMessage;
+			}
+		}
+		if (!WaveErrorMessage.IsEmpty()) {
+			return Failure(WaveErrorMessage);
+		}
+	}
+
+	UE_LOG(LogFFmpegEncoder, Log,
+	       TEXT("GOP cache of %s: %d reused, %d encoded."), *OutputPath,
+	       Result.ReusedGops, Result.EncodedGops);
+
+	// join the GOPs without re-encoding
+	return CopyMediaByStreamCopy(Ranges, OutputPath, ErrorMessage);
+}
@@ -0,0 +1,35 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+
+/**
+ * Counts of GOPs of EncodeImagesWithGopCache
+ */
+struct FFFmpegGopCacheResult {
+	int32 ReusedGops  = 0;
+	int32 EncodedGops = 0;
+};
+
+/**
+ * Encode ImagePaths into OutputPath in GOPs of FramesPerGop frames. Each GOP
+ * is encoded on its own, starting with a keyframe, into CacheDirectory under
+ * a key of the contents of its images and FFmpegEncoderConfig. GOPs whose
+ * key is cached are reused as they are, and all of them are joined into
+ * OutputPath by CopyMediaByStreamCopy, so that re-rendering a few frames
+ * re-encodes only their GOPs. Missing GOPs are encoded in parallel.
+ * As every GOP starts from frame 0, FilterGraph is rejected, and AudioCodec
+ * and TraceFilePath are ignored.
+ * Cached GOPs are kept until deleted, and are shared by sequences and
+ * outputs of the same extension.
+ * @param[out] Result   counts of reused and encoded GOPs.
+ * @return   whether OutputPath was written.
+ */
+bool EncodeImagesWithGopCache(TConstArrayView<FString>    ImagePaths,
+                              const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+                              const FString&              CacheDirectory,
+                              int32                       FramesPerGop,
+                              const FString&              OutputPath,
+                              FFFmpegGopCacheResult&      Result,
+                              FString&                    ErrorMessage);
@@ -0,0 +1,194 @@
+
+#include "FFmpegKeyframeIndex.h"
+
+#include "Algo/BinarySearch.h"
+#include "HAL/FileManager.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#pragma region helpers
+namespace FFmpegKeyframeIndexImpl {
+// first bytes of sidecar files, changed with the layout
+constexpr uint32 SidecarMagic = 0x4B464631; // "KFF1"
+} // namespace FFmpegKeyframeIndexImpl
+#pragma endregion
+
+FArchive& operator<<(FArchive& Ar, FFFmpegKeyframe& Keyframe) {
+	return Ar << Keyframe.Timestamp << Keyframe.Position << Keyframe.Seconds;
+}
+
+FString FFFmpegKeyframeIndex::SidecarPathOf(const FString& MediaPath) {
+	return MediaPath + TEXT(".keyframes");
+}
+
+bool FFFmpegKeyframeIndex::Build(const FString& InMediaPath) {
+	MediaPath = InMediaPath;
+	Keyframes.Reset();
+
+	// remember which media the index describes
+	auto& FileManager = IFileManager::Get();
+	MediaSize         = FileManager.FileSize(*MediaPath);
+	MediaTimestamp    = FileManager.GetTimeStamp(*MediaPath);
+
+	// open input
+	const auto&      Path          = StringCast<UTF8CHAR>(*MediaPath);
+	AVFormatContext* FormatContext = nullptr;
+	if (avformat_open_input(&FormatContext,
+	                        reinterpret_cast<const char*>(Path.Get()), nullptr,
+	                        nullptr) < 0) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to open %s."), *MediaPath);
+		return false;
+	}
+
+	// find the first video stream
+	const auto& StreamIndex =
+	    avformat_find_stream_info(FormatContext, nullptr) < 0
+	        ? AVERROR_STREAM_NOT_FOUND
+	        : av_find_best_stream(FormatContext, AVMEDIA_TYPE_VIDEO, -1, -1,
+	                              nullptr, 0);
+	if (StreamIndex < 0) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("No video stream is in %s."),
+		       *MediaPath);
+		avformat_close_input(&FormatContext);
+		return false;
+	}
+	const auto& Stream   = FormatContext->streams[StreamIndex];
+	const auto& TimeBase = av_q2d(Stream->time_base);
+	const auto& StartPts =
+	    AV_NOPTS_VALUE == Stream->start_time ? 0 : Stream->start_time;
+
+	// helper function to add a keyframe, timed from Origin of the same kind
+	// of timestamps
+	const auto& AddKeyframe = [&](const int64 Timestamp, const int64 Position,
+	                              const int64 Origin) {
+		if (AV_NOPTS_VALUE != Timestamp) {
+			Keyframes.Add(
+			    {Timestamp, Position, (Timestamp - Origin) * TimeBase});
+		}
+	};
+
+	// containers such as mp4 index their samples in the header, by decoding
+	// timestamps, which are timed from the first sample as keyframes are
+	// presented as late after decoding as the first one
+	const auto& NumEntries = avformat_index_get_entries_count(Stream);
+	const auto& FirstDts =
+	    NumEntries > 0 ? avformat_index_get_entry(Stream, 0)->timestamp : 0;
+	for (int Index = 0; Index < NumEntries; ++Index) {
+		const auto& Entry = avformat_index_get_entry(Stream, Index);
+		if (Entry->flags & AVINDEX_KEYFRAME) {
+			AddKeyframe(Entry->timestamp, Entry->pos, FirstDts);
+		}
+	}
+
+	// otherwise read packets without decoding them
+	if (Keyframes.IsEmpty()) {
+		AVPacket* Packet = av_packet_alloc();
+		while (nullptr != Packet && av_read_frame(FormatContext, Packet) >= 0) {
+			if (Packet->stream_index == StreamIndex &&
+			    (Packet->flags & AV_PKT_FLAG_KEY)) {
+				AddKeyframe(AV_NOPTS_VALUE == Packet->pts ? Packet->dts
+				                                          : Packet->pts,
+				            Packet->pos, StartPts);
+			}
+			av_packet_unref(Packet);
+		}
+		av_packet_free(&Packet);
+	}
+
+	avformat_close_input(&FormatContext);
+
+	// in timestamp order
+	Keyframes.Sort([](const FFFmpegKeyframe& A, const FFFmpegKeyframe& B) {
+		return A.Timestamp < B.Timestamp;
+	});
+
+	return true;
+}
+
+bool FFFmpegKeyframeIndex::LoadOrBuild(const FString& InMediaPath) {
+	if (Load(InMediaPath)) {
+		return true;
+	}
+
+	// build on first scan, and keep it for following ones
+	if (!Build(InMediaPath)) {
+		return false;
+	}
+	Save();
+	return true;
+}
+
+bool FFFmpegKeyframeIndex::Save() const {
+	using namespace FFmpegKeyframeIndexImpl;
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+
+	// FArchive takes non-const references, which saving doesn't modify
+	auto  Magic     = SidecarMagic;
+	auto  Size      = MediaSize;
+	auto  Timestamp = MediaTimestamp;
+	auto& Entries   = const_cast<TArray<FFFmpegKeyframe>&>(Keyframes);
+	Writer << Magic << Size << Timestamp << Entries;
+
+	return FFileHelper::SaveArrayToFile(Bytes, *SidecarPathOf(MediaPath));
+}
+
+bool FFFmpegKeyframeIndex::Load(const FString& InMediaPath) {
+	using namespace FFmpegKeyframeIndexImpl;
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *SidecarPathOf(InMediaPath),
+	                                  FILEREAD_Silent)) {
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32        Magic = 0;
+	Reader << Magic;
+	if (SidecarMagic != Magic) {
+		return false;
+	}
+
+	int64                   Size = 0;
+	FDateTime               Timestamp;
+	TArray<FFFmpegKeyframe> Entries;
+	Reader << Size << Timestamp << Entries;
+
+	// stale if the media was rewritten after the sidecar
+	auto& FileManager = IFileManager::Get();
+	if (Reader.IsError() || Size != FileManager.FileSize(*InMediaPath) ||
+	    Timestamp != FileManager.GetTimeStamp(*InMediaPath)) {
+		return false;
+	}
+
+	MediaPath      = InMediaPath;
+	MediaSize      = Size;
+	MediaTimestamp = Timestamp;
+	Keyframes      = MoveTemp(Entries);
+	return true;
+}
+
+const FFFmpegKeyframe*
+    FFFmpegKeyframeIndex::FindKeyframeBefore(const double Seconds) const {
+	if (Keyframes.IsEmpty()) {
+		return nullptr;
+	}
+
+	// first keyframe after Seconds
+	const auto& Next = Algo::UpperBoundBy(Keyframes, Seconds,
+	                                      &FFFmpegKeyframe::Seconds);
+
+	// the first keyframe if Seconds is before all of them
+	return &Keyframes[FMath::Max(Next - 1, 0)];
+}
+
+TConstArrayView<FFFmpegKeyframe> FFFmpegKeyframeIndex::GetKeyframes() const {
+	return Keyframes;
+}
@@ -0,0 +1,294 @@
+
+#include "FFmpegLoopbackCommandlet.h"
+
+#include "FFmpegEncoder.h"
+#include "FFmpegUtils.h"
+#include "LogFFmpegEncoder.h"
+#include "Tasks/Task.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/pixdesc.h>
+}
+
+#pragma region helpers
+namespace FFmpegLoopbackCommandletImpl {
+// bars of a frame, each carrying a bit of its index
+constexpr int32 NumBars = 12;
+
+// time without received bytes after which receiving ends, in microseconds
+constexpr const char* ReceiveTimeout = "2000000";
+
+/**
+ * A frame decoded by the receiver
+ */
+struct FReceivedFrame {
+	int32  Index   = INDEX_NONE;
+	double Seconds = 0.0;
+};
+
+/**
+ * @return   image of Width x Height with the bits of Index as black and
+ *           white bars, from the least significant on the left.
+ */
+FImage MakeFrameImage(const int32 Width, const int32 Height,
+                      const int32 Index) {
+	FImage Image(Width, Height, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	const auto& Colors = Image.AsBGRA8();
+	for (int32 X = 0; X < Width; ++X) {
+		Colors[X] = (Index >> (X * NumBars / Width)) & 1 ? FColor::White
+		                                                   : FColor::Black;
+	}
+	for (int32 Y = 1; Y < Height; ++Y) {
+		FMemory::Memcpy(&Colors[Y * Width], &Colors[0], Width * sizeof(FColor));
+	}
+	return Image;
+}
+
+/**
+ * Read the index of Frame from the luma at the centers of its bars.
+ * @return   INDEX_NONE if a bar is neither black nor white, or the luma
+ *           isn't in 8 bits.
+ */
+int32 ReadFrameIndex(const AVFrame& Frame) {
+	const auto& Descriptor =
+	    av_pix_fmt_desc_get(static_cast<AVPixelFormat>(Frame.format));
+	if (nullptr == Descriptor || (Descriptor->flags & AV_PIX_FMT_FLAG_RGB) ||
+	    8 != Descriptor->comp[0].depth) {
+		return INDEX_NONE;
+	}
+
+	const uint8* Row   = Frame.data[0] + Frame.linesize[0] * (Frame.height / 2);
+	int32        Index = 0;
+	for (int32 Bar = 0; Bar < NumBars; ++Bar) {
+		const auto& Luma = Row[(2 * Bar + 1) * Frame.width / (2 * NumBars)];
+		if (Luma > 64 && Luma < 192) {
+			return INDEX_NONE;
+		}
+		Index |= (Luma >= 192 ? 1 : 0) << Bar;
+	}
+	return Index;
+}
+
+/**
+ * Receive MPEG-TS from IOContext and decode its video on a single thread,
+ * without the delay of frame threads, until LastIndex is decoded or no
+ * byte arrives within the timeout of IOContext.
+ * @return   decoded frames in decoding order.
+ */
+TArray<FReceivedFrame> Receive(AVIOContext& IOContext, const int32 LastIndex) {
+	TArray<FReceivedFrame> Frames;
+	AVFormatContext*       Input   = avformat_alloc_context();
+	AVCodecContext*        Decoder = nullptr;
+	AVPacket*              Packet  = av_packet_alloc();
+	AVFrame*               Decoded = av_frame_alloc();
+
+	// helper function to free resources, except IOContext of the caller
+	const auto& Finish = [&]() {
+		av_frame_free(&Decoded);
+		av_packet_free(&Packet);
+		avcodec_free_context(&Decoder);
+		avformat_close_input(&Input);
+		return MoveTemp(Frames);
+	};
+
+	// helper function to time the frames decoded so far
+	const auto& ReceiveFrames = [&]() {
+		while (avcodec_receive_frame(Decoder, Decoded) == 0) {
+			Frames.Add({ReadFrameIndex(*Decoded), FPlatformTime::Seconds()});
+			av_frame_unref(Decoded);
+		}
+	};
+
+	if (nullptr == Input || nullptr == Packet || nullptr == Decoded) {
+		return Finish();
+	}
+	Input->pb = &IOContext;
+	if (avformat_open_input(&Input, nullptr, av_find_input_format("mpegts"),
+	                        nullptr) < 0 ||
+	    avformat_find_stream_info(Input, nullptr) < 0) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to receive the stream."));
+		return Finish();
+	}
+	const auto& StreamIndex =
+	    av_find_best_stream(Input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (StreamIndex < 0 ||
+	    nullptr == (Decoder = UFFmpegUtils::OpenVideoDecoder(
+	                    *Input->streams[StreamIndex], 1))) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to decode the stream."));
+		return Finish();
+	}
+
+	while (av_read_frame(Input, Packet) >= 0) {
+		if (Packet->stream_index == StreamIndex) {
+			avcodec_send_packet(Decoder, Packet);
+		}
+		av_packet_unref(Packet);
+		ReceiveFrames();
+
+		// stop at the last frame instead of waiting for the timeout
+		if (!Frames.IsEmpty() && LastIndex == Frames.Last().Index) {
+			return Finish();
+		}
+	}
+
+	// drain the decoder once the sender went quiet
+	avcodec_send_packet(Decoder, nullptr);
+	ReceiveFrames();
+	return Finish();
+}
+} // namespace FFmpegLoopbackCommandletImpl
+#pragma endregion
+
+UFFmpegLoopbackCommandlet::UFFmpegLoopbackCommandlet() {
+	IsClient        = false;
+	IsEditor        = false;
+	IsServer        = false;
+	LogToConsole    = true;
+	ShowErrorCount  = true;
+	HelpDescription = TEXT("Stream frames to a local port, decode them, and "
+	                       "verify them and their glass-to-glass latency.");
+}
+
+int32 UFFmpegLoopbackCommandlet::Main(const FString& Params) {
+	using namespace FFmpegLoopbackCommandletImpl;
+
+	int32 Port = 5000;
+	FParse::Value(*Params, TEXT("Port="), Port);
+	int32 NumFrames = 300;
+	FParse::Value(*Params, TEXT("Frames="), NumFrames);
+	float FrameRate = 30.0f;
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	int32 Width = 640;
+	FParse::Value(*Params, TEXT("Width="), Width);
+	int32 Height = 360;
+	FParse::Value(*Params, TEXT("Height="), Height);
+	float MinReceived = 0.9f;
+	FParse::Value(*Params, TEXT("MinReceived="), MinReceived);
+
+	// indices must fit in the bars, which must be wide enough to be read
+	NumFrames = FMath::Clamp(NumFrames, 1, 1 << NumBars);
+	Width     = FMath::Max(Width, 16 * NumBars);
+	Height    = FMath::Max(Height, 16);
+	FrameRate = FMath::Max(FrameRate, 1.0f);
+	const auto& Url = FString::Printf(TEXT("udp://127.0.0.1:%d"), Port);
+
+	// bind the receiver before sending, so that no keyframe is missed
+	AVDictionary* Options = nullptr;
+	av_dict_set(&Options, "timeout", ReceiveTimeout, 0);
+	av_dict_set(&Options, "buffer_size", "4194304", 0);
+	av_dict_set(&Options, "overrun_nonfatal", "1", 0);
+	AVIOContext* IOContext = nullptr;
+	const auto   UrlInUTF8 = StringCast<UTF8CHAR>(*Url);
+	const auto&  OpenResult =
+	    avio_open2(&IOContext, reinterpret_cast<const char*>(UrlInUTF8.Get()),
+	               AVIO_FLAG_READ, nullptr, &Options);
+	av_dict_free(&Options);
+	if (OpenResult < 0) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to listen on %s."), *Url);
+		return 1;
+	}
+
+	// receive while sending, which blocks a worker until the stream ends
+	auto ReceiveTask = UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [IOContext, LastIndex = NumFrames - 1]() {
+		    return Receive(*IOContext, LastIndex);
+	    },
+	    UE::Tasks::ETaskPriority::BackgroundHigh);
+
+	// stream with the lowest latency the encoder has
+	FFFmpegEncoderConfig Config;
+	Config.Width       = Width;
+	Config.Height      = Height;
+	Config.FrameRate   = FrameRate;
+	Config.bLowLatency = true;
+
+	const auto FFmpegEncoder = NewObject<UFFmpegEncoder>();
+	check(nullptr != FFmpegEncoder);
+
+	FFmpegEncoderOpenResult EncoderOpenResult;
+	FString                 ErrorMessage;
+	FFmpegEncoder->OpenStream(Config, Url, FFFmpegStreamConfig(),
+	                          EncoderOpenResult, ErrorMessage);
+	if (FFmpegEncoderOpenResult::Success != EncoderOpenResult) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to stream to %s: %s"),
+		       *Url, *ErrorMessage);
+		ReceiveTask.Wait();
+		avio_closep(&IOContext);
+		return 1;
+	}
+
+	// add frames at the frame rate, as a game renders them
+	TArray<double> AddedSeconds;
+	AddedSeconds.Init(0.0, NumFrames);
+	const auto& StartSeconds = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumFrames; ++Index) {
+		const auto& WaitSeconds =
+		    StartSeconds + Index / FrameRate - FPlatformTime::Seconds();
+		if (WaitSeconds > 0.0) {
+			FPlatformProcess::SleepNoStats(static_cast<float>(WaitSeconds));
+		}
+
+		auto Image          = MakeFrameImage(Width, Height, Index);
+		AddedSeconds[Index] = FPlatformTime::Seconds();
+
+		FFmpegEncoderAddFrameResult AddFrameResult;
+		FFmpegEncoder->AddFrame(
+		    UE::Tasks::MakeCompletedTask<FImage>(MoveTemp(Image)),
+		    AddFrameResult, ErrorMessage);
+		if (FFmpegEncoderAddFrameResult::Failure == AddFrameResult) {
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to add frame %d: %s"),
+			       Index, *ErrorMessage);
+			break;
+		}
+	}
+	FFmpegEncoder->Close();
+	const auto& StreamStats = FFmpegEncoder->GetStreamStats();
+
+	// the receiver ends at the last frame or once the sender is quiet
+	const auto& Received = ReceiveTask.GetResult();
+	avio_closep(&IOContext);
+
+	// frames must be intact and in order, and are timed from being added
+	int32  IntactFrames     = 0;
+	int32  CorruptedFrames  = 0;
+	int32  OutOfOrderFrames = 0;
+	int32  LastIndex        = INDEX_NONE;
+	double LatencySeconds   = 0.0;
+	double MaxLatency       = 0.0;
+	for (const auto& Frame : Received) {
+		if (INDEX_NONE == Frame.Index || Frame.Index >= NumFrames) {
+			++CorruptedFrames;
+			continue;
+		}
+		if (Frame.Index <= LastIndex) {
+			++OutOfOrderFrames;
+			continue;
+		}
+		LastIndex = Frame.Index;
+		++IntactFrames;
+
+		const auto& Latency = Frame.Seconds - AddedSeconds[Frame.Index];
+		LatencySeconds += Latency;
+		MaxLatency      = FMath::Max(MaxLatency, Latency);
+	}
+
+	UE_LOG(LogFFmpegEncoder, Display,
+	       TEXT("Decoded %d of %d frames from %s: %d corrupted, %d out of "
+	            "order, glass-to-glass latency %.1f ms on average, %.1f ms at "
+	            "most, %lld bytes sent, %lld bytes dropped"),
+	       IntactFrames, NumFrames, *Url, CorruptedFrames, OutOfOrderFrames,
+	       IntactFrames > 0 ? LatencySeconds * 1000.0 / IntactFrames : 0.0,
+	       MaxLatency * 1000.0, StreamStats.SentBytes,
+	       StreamStats.DroppedBytes);
+
+	if (CorruptedFrames > 0 || OutOfOrderFrames > 0 ||
+	    IntactFrames < MinReceived * NumFrames) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Loopback of %s failed."), *Url);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+
+#include "FFmpegMemory.h"
+
+#include "LogFFmpegEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+}
+
+LLM_DEFINE_TAG(BlueprintFFmpeg);
+LLM_DEFINE_TAG(BlueprintFFmpeg_Frames, NAME_None, TEXT("BlueprintFFmpeg"));
+LLM_DEFINE_TAG(BlueprintFFmpeg_Codec, NAME_None, TEXT("BlueprintFFmpeg"));
+LLM_DEFINE_TAG(BlueprintFFmpeg_Mux, NAME_None, TEXT("BlueprintFFmpeg"));
+LLM_DEFINE_TAG(BlueprintFFmpeg_Scaler, NAME_None, TEXT("BlueprintFFmpeg"));
+
+#pragma region helpers
+namespace FFmpegMemoryImpl {
+// alignment of frame planes and lines, for SIMD of swscale and encoders
+constexpr int32 BufferAlignment = 64;
+
+// usage of the innermost FFFmpegMemoryScope of the thread
+thread_local const FFFmpegMemoryUsagePtr* ScopeUsage = nullptr;
+
+/**
+ * Placed before the data of each frame buffer, to count its release for
+ * the usage it was allocated for
+ */
+struct FBufferHeader {
+	int64                 Size;
+	FFFmpegMemoryUsagePtr Usage;
+};
+
+constexpr SIZE_T HeaderSize = Align(sizeof(FBufferHeader), BufferAlignment);
+
+/**
+ * Free callback of buffers allocated by AllocateBuffer
+ */
+void FreeBuffer(void* Opaque, uint8* Data) {
+	const auto& Header = static_cast<FBufferHeader*>(Opaque);
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Frames, -Header->Size,
+	                     Header->Usage);
+	Header->~FBufferHeader();
+	FMemory::Free(Header);
+}
+
+/**
+ * @return   buffer of Size bytes from the engine allocator, counted as
+ *           frames for Usage. nullptr on failure.
+ */
+AVBufferRef* AllocateBuffer(const int32                  Size,
+                            const FFFmpegMemoryUsagePtr& Usage) {
+	LLM_SCOPE_BYTAG(BlueprintFFmpeg_Frames);
+
+	const auto& Base = static_cast<uint8*>(
+	    FMemory::Malloc(HeaderSize + Size, BufferAlignment));
+	const auto& Header = new (Base) FBufferHeader{Size, Usage};
+
+	const auto& Buffer =
+	    av_buffer_create(Base + HeaderSize, Size, &FreeBuffer, Header, 0);
+	if (nullptr == Buffer) {
+		Header->~FBufferHeader();
+		FMemory::Free(Base);
+		return nullptr;
+	}
+
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Frames, Size, Usage);
+	return Buffer;
+}
+} // namespace FFmpegMemoryImpl
+#pragma endregion
+
+void FFFmpegMemoryUsage::Add(const FFmpegMemoryCategory Category,
+                             const int64                Delta) {
+	const auto& Index = static_cast<int32>(Category);
+	const auto& Now =
+	    Bytes[Index].fetch_add(Delta, std::memory_order_relaxed) + Delta;
+
+	// raise the peak unless another thread raised it higher
+	auto Peak = PeakBytes[Index].load(std::memory_order_relaxed);
+	while (Now > Peak && !PeakBytes[Index].compare_exchange_weak(
+	                         Peak, Now, std::memory_order_relaxed)) {
+	}
+}
+
+FFFmpegMemoryStats FFFmpegMemoryUsage::GetStats() const {
+	const auto& Load = [&](const std::atomic<int64>* Counters,
+	                       const FFmpegMemoryCategory Category) {
+		return Counters[static_cast<int32>(Category)].load(
+		    std::memory_order_relaxed);
+	};
+
+	using enum FFmpegMemoryCategory;
+	FFFmpegMemoryStats Stats;
+	Stats.FrameBytes      = Load(Bytes, Frames);
+	Stats.CodecBytes      = Load(Bytes, Codec);
+	Stats.MuxBytes        = Load(Bytes, Mux);
+	Stats.ScalerBytes     = Load(Bytes, Scaler);
+	Stats.PeakFrameBytes  = Load(PeakBytes, Frames);
+	Stats.PeakCodecBytes  = Load(PeakBytes, Codec);
+	Stats.PeakMuxBytes    = Load(PeakBytes, Mux);
+	Stats.PeakScalerBytes = Load(PeakBytes, Scaler);
+	return Stats;
+}
+
+FFFmpegMemoryUsage& FFFmpegMemory::GetProcessUsage() {
+	static FFFmpegMemoryUsage Usage;
+	return Usage;
+}
+
+const FFFmpegMemoryUsagePtr& FFFmpegMemory::GetScopeUsage() {
+	using namespace FFmpegMemoryImpl;
+
+	static const FFFmpegMemoryUsagePtr None;
+	return ScopeUsage ? *ScopeUsage : None;
+}
+
+void FFFmpegMemory::Track(const FFmpegMemoryCategory   Category,
+                          const int64                  Bytes,
+                          const FFFmpegMemoryUsagePtr& Usage) {
+	GetProcessUsage().Add(Category, Bytes);
+	if (Usage) {
+		Usage->Add(Category, Bytes);
+	}
+}
+
+bool FFFmpegMemory::GetFrameBuffer(AVFrame& Frame) {
+	using namespace FFmpegMemoryImpl;
+
+	// all planes in one buffer, with lines aligned as av_frame_get_buffer
+	// does, and padding for SIMD reading past the end
+	const auto& Format = static_cast<AVPixelFormat>(Frame.format);
+	const auto& Size   = av_image_get_buffer_size(
+	    Format, Frame.width, Frame.height, BufferAlignment);
+	if (Size < 0) {
+		return false;
+	}
+
+	auto Buffer =
+	    AllocateBuffer(Size + AV_INPUT_BUFFER_PADDING_SIZE, GetScopeUsage());
+	if (nullptr == Buffer) {
+		return false;
+	}
+
+	if (av_image_fill_arrays(Frame.data, Frame.linesize, Buffer->data, Format,
+	                         Frame.width, Frame.height, BufferAlignment) < 0) {
+		av_buffer_unref(&Buffer);
+		return false;
+	}
+	Frame.buf[0]        = Buffer;
+	Frame.extended_data = Frame.data;
+	return true;
+}
+
+void FFFmpegMemory::LogReport() {
+	const auto& Stats = GetProcessUsage().GetStats();
+
+	const auto& ToMegabytes = [](const int64 Bytes) {
+		return Bytes / (1024.0 * 1024.0);
+	};
+	UE_LOG(LogFFmpegEncoder, Log,
+	       TEXT("FFmpeg memory (MB, current / peak): frames %.1f / %.1f, "
+	            "codec %.1f / %.1f, mux %.1f / %.1f, scaler %.1f / %.1f"),
+	       ToMegabytes(Stats.FrameBytes), ToMegabytes(Stats.PeakFrameBytes),
+	       ToMegabytes(Stats.CodecBytes), ToMegabytes(Stats.PeakCodecBytes),
+	       ToMegabytes(Stats.MuxBytes), ToMegabytes(Stats.PeakMuxBytes),
+	       ToMegabytes(Stats.ScalerBytes), ToMegabytes(Stats.PeakScalerBytes));
+}
+
+FFFmpegMemoryScope::FFFmpegMemoryScope(const FFFmpegMemoryUsagePtr& Usage)
+    : PreviousUsage(FFmpegMemoryImpl::ScopeUsage) {
+	FFmpegMemoryImpl::ScopeUsage = &Usage;
+}
+
+FFFmpegMemoryScope::~FFFmpegMemoryScope() {
+	FFmpegMemoryImpl::ScopeUsage = PreviousUsage;
+}
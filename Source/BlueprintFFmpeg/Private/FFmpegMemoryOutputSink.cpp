@@ -0,0 +1,238 @@
+
+#include "FFmpegMemoryOutputSink.h"
+
+#include "FFmpegMemory.h"
+
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+}
+
+namespace FFmpegMemoryOutputSinkImpl {
+/**
+ * Pool of buffers released by FFFmpegMemoryOutputSink
+ */
+struct FBufferPool {
+	std::mutex              Mutex;
+	TArray<TArray64<uint8>> Buffers;
+
+	static FBufferPool& Get() {
+		static FBufferPool Pool;
+		return Pool;
+	}
+};
+
+// buffers kept in the pool at most
+constexpr int32 MaxPooledBuffers = 4;
+} // namespace FFmpegMemoryOutputSinkImpl
+
+FFFmpegCustomIOOutputSink::FFFmpegCustomIOOutputSink(const FString& FormatName)
+    : FFFmpegMuxerOutputSink(FormatName, FString()) {}
+
+FFFmpegCustomIOOutputSink::~FFFmpegCustomIOOutputSink() {
+	// release resources if Close wasn't reached
+	FreeFormatContext();
+}
+
+int64 FFFmpegCustomIOOutputSink::Seek(int64, int) { return -1; }
+
+int64 FFFmpegCustomIOOutputSink::Size() const { return -1; }
+
+bool FFFmpegCustomIOOutputSink::IsSeekable() const { return false; }
+
+AVIOContext* FFFmpegCustomIOOutputSink::OpenIOContext() {
+	// allocate buffer the muxer writes into, owned by the IO context
+	const auto& Buffer = static_cast<uint8*>(av_malloc(IOBufferSize));
+	if (nullptr == Buffer) {
+		return nullptr;
+	}
+
+	// the type of write callback became const in libavformat 61
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+	const auto& WriteFunction = &WriteCallback;
+#else
+	const auto& WriteFunction = [](void* Opaque, uint8_t* Data, int DataSize) {
+		return WriteCallback(Opaque, Data, DataSize);
+	};
+#endif
+
+	// open IO context which calls back this sink
+	const auto& IOContext = avio_alloc_context(
+	    Buffer, IOBufferSize, 1, this, nullptr, WriteFunction,
+	    IsSeekable() ? &SeekCallback : nullptr);
+	if (nullptr == IOContext) {
+		av_free(Buffer);
+		return nullptr;
+	}
+
+	return IOContext;
+}
+
+void FFFmpegCustomIOOutputSink::CloseIOContext(AVIOContext*& IOContext) {
+	// av_write_trailer has flushed IOContext, nothing is written while
+	// aborting
+	av_freep(&IOContext->buffer);
+	avio_context_free(&IOContext);
+}
+
+int FFFmpegCustomIOOutputSink::WriteCallback(void* Opaque, const uint8* Buffer,
+                                             int BufferSize) {
+	const auto& Sink = static_cast<FFFmpegCustomIOOutputSink*>(Opaque);
+	return Sink->Write(TArrayView<const uint8>(Buffer, BufferSize))
+	           ? BufferSize
+	           : AVERROR(EIO);
+}
+
+int64_t FFFmpegCustomIOOutputSink::SeekCallback(void* Opaque, int64_t Offset,
+                                                int Whence) {
+	const auto& Sink = static_cast<FFFmpegCustomIOOutputSink*>(Opaque);
+
+	// muxer asks the size without moving
+	if (Whence & AVSEEK_SIZE) {
+		return Sink->Size();
+	}
+
+	return Sink->Seek(Offset, Whence & ~AVSEEK_FORCE);
+}
+
+FFFmpegMemoryOutputSink::FFFmpegMemoryOutputSink(const FString&  FormatName,
+                                                 FClosedCallback OnClosed)
+    : FFFmpegCustomIOOutputSink(FormatName), OnClosed(MoveTemp(OnClosed)) {}
+
+FFFmpegMemoryOutputSink::~FFFmpegMemoryOutputSink() {
+	// release resources before Write becomes unavailable
+	FreeFormatContext();
+
+	// give unclaimed output back to the pool
+	if (Buffer.Max() > 0) {
+		ReleaseBuffer(MoveTemp(Buffer));
+	}
+}
+
+TArray64<uint8> FFFmpegMemoryOutputSink::MoveData() {
+	Position = 0;
+	return MoveTemp(Buffer);
+}
+
+void FFFmpegMemoryOutputSink::ReleaseBuffer(TArray64<uint8>&& Buffer) {
+	using namespace FFmpegMemoryOutputSinkImpl;
+
+	auto& Pool = FBufferPool::Get();
+
+	std::lock_guard Lock(Pool.Mutex);
+	if (Pool.Buffers.Num() < MaxPooledBuffers) {
+		Buffer.Reset();
+		Pool.Buffers.Add(MoveTemp(Buffer));
+	}
+}
+
+TArray64<uint8> FFFmpegMemoryOutputSink::AcquireBuffer() {
+	using namespace FFmpegMemoryOutputSinkImpl;
+
+	auto& Pool = FBufferPool::Get();
+
+	std::lock_guard Lock(Pool.Mutex);
+	return Pool.Buffers.IsEmpty() ? TArray64<uint8>() : Pool.Buffers.Pop();
+}
+
+bool FFFmpegMemoryOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> CodecContexts) {
+	// reuse an allocation of earlier output
+	if (0 == Buffer.Max()) {
+		Buffer = AcquireBuffer();
+	}
+	Buffer.Reset();
+	Position = 0;
+
+	return FFFmpegCustomIOOutputSink::Open(CodecContexts);
+}
+
+bool FFFmpegMemoryOutputSink::Close() {
+	if (!FFFmpegCustomIOOutputSink::Close()) {
+		return false;
+	}
+
+	// hand output to the owner
+	if (OnClosed) {
+		OnClosed(MoveData());
+	}
+
+	return true;
+}
+
+bool FFFmpegMemoryOutputSink::Write(TArrayView<const uint8> Data) {
+	// overwrite bytes behind the end after seeking back, append the rest
+	LLM_SCOPE_BYTAG(BlueprintFFmpeg_Mux);
+	const auto& NumOverwritten =
+	    FMath::Min<int64>(Data.Num(), Buffer.Num() - Position);
+	FMemory::Memcpy(Buffer.GetData() + Position, Data.GetData(), NumOverwritten);
+	Buffer.Append(Data.GetData() + NumOverwritten, Data.Num() - NumOverwritten);
+
+	Position += Data.Num();
+	return true;
+}
+
+int64 FFFmpegMemoryOutputSink::Seek(int64 Offset, int Whence) {
+	// compute new position
+	int64 NewPosition;
+	switch (Whence) {
+	case SEEK_SET:
+		NewPosition = Offset;
+		break;
+	case SEEK_CUR:
+		NewPosition = Position + Offset;
+		break;
+	case SEEK_END:
+		NewPosition = Buffer.Num() + Offset;
+		break;
+	default:
+		return -1;
+	}
+
+	// position must be inside written output
+	if (NewPosition < 0 || NewPosition > Buffer.Num()) {
+		return -1;
+	}
+
+	Position = NewPosition;
+	return Position;
+}
+
+int64 FFFmpegMemoryOutputSink::Size() const { return Buffer.Num(); }
+
+bool FFFmpegMemoryOutputSink::IsSeekable() const { return true; }
+
+FFFmpegCallbackOutputSink::FFFmpegCallbackOutputSink(const FString& FormatName,
+                                                     FChunkCallback OnChunk)
+    : FFFmpegCustomIOOutputSink(FormatName), OnChunk(MoveTemp(OnChunk)) {}
+
+FFFmpegCallbackOutputSink::~FFFmpegCallbackOutputSink() {
+	// release resources before Write becomes unavailable
+	FreeFormatContext();
+}
+
+bool FFFmpegCallbackOutputSink::Write(TArrayView<const uint8> Data) {
+	return OnChunk(Data);
+}
+
+FFFmpegPacketCallbackOutputSink::FFFmpegPacketCallbackOutputSink(
+    FPacketCallback OnPacket)
+    : OnPacket(MoveTemp(OnPacket)) {}
+
+bool FFFmpegPacketCallbackOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> InCodecContexts) {
+	CodecContexts = InCodecContexts;
+	return true;
+}
+
+bool FFFmpegPacketCallbackOutputSink::WritePacket(const AVPacket& Packet) {
+	return OnPacket(Packet, *CodecContexts[Packet.stream_index]);
+}
+
+bool FFFmpegPacketCallbackOutputSink::Close() {
+	CodecContexts.Reset();
+	return true;
+}
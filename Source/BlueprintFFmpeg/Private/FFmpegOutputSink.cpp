@@ -0,0 +1,172 @@
+
+#include "FFmpegOutputSink.h"
+
+#include "LogFFmpegEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+}
+
+FFFmpegMuxerOutputSink::FFFmpegMuxerOutputSink(const FString& FormatName,
+                                               const FString& FileName)
+    : FormatName(FormatName), FileName(FileName) {}
+
+FFFmpegMuxerOutputSink::~FFFmpegMuxerOutputSink() {
+	// subclass must have released the muxer
+	ensure(nullptr == FormatContext);
+	av_packet_free(&MuxPacket);
+}
+
+bool FFFmpegMuxerOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> CodecContexts) {
+	// helper function to finish with failure
+	const auto& Failure = [&](const TCHAR* Message) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), Message);
+		FreeFormatContext();
+		return false;
+	};
+
+	// forget streams of a previous output
+	CodecTimeBases.Reset();
+
+	// empty names let FFmpeg guess the container
+	const auto FormatNameInUTF8 = StringCast<UTF8CHAR>(*FormatName);
+	const auto FileNameInUTF8   = StringCast<UTF8CHAR>(*FileName);
+
+	// allocate memory to FormatContext
+	if (avformat_alloc_output_context2(
+	        &FormatContext, nullptr,
+	        FormatName.IsEmpty()
+	            ? nullptr
+	            : reinterpret_cast<const char*>(FormatNameInUTF8.Get()),
+	        FileName.IsEmpty()
+	            ? nullptr
+	            : reinterpret_cast<const char*>(FileNameInUTF8.Get())) < 0) {
+		return Failure(TEXT("Failed to allocate format context."));
+	}
+
+	// add a stream for each codec
+	for (const auto& CodecContext : CodecContexts) {
+		const auto& Stream = avformat_new_stream(FormatContext, nullptr);
+		if (nullptr == Stream) {
+			return Failure(TEXT("Failed to add a new stream."));
+		}
+
+		// set Stream information
+		Stream->sample_aspect_ratio = CodecContext->sample_aspect_ratio;
+		Stream->time_base           = CodecContext->time_base;
+
+		// set parameter from codec context
+		if (avcodec_parameters_from_context(Stream->codecpar, CodecContext) <
+		    0) {
+			return Failure(TEXT("Failed to set codec parameters."));
+		}
+
+		// packets arrive in time base of codec
+		CodecTimeBases.Add(CodecContext->time_base);
+	}
+
+	// set FormatContext to output to the IO context of subclass
+	FormatContext->pb = OpenIOContext();
+	if (nullptr == FormatContext->pb) {
+		return Failure(TEXT("Failed to open IO context."));
+	}
+
+	// mp4 can't go back to write the index into unseekable output
+	AVDictionary* MuxerOptions = nullptr;
+	if (!(FormatContext->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+	    (FCStringAnsi::Strcmp(FormatContext->oformat->name, "mp4") == 0 ||
+	     FCStringAnsi::Strcmp(FormatContext->oformat->name, "mov") == 0)) {
+		av_dict_set(&MuxerOptions, "movflags",
+		            "frag_keyframe+empty_moov+default_base_moof", 0);
+	}
+	AddMuxerOptions(MuxerOptions);
+
+	// write header to output
+	const auto& HeaderResult =
+	    avformat_write_header(FormatContext, &MuxerOptions);
+	av_dict_free(&MuxerOptions);
+	if (HeaderResult < 0) {
+		return Failure(TEXT("Failed to write header."));
+	}
+
+	// allocate packet to pass references to the muxer
+	MuxPacket = av_packet_alloc();
+	if (nullptr == MuxPacket) {
+		return Failure(TEXT("Failed to allocate packet."));
+	}
+
+	return true;
+}
+
+bool FFFmpegMuxerOutputSink::WritePacket(const AVPacket& Packet) {
+	// share the buffer of Packet instead of copying it
+	if (av_packet_ref(MuxPacket, &Packet) < 0) {
+		return false;
+	}
+
+	// rescale
+	av_packet_rescale_ts(MuxPacket, CodecTimeBases[Packet.stream_index],
+	                     FormatContext->streams[Packet.stream_index]->time_base);
+
+	// write Packet to output media, which takes over the reference
+	return av_interleaved_write_frame(FormatContext, MuxPacket) == 0;
+}
+
+bool FFFmpegMuxerOutputSink::Close() {
+	// Open must have succeeded
+	if (nullptr == FormatContext) {
+		return false;
+	}
+
+	// write trailer to output
+	const auto& bSuccess = av_write_trailer(FormatContext) == 0;
+
+	// free resources
+	FreeFormatContext();
+
+	return bSuccess;
+}
+
+void FFFmpegMuxerOutputSink::FreeFormatContext() {
+	av_packet_free(&MuxPacket);
+
+	if (nullptr == FormatContext) {
+		return;
+	}
+
+	if (nullptr != FormatContext->pb) {
+		CloseIOContext(FormatContext->pb);
+	}
+
+	avformat_free_context(FormatContext);
+	FormatContext = nullptr;
+}
+
+FFFmpegFileOutputSink::FFFmpegFileOutputSink(const FString& OutputFilePath)
+    : FFFmpegMuxerOutputSink(FString(), OutputFilePath),
+      FilePath(OutputFilePath) {}
+
+FFFmpegFileOutputSink::~FFFmpegFileOutputSink() {
+	// release resources if Close wasn't reached
+	FreeFormatContext();
+}
+
+AVIOContext* FFFmpegFileOutputSink::OpenIOContext() {
+	// open output file
+	auto         OutputFilePathInUTF8 = StringCast<UTF8CHAR>(*FilePath);
+	AVIOContext* IOContext            = nullptr;
+	if (avio_open(&IOContext,
+	              reinterpret_cast<const char*>(OutputFilePathInUTF8.Get()),
+	              AVIO_FLAG_WRITE) < 0) {
+		return nullptr;
+	}
+
+	return IOContext;
+}
+
+void FFFmpegFileOutputSink::CloseIOContext(AVIOContext*& IOContext) {
+	avio_closep(&IOContext);
+}
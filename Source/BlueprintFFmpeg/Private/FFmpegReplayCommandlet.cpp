@@ -0,0 +1,89 @@
+
+#include "FFmpegReplayCommandlet.h"
+
+#include "FFmpegFrameTrace.h"
+#include "HAL/FileManager.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UFFmpegReplayCommandlet::UFFmpegReplayCommandlet() {
+	IsClient        = false;
+	IsEditor        = false;
+	IsServer        = false;
+	LogToConsole    = true;
+	ShowErrorCount  = true;
+	HelpDescription = TEXT("Replay a trace of images added to an FFmpeg "
+	                       "encoder, and report its stats.");
+}
+
+int32 UFFmpegReplayCommandlet::Main(const FString& Params) {
+	// trace
+	FString TracePath;
+	if (!FParse::Value(*Params, TEXT("Trace="), TracePath)) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("-Trace=<path> is required."));
+		return 1;
+	}
+	FFFmpegTrace Trace;
+	FString      ErrorMessage;
+	if (!Trace.Load(TracePath, ErrorMessage)) {
+		return 1;
+	}
+
+	FString OutputPath =
+	    FPaths::ProjectSavedDir() / TEXT("FFmpegReplay") /
+	    FPaths::GetBaseFilename(TracePath) + TEXT(".mkv");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	float TimeScale = 1.0f;
+	FParse::Value(*Params, TEXT("TimeScale="), TimeScale);
+	FString ReportPath;
+	FParse::Value(*Params, TEXT("Report="), ReportPath);
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(OutputPath), true);
+
+	// replay
+	const auto&         StartCycles = FPlatformTime::Cycles64();
+	FFFmpegEncoderStats Stats;
+	if (!Trace.Replay(OutputPath, FMath::Max(TimeScale, 0.0f), Stats,
+	                  ErrorMessage)) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to replay %s: %s"),
+		       *TracePath, *ErrorMessage);
+		return 1;
+	}
+	const auto& WallSeconds =
+	    FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+
+	UE_LOG(LogFFmpegEncoder, Display,
+	       TEXT("Replayed %d images of %s into %s in %.2f s: %lld frames, "
+	            "%.1f fps, conversion wait %.2f ms, wake latency %.3f ms, "
+	            "first packet %.1f ms, peak frames %lld bytes"),
+	       Trace.GetEvents().Num(), *TracePath, *OutputPath, WallSeconds,
+	       Stats.EncodedFrames, Stats.EncodeFramesPerSecond,
+	       Stats.ConversionWaitMilliseconds, Stats.WakeLatencyMilliseconds,
+	       Stats.FirstPacketMilliseconds, Stats.Memory.PeakFrameBytes);
+
+	// report, a row per replay
+	if (!ReportPath.IsEmpty()) {
+		FString Csv;
+		if (!IFileManager::Get().FileExists(*ReportPath)) {
+			Csv += TEXT("Trace,TimeScale,Images,WallSeconds,EncodedFrames,"
+			            "EncodeFramesPerSecond,ConversionWaitMilliseconds,"
+			            "WakeLatencyMilliseconds,FirstPacketMilliseconds,"
+			            "PeakFrameBytes,PeakScalerBytes\n");
+		}
+		Csv += FString::Printf(
+		    TEXT("%s,%g,%d,%.3f,%lld,%.2f,%.3f,%.3f,%.2f,%lld,%lld\n"),
+		    *FPaths::GetCleanFilename(TracePath), TimeScale,
+		    Trace.GetEvents().Num(), WallSeconds, Stats.EncodedFrames,
+		    Stats.EncodeFramesPerSecond, Stats.ConversionWaitMilliseconds,
+		    Stats.WakeLatencyMilliseconds, Stats.FirstPacketMilliseconds,
+		    Stats.Memory.PeakFrameBytes, Stats.Memory.PeakScalerBytes);
+		FFileHelper::SaveStringToFile(
+		    Csv, *ReportPath, FFileHelper::EEncodingOptions::AutoDetect,
+		    &IFileManager::Get(), FILEWRITE_Append);
+		UE_LOG(LogFFmpegEncoder, Display, TEXT("Report is appended to %s."),
+		       *ReportPath);
+	}
+
+	return 0;
+}
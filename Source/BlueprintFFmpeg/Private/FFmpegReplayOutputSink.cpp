@@ -0,0 +1,220 @@
+
+#include "FFmpegReplayOutputSink.h"
+
+#include "LogFFmpegEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+FFFmpegReplayOutputSink::FFFmpegReplayOutputSink(const double MaxSeconds,
+                                                 const int64  MaxBytes)
+    : MaxSeconds(MaxSeconds), MaxBytes(MaxBytes) {}
+
+UE::Tasks::TTask<bool>
+    FFFmpegReplayOutputSink::Save(const FString& OutputFilePath,
+                                  const double   Seconds) const {
+	TArray<FPacketSharedPtr>       Packets;
+	TArray<FCodecContextSharedPtr> SavedCodecContexts;
+	int64                          StartPts = 0;
+	{
+		std::lock_guard Lock(Mutex);
+
+		// nothing is buffered yet
+		if (Groups.IsEmpty()) {
+			UE_LOG(LogFFmpegEncoder, Warning,
+			       TEXT("No packets are buffered to save replay."));
+			return UE::Tasks::MakeCompletedTask<bool>(false);
+		}
+
+		// find the nearest keyframe at or before the start of the window
+		int32 FirstGroup = 0;
+		if (Seconds > 0.0) {
+			const auto& WindowStart = LatestPts - DurationOfFirstStream(Seconds);
+			for (int32 GroupIndex = Groups.Num() - 1; GroupIndex >= 0;
+			     --GroupIndex) {
+				if (Groups[GroupIndex].KeyframePts <= WindowStart) {
+					FirstGroup = GroupIndex;
+					break;
+				}
+			}
+		}
+
+		// share packets of the window, the live encoder keeps appending
+		for (int32 GroupIndex = FirstGroup; GroupIndex < Groups.Num();
+		     ++GroupIndex) {
+			Packets.Append(Groups[GroupIndex].Packets);
+		}
+		SavedCodecContexts = CodecContexts;
+		StartPts           = Groups[FirstGroup].KeyframePts;
+	}
+
+	// mux on a background thread
+	return UE::Tasks::Launch(
+	    UE_SOURCE_LOCATION,
+	    [OutputFilePath, Packets = MoveTemp(Packets),
+	     SavedCodecContexts = MoveTemp(SavedCodecContexts), StartPts]() {
+		    // open output file
+		    TArray<const AVCodecContext*> Contexts;
+		    for (const auto& CodecContext : SavedCodecContexts) {
+			    Contexts.Add(CodecContext.Get());
+		    }
+		    FFFmpegFileOutputSink Sink(OutputFilePath);
+		    if (!Sink.Open(Contexts)) {
+			    return false;
+		    }
+
+		    // allocate packet to rebase timestamps without touching the buffer
+		    AVPacket* Packet = av_packet_alloc();
+		    if (nullptr == Packet) {
+			    return false;
+		    }
+
+		    // write packets, starting at time 0
+		    auto bSuccess = true;
+		    for (const auto& BufferedPacket : Packets) {
+			    if (av_packet_ref(Packet, BufferedPacket.Get()) < 0) {
+				    bSuccess = false;
+				    break;
+			    }
+
+			    const auto& Offset = av_rescale_q(
+			        StartPts, Contexts[0]->time_base,
+			        Contexts[Packet->stream_index]->time_base);
+			    if (AV_NOPTS_VALUE != Packet->pts) {
+				    Packet->pts -= Offset;
+			    }
+			    if (AV_NOPTS_VALUE != Packet->dts) {
+				    Packet->dts -= Offset;
+			    }
+
+			    bSuccess = Sink.WritePacket(*Packet);
+			    av_packet_unref(Packet);
+			    if (!bSuccess) {
+				    break;
+			    }
+		    }
+
+		    // free Packet resource
+		    av_packet_free(&Packet);
+
+		    // write trailer to output file
+		    return bSuccess && Sink.Close();
+	    },
+	    LowLevelTasks::ETaskPriority::BackgroundNormal);
+}
+
+double FFFmpegReplayOutputSink::GetBufferedSeconds() const {
+	std::lock_guard Lock(Mutex);
+
+	if (Groups.IsEmpty()) {
+		return 0.0;
+	}
+
+	return (LatestPts - Groups.First().KeyframePts) *
+	       av_q2d(CodecContexts[0]->time_base);
+}
+
+int64 FFFmpegReplayOutputSink::GetBufferedBytes() const {
+	std::lock_guard Lock(Mutex);
+	return BufferedBytes;
+}
+
+bool FFFmpegReplayOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> InCodecContexts) {
+	// copy codec parameters, which outlive the encoder for later saves
+	TArray<FCodecContextSharedPtr> NewCodecContexts;
+	for (const auto& CodecContext : InCodecContexts) {
+		FCodecContextSharedPtr Copy(
+		    avcodec_alloc_context3(nullptr),
+		    [](AVCodecContext* Context) { avcodec_free_context(&Context); });
+		AVCodecParameters* Parameters = avcodec_parameters_alloc();
+		const auto&        bCopied =
+		    nullptr != Copy && nullptr != Parameters &&
+		    avcodec_parameters_from_context(Parameters, CodecContext) >= 0 &&
+		    avcodec_parameters_to_context(Copy.Get(), Parameters) >= 0;
+		avcodec_parameters_free(&Parameters);
+		if (!bCopied) {
+			UE_LOG(LogFFmpegEncoder, Error,
+			       TEXT("Failed to copy codec parameters for replay."));
+			return false;
+		}
+
+		Copy->time_base = CodecContext->time_base;
+		Copy->framerate = CodecContext->framerate;
+		NewCodecContexts.Add(MoveTemp(Copy));
+	}
+
+	std::lock_guard Lock(Mutex);
+
+	// forget packets of a previous encoding
+	CodecContexts = MoveTemp(NewCodecContexts);
+	Groups.Reset();
+	BufferedBytes = 0;
+	LatestPts     = 0;
+
+	return true;
+}
+
+bool FFFmpegReplayOutputSink::WritePacket(const AVPacket& Packet) {
+	// share the buffer of Packet instead of copying it
+	FPacketSharedPtr BufferedPacket(
+	    av_packet_clone(&Packet),
+	    [](AVPacket* Clone) { av_packet_free(&Clone); });
+	if (nullptr == BufferedPacket) {
+		return false;
+	}
+
+	std::lock_guard Lock(Mutex);
+
+	// a keyframe of the first stream starts a new group
+	const auto& bFirstStream = 0 == Packet.stream_index;
+	if (bFirstStream && (Packet.flags & AV_PKT_FLAG_KEY)) {
+		Groups.EmplaceLast().KeyframePts = Packet.pts;
+	}
+
+	// packets before the first keyframe can't be decoded
+	if (Groups.IsEmpty()) {
+		return true;
+	}
+
+	// append to the latest group
+	auto& Group = Groups.Last();
+	Group.Packets.Add(MoveTemp(BufferedPacket));
+	Group.Bytes += Packet.size;
+	BufferedBytes += Packet.size;
+	if (bFirstStream) {
+		LatestPts = FMath::Max(LatestPts, Packet.pts);
+	}
+
+	// keep memory bounded
+	DropOldGroups();
+
+	return true;
+}
+
+bool FFFmpegReplayOutputSink::Close() {
+	// keep buffered packets to save after encoding
+	return true;
+}
+
+void FFFmpegReplayOutputSink::DropOldGroups() {
+	const auto& MaxDuration = DurationOfFirstStream(MaxSeconds);
+
+	while (Groups.Num() > 1) {
+		// the next group alone covers MaxSeconds, or bytes exceed MaxBytes
+		const auto& bTooLong  = Groups[1].KeyframePts <= LatestPts - MaxDuration;
+		const auto& bTooLarge = BufferedBytes > MaxBytes;
+		if (!bTooLong && !bTooLarge) {
+			break;
+		}
+
+		BufferedBytes -= Groups.First().Bytes;
+		Groups.PopFirst();
+	}
+}
+
+int64 FFFmpegReplayOutputSink::DurationOfFirstStream(
+    const double Seconds) const {
+	return FMath::RoundToInt64(Seconds / av_q2d(CodecContexts[0]->time_base));
+}
@@ -0,0 +1,149 @@
+
+#include "FFmpegRotatingOutputSink.h"
+
+#include "LogFFmpegEncoder.h"
+#include "Misc/Paths.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+FFFmpegRotatingOutputSink::FFFmpegRotatingOutputSink(
+    const FString& OutputFilePath, const double MaxSeconds,
+    const int64 MaxBytes, FRotatedCallback OnRotated)
+    : OutputFilePath(OutputFilePath), MaxSeconds(MaxSeconds),
+      MaxBytes(MaxBytes), OnRotated(MoveTemp(OnRotated)) {}
+
+FFFmpegRotatingOutputSink::~FFFmpegRotatingOutputSink() {
+	av_packet_free(&RebasedPacket);
+}
+
+void FFFmpegRotatingOutputSink::Rotate() {
+	bRotationRequested = true;
+	bKeyframeRequested = true;
+}
+
+FString FFFmpegRotatingOutputSink::FilePathOf(const int32 Index) const {
+	// the first file is OutputFilePath itself
+	if (0 == Index) {
+		return OutputFilePath;
+	}
+
+	return FString::Printf(TEXT("%s_%03d.%s"),
+	                       *FPaths::GetBaseFilename(OutputFilePath, false),
+	                       Index, *FPaths::GetExtension(OutputFilePath));
+}
+
+bool FFFmpegRotatingOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> InCodecContexts) {
+	// codec contexts live until Close
+	CodecContexts = InCodecContexts;
+
+	// allocate packet to rebase timestamps of each file
+	if (nullptr == RebasedPacket) {
+		RebasedPacket = av_packet_alloc();
+		if (nullptr == RebasedPacket) {
+			return false;
+		}
+	}
+
+	// open the first file
+	FileIndex     = 0;
+	FileBytes     = 0;
+	bFileHasVideo = false;
+	File          = MakeUnique<FFFmpegFileOutputSink>(FilePathOf(FileIndex));
+	return File->Open(CodecContexts);
+}
+
+bool FFFmpegRotatingOutputSink::WritePacket(const AVPacket& Packet) {
+	const auto& bVideo = 0 == Packet.stream_index;
+
+	if (bVideo) {
+		// split at a keyframe after the current file got video
+		if (bFileHasVideo && bRotationRequested &&
+		    (Packet.flags & AV_PKT_FLAG_KEY)) {
+			if (!StartNextFile()) {
+				return false;
+			}
+		}
+
+		// the file starts at its first keyframe
+		if (!bFileHasVideo) {
+			bFileHasVideo = true;
+			FileStartPts  = Packet.pts;
+		}
+
+		// request the next keyframe when the file reaches a limit
+		const auto& FileSeconds = (Packet.pts - FileStartPts) *
+		                          av_q2d(CodecContexts[0]->time_base);
+		const auto& bTooLong  = MaxSeconds > 0.0 && FileSeconds >= MaxSeconds;
+		const auto& bTooLarge = MaxBytes > 0 && FileBytes >= MaxBytes;
+		if ((bTooLong || bTooLarge) && !bRotationRequested) {
+			Rotate();
+		}
+	}
+
+	// share the buffer of Packet to shift its timestamps
+	if (av_packet_ref(RebasedPacket, &Packet) < 0) {
+		return false;
+	}
+
+	// the file starts at time 0
+	const auto& Offset =
+	    av_rescale_q(FileStartPts, CodecContexts[0]->time_base,
+	                 CodecContexts[Packet.stream_index]->time_base);
+	if (AV_NOPTS_VALUE != RebasedPacket->pts) {
+		RebasedPacket->pts -= Offset;
+	}
+	if (AV_NOPTS_VALUE != RebasedPacket->dts) {
+		RebasedPacket->dts -= Offset;
+	}
+
+	// write Packet to the current file
+	FileBytes += Packet.size;
+	const auto& bWritten = File->WritePacket(*RebasedPacket);
+	av_packet_unref(RebasedPacket);
+	return bWritten;
+}
+
+bool FFFmpegRotatingOutputSink::Close() {
+	// finalize the last file
+	const auto& bSuccess = File && File->Close();
+	if (bSuccess && OnRotated) {
+		OnRotated(FilePathOf(FileIndex));
+	}
+
+	File.Reset();
+	CodecContexts.Reset();
+	return bSuccess;
+}
+
+bool FFFmpegRotatingOutputSink::TakeKeyframeRequest() {
+	return bKeyframeRequested.exchange(false);
+}
+
+bool FFFmpegRotatingOutputSink::StartNextFile() {
+	// finalize the current file while the encoder keeps running
+	if (!File->Close()) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to finalize %s."),
+		       *FilePathOf(FileIndex));
+		return false;
+	}
+	if (OnRotated) {
+		OnRotated(FilePathOf(FileIndex));
+	}
+
+	// open the next file
+	++FileIndex;
+	FileBytes          = 0;
+	bFileHasVideo      = false;
+	bRotationRequested = false;
+	File = MakeUnique<FFFmpegFileOutputSink>(FilePathOf(FileIndex));
+	if (!File->Open(CodecContexts)) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to open %s."),
+		       *FilePathOf(FileIndex));
+		return false;
+	}
+
+	return true;
+}
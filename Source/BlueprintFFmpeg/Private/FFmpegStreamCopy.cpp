@@ -0,0 +1,258 @@
+
+#include "FFmpegStreamCopy.h"
+
+#include "HAL/FileManager.h"
+#include "LogFFmpegEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#pragma region helpers
+namespace FFmpegStreamCopyImpl {
+/**
+ * @return   whether packets of In can be written to a stream of Out.
+ */
+bool AreCompatible(const AVCodecParameters& In, const AVCodecParameters& Out) {
+	// decoders are set up once from the parameters of the first input
+	return In.codec_type == Out.codec_type && In.codec_id == Out.codec_id &&
+	       In.format == Out.format && In.width == Out.width &&
+	       In.height == Out.height && In.sample_rate == Out.sample_rate &&
+	       In.extradata_size == Out.extradata_size &&
+	       0 == FMemory::Memcmp(In.extradata, Out.extradata,
+	                            In.extradata_size);
+}
+} // namespace FFmpegStreamCopyImpl
+#pragma endregion
+
+bool CopyMediaByStreamCopy(TArrayView<FFFmpegStreamCopyRange> Ranges,
+                           const FString&                     OutputPath,
+                           FString&                           ErrorMessage) {
+	using namespace FFmpegStreamCopyImpl;
+
+	AVFormatContext* Output         = nullptr;
+	AVFormatContext* Input          = nullptr;
+	AVPacket*        Packet         = av_packet_alloc();
+	bool             bHeaderWritten = false;
+
+	// helper function to free resources
+	const auto& Finish = [&](const bool bSuccess) {
+		avformat_close_input(&Input);
+		if (nullptr != Output) {
+			avio_closep(&Output->pb);
+			avformat_free_context(Output);
+		}
+		av_packet_free(&Packet);
+		return bSuccess;
+	};
+
+	// helper function to finish with failure, never leaving a partial output
+	const auto& Failure = [&](const FString& Message) {
+		ErrorMessage = Message;
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *ErrorMessage);
+		const auto& bOutputOpened = nullptr != Output && nullptr != Output->pb;
+		Finish(false);
+		if (bOutputOpened) {
+			IFileManager::Get().Delete(*OutputPath);
+		}
+		return false;
+	};
+
+	if (Ranges.IsEmpty() || nullptr == Packet) {
+		return Failure(TEXT("Nothing to copy."));
+	}
+
+	// end of the output written so far, and the last decoding timestamp of
+	// each stream, which must increase across inputs
+	int64         OutputEnd = 0;
+	TArray<int64> LastDts;
+
+	for (auto& Range : Ranges) {
+		const auto& InputPath = Range.InputPath;
+
+		// open input
+		const auto& Path = StringCast<UTF8CHAR>(*InputPath);
+		if (avformat_open_input(&Input, reinterpret_cast<const char*>(Path.Get()),
+		                        nullptr, nullptr) < 0 ||
+		    avformat_find_stream_info(Input, nullptr) < 0) {
+			return Failure(FString::Printf(TEXT("Failed to open %s."),
+			                               *InputPath));
+		}
+
+		// the first input decides the streams of the output
+		if (nullptr == Output) {
+			const auto& OutputPathInUTF8 = StringCast<UTF8CHAR>(*OutputPath);
+			if (avformat_alloc_output_context2(
+			        &Output, nullptr, nullptr,
+			        reinterpret_cast<const char*>(OutputPathInUTF8.Get())) < 0) {
+				return Failure(TEXT("Failed to allocate format context."));
+			}
+			for (unsigned Index = 0; Index < Input->nb_streams; ++Index) {
+				const auto& InStream  = Input->streams[Index];
+				const auto& OutStream = avformat_new_stream(Output, nullptr);
+				if (nullptr == OutStream ||
+				    avcodec_parameters_copy(OutStream->codecpar,
+				                            InStream->codecpar) < 0) {
+					return Failure(TEXT("Failed to add a new stream."));
+				}
+				OutStream->codecpar->codec_tag = 0;
+				OutStream->time_base           = InStream->time_base;
+			}
+			if (avio_open(&Output->pb,
+			              reinterpret_cast<const char*>(OutputPathInUTF8.Get()),
+			              AVIO_FLAG_WRITE) < 0 ||
+			    avformat_write_header(Output, nullptr) < 0) {
+				return Failure(FString::Printf(TEXT("Failed to open %s."),
+				                               *OutputPath));
+			}
+			bHeaderWritten = true;
+			LastDts.Init(AV_NOPTS_VALUE, Output->nb_streams);
+		}
+
+		// following inputs must match
+		if (Input->nb_streams != Output->nb_streams) {
+			return Failure(FString::Printf(
+			    TEXT("%s differs in the number of streams."), *InputPath));
+		}
+		for (unsigned Index = 0; Index < Input->nb_streams; ++Index) {
+			if (!AreCompatible(*Input->streams[Index]->codecpar,
+			                   *Output->streams[Index]->codecpar)) {
+				return Failure(FString::Printf(
+				    TEXT("%s differs in codec parameters."), *InputPath));
+			}
+		}
+
+		// times of the input, in AV_TIME_BASE
+		const auto& InputStart =
+		    AV_NOPTS_VALUE == Input->start_time ? 0 : Input->start_time;
+		const auto& StartTime =
+		    InputStart + static_cast<int64>(Range.StartSeconds * AV_TIME_BASE);
+		const auto& EndTime =
+		    Range.EndSeconds > 0.0
+		        ? InputStart + static_cast<int64>(Range.EndSeconds * AV_TIME_BASE)
+		        : MAX_int64;
+
+		// cut at keyframes of the video, or at any packet without video
+		const auto& VideoIndex =
+		    av_find_best_stream(Input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+		if (Range.StartSeconds > 0.0) {
+			av_seek_frame(Input, -1, StartTime, AVSEEK_FLAG_BACKWARD);
+		}
+
+		// first and last copied times, and shift of timestamps so that the
+		// first copied packet is decoded at the end of the output
+		auto  CutStart = AV_NOPTS_VALUE;
+		auto  CutEnd   = AV_NOPTS_VALUE;
+		int64 Offset   = 0;
+		int64 InputEnd = OutputEnd;
+
+		while (av_read_frame(Input, Packet) >= 0) {
+			const auto& Index     = Packet->stream_index;
+			const auto& InStream  = Input->streams[Index];
+			const auto& OutStream = Output->streams[Index];
+
+			// time of Packet, skipped if unknown
+			const auto& Timestamp =
+			    AV_NOPTS_VALUE == Packet->pts ? Packet->dts : Packet->pts;
+			if (AV_NOPTS_VALUE == Timestamp) {
+				av_packet_unref(Packet);
+				continue;
+			}
+			const auto& Time =
+			    av_rescale_q(Timestamp, InStream->time_base, AV_TIME_BASE_Q);
+
+			// start at the first keyframe after seeking, and end at the first
+			// one from EndTime
+			const auto& bCutPoint =
+			    VideoIndex < 0 ||
+			    (Index == VideoIndex && (Packet->flags & AV_PKT_FLAG_KEY));
+			if (bCutPoint && AV_NOPTS_VALUE == CutStart &&
+			    (VideoIndex >= 0 || Time >= StartTime)) {
+				const auto& DecodeTime =
+				    AV_NOPTS_VALUE == Packet->dts
+				        ? Time
+				        : av_rescale_q(Packet->dts, InStream->time_base,
+				                       AV_TIME_BASE_Q);
+				CutStart = Time;
+				Offset   = OutputEnd - DecodeTime;
+			} else if (bCutPoint && AV_NOPTS_VALUE != CutStart &&
+			           AV_NOPTS_VALUE == CutEnd && Time >= EndTime) {
+				CutEnd = Time;
+			}
+
+			// stop once other streams have interleaved past the end
+			if (AV_NOPTS_VALUE != CutEnd && Time >= CutEnd + AV_TIME_BASE) {
+				av_packet_unref(Packet);
+				break;
+			}
+
+			// skip packets outside the cut
+			if (AV_NOPTS_VALUE == CutStart || Time < CutStart ||
+			    (AV_NOPTS_VALUE != CutEnd &&
+			     (Index == VideoIndex || Time >= CutEnd))) {
+				av_packet_unref(Packet);
+				continue;
+			}
+
+			// shift into the output
+			av_packet_rescale_ts(Packet, InStream->time_base,
+			                     OutStream->time_base);
+			const auto& Shift =
+			    av_rescale_q(Offset, AV_TIME_BASE_Q, OutStream->time_base);
+			if (AV_NOPTS_VALUE != Packet->pts) {
+				Packet->pts += Shift;
+			}
+			if (AV_NOPTS_VALUE != Packet->dts) {
+				Packet->dts += Shift;
+
+				// reordering delays differ between inputs by a few ticks
+				if (AV_NOPTS_VALUE != LastDts[Index] &&
+				    Packet->dts <= LastDts[Index]) {
+					Packet->dts = LastDts[Index] + 1;
+					if (AV_NOPTS_VALUE != Packet->pts) {
+						Packet->pts = FMath::Max(Packet->pts, Packet->dts);
+					}
+				}
+				LastDts[Index] = Packet->dts;
+			}
+			InputEnd = FMath::Max(
+			    InputEnd,
+			    av_rescale_q((AV_NOPTS_VALUE == Packet->dts ? Packet->pts
+			                                                : Packet->dts) +
+			                     Packet->duration,
+			                 OutStream->time_base, AV_TIME_BASE_Q));
+			Packet->pos = -1;
+
+			// write Packet to output, which takes over the reference
+			if (av_interleaved_write_frame(Output, Packet) < 0) {
+				return Failure(TEXT("Failed to write packet."));
+			}
+		}
+
+		if (AV_NOPTS_VALUE == CutStart) {
+			return Failure(FString::Printf(
+			    TEXT("No keyframe is in the range of %s."), *InputPath));
+		}
+
+		// report the copied range in the time of the input
+		Range.CopiedStartSeconds =
+		    static_cast<double>(CutStart - InputStart) / AV_TIME_BASE;
+		Range.CopiedEndSeconds =
+		    static_cast<double>(AV_NOPTS_VALUE == CutEnd
+		                            ? InputEnd - Offset - InputStart
+		                            : CutEnd - InputStart) /
+		    AV_TIME_BASE;
+
+		// the next range continues from here
+		OutputEnd = InputEnd;
+		avformat_close_input(&Input);
+	}
+
+	// finalize output
+	if (!bHeaderWritten || av_write_trailer(Output) < 0) {
+		return Failure(TEXT("Failed to write trailer."));
+	}
+
+	return Finish(true);
+}
@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Range of an input copied by CopyMediaByStreamCopy
+ */
+struct FFFmpegStreamCopyRange {
+	/**
+	 * media to copy from
+	 */
+	FString InputPath;
+
+	/**
+	 * start of the range, widened to the video keyframe at or before it
+	 */
+	double StartSeconds = 0.0;
+
+	/**
+	 * end of the range, widened to the first video keyframe at or after it.
+	 * the end of the input if not positive.
+	 */
+	double EndSeconds = 0.0;
+
+	/**
+	 * [out] copied range in the time of the input
+	 */
+	double CopiedStartSeconds = 0.0;
+	double CopiedEndSeconds   = 0.0;
+};
+
+/**
+ * Join Ranges into OutputPath by copying packets, without re-encoding.
+ * Inputs must have the same streams with the same codec parameters.
+ * Timestamps of each range continue from the end of the previous one, and
+ * the output starts at 0.
+ * @return   whether OutputPath was written. it is deleted on failure.
+ */
+bool CopyMediaByStreamCopy(TArrayView<FFFmpegStreamCopyRange> Ranges,
+                           const FString&                     OutputPath,
+                           FString&                           ErrorMessage);
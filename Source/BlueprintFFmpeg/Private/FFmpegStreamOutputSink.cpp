@@ -0,0 +1,322 @@
+
+#include "FFmpegStreamOutputSink.h"
+
+#include "FFmpegMemory.h"
+#include "HAL/RunnableThread.h"
+#include "LogFFmpegEncoder.h"
+
+#include <chrono>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+}
+
+FFFmpegStreamOutputSink::FFFmpegStreamOutputSink(
+    const FString& Url, const FFFmpegStreamConfig& StreamConfig)
+    : FFFmpegCustomIOOutputSink(FormatNameOf(Url)), Url(Url),
+      StreamConfig(StreamConfig), bRtp(Url.StartsWith(TEXT("rtp://"))) {}
+
+FFFmpegStreamOutputSink::~FFFmpegStreamOutputSink() {
+	// release resources before Write becomes unavailable
+	FreeFormatContext();
+
+	if (Thread) {
+		// wait to finish thread
+		Thread->Kill(true);
+
+		// release memory for Thread
+		delete Thread;
+	}
+
+	// bytes left unsent
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Mux, -QueuedBytes);
+}
+
+FFFmpegStreamStats FFFmpegStreamOutputSink::GetStats() {
+	std::lock_guard lk(Queue_mutex);
+
+	FFFmpegStreamStats Stats;
+	Stats.bConnected   = bConnected;
+	Stats.Reconnects   = Reconnects;
+	Stats.SentBytes    = SentBytes;
+	Stats.DroppedBytes = DroppedBytes;
+	Stats.QueuedBytes  = QueuedBytes;
+	Stats.SendLatencyMilliseconds =
+	    SentChunks > 0 ? SendLatencySeconds * 1000.0 / SentChunks : 0.0;
+	Stats.EncodeToSendMilliseconds =
+	    TimedChunks > 0 ? EncodeToSendSeconds * 1000.0 / TimedChunks : 0.0;
+	return Stats;
+}
+
+bool FFFmpegStreamOutputSink::Open(
+    TConstArrayView<const AVCodecContext*> CodecContexts) {
+	// connect while the muxer starts
+	if (nullptr == Thread) {
+		Thread = FRunnableThread::Create(this, TEXT("FFmpeg stream thread"));
+		if (nullptr == Thread) {
+			UE_LOG(LogFFmpegEncoder, Error,
+			       TEXT("Failed to create stream thread."));
+			return false;
+		}
+	}
+
+	return FFFmpegCustomIOOutputSink::Open(CodecContexts);
+}
+
+bool FFFmpegStreamOutputSink::WritePacket(const AVPacket& Packet) {
+	// receivers can start decoding from a keyframe of the video stream.
+	// every audio packet is a keyframe.
+	const auto& bVideo = 0 == Packet.stream_index;
+	{
+		std::lock_guard lk(Queue_mutex);
+		if (bDropping && bConnected && bVideo &&
+		    (Packet.flags & AV_PKT_FLAG_KEY)) {
+			bDropping = false;
+		}
+	}
+
+	// time the frame of Packet was sent to the encoder, stamped by the
+	// encode thread
+#ifdef AV_CODEC_FLAG_COPY_OPAQUE
+	if (bVideo) {
+		CurrentFrameCycles = reinterpret_cast<UPTRINT>(Packet.opaque);
+	}
+#endif
+
+	// muxed bytes of Packet are written through to Write
+	return FFFmpegCustomIOOutputSink::WritePacket(Packet);
+}
+
+bool FFFmpegStreamOutputSink::Close() {
+	// finish muxing
+	const auto& bClosed = FFFmpegCustomIOOutputSink::Close();
+
+	// send the rest and stop the sender thread
+	Stop();
+	if (Thread) {
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	return bClosed;
+}
+
+bool FFFmpegStreamOutputSink::TakeKeyframeRequest() {
+	return bKeyframeRequested.exchange(false);
+}
+
+bool FFFmpegStreamOutputSink::Write(TArrayView<const uint8> Data) {
+	std::lock_guard lk(Queue_mutex);
+
+	// skip up to the next keyframe while disconnected or after overflow
+	if (bDropping) {
+		DroppedBytes += Data.Num();
+		return true;
+	}
+
+	// the network is slower than encoding, so drop what is queued and
+	// restart from a keyframe instead of falling behind
+	if (QueuedBytes + Data.Num() >
+	    static_cast<int64>(StreamConfig.MaxQueueKilobytes) * 1024) {
+		DroppedBytes += QueuedBytes + Data.Num();
+		FFFmpegMemory::Track(FFmpegMemoryCategory::Mux, -QueuedBytes);
+		Queue.Reset();
+		QueuedBytes        = 0;
+		bDropping          = true;
+		bKeyframeRequested = true;
+		return true;
+	}
+
+	// enqueue for the sender thread
+	{
+		LLM_SCOPE_BYTAG(BlueprintFFmpeg_Mux);
+		Queue.EmplaceLast(FChunk{TArray<uint8>(Data.GetData(), Data.Num()),
+		                         FPlatformTime::Cycles64(), CurrentFrameCycles});
+	}
+	QueuedBytes += Data.Num();
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Mux, Data.Num());
+	Queue_cv.notify_one();
+	return true;
+}
+
+AVIOContext* FFFmpegStreamOutputSink::OpenIOContext() {
+	// RTP packets are formed to carry 7 MPEG-TS packets in a datagram
+	const auto& IOContext = FFFmpegCustomIOOutputSink::OpenIOContext();
+	if (nullptr != IOContext) {
+		IOContext->max_packet_size = DatagramBytes + 12;
+	}
+
+	return IOContext;
+}
+
+void FFFmpegStreamOutputSink::AddMuxerOptions(
+    AVDictionary*& MuxerOptions) const {
+	// hand each packet to Write as soon as it is muxed, without delaying
+	// timestamps for a receiver buffer
+	av_dict_set(&MuxerOptions, "flush_packets", "1", 0);
+	av_dict_set(&MuxerOptions, "max_delay", "0", 0);
+}
+
+FString FFFmpegStreamOutputSink::FormatNameOf(const FString& Url) {
+	return Url.StartsWith(TEXT("rtp://")) ? TEXT("rtp_mpegts") : TEXT("mpegts");
+}
+
+#pragma region Run on the new thread functions
+
+uint32 FFFmpegStreamOutputSink::Run() {
+	while (true) {
+		// connect, retrying until stopped. nothing is queued while
+		// disconnected, so stopping needs no more sending
+		if (!bConnected) {
+			if (!bRunning) {
+				break;
+			}
+			if (!Connect()) {
+				std::unique_lock lk(Queue_mutex);
+				Queue_cv.wait_for(lk,
+				                  std::chrono::duration<double>(
+				                      StreamConfig.ReconnectSeconds),
+				                  [&]() { return !bRunning; });
+				continue;
+			}
+		}
+
+		// wait for bytes to send
+		FChunk Chunk;
+		{
+			std::unique_lock lk(Queue_mutex);
+			Queue_cv.wait(lk, [&]() { return !bRunning || !Queue.IsEmpty(); });
+
+			// stopped after sending everything
+			if (Queue.IsEmpty()) {
+				break;
+			}
+
+			Chunk = MoveTemp(Queue.First());
+			Queue.PopFirst();
+			QueuedBytes -= Chunk.Bytes.Num();
+			FFFmpegMemory::Track(FFmpegMemoryCategory::Mux,
+			                     -Chunk.Bytes.Num());
+		}
+
+		// reconnect if the receiver went away
+		if (!Send(Chunk)) {
+			Disconnect();
+		}
+	}
+
+	avio_closep(&UrlContext);
+	return 0;
+}
+
+bool FFFmpegStreamOutputSink::Connect() {
+	// datagrams of whole MPEG-TS packets, and a bounded wait for TCP peers
+	AVDictionary* Options = nullptr;
+	av_dict_set(&Options, "timeout", IOTimeout, 0);
+	av_dict_set(&Options, "rw_timeout", IOTimeout, 0);
+	av_dict_set(&Options, "tcp_nodelay", "1", 0);
+	if (!bRtp) {
+		av_dict_set_int(&Options, "pkt_size", DatagramBytes, 0);
+	}
+
+	// connecting is abandoned as soon as Stop is called
+	const AVIOInterruptCB InterruptCallback = {&IsInterrupted, this};
+
+	const auto UrlInUTF8 = StringCast<UTF8CHAR>(*Url);
+	const auto& OpenResult =
+	    avio_open2(&UrlContext, reinterpret_cast<const char*>(UrlInUTF8.Get()),
+	               AVIO_FLAG_WRITE, &InterruptCallback, &Options);
+	av_dict_free(&Options);
+	if (OpenResult < 0) {
+		return false;
+	}
+
+	// receivers join at the next keyframe, which is requested now
+	{
+		std::lock_guard lk(Queue_mutex);
+		if (bEverConnected) {
+			++Reconnects;
+		}
+		bConnected = true;
+	}
+	bKeyframeRequested = true;
+	bEverConnected     = true;
+	NextSendSeconds    = FPlatformTime::Seconds();
+
+	UE_LOG(LogFFmpegEncoder, Log, TEXT("Connected to %s."), *Url);
+	return true;
+}
+
+int FFFmpegStreamOutputSink::IsInterrupted(void* Opaque) {
+	// bytes are still sent while connected, until the queue is empty
+	const auto& This = static_cast<const FFFmpegStreamOutputSink*>(Opaque);
+	return !This->bRunning && !This->bConnected;
+}
+
+void FFFmpegStreamOutputSink::Disconnect() {
+	UE_LOG(LogFFmpegEncoder, Warning, TEXT("Lost connection to %s."), *Url);
+	avio_closep(&UrlContext);
+
+	// drop queued bytes, and the rest up to the keyframe after reconnecting
+	std::lock_guard lk(Queue_mutex);
+	DroppedBytes += QueuedBytes;
+	FFFmpegMemory::Track(FFmpegMemoryCategory::Mux, -QueuedBytes);
+	Queue.Reset();
+	QueuedBytes = 0;
+	bDropping   = true;
+	bConnected  = false;
+}
+
+bool FFFmpegStreamOutputSink::Send(const FChunk& Chunk) {
+	// RTP packets are sent as they are, MPEG-TS in datagrams
+	const auto& NumBytes   = Chunk.Bytes.Num();
+	const auto& PieceBytes = bRtp ? NumBytes : DatagramBytes;
+	for (int32 Offset = 0; Offset < NumBytes; Offset += PieceBytes) {
+		const auto& Size = FMath::Min(PieceBytes, NumBytes - Offset);
+
+		// spread pieces over time at the pacing rate
+		if (StreamConfig.PacingBitRate > 0) {
+			const auto& WaitSeconds = NextSendSeconds - FPlatformTime::Seconds();
+			if (WaitSeconds > 0.0) {
+				FPlatformProcess::SleepNoStats(static_cast<float>(WaitSeconds));
+			}
+			NextSendSeconds =
+			    FMath::Max(NextSendSeconds, FPlatformTime::Seconds()) +
+			    Size * 8.0 / StreamConfig.PacingBitRate;
+		}
+
+		avio_write(UrlContext, Chunk.Bytes.GetData() + Offset, Size);
+		avio_flush(UrlContext);
+		if (UrlContext->error < 0) {
+			return false;
+		}
+	}
+
+	// update stats
+	const auto& SentCycles = FPlatformTime::Cycles64();
+	std::lock_guard lk(Queue_mutex);
+	SentBytes += NumBytes;
+	++SentChunks;
+	SendLatencySeconds +=
+	    FPlatformTime::ToSeconds64(SentCycles - Chunk.QueuedCycles);
+	if (0 != Chunk.FrameCycles) {
+		++TimedChunks;
+		EncodeToSendSeconds +=
+		    FPlatformTime::ToSeconds64(SentCycles - Chunk.FrameCycles);
+	}
+	return true;
+}
+
+#pragma endregion
+
+void FFFmpegStreamOutputSink::Stop() {
+	// stop running
+	bRunning = false;
+
+	// wake the sender thread to finish
+	std::lock_guard lk(Queue_mutex);
+	Queue_cv.notify_one();
+}
@@ -0,0 +1,189 @@
+
+#include "FFmpegSweepCommandlet.h"
+
+#include "FFmpegEncoderSweep.h"
+#include "FFmpegUtils.h"
+#include "HAL/FileManager.h"
+#include "ImageUtils.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#pragma region helpers
+namespace FFmpegSweepCommandletImpl {
+/**
+ * @return   comma separated values of Key in Params, or Default.
+ */
+TArray<FString> ParseList(const FString& Params, const TCHAR* Key,
+                          const TCHAR* Default) {
+	FString Value = Default;
+	FParse::Value(*Params, Key, Value, false);
+
+	TArray<FString> Values;
+	Value.ParseIntoArray(Values, TEXT(","));
+	return Values;
+}
+
+/**
+ * @return   images in Directory sorted by name, at most NumFrames.
+ */
+TArray<FImage> LoadImages(const FString& Directory, const int32 NumFrames) {
+	TArray<FString> FileNames;
+	IFileManager::Get().FindFiles(FileNames, *(Directory / TEXT("*")), true,
+	                              false);
+	FileNames.Sort();
+
+	TArray<FImage> Images;
+	for (const auto& FileName : FileNames) {
+		if (Images.Num() >= NumFrames) {
+			break;
+		}
+
+		// skip files that aren't images
+		FImage Image;
+		if (FImageUtils::LoadImage(*(Directory / FileName), Image)) {
+			Images.Add(MoveTemp(Image));
+		}
+	}
+
+	return Images;
+}
+} // namespace FFmpegSweepCommandletImpl
+#pragma endregion
+
+UFFmpegSweepCommandlet::UFFmpegSweepCommandlet() {
+	IsClient        = false;
+	IsEditor        = false;
+	IsServer        = false;
+	LogToConsole    = true;
+	ShowErrorCount  = true;
+	HelpDescription = TEXT("Sweep FFmpeg encoder settings and report the "
+	                       "Pareto front of speed, quality and bit rate.");
+}
+
+int32 UFFmpegSweepCommandlet::Main(const FString& Params) {
+	using namespace FFmpegSweepCommandletImpl;
+
+	// reference clip
+	FString ImageDirectory;
+	FParse::Value(*Params, TEXT("Images="), ImageDirectory);
+	int32 NumFrames = 120;
+	FParse::Value(*Params, TEXT("Frames="), NumFrames);
+	float FrameRate = 30.0f;
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FString Content = ImageDirectory.IsEmpty()
+	                      ? FString(TEXT("Synthetic"))
+	                      : FPaths::GetCleanFilename(ImageDirectory);
+	FParse::Value(*Params, TEXT("Content="), Content);
+
+	const auto& Images = ImageDirectory.IsEmpty()
+	                         ? TArray<FImage>()
+	                         : LoadImages(ImageDirectory, NumFrames);
+	if (!ImageDirectory.IsEmpty()) {
+		if (Images.IsEmpty()) {
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("No images are found in %s."),
+			       *ImageDirectory);
+			return 1;
+		}
+		NumFrames = Images.Num();
+	}
+
+	// grid of settings
+	const auto& Resolutions =
+	    ParseList(Params, TEXT("Resolutions="), TEXT("1920x1080"));
+	const auto& Presets = ParseList(Params, TEXT("Presets="),
+	                                TEXT("ultrafast,veryfast,medium"));
+	const auto& Crfs    = ParseList(Params, TEXT("Crfs="), TEXT("18,23,28"));
+	const auto& BFrames = ParseList(Params, TEXT("BFrames="), TEXT("0,3"));
+	const auto& Threads = ParseList(Params, TEXT("Threads="), TEXT("0"));
+
+	TArray<FFmpegVideoCodec> Codecs;
+	for (const auto& Name : ParseList(Params, TEXT("Codecs="), TEXT("H264"))) {
+		const auto& Value =
+		    StaticEnum<FFmpegVideoCodec>()->GetValueByNameString(Name);
+		if (INDEX_NONE == Value) {
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("Unknown codec %s."), *Name);
+			return 1;
+		}
+		Codecs.Add(static_cast<FFmpegVideoCodec>(Value));
+	}
+
+	FString ReportDirectory = FPaths::ProjectSavedDir() / TEXT("FFmpegSweep");
+	FParse::Value(*Params, TEXT("Report="), ReportDirectory);
+
+	for (const auto& Resolution : Resolutions) {
+		FString Width, Height;
+		if (!Resolution.Split(TEXT("x"), &Width, &Height)) {
+			UE_LOG(LogFFmpegEncoder, Error, TEXT("Invalid resolution %s."),
+			       *Resolution);
+			return 1;
+		}
+
+		FFFmpegEncoderConfig BaseConfig;
+		BaseConfig.Width     = FCString::Atoi(*Width);
+		BaseConfig.Height    = FCString::Atoi(*Height);
+		BaseConfig.FrameRate = FrameRate;
+
+		// source frames are converted once, so that only encoding is measured
+		TArray<FFFmpegFrameThreadSafeSharedPtr> SourceFrames;
+		for (int32 Index = 0; Index < NumFrames; ++Index) {
+			SourceFrames.Add(UFFmpegUtils::CreateFrame(
+			    Images.IsEmpty() ? FFFmpegEncoderSweep::CreateSyntheticImage(
+			                           BaseConfig.Width, BaseConfig.Height, Index)
+			                     : Images[Index],
+			    Index, BaseConfig));
+		}
+
+		// measure each setting
+		TArray<FFFmpegSweepResult> Results;
+		for (const auto& Codec : Codecs) {
+			for (const auto& Preset : Presets) {
+				for (const auto& Crf : Crfs) {
+					for (const auto& BFrame : BFrames) {
+						for (const auto& Thread : Threads) {
+							auto Config       = BaseConfig;
+							Config.Codec      = Codec;
+							Config.Preset     = Preset;
+							Config.Crf        = FCString::Atof(*Crf);
+							Config.MaxBFrames = FCString::Atoi(*BFrame);
+							Config.Threads    = FCString::Atoi(*Thread);
+
+							FFFmpegSweepResult Result;
+							if (FFFmpegEncoderSweep::Measure(SourceFrames, Config,
+							                                 Result)) {
+								Results.Add(Result);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// report
+		FFFmpegEncoderSweep::MarkParetoFront(Results);
+		const auto& ReportPath =
+		    ReportDirectory / FString::Printf(TEXT("%s_%sx%s.csv"), *Content,
+		                                      *Width, *Height);
+		FFileHelper::SaveStringToFile(FFFmpegEncoderSweep::ToCsv(Results),
+		                              *ReportPath);
+
+		UE_LOG(LogFFmpegEncoder, Display, TEXT("Pareto front of %s at %s:"),
+		       *Content, *Resolution);
+		for (const auto& Result : Results) {
+			if (Result.bParetoOptimal) {
+				UE_LOG(LogFFmpegEncoder, Display,
+				       TEXT("  %s preset=%s crf=%g bframes=%d threads=%d: "
+				            "%.1f fps, %.0f kbps, SSIM %.4f, PSNR %.2f dB"),
+				       *UEnum::GetValueAsString(Result.Config.Codec),
+				       *Result.Config.Preset, Result.Config.Crf,
+				       Result.Config.MaxBFrames, Result.Config.Threads,
+				       Result.EncodeFramesPerSecond, Result.KilobitsPerSecond,
+				       Result.SsimY, Result.PsnrY);
+			}
+		}
+		UE_LOG(LogFFmpegEncoder, Display, TEXT("Report is written to %s."),
+		       *ReportPath);
+	}
+
+	return 0;
+}
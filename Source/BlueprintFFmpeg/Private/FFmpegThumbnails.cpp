@@ -0,0 +1,219 @@
+
+#include "FFmpegThumbnails.h"
+
+#include "Async/ParallelFor.h"
+#include "FFmpegKeyframeIndex.h"
+#include "FFmpegUtils.h"
+#include "ImageUtils.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/Crc.h"
+#include "Misc/Paths.h"
+
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+TArray<FString> UFFmpegThumbnails::ExtractThumbnailsToFiles(
+    const TArray<FString>& MediaPaths, const float IntervalSeconds,
+    const int32 Width, const FString& OutputDirectory) {
+	// a request per file
+	TArray<FFFmpegThumbnailRequest> Requests;
+	for (const auto& MediaPath : MediaPaths) {
+		auto& Request           = Requests.AddDefaulted_GetRef();
+		Request.MediaPath       = MediaPath;
+		Request.IntervalSeconds = IntervalSeconds;
+	}
+
+	// save on the worker tasks, so that images don't pile up in memory
+	std::mutex      SavedPaths_mutex;
+	TArray<FString> SavedPaths;
+	ExtractThumbnails(
+	    Requests, Width,
+	    [&](const int32 RequestIndex, TArray<FFFmpegThumbnail>&& Thumbnails) {
+		    // named after the media and a hash of its full path
+		    const auto& MediaPath = Requests[RequestIndex].MediaPath;
+		    const auto& BaseName  = FPaths::GetBaseFilename(MediaPath);
+		    const auto& PathHash  = FCrc::StrCrc32(
+		        *FPaths::ConvertRelativePathToFull(MediaPath));
+		    for (int32 Index = 0; Index < Thumbnails.Num(); ++Index) {
+			    const auto& Path =
+			        OutputDirectory /
+			        FString::Printf(TEXT("%s_%08x_%04d.jpg"), *BaseName,
+			                        PathHash, Index);
+			    if (Thumbnails[Index].Image.RawData.IsEmpty() ||
+			        !FImageUtils::SaveImageByExtension(*Path,
+			                                           Thumbnails[Index].Image)) {
+				    continue;
+			    }
+
+			    std::lock_guard Lock(SavedPaths_mutex);
+			    SavedPaths.Add(Path);
+		    }
+	    });
+
+	return SavedPaths;
+}
+
+void UFFmpegThumbnails::ExtractThumbnails(
+    TConstArrayView<FFFmpegThumbnailRequest> Requests, const int32 Width,
+    const FExtractedCallback& OnExtracted) {
+	// files are independent, each decoded on its own worker
+	ParallelFor(Requests.Num(), [&](const int32 RequestIndex) {
+		OnExtracted(RequestIndex,
+		            ExtractThumbnailsOfFile(Requests[RequestIndex], Width));
+	});
+}
+
+TArray<FFFmpegThumbnail>
+    UFFmpegThumbnails::ExtractThumbnailsOfFile(
+        const FFFmpegThumbnailRequest& Request, const int32 Width) {
+	TArray<FFFmpegThumbnail> Thumbnails;
+
+	// keyframes from the sidecar, or scanned on first use
+	FFFmpegKeyframeIndex KeyframeIndex;
+	KeyframeIndex.LoadOrBuild(Request.MediaPath);
+
+	// open input
+	const auto&      Path          = StringCast<UTF8CHAR>(*Request.MediaPath);
+	AVFormatContext* FormatContext = nullptr;
+	if (avformat_open_input(&FormatContext,
+	                        reinterpret_cast<const char*>(Path.Get()), nullptr,
+	                        nullptr) < 0 ||
+	    avformat_find_stream_info(FormatContext, nullptr) < 0) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to open %s."),
+		       *Request.MediaPath);
+		avformat_close_input(&FormatContext);
+		return Thumbnails;
+	}
+
+	// open decoder of the first video stream. files run in parallel, so
+	// that each decodes on a single thread
+	const auto& StreamIndex = av_find_best_stream(
+	    FormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	auto CodecContext =
+	    StreamIndex < 0 ? nullptr
+	                    : UFFmpegUtils::OpenVideoDecoder(
+	                          *FormatContext->streams[StreamIndex], 1);
+	AVPacket* Packet  = av_packet_alloc();
+	AVFrame*  Decoded = av_frame_alloc();
+
+	// helper function to free resources
+	const auto& Finish = [&]() {
+		av_frame_free(&Decoded);
+		av_packet_free(&Packet);
+		avcodec_free_context(&CodecContext);
+		avformat_close_input(&FormatContext);
+		return MoveTemp(Thumbnails);
+	};
+
+	if (nullptr == CodecContext || nullptr == Packet || nullptr == Decoded) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Failed to decode %s."),
+		       *Request.MediaPath);
+		return Finish();
+	}
+
+	// timestamps of the stream
+	const auto& Stream   = FormatContext->streams[StreamIndex];
+	const auto& TimeBase = av_q2d(Stream->time_base);
+	const auto& StartPts =
+	    AV_NOPTS_VALUE == Stream->start_time ? 0 : Stream->start_time;
+	const auto& FrameRate =
+	    av_q2d(av_guess_frame_rate(FormatContext, Stream, nullptr));
+	const auto& HalfFrameSeconds = FrameRate > 0.0 ? 0.5 / FrameRate : 0.0;
+
+	// requested times in order, so that each file is read forward
+	auto Targets = Request.Seconds;
+	if (Request.IntervalSeconds > 0.0 &&
+	    AV_NOPTS_VALUE != FormatContext->duration) {
+		const auto& Duration =
+		    static_cast<double>(FormatContext->duration) / AV_TIME_BASE;
+		for (double Seconds = 0.0; Seconds < Duration;
+		     Seconds += Request.IntervalSeconds) {
+			Targets.Add(Seconds);
+		}
+	}
+	Targets.Sort();
+
+	// size of images, keeping the aspect ratio
+	const auto& ImageWidth  = Width > 0 ? Width : CodecContext->width;
+	const auto& ImageHeight = FMath::Max(
+	    2, FMath::RoundToInt32(static_cast<double>(ImageWidth) *
+	                           CodecContext->height / CodecContext->width / 2) *
+	           2);
+
+	// helper function to receive the next frame into Decoded
+	const auto& ReceiveFrame = [&]() {
+		while (true) {
+			const auto& ReceiveResult =
+			    avcodec_receive_frame(CodecContext, Decoded);
+			if (AVERROR(EAGAIN) != ReceiveResult) {
+				return 0 == ReceiveResult;
+			}
+
+			// feed the next packet, or drain the decoder at the end
+			if (av_read_frame(FormatContext, Packet) < 0) {
+				avcodec_send_packet(CodecContext, nullptr);
+				continue;
+			}
+			if (Packet->stream_index == StreamIndex) {
+				avcodec_send_packet(CodecContext, Packet);
+			}
+			av_packet_unref(Packet);
+		}
+	};
+
+	// byte offsets are exact where timestamps are not, such as MPEG-TS
+	const auto& bSeekByByte =
+	    (FormatContext->iformat->flags & AVFMT_TS_DISCONT) &&
+	    !(FormatContext->iformat->flags & AVFMT_NO_BYTE_SEEK);
+
+	const FFFmpegKeyframe* CurrentKeyframe = nullptr;
+	bool                   bHasFrame       = false;
+	for (const auto& Target : Targets) {
+		auto& Thumbnail            = Thumbnails.AddDefaulted_GetRef();
+		Thumbnail.RequestedSeconds = Target;
+
+		// seek unless Target is in the group being decoded
+		const auto& Keyframe = KeyframeIndex.FindKeyframeBefore(Target);
+		if (nullptr == Keyframe || Keyframe != CurrentKeyframe) {
+			if (nullptr == Keyframe) {
+				av_seek_frame(FormatContext, StreamIndex,
+				              StartPts + static_cast<int64>(Target / TimeBase),
+				              AVSEEK_FLAG_BACKWARD);
+			} else if (bSeekByByte && Keyframe->Position >= 0) {
+				av_seek_frame(FormatContext, StreamIndex, Keyframe->Position,
+				              AVSEEK_FLAG_BYTE);
+			} else {
+				av_seek_frame(FormatContext, StreamIndex, Keyframe->Timestamp,
+				              AVSEEK_FLAG_BACKWARD);
+			}
+			avcodec_flush_buffers(CodecContext);
+			CurrentKeyframe = Keyframe;
+			bHasFrame       = false;
+		}
+
+		// decode up to the first frame at or after Target. the frame is kept
+		// for the next target
+		while (bHasFrame || (bHasFrame = ReceiveFrame())) {
+			const auto& Seconds =
+			    AV_NOPTS_VALUE == Decoded->best_effort_timestamp
+			        ? 0.0
+			        : (Decoded->best_effort_timestamp - StartPts) * TimeBase;
+			if (Seconds + HalfFrameSeconds >= Target) {
+				Thumbnail.Seconds = Seconds;
+				Thumbnail.Image   = FImage(ImageWidth, ImageHeight,
+				                           ERawImageFormat::BGRA8,
+				                           EGammaSpace::sRGB);
+				UFFmpegUtils::ConvertFrameIntoImage(*Decoded, Thumbnail.Image,
+				                                    FFmpegScaleFilter::Area);
+				break;
+			}
+			bHasFrame = false;
+		}
+	}
+
+	return Finish();
+}
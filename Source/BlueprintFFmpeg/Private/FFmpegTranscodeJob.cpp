@@ -0,0 +1,345 @@
+
+#include "FFmpegTranscodeJob.h"
+
+#include "FFmpegKeyframeIndex.h"
+#include "FFmpegOutputSink.h"
+#include "FFmpegUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "LogFFmpegEncoder.h"
+#include "Misc/Paths.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+FFFmpegTranscodeJob::FFFmpegTranscodeJob(
+    const FString& ProxyFilePath, const FString& OutputFilePath,
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig)
+    : ProxyFilePath(ProxyFilePath), OutputFilePath(OutputFilePath),
+      Config(FFmpegEncoderConfig) {
+	// the delivery codec is encoded within the thread budget
+	Config.ProxyCodec = FFmpegProxyCodec::None;
+	Config.Threads    = Config.TranscodeThreads;
+}
+
+FFFmpegTranscodeJob::~FFFmpegTranscodeJob() {
+	if (Thread) {
+		// wait to finish thread
+		Thread->Kill(true);
+
+		// release memory for Thread
+		delete Thread;
+	}
+}
+
+FString FFFmpegTranscodeJob::ProxyFilePathOf(const FString& OutputFilePath) {
+	return FPaths::GetBaseFilename(OutputFilePath, false) +
+	       TEXT(".proxy.mkv");
+}
+
+void FFFmpegTranscodeJob::Start() {
+	// start only once
+	if (bStarted.exchange(true)) {
+		return;
+	}
+
+	// stay behind the game, render and encode threads, on the encode cores
+	Thread = FRunnableThread::Create(this, TEXT("FFmpeg transcode thread"), 0,
+	                                 TPri_Lowest, Config.GetEncodeAffinityMask());
+	if (nullptr == Thread) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to create transcode thread."));
+	}
+}
+
+void FFFmpegTranscodeJob::MarkProxyFinished() {
+	std::lock_guard lk(Start_mutex);
+	bProxyFinished = true;
+	ProxyFinished_cv.notify_one();
+}
+
+void FFFmpegTranscodeJob::Cancel() {
+	Stop();
+}
+
+bool FFFmpegTranscodeJob::IsSucceeded() const {
+	return bSucceeded;
+}
+
+bool FFFmpegTranscodeJob::IsFinished() const {
+	return bExited || (bCanceled && !bStarted);
+}
+
+float FFFmpegTranscodeJob::GetProgress() const {
+	return Progress;
+}
+
+FString FFFmpegTranscodeJob::SegmentPathOf(const int32 Index) const {
+	return OutputFilePath + TEXT(".segments") /
+	       FString::Printf(TEXT("%05d.%s"), Index,
+	                       *FPaths::GetExtension(OutputFilePath));
+}
+
+#pragma region Run on the new thread functions
+
+uint32 FFFmpegTranscodeJob::Run() {
+	// wait for the proxy to be finished
+	{
+		std::unique_lock lk(Start_mutex);
+		ProxyFinished_cv.wait(lk, [&]() { return bProxyFinished || bCanceled; });
+	}
+	if (bCanceled) {
+		return 1;
+	}
+
+	// transcode the rest of segments
+	const auto& NumSegments = TranscodeSegments();
+	if (INDEX_NONE == NumSegments) {
+		return 1;
+	}
+
+	// join segments into the output
+	TArray<FString> SegmentPaths;
+	for (int32 Index = 0; Index < NumSegments; ++Index) {
+		SegmentPaths.Add(SegmentPathOf(Index));
+	}
+	FString ErrorMessage;
+	if (!UFFmpegUtils::ConcatVideosByStreamCopy(SegmentPaths, OutputFilePath,
+	                                            ErrorMessage)) {
+		return 1;
+	}
+
+	// delete intermediates
+	auto& FileManager = IFileManager::Get();
+	FileManager.DeleteDirectory(*FPaths::GetPath(SegmentPathOf(0)), false,
+	                            true);
+	FileManager.Delete(*ProxyFilePath);
+
+	// index keyframes of the output
+	if (Config.bWriteKeyframeIndex) {
+		FFFmpegKeyframeIndex KeyframeIndex;
+		if (KeyframeIndex.Build(OutputFilePath)) {
+			KeyframeIndex.Save();
+		}
+	}
+
+	Progress   = 1.0f;
+	bSucceeded = true;
+	return 0;
+}
+
+int32 FFFmpegTranscodeJob::TranscodeSegments() {
+	// resume after the finished segments
+	auto& FileManager  = IFileManager::Get();
+	int32 FirstSegment = 0;
+	while (FileManager.FileExists(*SegmentPathOf(FirstSegment))) {
+		++FirstSegment;
+	}
+
+	// get Codec
+	const auto& Codec = UFFmpegUtils::FindVideoEncoder(Config.Codec);
+	if (nullptr == Codec) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("Codec is not found."));
+		return INDEX_NONE;
+	}
+
+	// open proxy
+	const auto&      Path    = StringCast<UTF8CHAR>(*ProxyFilePath);
+	AVFormatContext* Input   = nullptr;
+	AVCodecContext*  Decoder = nullptr;
+	AVCodecContext*  Encoder = nullptr;
+	AVPacket*        Packet  = av_packet_alloc();
+	AVFrame*         Decoded = av_frame_alloc();
+	TUniquePtr<FFFmpegFileOutputSink> Sink;
+
+	// helper function to free resources
+	const auto& Finish = [&](const int32 Result) {
+		Sink.Reset();
+		avcodec_free_context(&Encoder);
+		av_frame_free(&Decoded);
+		av_packet_free(&Packet);
+		avcodec_free_context(&Decoder);
+		avformat_close_input(&Input);
+		return Result;
+	};
+
+	// helper function to finish with failure
+	const auto& Failure = [&](const FString& Message) {
+		UE_LOG(LogFFmpegEncoder, Error, TEXT("%s"), *Message);
+		return Finish(INDEX_NONE);
+	};
+
+	// segments are written beside the output
+	const auto& SegmentDirectory = FPaths::GetPath(SegmentPathOf(0));
+	if (!FileManager.MakeDirectory(*SegmentDirectory, true)) {
+		return Failure(FString::Printf(TEXT("Failed to create %s."),
+		                               *SegmentDirectory));
+	}
+
+	if (avformat_open_input(&Input, reinterpret_cast<const char*>(Path.Get()),
+	                        nullptr, nullptr) < 0 ||
+	    avformat_find_stream_info(Input, nullptr) < 0) {
+		return Failure(FString::Printf(TEXT("Failed to open %s."),
+		                               *ProxyFilePath));
+	}
+	// decode on a single thread, leaving TranscodeThreads to the encoder
+	const auto& StreamIndex =
+	    av_find_best_stream(Input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (StreamIndex < 0 || nullptr == Packet || nullptr == Decoded ||
+	    nullptr == (Decoder = UFFmpegUtils::OpenVideoDecoder(
+	                    *Input->streams[StreamIndex], 1))) {
+		return Failure(TEXT("Failed to decode the proxy."));
+	}
+
+	// timestamps of the proxy, whose frames are numbered from 0
+	const auto& Stream   = Input->streams[StreamIndex];
+	const auto& TimeBase = av_q2d(Stream->time_base);
+	const auto& StartPts =
+	    AV_NOPTS_VALUE == Stream->start_time ? 0 : Stream->start_time;
+	const auto& SegmentFrames =
+	    FMath::Max(1, FMath::RoundToInt32(SegmentSeconds * Config.FrameRate));
+	const auto& NumFrames =
+	    Stream->nb_frames > 0
+	        ? static_cast<double>(Stream->nb_frames)
+	        : FMath::Max(1.0, static_cast<double>(Input->duration) /
+	                              AV_TIME_BASE * Config.FrameRate);
+
+	// every frame of the proxy is a keyframe, so seek to the first frame
+	const auto& FirstFrame = static_cast<int64>(FirstSegment) * SegmentFrames;
+	if (FirstFrame > 0) {
+		av_seek_frame(Input, StreamIndex,
+		              StartPts + static_cast<int64>(FirstFrame /
+		                                            Config.FrameRate / TimeBase),
+		              AVSEEK_FLAG_BACKWARD);
+	}
+
+	int32       Segment     = FirstSegment;
+	const auto& PartialPath = [&]() {
+		return FPaths::GetBaseFilename(SegmentPathOf(Segment), false) +
+		       TEXT("_partial.") + FPaths::GetExtension(OutputFilePath);
+	};
+
+	// helper function to write all pending packets of Encoder
+	const auto& ReceivePackets = [&]() {
+		while (avcodec_receive_packet(Encoder, Packet) == 0) {
+			Packet->stream_index = 0;
+			const auto& bWritten = Sink->WritePacket(*Packet);
+			av_packet_unref(Packet);
+			if (!bWritten) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// helper function to finalize the segment being encoded
+	const auto& FinishSegment = [&]() {
+		avcodec_send_frame(Encoder, nullptr);
+		const auto& bFinished = ReceivePackets() && Sink->Close();
+		Sink.Reset();
+		avcodec_free_context(&Encoder);
+
+		// finished segments appear under their final name only
+		if (!bFinished ||
+		    !FileManager.Move(*SegmentPathOf(Segment), *PartialPath())) {
+			return false;
+		}
+		++Segment;
+		return true;
+	};
+
+	// helper function to receive the next frame of the proxy into Decoded
+	const auto& ReceiveFrame = [&]() {
+		while (true) {
+			const auto& ReceiveResult = avcodec_receive_frame(Decoder, Decoded);
+			if (AVERROR(EAGAIN) != ReceiveResult) {
+				return 0 == ReceiveResult;
+			}
+
+			// feed the next packet, or drain the decoder at the end
+			if (av_read_frame(Input, Packet) < 0) {
+				avcodec_send_packet(Decoder, nullptr);
+				continue;
+			}
+			if (Packet->stream_index == StreamIndex) {
+				avcodec_send_packet(Decoder, Packet);
+			}
+			av_packet_unref(Packet);
+		}
+	};
+
+	while (ReceiveFrame()) {
+		// discard the segment being encoded, keep finished ones
+		if (bCanceled) {
+			Sink.Reset();
+			FileManager.Delete(*PartialPath());
+			return Finish(INDEX_NONE);
+		}
+
+		// skip frames of finished segments
+		const auto& FrameNumber = FMath::RoundToInt64(
+		    (Decoded->best_effort_timestamp - StartPts) * TimeBase *
+		    Config.FrameRate);
+		if (FrameNumber < FirstFrame) {
+			continue;
+		}
+
+		// open the delivery encoder for a new segment, which starts with a
+		// keyframe
+		const auto& SegmentStart = static_cast<int64>(Segment) * SegmentFrames;
+		if (nullptr == Encoder) {
+			Encoder = UFFmpegUtils::OpenVideoEncoder(*Codec, Config);
+			if (nullptr == Encoder) {
+				return Failure(TEXT("Failed to open the delivery encoder."));
+			}
+			if (Decoded->format != Encoder->pix_fmt) {
+				return Failure(TEXT("Pixel format of the proxy differs."));
+			}
+			Sink = MakeUnique<FFFmpegFileOutputSink>(PartialPath());
+			const AVCodecContext* CodecContexts[] = {Encoder};
+			if (!Sink->Open(CodecContexts)) {
+				return Failure(TEXT("Failed to open a segment."));
+			}
+		}
+
+		// encode as a frame of the segment, letting the encoder pick types
+		Decoded->pts       = FrameNumber - SegmentStart;
+		Decoded->pict_type = AV_PICTURE_TYPE_NONE;
+		if (avcodec_send_frame(Encoder, Decoded) < 0 || !ReceivePackets()) {
+			return Failure(TEXT("Failed to encode a frame."));
+		}
+		Progress = FMath::Min(static_cast<float>((FrameNumber + 1) / NumFrames),
+		                      0.99f);
+
+		// finish the segment when full
+		if (FrameNumber + 1 - SegmentStart >= SegmentFrames &&
+		    !FinishSegment()) {
+			return Failure(TEXT("Failed to finish a segment."));
+		}
+	}
+
+	// finish the last segment
+	if (nullptr != Encoder && !FinishSegment()) {
+		return Failure(TEXT("Failed to finish a segment."));
+	}
+
+	return Finish(Segment);
+}
+
+#pragma endregion
+
+void FFFmpegTranscodeJob::Stop() {
+	// stop running
+	bCanceled = true;
+
+	// wake the thread waiting for the proxy
+	std::lock_guard lk(Start_mutex);
+	ProxyFinished_cv.notify_one();
+}
+
+void FFFmpegTranscodeJob::Exit() {
+	// Run has returned
+	bExited = true;
+}
@@ -1,7 +1,145 @@
 
 #include "FFmpegUtils.h"
 
+#include "Async/ParallelFor.h"
 #include "FFmpegEncoder.h"
+#include "FFmpegEncoderPool.h"
+#include "FFmpegGopCache.h"
+#include "FFmpegMemory.h"
+#include "FFmpegStreamCopy.h"
+#include "LogFFmpegEncoder.h"
+#include "RenderingThread.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/pixdesc.h>
+}
+
+#pragma region helpers
+namespace FFmpegUtilsImpl {
+/**
+ * Intermediate image of conversion, counted as scaler memory while alive
+ */
+struct FScalerImage {
+	FImage Image;
+	int64  TrackedBytes = 0;
+
+	/**
+	 * Count Image after it is filled.
+	 */
+	void Track() {
+		TrackedBytes = Image.RawData.GetAllocatedSize();
+		FFFmpegMemory::Track(FFmpegMemoryCategory::Scaler, TrackedBytes,
+		                     FFFmpegMemory::GetScopeUsage());
+	}
+
+	~FScalerImage() {
+		FFFmpegMemory::Track(FFmpegMemoryCategory::Scaler, -TrackedBytes,
+		                     FFFmpegMemory::GetScopeUsage());
+	}
+};
+
+/**
+ * @return   swscale context of the calling thread, reused while the
+ *           parameters are unchanged so that filter coefficients aren't
+ *           recomputed for each frame.
+ */
+SwsContext* GetThreadLocalSwsContext(const int SrcWidth, const int SrcHeight,
+                                     const AVPixelFormat SrcFormat,
+                                     const int DstWidth, const int DstHeight,
+                                     const AVPixelFormat DstFormat,
+                                     const int           Flags) {
+	struct FSwsContextHolder {
+		SwsContext* Context = nullptr;
+		~FSwsContextHolder() { sws_freeContext(Context); }
+	};
+	thread_local FSwsContextHolder Holder;
+
+	Holder.Context = sws_getCachedContext(Holder.Context, SrcWidth, SrcHeight,
+	                                      SrcFormat, DstWidth, DstHeight,
+	                                      DstFormat, Flags, nullptr, nullptr,
+	                                      nullptr);
+	return Holder.Context;
+}
+
+/**
+ * Decide the regions of source and destination by ScaleMode.
+ * Destination region keeps even origin and size for 4:2:0 chroma.
+ */
+void FitRegions(const FFmpegScaleMode ScaleMode, const FIntPoint SrcSize,
+                const FIntRect& DstRect, FIntRect& OutSrcRegion,
+                FIntRect& OutDstRegion) {
+	OutSrcRegion = FIntRect(FIntPoint::ZeroValue, SrcSize);
+	OutDstRegion = DstRect;
+
+	const auto& DstSize = DstRect.Size();
+	const auto& ScaleX  = static_cast<double>(DstSize.X) / SrcSize.X;
+	const auto& ScaleY  = static_cast<double>(DstSize.Y) / SrcSize.Y;
+
+	switch (ScaleMode) {
+	case FFmpegScaleMode::Fit: {
+		// shrink destination to the aspect ratio of source
+		const auto&     Scale = FMath::Min(ScaleX, ScaleY);
+		const FIntPoint FittedSize(
+		    FMath::Max(2, FMath::RoundToInt(SrcSize.X * Scale) & ~1),
+		    FMath::Max(2, FMath::RoundToInt(SrcSize.Y * Scale) & ~1));
+		const FIntPoint Offset(((DstSize.X - FittedSize.X) / 2) & ~1,
+		                       ((DstSize.Y - FittedSize.Y) / 2) & ~1);
+
+		OutDstRegion =
+		    FIntRect(DstRect.Min + Offset,
+		             DstRect.Min + Offset + FittedSize.ComponentMin(DstSize));
+		return;
+	}
+	case FFmpegScaleMode::Fill: {
+		// crop source to the aspect ratio of destination
+		const auto&     Scale = FMath::Max(ScaleX, ScaleY);
+		const FIntPoint CroppedSize(
+		    FMath::Clamp(FMath::RoundToInt(DstSize.X / Scale), 1, SrcSize.X),
+		    FMath::Clamp(FMath::RoundToInt(DstSize.Y / Scale), 1, SrcSize.Y));
+		const FIntPoint Offset((SrcSize - CroppedSize) / 2);
+
+		OutSrcRegion = FIntRect(Offset, Offset + CroppedSize);
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+/**
+ * Get pointers to the pixel at Origin in each plane of Frame.
+ */
+void FrameDataAt(const AVFrame& Frame, const FIntPoint Origin,
+                 uint8* (&OutData)[4]) {
+	const auto& Descriptor =
+	    av_pix_fmt_desc_get(static_cast<AVPixelFormat>(Frame.format));
+	check(nullptr != Descriptor);
+
+	FMemory::Memzero(OutData);
+
+	for (int Component = 0; Component < Descriptor->nb_components;
+	     ++Component) {
+		const auto& Plane = Descriptor->comp[Component].plane;
+		if (nullptr != OutData[Plane]) {
+			continue;
+		}
+
+		// chroma planes are subsampled
+		const bool bChroma = (1 == Component || 2 == Component) &&
+		                     !(Descriptor->flags & AV_PIX_FMT_FLAG_RGB);
+		const int ShiftX = bChroma ? Descriptor->log2_chroma_w : 0;
+		const int ShiftY = bChroma ? Descriptor->log2_chroma_h : 0;
+
+		OutData[Plane] =
+		    Frame.data[Plane] +
+		    static_cast<int64>(Origin.Y >> ShiftY) * Frame.linesize[Plane] +
+		    (Origin.X >> ShiftX) * Descriptor->comp[Component].step;
+	}
+}
+} // namespace FFmpegUtilsImpl
+#pragma endregion
 
 void UFFmpegUtils::GenerateVideoFromImageFiles(
     const FString& OutputFilePath, const TArray<FString>& InputImagePaths,
@@ -15,13 +153,559 @@ void UFFmpegUtils::GenerateVideoFromImageFiles(
 	                    Open_ErrorMessage);
 	check(FFmpegEncoderOpenResult::Success == OpenResult);
 
-	for (const auto& ImagePath : InputImagePaths) {
-		FFmpegEncoderAddFrameResult AddFrame_Result;
-		FString                     AddFrame_ErrorMessage;
-		FFmpegEncoder->AddFrameFromImagePath(ImagePath, AddFrame_Result,
-		                                     AddFrame_ErrorMessage);
-		check(FFmpegEncoderAddFrameResult::Success == AddFrame_Result);
-	}
+	FFmpegEncoderAddFrameResult AddFrame_Result;
+	FString                     AddFrame_ErrorMessage;
+	FFmpegEncoder->AddFramesFromImagePaths(InputImagePaths, AddFrame_Result,
+	                                       AddFrame_ErrorMessage);
+	check(FFmpegEncoderAddFrameResult::Success == AddFrame_Result);
 
 	FFmpegEncoder->Close();
 }
+
+bool UFFmpegUtils::GenerateVideoFromImageFilesCached(
+    const FString& OutputFilePath, const TArray<FString>& InputImagePaths,
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+    const FString& CacheDirectory, int32& ReusedGops, int32& EncodedGops,
+    FString& ErrorMessage, const int32 FramesPerGop) {
+	FFFmpegGopCacheResult Result;
+	const auto&           bSucceeded = EncodeImagesWithGopCache(
+	    InputImagePaths, FFmpegEncoderConfig, CacheDirectory, FramesPerGop,
+	    OutputFilePath, Result, ErrorMessage);
+	ReusedGops  = Result.ReusedGops;
+	EncodedGops = Result.EncodedGops;
+	return bSucceeded;
+}
+
+bool UFFmpegUtils::ConcatVideosByStreamCopy(
+    const TArray<FString>& InputFilePaths, const FString& OutputFilePath,
+    FString& ErrorMessage) {
+	// whole inputs one after another
+	TArray<FFFmpegStreamCopyRange> Ranges;
+	for (const auto& InputFilePath : InputFilePaths) {
+		Ranges.AddDefaulted_GetRef().InputPath = InputFilePath;
+	}
+
+	return CopyMediaByStreamCopy(Ranges, OutputFilePath, ErrorMessage);
+}
+
+bool UFFmpegUtils::TrimVideoByStreamCopy(
+    const FString& InputFilePath, const FString& OutputFilePath,
+    const float StartSeconds, const float EndSeconds,
+    float& TrimmedStartSeconds, float& TrimmedEndSeconds,
+    FString& ErrorMessage) {
+	FFFmpegStreamCopyRange Range;
+	Range.InputPath    = InputFilePath;
+	Range.StartSeconds = FMath::Max(StartSeconds, 0.0f);
+	Range.EndSeconds   = EndSeconds;
+
+	const auto& bSuccess =
+	    CopyMediaByStreamCopy(MakeArrayView(&Range, 1), OutputFilePath,
+	                          ErrorMessage);
+	TrimmedStartSeconds = Range.CopiedStartSeconds;
+	TrimmedEndSeconds   = Range.CopiedEndSeconds;
+	return bSuccess;
+}
+
+void UFFmpegUtils::PrewarmEncoders(const FFFmpegEncoderConfig& Config,
+                                   const int32                 NumEncoders) {
+	FFFmpegEncoderPool::Get().Prewarm(Config, NumEncoders);
+}
+
+void UFFmpegUtils::ReleasePrewarmedEncoders() {
+	FFFmpegEncoderPool::Get().Empty();
+}
+
+FFFmpegMemoryStats UFFmpegUtils::GetMemoryStats() {
+	return FFFmpegMemory::GetProcessUsage().GetStats();
+}
+
+const AVCodec* UFFmpegUtils::FindVideoEncoder(FFmpegVideoCodec Codec) {
+	switch (Codec) {
+	case FFmpegVideoCodec::H264:
+		return avcodec_find_encoder(AV_CODEC_ID_H264);
+	case FFmpegVideoCodec::HEVC:
+		return avcodec_find_encoder(AV_CODEC_ID_HEVC);
+	case FFmpegVideoCodec::AV1:
+		// prefer encoders that take crf and 10-bit input
+		for (const auto& Name : {"libsvtav1", "libaom-av1"}) {
+			if (const auto& Encoder = avcodec_find_encoder_by_name(Name)) {
+				return Encoder;
+			}
+		}
+		return avcodec_find_encoder(AV_CODEC_ID_AV1);
+	default:
+		return nullptr;
+	}
+}
+
+AVCodecContext*
+    UFFmpegUtils::OpenVideoEncoder(const AVCodec&              Codec,
+                                   const FFFmpegEncoderConfig& Config) {
+	// get Codec Context
+	auto CodecContext = avcodec_alloc_context3(&Codec);
+	if (nullptr == CodecContext) {
+		return nullptr;
+	}
+
+	// FrameRate as Rational
+	const auto FrameRateAsRational = av_d2q(Config.FrameRate, INT_MAX);
+
+	// set Codec Context settings
+	CodecContext->width     = Config.Width;
+	CodecContext->height    = Config.Height;
+	CodecContext->bit_rate  = Config.BitRate;
+	CodecContext->time_base = av_inv_q(FrameRateAsRational);
+	CodecContext->framerate = FrameRateAsRational;
+
+	CodecContext->gop_size     = 300;
+	CodecContext->max_b_frames = Config.MaxBFrames;
+	CodecContext->thread_count = Config.Threads;
+	CodecContext->pix_fmt =
+	    FFFmpegColorConversion::PixelFormatOf(Config.PixelFormat);
+
+	// tag color properties of frames on the stream
+	FFFmpegColorConversion(Config).SetColorProperties(*CodecContext);
+
+	// set CRF quality value and speed preset
+	const auto&   Crf           = FString::Printf(TEXT("%g"), Config.Crf);
+	const auto    CrfInUTF8     = StringCast<UTF8CHAR>(*Crf);
+	const auto    PresetInUTF8  = StringCast<UTF8CHAR>(*Config.Preset);
+	AVDictionary* EncodeOptions = nullptr;
+	av_dict_set(&EncodeOptions, "crf",
+	            reinterpret_cast<const char*>(CrfInUTF8.Get()), 0);
+	if (!Config.Preset.IsEmpty()) {
+		av_dict_set(&EncodeOptions, "preset",
+		            reinterpret_cast<const char*>(PresetInUTF8.Get()), 0);
+	}
+
+	// make requested keyframes IDR, so that output can be split there
+	av_dict_set(&EncodeOptions, "forced-idr", "1", 0);
+
+	// emit each frame without reordering or lookahead, with keyframes often
+	// enough that receivers can join the stream
+	if (Config.bLowLatency) {
+		CodecContext->max_b_frames = 0;
+		CodecContext->gop_size =
+		    FMath::Max(1, FMath::RoundToInt32(Config.FrameRate * 2.0f));
+		CodecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+		av_dict_set(&EncodeOptions, "tune", "zerolatency", 0);
+		av_dict_set(&EncodeOptions, "lag-in-frames", "0", 0);
+	}
+
+#ifdef AV_CODEC_FLAG_COPY_OPAQUE
+	// pass the time frames are sent on to their packets, for latency stats
+	CodecContext->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+#endif
+
+	// open codec
+	const auto& OpenResult = avcodec_open2(CodecContext, &Codec, &EncodeOptions);
+	av_dict_free(&EncodeOptions);
+	if (OpenResult != 0) {
+		avcodec_free_context(&CodecContext);
+		return nullptr;
+	}
+
+	return CodecContext;
+}
+
+AVCodecContext*
+    UFFmpegUtils::OpenProxyEncoder(const FFFmpegEncoderConfig& Config) {
+	const auto& bFFV1 = FFmpegProxyCodec::FFV1 == Config.ProxyCodec;
+	const auto& Codec = bFFV1 ? avcodec_find_encoder(AV_CODEC_ID_FFV1)
+	                          : avcodec_find_encoder_by_name("libx264");
+	if (nullptr == Codec) {
+		return nullptr;
+	}
+
+	// get Codec Context
+	auto CodecContext = avcodec_alloc_context3(Codec);
+	if (nullptr == CodecContext) {
+		return nullptr;
+	}
+
+	// FrameRate as Rational
+	const auto FrameRateAsRational = av_d2q(Config.FrameRate, INT_MAX);
+
+	// set Codec Context settings, every frame is a keyframe
+	CodecContext->width        = Config.Width;
+	CodecContext->height       = Config.Height;
+	CodecContext->time_base    = av_inv_q(FrameRateAsRational);
+	CodecContext->framerate    = FrameRateAsRational;
+	CodecContext->gop_size     = 1;
+	CodecContext->max_b_frames = 0;
+	CodecContext->thread_count = Config.Threads;
+	CodecContext->pix_fmt =
+	    FFFmpegColorConversion::PixelFormatOf(Config.PixelFormat);
+
+	// tag color properties of frames on the stream
+	FFFmpegColorConversion(Config).SetColorProperties(*CodecContext);
+
+	// cheapest lossless settings
+	AVDictionary* EncodeOptions = nullptr;
+	if (bFFV1) {
+		// version 3 encodes slices in parallel
+		av_dict_set(&EncodeOptions, "level", "3", 0);
+		av_dict_set(&EncodeOptions, "slicecrc", "0", 0);
+		av_dict_set(&EncodeOptions, "coder", "rice", 0);
+	} else {
+		av_dict_set(&EncodeOptions, "preset", "ultrafast", 0);
+		av_dict_set(&EncodeOptions, "qp", "0", 0);
+	}
+
+	// open codec
+	const auto& OpenResult = avcodec_open2(CodecContext, Codec, &EncodeOptions);
+	av_dict_free(&EncodeOptions);
+	if (OpenResult != 0) {
+		avcodec_free_context(&CodecContext);
+		return nullptr;
+	}
+
+	return CodecContext;
+}
+
+AVCodecContext* UFFmpegUtils::OpenVideoDecoder(const AVStream& Stream,
+                                               const int32     Threads) {
+	const auto& Codec = avcodec_find_decoder(Stream.codecpar->codec_id);
+	if (nullptr == Codec) {
+		return nullptr;
+	}
+
+	// get Codec Context with parameters of Stream
+	auto CodecContext = avcodec_alloc_context3(Codec);
+	if (nullptr == CodecContext ||
+	    avcodec_parameters_to_context(CodecContext, Stream.codecpar) < 0) {
+		avcodec_free_context(&CodecContext);
+		return nullptr;
+	}
+
+	// decode frames and slices in parallel
+	CodecContext->thread_count = Threads;
+	CodecContext->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	CodecContext->pkt_timebase = Stream.time_base;
+
+	// open Codec
+	if (avcodec_open2(CodecContext, Codec, nullptr) < 0) {
+		avcodec_free_context(&CodecContext);
+		return nullptr;
+	}
+
+	return CodecContext;
+}
+
+int UFFmpegUtils::SwsFlagsOf(FFmpegScaleFilter ScaleFilter) noexcept {
+	switch (ScaleFilter) {
+	case FFmpegScaleFilter::FastBilinear:
+		return SWS_FAST_BILINEAR;
+	case FFmpegScaleFilter::Bicubic:
+		return SWS_BICUBIC;
+	case FFmpegScaleFilter::Area:
+		return SWS_AREA;
+	case FFmpegScaleFilter::Lanczos:
+		return SWS_LANCZOS;
+	default:
+		return SWS_BILINEAR;
+	}
+}
+
+bool UFFmpegUtils::ConvertImageIntoFrame(
+    const FImage& Image, AVFrame& Frame, const FIntRect& DstRect,
+    const FFFmpegColorConversion& ColorConversion,
+    FFmpegScaleFilter ScaleFilter, FFmpegScaleMode ScaleMode) {
+	using namespace FFmpegUtilsImpl;
+
+	const auto& PixelFormat = static_cast<AVPixelFormat>(Frame.format);
+
+	// decide which part of Image goes to which part of Frame
+	FIntRect SrcRegion;
+	FIntRect DstRegion;
+	FitRegions(ScaleMode, FIntPoint(Image.GetWidth(), Image.GetHeight()),
+	           DstRect, SrcRegion, DstRegion);
+
+	// float images and HDR output are converted without swscale
+	if (ColorConversion.RequiresLinearConversion(Image.Format, PixelFormat)) {
+		// half and float RGBA are converted as they are
+		if (Image.Format == ERawImageFormat::RGBA16F ||
+		    Image.Format == ERawImageFormat::RGBA32F) {
+			ColorConversion.ConvertLinearImage(Image, SrcRegion, Frame, DstRegion);
+			return true;
+		}
+
+		// the others are linearized first
+		LLM_SCOPE_BYTAG(BlueprintFFmpeg_Scaler);
+		FScalerImage LinearImage;
+		Image.CopyTo(LinearImage.Image, ERawImageFormat::RGBA32F,
+		             EGammaSpace::Linear);
+		LinearImage.Track();
+		ColorConversion.ConvertLinearImage(LinearImage.Image, SrcRegion, Frame,
+		                                   DstRegion);
+		return true;
+	}
+
+	// swscale can't read float images, so fall back to 8-bit
+	if (FFFmpegColorConversion::IsFloatFormat(Image.Format)) {
+		LLM_SCOPE_BYTAG(BlueprintFFmpeg_Scaler);
+		FScalerImage SRGBImage;
+		Image.CopyTo(SRGBImage.Image, ERawImageFormat::BGRA8,
+		             EGammaSpace::sRGB);
+		SRGBImage.Track();
+		return ConvertImageIntoFrame(SRGBImage.Image, Frame, DstRect,
+		                             ColorConversion, ScaleFilter, ScaleMode);
+	}
+
+	const auto& SrcFormat = FFmpegFrameFormatOf(Image.Format);
+
+	// scale and convert in one pass
+	SwsContext* SwsConvertFormatContext = GetThreadLocalSwsContext(
+	    SrcRegion.Width(), SrcRegion.Height(), SrcFormat, DstRegion.Width(),
+	    DstRegion.Height(), PixelFormat, SwsFlagsOf(ScaleFilter));
+	if (nullptr == SwsConvertFormatContext) {
+		UE_LOG(LogTemp, Error, TEXT("Failed to create SwsContext."));
+		return false;
+	}
+
+	// use the matrix tagged on the frame
+	ColorConversion.SetColorProperties(*SwsConvertFormatContext);
+
+	const auto& BytesPerPixel = Image.GetBytesPerPixel();
+	const auto& SrcStride     = Image.GetWidth() * BytesPerPixel;
+	const auto& SrcFirstPixel = Image.RawData.GetData() +
+	                            static_cast<int64>(SrcRegion.Min.Y) * SrcStride +
+	                            SrcRegion.Min.X * BytesPerPixel;
+	const uint8_t* SrcData[4]     = {SrcFirstPixel, nullptr, nullptr, nullptr};
+	const int      SrcLineSize[4] = {static_cast<int>(SrcStride), 0, 0, 0};
+
+	uint8* DstData[4];
+	FrameDataAt(Frame, DstRegion.Min, DstData);
+
+	sws_scale(SwsConvertFormatContext, SrcData, SrcLineSize, 0,
+	          SrcRegion.Height(), DstData, Frame.linesize);
+
+	return true;
+}
+
+bool UFFmpegUtils::ConvertFrameIntoImage(const AVFrame&          Frame,
+                                         FImage&                 Image,
+                                         const FFmpegScaleFilter ScaleFilter) {
+	using namespace FFmpegUtilsImpl;
+
+	SwsContext* SwsConvertFormatContext = GetThreadLocalSwsContext(
+	    Frame.width, Frame.height, static_cast<AVPixelFormat>(Frame.format),
+	    Image.GetWidth(), Image.GetHeight(), AV_PIX_FMT_BGRA,
+	    SwsFlagsOf(ScaleFilter));
+	if (nullptr == SwsConvertFormatContext) {
+		UE_LOG(LogTemp, Error, TEXT("Failed to create SwsContext."));
+		return false;
+	}
+
+	// untagged streams are taken as BT.709, as UFFmpegEncoder writes
+	const auto& Colorspace = AVCOL_SPC_UNSPECIFIED == Frame.colorspace
+	                             ? SWS_CS_ITU709
+	                             : static_cast<int>(Frame.colorspace);
+	sws_setColorspaceDetails(
+	    SwsConvertFormatContext, sws_getCoefficients(Colorspace),
+	    AVCOL_RANGE_JPEG == Frame.color_range,
+	    sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+
+	uint8* const DstData[]     = {Image.RawData.GetData()};
+	const int    DstLinesize[] = {Image.GetWidth() * 4};
+	return sws_scale(SwsConvertFormatContext, Frame.data, Frame.linesize, 0,
+	                 Frame.height, DstData, DstLinesize) > 0;
+}
+
+bool UFFmpegUtils::ConvertBandsIntoFrame(
+    AVFrame& Frame, const int32 BandHeight,
+    const FFFmpegColorConversion&                              ColorConversion,
+    TFunctionRef<bool(const FIntRect& BandRect, FImage& Band)> ReadBand) {
+	// band recycled between bands and frames of this thread
+	LLM_SCOPE_BYTAG(BlueprintFFmpeg_Scaler);
+	thread_local FImage Band;
+
+	// even rows keep 4:2:0 chroma of each band whole
+	const auto& RowsPerBand = FMath::Max(2, (BandHeight + 1) & ~1);
+
+	for (int32 Top = 0; Top < Frame.height; Top += RowsPerBand) {
+		const FIntRect BandRect(0, Top, Frame.width,
+		                        FMath::Min(Top + RowsPerBand, Frame.height));
+		if (!ReadBand(BandRect, Band)) {
+			return false;
+		}
+
+		// same size as the region, so converted without scaling
+		if (!ConvertImageIntoFrame(Band, Frame, BandRect, ColorConversion)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool UFFmpegUtils::ConvertImagesIntoTiles(
+    TConstArrayView<const FImage*> Images, TConstArrayView<FIntRect> Tiles,
+    AVFrame& Frame, const FFFmpegColorConversion& ColorConversion,
+    const FFmpegScaleFilter ScaleFilter, const FFmpegScaleMode ScaleMode,
+    const EParallelForFlags Flags) {
+	check(Images.Num() == Tiles.Num());
+
+	// tiles are disjoint, so each is written by its own worker through the
+	// scaler of that thread
+	std::atomic_bool bSucceeded = true;
+	ParallelFor(
+	    Images.Num(),
+	    [&](const int32 Index) {
+		    const auto& Image = Images[Index];
+		    if (nullptr == Image || 0 == Image->GetNumPixels()) {
+			    return;
+		    }
+		    if (!ConvertImageIntoFrame(*Image, Frame, Tiles[Index],
+		                               ColorConversion, ScaleFilter,
+		                               ScaleMode)) {
+			    bSucceeded = false;
+		    }
+	    },
+	    Flags);
+
+	return bSucceeded;
+}
+
+TArray<FFFmpegBandMemory>
+    UFFmpegUtils::MeasureBandMemory(const FFFmpegEncoderConfig& Config,
+                                    const int32                 BandHeight) {
+	TArray<FFFmpegBandMemory> Results;
+
+	// nothing to measure
+	if (Config.Width <= 0 || Config.Height <= 0) {
+		return Results;
+	}
+
+	// render target as the encoder reads it, created on the render thread
+	const auto&              bReadFloat = Config.IsHighPrecision();
+	TPromise<FTextureRHIRef> Texture_Promise;
+	auto                     Texture_Future = Texture_Promise.GetFuture();
+	ENQUEUE_RENDER_COMMAND(CreateBandMemoryTexture)
+	([&](FRHICommandListImmediate&) {
+		Texture_Promise.SetValue(RHICreateTexture(
+		    FRHITextureCreateDesc::Create2D(
+		        TEXT("FFmpegBandMemory"), Config.Width, Config.Height,
+		        bReadFloat ? PF_FloatRGBA : PF_B8G8R8A8)
+		        .SetFlags(ETextureCreateFlags::RenderTargetable |
+		                  ETextureCreateFlags::ShaderResource)
+		        .SetInitialState(ERHIAccess::SRVMask)));
+	});
+	const auto& TextureRHI = Texture_Future.Get();
+
+	// used physical memory is sampled where allocations are alive
+	const auto& UsedMemory = []() {
+		return FPlatformMemory::GetStats().UsedPhysical;
+	};
+
+	// bands first, so that memory freed by whole frames doesn't hide theirs
+	for (const auto& RowsPerBand : {BandHeight, 0}) {
+		const auto& BaseMemory = UsedMemory();
+		auto        PeakMemory = BaseMemory;
+
+		const auto& StartSeconds = FPlatformTime::Seconds();
+		if (RowsPerBand > 0) {
+			// snapshot and read back band by band, as AddFrame does
+			auto BandConfig       = Config;
+			BandConfig.BandHeight = RowsPerBand;
+			auto Snapshot         = SnapshotTextureRHIAsync(TextureRHI).Get();
+			{
+				const auto& Reader =
+				    FTextureBandReader::Create(Snapshot, bReadFloat);
+				const auto& Frame = CreateFrameInBands(
+				    0, BandConfig, [&](const FIntRect& BandRect, FImage& Band) {
+					    const auto& bRead =
+					        Reader ? Reader->ReadIntoImage(BandRect, Band)
+					               : ReadTextureRHIIntoImage(
+					                     Snapshot, BandRect, bReadFloat, Band);
+					    PeakMemory = FMath::Max(PeakMemory, UsedMemory());
+					    return bRead;
+				    });
+				PeakMemory = FMath::Max(PeakMemory, UsedMemory());
+			}
+			ReleaseTextureSnapshot(MoveTemp(Snapshot));
+		} else {
+			// whole image read back resides with the frame
+			const auto& Image =
+			    CreateImageFromTextureRHIAsync(TextureRHI, bReadFloat)
+			        .GetResult();
+			const auto& Frame = CreateFrame(Image, 0, Config);
+			PeakMemory        = FMath::Max(PeakMemory, UsedMemory());
+		}
+		const auto& ElapsedSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		auto& Result         = Results.AddDefaulted_GetRef();
+		Result.BandHeight    = RowsPerBand;
+		Result.PeakMegabytes = (PeakMemory - BaseMemory) / (1024.0f * 1024.0f);
+		Result.MillisecondsPerFrame = static_cast<float>(ElapsedSeconds * 1000.0);
+
+		UE_LOG(LogFFmpegEncoder, Log,
+		       TEXT("band height %d: peak %.1f MB, %.2f ms/frame"),
+		       Result.BandHeight, Result.PeakMegabytes,
+		       Result.MillisecondsPerFrame);
+	}
+
+	return Results;
+}
+
+TArray<FFFmpegScaleThroughput> UFFmpegUtils::MeasureScaleThroughput(
+    int32 SourceWidth, int32 SourceHeight,
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig, int32 NumFrames) {
+	TArray<FFFmpegScaleThroughput> Results;
+
+	// nothing to time
+	if (NumFrames <= 0 || SourceWidth <= 0 || SourceHeight <= 0) {
+		return Results;
+	}
+
+	// synthetic source with gradients, so that filters have work to do
+	FImage Image(SourceWidth, SourceHeight, ERawImageFormat::BGRA8,
+	             EGammaSpace::sRGB);
+	const auto& Colors = Image.AsBGRA8();
+	for (int32 Y = 0; Y < SourceHeight; ++Y) {
+		for (int32 X = 0; X < SourceWidth; ++X) {
+			Colors[Y * SourceWidth + X] =
+			    FColor(X * 255 / SourceWidth, Y * 255 / SourceHeight,
+			           (X ^ Y) & 0xFF, 255);
+		}
+	}
+
+	// one frame is reused, so that only conversion is measured
+	const auto& Frame = CreateFrame(Image, 0, FFmpegEncoderConfig);
+	if (!Frame || nullptr == Frame->data[0]) {
+		return Results;
+	}
+
+	const FFFmpegColorConversion ColorConversion(FFmpegEncoderConfig);
+	const FIntRect               FrameRect(0, 0, Frame->width, Frame->height);
+
+	for (const auto& ScaleFilter :
+	     {FFmpegScaleFilter::FastBilinear, FFmpegScaleFilter::Bilinear,
+	      FFmpegScaleFilter::Bicubic, FFmpegScaleFilter::Area,
+	      FFmpegScaleFilter::Lanczos}) {
+		// warm up the scaler of this thread
+		ConvertImageIntoFrame(Image, *Frame, FrameRect, ColorConversion,
+		                      ScaleFilter, FFmpegEncoderConfig.ScaleMode);
+
+		const auto& StartSeconds = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumFrames; ++Index) {
+			ConvertImageIntoFrame(Image, *Frame, FrameRect, ColorConversion,
+			                      ScaleFilter, FFmpegEncoderConfig.ScaleMode);
+		}
+		const auto& ElapsedSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+		auto& Result                = Results.AddDefaulted_GetRef();
+		Result.ScaleFilter          = ScaleFilter;
+		Result.MillisecondsPerFrame =
+		    static_cast<float>(ElapsedSeconds * 1000.0 / NumFrames);
+		Result.MegapixelsPerSecond = static_cast<float>(
+		    static_cast<double>(SourceWidth) * SourceHeight * NumFrames /
+		    FMath::Max(ElapsedSeconds, 1e-9) / 1e6);
+
+		UE_LOG(LogFFmpegEncoder, Log, TEXT("%s: %.2f ms/frame, %.1f Mpx/s"),
+		       *UEnum::GetValueAsString(ScaleFilter),
+		       Result.MillisecondsPerFrame, Result.MegapixelsPerSecond);
+	}
+
+	return Results;
+}
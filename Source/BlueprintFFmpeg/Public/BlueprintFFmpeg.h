@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+class IConsoleObject;
+
 class FBlueprintFFmpegModule : public IModuleInterface
 {
 public:
@@ -12,4 +14,8 @@ public:
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+private:
+	/** FFmpeg.MemReport console command */
+	IConsoleObject* MemReportCommand = nullptr;
 };
@@ -2,21 +2,160 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "RHIGPUReadback.h"
 
 /**
  * @param TextureRHI   Source TextureRHI from which the image is created.
+ * @param bReadFloat   Read float textures into a linear RGBA16F image instead
+ *                     of a BGRA8 image.
  * @return   task to create image
  */
 template <typename FTextureRHIRef_T>
   requires std::is_same_v<FTextureRHIRef, std::remove_cvref_t<FTextureRHIRef_T>>
 UE::Tasks::TTask<FImage>
-    CreateImageFromTextureRHIAsync(FTextureRHIRef_T&& TextureRHI);
+    CreateImageFromTextureRHIAsync(FTextureRHIRef_T&& TextureRHI,
+                                   bool               bReadFloat = false);
+
+/**
+ * Read pixels of TextureRHI on the render thread and wait for them.
+ * Must not be called on the render thread.
+ * @tparam FColor_T   FColor or FFloat16Color
+ * @param Rect   region to read.
+ * @return   pixels of Rect, fewer if reading failed.
+ */
+template <typename FColor_T>
+TArray<FColor_T> ReadTextureRHI(FTextureRHIRef TextureRHI, FIntRect Rect);
+
+/**
+ * Read pixels of TextureRHI into Image, reusing the allocation of Image.
+ * Must not be called on the render thread.
+ * @param Rect   region to read. Image becomes its size.
+ * @param bReadFloat   Read float textures into a linear RGBA16F image instead
+ *                     of a BGRA8 image.
+ * @return   whether all pixels of Rect were read. Image is emptied if not.
+ */
+BLUEPRINTFFMPEG_API bool ReadTextureRHIIntoImage(FTextureRHIRef TextureRHI,
+                                                 FIntRect       Rect,
+                                                 bool           bReadFloat,
+                                                 FImage&        Image);
+
+/**
+ * Reader of regions of a texture, such as bands of a frame. Each region is
+ * copied on the GPU into a staging texture of the size of the largest
+ * region so far, and read back once the fence of the copy signals, without
+ * waiting for the GPU to become idle. Staging textures are pooled, so that
+ * bands and frames of the same size reuse them.
+ */
+class BLUEPRINTFFMPEG_API FTextureBandReader {
+	// public functions
+public:
+	/**
+	 * @param bReadFloat   Read float textures as a linear RGBA16F image
+	 *                     instead of a BGRA8 image.
+	 * @return   nullptr if the format of TextureRHI can't be copied into an
+	 *           image as it is, to read it with ReadTextureRHIIntoImage.
+	 */
+	static TUniquePtr<FTextureBandReader> Create(FTextureRHIRef TextureRHI,
+	                                             bool           bReadFloat);
+
+	/**
+	 * Read the rows of Rect into Image, reusing the allocation of Image, and
+	 * wait for them. Must not be called on the render thread.
+	 * @return   whether Rect is inside the texture and was read back before
+	 *           the timeout.
+	 */
+	bool ReadIntoImage(const FIntRect& Rect, FImage& Image);
+
+	/**
+	 * Return the staging texture to the pool.
+	 */
+	~FTextureBandReader();
+
+	// private functions
+private:
+	FTextureBandReader() = default;
+
+	// private constants
+private:
+	// time to wait for a copy at most, after which the read fails
+	static constexpr double TimeoutSeconds = 1.0;
+
+	// interval of polling the fence of a copy
+	static constexpr float PollSeconds = 0.0005f;
+
+	// private fields
+private:
+	FTextureRHIRef                     TextureRHI;
+	TUniquePtr<FRHIGPUTextureReadback> Readback;
+	FIntPoint                          CopySize      = FIntPoint::ZeroValue;
+	int32                              BytesPerPixel = 0;
+	ERawImageFormat::Type              Format        = ERawImageFormat::BGRA8;
+	EGammaSpace                        GammaSpace    = EGammaSpace::sRGB;
+
+	// whether a copy timed out, which the GPU may still write
+	bool bTimedOut = false;
+};
+
+/**
+ * Copy TextureRHI on the GPU, so that it can be read later even if
+ * TextureRHI is rendered again. Call on the game thread, the copy is ordered
+ * with rendering enqueued so far.
+ * Copies are pooled, return them with ReleaseTextureSnapshot.
+ * @return   future of the copy.
+ */
+BLUEPRINTFFMPEG_API TSharedFuture<FTextureRHIRef>
+    SnapshotTextureRHIAsync(FTextureRHIRef TextureRHI);
+
+/**
+ * Return a copy made by SnapshotTextureRHIAsync to the pool.
+ */
+BLUEPRINTFFMPEG_API void ReleaseTextureSnapshot(FTextureRHIRef&& Snapshot);
 
 #pragma region definition of template functions
+template <typename FColor_T>
+TArray<FColor_T> ReadTextureRHI(FTextureRHIRef TextureRHI, FIntRect Rect) {
+	// pre allocate array of Color
+	TArray<FColor_T> ColorArray_Pre;
+
+	// ColorArray.Num() becomes Width * Height
+	ColorArray_Pre.Reserve(Rect.Area());
+
+	// make promise to store Color
+	TPromise<TArray<FColor_T>> Color_Promise;
+	auto                       Color_Future = Color_Promise.GetFuture();
+
+	// On Render Thread
+	ENQUEUE_RENDER_COMMAND(ReadTexture)
+	([&](FRHICommandListImmediate& RHICmdList) mutable {
+		// create settings
+		FReadSurfaceDataFlags ReadSurfaceDataFlags;
+
+		// assume color space of TextureRHI is gamma space
+		ReadSurfaceDataFlags.SetLinearToGamma(false);
+
+		// read texture color data to ColorArray_Pre
+		if constexpr (std::is_same_v<FColor_T, FFloat16Color>) {
+			RHICmdList.ReadSurfaceFloatData(MoveTemp(TextureRHI), Rect,
+			                                ColorArray_Pre, ReadSurfaceDataFlags);
+		} else {
+			RHICmdList.ReadSurfaceData(MoveTemp(TextureRHI), Rect, ColorArray_Pre,
+			                           ReadSurfaceDataFlags);
+		}
+
+		// Store Color and delivers on promise
+		Color_Promise.EmplaceValue(MoveTemp(ColorArray_Pre));
+	});
+
+	// get array of Color, which the caller checks to be packed with all
+	// pixels of Rect
+	return Color_Future.Consume();
+}
+
 template <typename FTextureRHIRef_T>
   requires std::is_same_v<FTextureRHIRef, std::remove_cvref_t<FTextureRHIRef_T>>
 UE::Tasks::TTask<FImage>
-    CreateImageFromTextureRHIAsync(FTextureRHIRef_T&& TextureRHI) {
+    CreateImageFromTextureRHIAsync(FTextureRHIRef_T&& TextureRHI,
+                                   const bool         bReadFloat) {
 	namespace Tasks = UE::Tasks;
 
 	// wait to ReadSurfaceData in GameThread
@@ -89,60 +228,18 @@ UE::Tasks::TTask<FImage>
 #elif true
 	return Tasks::Launch(
 	    UE_SOURCE_LOCATION,
-	    [TextureRHI = Forward<FTextureRHIRef_T>(TextureRHI)]() mutable {
+	    [TextureRHI = Forward<FTextureRHIRef_T>(TextureRHI),
+	     bReadFloat]() mutable {
 		    // get description of source texture RHI
 		    const auto& Desc = TextureRHI->GetDesc();
 
-		    // get Width
-		    const auto& Width = Desc.Extent.X;
-
-		    // get Height
-		    const auto& Height = Desc.Extent.Y;
-
-		    // get PixelFormat
-		    const auto& PixelFormat = Desc.Format;
-
-		    // pre allocate array of Color
-		    TArray<FColor> ColorArray_Pre;
-
-		    // ColorArray.Num() becomes Width * Height
-		    ColorArray_Pre.Reserve(Width * Height);
-
-		    // make promise to store Color
-		    TPromise<TArray<FColor>> Color_Promise;
-		    auto                     Color_Future = Color_Promise.GetFuture();
-
-		    // On Render Thread
-		    ENQUEUE_RENDER_COMMAND(ReadTexture)
-		    ([&](FRHICommandListImmediate& RHICmdList) mutable {
-			    // create settings
-			    FReadSurfaceDataFlags ReadSurfaceDataFlags;
-
-			    // assume color space of TextureRHI is gamma space
-			    ReadSurfaceDataFlags.SetLinearToGamma(false);
+		    // whole texture
+		    const FIntRect Rect(0, 0, Desc.Extent.X, Desc.Extent.Y);
 
-			    // read texture color data to ColorArray_Pre
-			    RHICmdList.ReadSurfaceData(MoveTemp(TextureRHI),
-			                               FIntRect(0, 0, Width, Height),
-			                               ColorArray_Pre, ReadSurfaceDataFlags);
-
-			    // Store Color and delivers on promise
-			    Color_Promise.EmplaceValue(MoveTemp(ColorArray_Pre));
-		    });
-
-		    // get array of Color
-		    auto&& ColorArray = Color_Future.Consume();
-
-		    // ColorArray should be packed with all the pixel information without
-		    // wasting a single byte.
-		    check(Width * Height == ColorArray.Num());
-
-		    // initialize OutImage
-		    FImage OutImage(Width, Height, ERawImageFormat::BGRA8);
-
-		    // copy ColorArray to OutImage
-		    FMemory::Memcpy(OutImage.RawData.GetData(), ColorArray.GetData(),
-		                    ColorArray.Num() * sizeof(FColor));
+		    // read texture into OutImage
+		    FImage OutImage;
+		    ReadTextureRHIIntoImage(MoveTemp(TextureRHI), Rect, bReadFloat,
+		                            OutImage);
 
 		    return OutImage;
 	    },
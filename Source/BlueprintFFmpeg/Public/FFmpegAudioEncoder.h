@@ -0,0 +1,186 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "FFmpegMemory.h"
+
+#include <atomic>
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+/**
+ * Single-producer, single-consumer ring of interleaved PCM samples.
+ * Push and Pop neither allocate nor block, so that the audio render thread
+ * can submit samples while the encode thread takes them.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegPCMRing {
+	// public functions
+public:
+	/**
+	 * Allocate the ring. Not thread-safe.
+	 * @param NumFrames   sample frames the ring holds.
+	 * @param NumChannels   samples per sample frame.
+	 */
+	void Init(int32 NumFrames, int32 NumChannels);
+
+	/**
+	 * Append whole sample frames of Samples that fit. Producer only.
+	 * @return   samples appended.
+	 */
+	int32 Push(TConstArrayView<float> Samples);
+
+	/**
+	 * Append up to NumFrames sample frames of silence that fit. Producer
+	 * only.
+	 * @return   sample frames appended.
+	 */
+	int32 PushSilence(int32 NumFrames);
+
+	/**
+	 * Take samples from the front into Samples. Consumer only.
+	 * @return   samples taken.
+	 */
+	int32 Pop(TArrayView<float> Samples);
+
+	/**
+	 * @return   samples in the ring. exact for the consumer.
+	 */
+	int32 Num() const;
+
+	/**
+	 * @return   bytes of the ring.
+	 */
+	SIZE_T GetAllocatedSize() const { return Buffer.GetAllocatedSize(); }
+
+	// private fields: no data race
+private:
+	TArray<float> Buffer;
+	int32         NumChannels = 1;
+
+	// private fields: beware of data race
+private:
+	// samples pushed and popped so far, wrapped by the size of Buffer
+	std::atomic<uint64> PushedSamples = 0;
+	std::atomic<uint64> PoppedSamples = 0;
+};
+
+/**
+ * Encoder of an audio track submitted as interleaved float PCM from any
+ * single thread, such as the audio render thread. Samples are encoded on
+ * the encode thread with timestamps counted in samples, and kept in step
+ * with the video clock: silence fills gaps where submission falls behind,
+ * and samples submitted with their capture time are placed at it, so that
+ * samples arriving after silence was padded for them are dropped.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegAudioEncoder {
+	// public functions
+public:
+	FFFmpegAudioEncoder() = default;
+
+	FFFmpegAudioEncoder(const FFFmpegAudioEncoder&)            = delete;
+	FFFmpegAudioEncoder& operator=(const FFFmpegAudioEncoder&) = delete;
+
+	~FFFmpegAudioEncoder();
+
+	/**
+	 * Open the encoder of the audio settings of FFmpegEncoderConfig. Its
+	 * buffers are counted for the FFFmpegMemoryScope of the calling thread.
+	 * @return   whether it was opened.
+	 */
+	bool Open(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	          FString&                    ErrorMessage);
+
+	/**
+	 * @return   opened encoder, to open the output with.
+	 */
+	const AVCodecContext* GetCodecContext() const { return CodecContext; }
+
+	/**
+	 * Submit interleaved samples in the configured sample rate and number
+	 * of channels. Never allocates nor blocks. Samples that don't fit in
+	 * the ring are dropped.
+	 * @param CaptureSeconds   time of the first sample on the video clock,
+	 *                         where frame N is at N / FrameRate. samples
+	 *                         follow the previous ones if negative.
+	 * @return   whether all samples were submitted.
+	 */
+	bool AddSamples(TConstArrayView<float> InterleavedSamples,
+	                double                 CaptureSeconds = -1.0);
+
+	/**
+	 * Encode samples submitted so far on the encode thread.
+	 * @param VideoSeconds   time of the video encoded so far. silence is
+	 *                       encoded where audio lags behind it further
+	 *                       than the ring can be late.
+	 * @param WritePacket   receives each encoded packet.
+	 * @return   whether all packets were encoded and written.
+	 */
+	bool Encode(double                               VideoSeconds,
+	            TFunctionRef<bool(AVPacket& Packet)> WritePacket);
+
+	/**
+	 * Encode the rest of the samples and drain the encoder.
+	 */
+	bool Flush(TFunctionRef<bool(AVPacket& Packet)> WritePacket);
+
+	/**
+	 * Fill audio fields of Stats. can be called from any thread.
+	 */
+	void GetStats(FFFmpegEncoderStats& Stats) const;
+
+	// private functions
+private:
+	/**
+	 * Encode full frames of samples in Ring, keeping the rest in Pending.
+	 */
+	bool EncodeSubmitted(TFunctionRef<bool(AVPacket& Packet)> WritePacket);
+
+	/**
+	 * Convert NumFrames sample frames of Samples into Frame and encode it.
+	 */
+	bool EncodeSamples(const float* Samples, int32 NumFrames,
+	                   TFunctionRef<bool(AVPacket& Packet)> WritePacket);
+
+	/**
+	 * Receive packets of the encoder into WritePacket.
+	 */
+	bool ReceivePackets(TFunctionRef<bool(AVPacket& Packet)> WritePacket);
+
+	// private fields: no data race
+private:
+	AVCodecContext* CodecContext = nullptr;
+	AVFrame*        Frame        = nullptr;
+	AVPacket*       Packet       = nullptr;
+	int32           NumChannels  = 0;
+	int32           SampleRate   = 0;
+
+	// sample frames per encoded frame
+	int32 FrameSize = 0;
+
+	// samples of the next encoded frame, taken from Ring
+	TArray<float> Pending;
+	int32         NumPending = 0;
+
+	// sample frames sent to the encoder, which is the next pts
+	int64 EncodedFrames = 0;
+
+	// buffers counted as codec memory, for the encoder that opened this
+	FFFmpegMemoryUsagePtr MemoryUsage;
+	int64                 TrackedBytes = 0;
+
+	// private fields: beware of data race
+private:
+	FFFmpegPCMRing Ring;
+
+	// counters of the submitting thread and the encode thread. OwedFrames
+	// is silence padded for samples not submitted yet
+	std::atomic<int64>  SubmittedFrames = 0;
+	std::atomic<int64>  DroppedFrames   = 0;
+	std::atomic<int64>  SilentFrames    = 0;
+	std::atomic<int32>  Underruns       = 0;
+	std::atomic<int64>  OwedFrames      = 0;
+	std::atomic<double> DriftSeconds    = 0.0;
+};
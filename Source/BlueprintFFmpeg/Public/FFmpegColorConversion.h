@@ -0,0 +1,118 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "ImageCore.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+struct AVCodecContext;
+struct SwsContext;
+
+/**
+ * Color pipeline of output media.
+ * Converts linear float images straight to 8/10-bit YUV with tone mapping
+ * and transfer function, and tags the matching color properties on frames,
+ * codec contexts and swscale contexts.
+ * Float images never go through swscale, which cannot interpret them.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegColorConversion {
+	// public functions
+public:
+	/**
+	 * SDR sRGB to 8-bit YUV420P.
+	 */
+	FFFmpegColorConversion() = default;
+
+	/**
+	 * @param FFmpegEncoderConfig   setting of output media.
+	 */
+	explicit FFFmpegColorConversion(
+	    const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * @return   FFmpeg pixel format of PixelFormat
+	 */
+	static AVPixelFormat PixelFormatOf(FFmpegPixelFormat PixelFormat) noexcept;
+
+	/**
+	 * @return   whether images of Format hold linear or HDR values that
+	 *           swscale cannot interpret.
+	 */
+	static bool IsFloatFormat(ERawImageFormat::Type Format) noexcept;
+
+	/**
+	 * @return   whether ConvertLinearImage can write frames of PixelFormat
+	 */
+	static bool CanConvertTo(AVPixelFormat PixelFormat) noexcept;
+
+	/**
+	 * @return   whether images of SrcFormat must be converted by
+	 *           ConvertLinearImage instead of swscale to write frames of
+	 *           DstFormat.
+	 */
+	bool RequiresLinearConversion(ERawImageFormat::Type SrcFormat,
+	                              AVPixelFormat         DstFormat) const;
+
+	/**
+	 * Tag color properties of this conversion on Frame.
+	 */
+	void SetColorProperties(AVFrame& Frame) const;
+
+	/**
+	 * Tag color properties of this conversion on CodecContext, so that they
+	 * are written to the stream.
+	 */
+	void SetColorProperties(AVCodecContext& CodecContext) const;
+
+	/**
+	 * Make SwsContext convert RGB to YUV with the matrix of this conversion.
+	 */
+	void SetColorProperties(SwsContext& SwsContext) const;
+
+	/**
+	 * Convert a whole linear image into a frame of the same size in parallel.
+	 * @param Image   RGBA16F or RGBA32F image of the same size as Frame.
+	 * @param Frame   allocated frame of a format that CanConvertTo accepts.
+	 */
+	void ConvertLinearImage(const FImage& Image, AVFrame& Frame) const;
+
+	/**
+	 * Scale a region of a linear image into a region of Frame and convert it
+	 * in parallel, in one pass. Scaling is bilinear.
+	 * @param Image   RGBA16F or RGBA32F image.
+	 * @param SrcRegion   region of Image to read.
+	 * @param Frame   allocated frame of a format that CanConvertTo accepts.
+	 * @param DstRegion   region of Frame to write. its origin must be even.
+	 */
+	void ConvertLinearImage(const FImage& Image, const FIntRect& SrcRegion,
+	                        AVFrame& Frame, const FIntRect& DstRegion) const;
+
+	/**
+	 * Convert rows of a linear image into Frame.
+	 * @param SrcRows   first source row.
+	 * @param SrcStride   bytes between source rows.
+	 * @param SrcFormat   RGBA16F or RGBA32F.
+	 * @param Width   pixels per row.
+	 * @param NumRows   number of rows. must be even unless the rows reach the
+	 *                  bottom of Frame.
+	 * @param DstOrigin   pixel of Frame the first source pixel goes to. must be
+	 *                    even.
+	 * @param Frame   allocated frame of a format that CanConvertTo accepts.
+	 */
+	void ConvertLinearRows(const uint8* SrcRows, int64 SrcStride,
+	                       ERawImageFormat::Type SrcFormat, int32 Width,
+	                       int32 NumRows, FIntPoint DstOrigin,
+	                       AVFrame& Frame) const;
+
+	// private fields
+private:
+	FFmpegColorTransfer ColorTransfer    = FFmpegColorTransfer::SRGB;
+	FFmpegToneMapping   ToneMapping      = FFmpegToneMapping::None;
+	float               PaperWhiteNits   = 203.0f;
+	EParallelForFlags   ParallelForFlags = EParallelForFlags::None;
+};
@@ -0,0 +1,186 @@
+
+#pragma once
+
+#include "Containers/Deque.h"
+#include "CoreMinimal.h"
+#include "FFmpegDecoderConfig.h"
+#include "ImageCore.h"
+#include "LogFFmpegEncoder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+
+struct AVCodecContext;
+struct AVFormatContext;
+
+/**
+ * A decoded frame of FFFmpegDecodeThread
+ */
+struct BLUEPRINTFFMPEG_API FFFmpegDecodedFrame {
+	/**
+	 * BGRA8 image of the configured size. return it by ReleaseImage when done.
+	 */
+	FImage Image;
+
+	/**
+	 * presentation time from the start of input media
+	 */
+	double Seconds = 0.0;
+};
+
+/**
+ * Images recycled between decoded frames. Threadsafe.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegDecodedImagePool {
+	// public functions
+public:
+	/**
+	 * @return   BGRA8 sRGB image of the size, reusing a released one.
+	 */
+	FImage Acquire(int32 Width, int32 Height);
+
+	/**
+	 * Keep Image for Acquire.
+	 */
+	void Release(FImage&& Image);
+
+	// private constants
+private:
+	static constexpr int32 MaxPooledImages = 4;
+
+	// private fields
+private:
+	std::mutex     Mutex;
+	TArray<FImage> Images;
+};
+
+/**
+ * A video decoder that uses FFmpeg, which decodes frames ahead on its thread
+ * with frame and slice threading of the codec.
+ * How to use:
+ *   1. call Open function
+ *   2. call ReadFrame function for each frames, and ReleaseImage with them
+ *   3. call Seek function to read from another time
+ *   4. call Close function
+ */
+class BLUEPRINTFFMPEG_API FFFmpegDecodeThread: public FRunnable {
+	// public functions
+public:
+	/**
+	 * Open InputFilePath and start decoding ahead.
+	 * @param FFmpegDecoderConfig   setting.
+	 * @param InputFilePath   media to decode. its first video stream is read.
+	 * @param[out] Result   result.
+	 */
+	void Open(const FFFmpegDecoderConfig& FFmpegDecoderConfig,
+	          const FString& InputFilePath, FFmpegDecoderOpenResult& Result,
+	          FString& ErrorMessage);
+
+	/**
+	 * Stop decoding.
+	 */
+	void Close();
+
+	/**
+	 * Take the next decoded frame.
+	 * @param bWait   whether to wait until a frame is decoded.
+	 * @param[out] Frame   decoded frame, on success.
+	 */
+	FFmpegDecoderReadFrameResult ReadFrame(FFFmpegDecodedFrame& Frame,
+	                                       bool bWait = false);
+
+	/**
+	 * Recycle the image of a frame taken by ReadFrame.
+	 */
+	void ReleaseImage(FImage&& Image);
+
+	/**
+	 * Discard frames decoded ahead and continue decoding from the frame at
+	 * Seconds.
+	 */
+	void Seek(double Seconds);
+
+	/**
+	 * @return   throughput and latency so far.
+	 */
+	FFFmpegDecoderStats GetStats();
+
+	/**
+	 * @return   pool of images of decoded frames, which outlives this.
+	 */
+	TSharedRef<FFFmpegDecodedImagePool, ESPMode::ThreadSafe>
+	    GetImagePool() const;
+
+	/**
+	 * @return   size of decoded images.
+	 */
+	FIntPoint GetSize() const;
+
+	/**
+	 * @return   duration of input media in seconds, 0 if unknown.
+	 */
+	double GetDuration() const;
+
+	/**
+	 * @return   frame rate of input media, 0 if unknown.
+	 */
+	double GetFrameRate() const;
+
+public:
+	~FFFmpegDecodeThread();
+
+	// FRunnable interfaces
+public:
+	virtual uint32 Run() override;
+	virtual void   Stop() override;
+
+	// private types
+private:
+	struct FPrefetchedFrame {
+		FFFmpegDecodedFrame Frame;
+		double              DecodedAt = 0.0;
+	};
+
+	// private functions
+private:
+	/**
+	 * Queue Frame unless a seek discarded it. Waits while the queue is full.
+	 * @return   whether decoding should continue.
+	 */
+	bool Prefetch(FFFmpegDecodedFrame&& Frame, uint64 Generation);
+
+	// private fields: no data race
+private:
+	bool                 bOpened = false;
+	bool                 bClosed = false;
+	FFFmpegDecoderConfig Config;
+	AVFormatContext*     FormatContext = nullptr;
+	AVCodecContext*      CodecContext  = nullptr;
+	int32                StreamIndex   = INDEX_NONE;
+	FIntPoint            Size          = FIntPoint::ZeroValue;
+	double               Duration      = 0.0;
+	double               FrameRate     = 0.0;
+	FRunnableThread*     Thread        = nullptr;
+
+	TSharedRef<FFFmpegDecodedImagePool, ESPMode::ThreadSafe> ImagePool =
+	    MakeShared<FFFmpegDecodedImagePool, ESPMode::ThreadSafe>();
+
+	// private fields: beware of data race
+private:
+	std::mutex               Frames_mutex;
+	std::condition_variable  DecodeThread_cv;
+	std::condition_variable  ReadFrame_cv;
+	TDeque<FPrefetchedFrame> Frames;
+	std::optional<double>    SeekSeconds;
+	uint64                   SeekGeneration = 0;
+	bool                     bEndOfStream   = false;
+	std::atomic_bool         bRunning       = true;
+
+	// statistics, guarded by Frames_mutex
+	int64  DecodedFrames      = 0;
+	double DecodeSeconds      = 0.0;
+	int64  ReadFrames         = 0;
+	double DecodeAheadSeconds = 0.0;
+};
@@ -0,0 +1,101 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/Texture2D.h"
+#include "FFmpegDecodeThread.h"
+#include "FFmpegDecoderConfig.h"
+
+#include "FFmpegDecoder.generated.h"
+
+/**
+ * A video decoder that uses FFmpeg and can be used from blueprint, the
+ * counterpart of UFFmpegEncoder.
+ * How to use:
+ *   1. Create instance of this class
+ *   2. call Open function
+ *   3. call ReadFrameToTexture function each tick to play the video
+ *   4. call Seek function to jump to another time
+ *   5. call Close function
+ * Frames are decoded ahead on a background thread.
+ */
+UCLASS(Blueprintable, BlueprintType)
+class BLUEPRINTFFMPEG_API UFFmpegDecoder: public UObject {
+	GENERATED_BODY()
+
+	// blueprint functions
+public:
+	/**
+	 * Open a video file and start decoding ahead.
+	 * @param FFmpegDecoderConfig   setting.
+	 * @param InputFilePath   media to decode. its first video stream is read.
+	 * @param[out] Result   result.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void Open(const FFFmpegDecoderConfig& FFmpegDecoderConfig,
+	          const FString& InputFilePath, FFmpegDecoderOpenResult& Result,
+	          FString& ErrorMessage);
+
+	/**
+	 * Stop decoding.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void Close();
+
+	/**
+	 * Upload the next decoded frame to a texture, without waiting for
+	 * decoding. The same texture is updated by following frames.
+	 * @param[out] Texture   texture of the decoded frame.
+	 * @param[out] Seconds   presentation time of the decoded frame.
+	 * @param[out] Result   result.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void ReadFrameToTexture(UTexture2D*& Texture, float& Seconds,
+	                        FFmpegDecoderReadFrameResult& Result);
+
+	/**
+	 * Discard frames decoded ahead and continue decoding from Seconds.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void Seek(float Seconds);
+
+	/**
+	 * @return   throughput and latency of decoding so far.
+	 */
+	UFUNCTION(BlueprintPure)
+	FFFmpegDecoderStats GetStats();
+
+	/**
+	 * @return   duration of input media in seconds, 0 if unknown.
+	 */
+	UFUNCTION(BlueprintPure)
+	float GetDuration() const;
+
+	/**
+	 * @return   frame rate of input media, 0 if unknown.
+	 */
+	UFUNCTION(BlueprintPure)
+	float GetFrameRate() const;
+
+	// C++ functions
+public:
+	/**
+	 * Take the next decoded frame. Return its image by ReleaseImage.
+	 * @param bWait   whether to wait until a frame is decoded.
+	 * @param[out] Frame   decoded frame, on success.
+	 */
+	FFmpegDecoderReadFrameResult ReadFrame(FFFmpegDecodedFrame& Frame,
+	                                       bool bWait = false);
+
+	/**
+	 * Recycle the image of a frame taken by ReadFrame.
+	 */
+	void ReleaseImage(FImage&& Image);
+
+	// private fields
+private:
+	FFFmpegDecodeThread FFmpegDecodeThread;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UTexture2D> FrameTexture;
+};
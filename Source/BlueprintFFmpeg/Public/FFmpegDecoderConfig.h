@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+
+#include "FFmpegDecoderConfig.generated.h"
+
+/**
+ * Result type of UFFmpegDecoder::Open
+ */
+UENUM(BlueprintType)
+enum class FFmpegDecoderOpenResult : uint8 { Success, Failure };
+
+/**
+ * Result type of UFFmpegDecoder::ReadFrame
+ */
+UENUM(BlueprintType)
+enum class FFmpegDecoderReadFrameResult : uint8 {
+	/** a frame was read */
+	Success,
+	/** the next frame is still being decoded */
+	NotReady,
+	/** all frames were read. Seek to read again */
+	EndOfStream
+};
+
+/**
+ * Structure for FFmpegDecoder settings
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegDecoderConfig {
+	GENERATED_BODY()
+
+	/**
+	 * Width of decoded images. Width of input media if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 Width = 0;
+
+	/**
+	 * Height of decoded images. Height of input media if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 Height = 0;
+
+	/**
+	 * Number of threads of the decoder, which decodes frames and slices in
+	 * parallel. Picked automatically if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 Threads = 0;
+
+	/**
+	 * Frames decoded ahead of reading
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1"))
+	int32 PrefetchFrames = 8;
+
+	/**
+	 * Filter used when decoded images differ in size from input media
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegScaleFilter ScaleFilter = FFmpegScaleFilter::Bilinear;
+};
+
+/**
+ * Throughput and latency of FFmpegDecoder
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegDecoderStats {
+	GENERATED_BODY()
+
+	/**
+	 * frames decoded and converted since Open
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 DecodedFrames = 0;
+
+	/**
+	 * frames decoded and converted per second of decoding, excluding time
+	 * waiting for the prefetch queue to drain
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float DecodeFramesPerSecond = 0.0f;
+
+	/**
+	 * frames waiting in the prefetch queue
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int32 PrefetchedFrames = 0;
+
+	/**
+	 * average time frames waited in the prefetch queue before being read, in
+	 * milliseconds
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float DecodeAheadMilliseconds = 0.0f;
+};
@@ -4,8 +4,15 @@
 #include "CoreMinimal.h"
 #include "CreateImageFromTextureRHI.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "FFmpegAudioEncoder.h"
 #include "FFmpegEncoderConfig.h"
+#include "FFmpegEncoderPool.h"
+#include "FFmpegFilterGraph.h"
+#include "FFmpegFrameAccumulator.h"
 #include "FFmpegFrameSharedPtr.h"
+#include "FFmpegFrameTrace.h"
+#include "FFmpegMemory.h"
+#include "FFmpegOutputSink.h"
 #include "FFmpegUtils.h"
 #include "LogFFmpegEncoder.h"
 
@@ -32,21 +39,17 @@ enum class FFmpegEncoderAddFrameResult : uint8 { Success, Failure };
 
 enum class FFmpegEncoderThreadResult {
 	Success = 0,
-	CodecH264IsNotFound,
-	FailedToAllocateCodecContext,
+	CodecIsNotFound,
 	FailedToInitializeCodecContext,
-	FailedToInitializeIOContext,
-	FailedToAllocateFormatContext,
-	FailedToAddANewStream,
-	FailedToSetCodecParameters,
-	FailedToWriteHeader,
+	FailedToOpenOutput,
 
 	FailedToSendFrame,
+	FailedToFilterFrame,
 	FailedToAllocatePacket,
 	FailedToWritePacket,
 
 	FailedToFlushSendFrame,
-	FailedToWriteTrailer
+	FailedToCloseOutput
 };
 
 /**
@@ -56,13 +59,15 @@ enum class FFmpegEncoderThreadResult {
  *   2. call Open function
  *   3. call AddFrame function for each frames you want to encode
  *   4. call Close function
- * then the video is output to the OutputFilePath specified in Open function.
+ * then the video is output to the OutputFilePath specified in Open function,
+ * or to the output sink passed to it.
  */
 class BLUEPRINTFFMPEG_API FFFmpegEncodeThread: public FRunnable {
 	// type aliases
 public:
-	using TTask_Frame = UE::Tasks::TTask<FFFmpegFrameThreadSafeSharedPtr>;
-	using TTask_Image = UE::Tasks::TTask<FImage>;
+	using TTask_Frame  = UE::Tasks::TTask<FFFmpegFrameThreadSafeSharedPtr>;
+	using TTask_Frames = UE::Tasks::TTask<TArray<FFFmpegFrameThreadSafeSharedPtr>>;
+	using TTask_Image  = UE::Tasks::TTask<FImage>;
 
 	// public functions
 public:
@@ -78,32 +83,46 @@ public:
 	          const FString& OutputFilePath, FFmpegEncoderOpenResult& Result,
 	          FString& ErrorMessage);
 
+	/**
+	 * Initialize and put into encoding standby status. The encoder, taken
+	 * from FFFmpegEncoderPool if warm, and InOutputSink are opened before
+	 * returning, so that Result tells whether encoding can start.
+	 * @param FFmpegEncoderConfig   setting.
+	 * @param InOutputSink   destination of encoded packets, such as
+	 *                       FFFmpegMemoryOutputSink. opened on the calling
+	 *                       thread, and called on the encode thread after.
+	 * @param[out] Result   result.
+	 */
+	void Open(const FFFmpegEncoderConfig&   FFmpegEncoderConfig,
+	          TSharedRef<IFFmpegOutputSink> InOutputSink,
+	          FFmpegEncoderOpenResult& Result, FString& ErrorMessage);
+
 	/**
 	 * Terminate encoding. The encoding result is output to the file specified by
-	 * OutputFilePath of the Open function.
+	 * OutputFilePath of the Open function, or finalized by its output sink.
 	 */
 	void Close();
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	void AddFrame(const UTextureRenderTarget2D* TextureRenderTarget,
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	void AddFrame(const FString& ImagePath, FFmpegEncoderAddFrameResult& Result,
 	              FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	template <typename FTextureRHIRef_T>
 	  requires std::is_same_v<FTextureRHIRef,
@@ -112,17 +131,17 @@ public:
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	void AddFrame(const TTask_Image&           ImageTask,
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	template <typename TTaskFFFmpegFrameThreadSafeSharedPtr_T>
 	  requires std::is_same_v<
@@ -131,6 +150,94 @@ public:
 	void AddFrame(TTaskFFFmpegFrameThreadSafeSharedPtr_T&& Frame,
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
+	/**
+	 * Add frames at once. The frames get consecutive indices, are converted
+	 * in parallel, and wake the encode thread only once.
+	 * Images whose file fails to load are skipped.
+	 */
+	void AddFrames(TConstArrayView<FString>     ImagePaths,
+	               FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add frames at once. The frames get consecutive indices, are converted
+	 * in parallel, and wake the encode thread only once.
+	 */
+	void AddFrames(TArray<FImage>&& Images, FFmpegEncoderAddFrameResult& Result,
+	               FString& ErrorMessage);
+
+	/**
+	 * Add frames at once. The frames get consecutive indices, are converted
+	 * in parallel, and wake the encode thread only once.
+	 */
+	void AddFrames(TConstArrayView<TTask_Image> ImageTasks,
+	               FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add frames at once, which wake the encode thread only once.
+	 */
+	void AddFrames(TConstArrayView<TTask_Frame> Frames,
+	               FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic of Config.MosaicTiles tiles.
+	 * The mosaic is added as a frame once every tile is added, or as
+	 * Config.MosaicSyncPolicy when a tile is added again before the others.
+	 */
+	void AddMosaicTile(int32                         TileIndex,
+	                   const UTextureRenderTarget2D* TextureRenderTarget,
+	                   FFmpegEncoderAddFrameResult&  Result,
+	                   FString&                      ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic, loaded on a task.
+	 */
+	void AddMosaicTile(int32 TileIndex, const FString& ImagePath,
+	                   FFmpegEncoderAddFrameResult& Result,
+	                   FString&                     ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic.
+	 */
+	void AddMosaicTile(int32 TileIndex, const TTask_Image& ImageTask,
+	                   FFmpegEncoderAddFrameResult& Result,
+	                   FString&                     ErrorMessage);
+
+	/**
+	 * Add interleaved audio samples in the sample rate and channels of
+	 * Config, in order from a single thread such as the audio render
+	 * thread. Never allocates nor blocks.
+	 * @param CaptureSeconds   time of the first sample on the video clock,
+	 *                         where frame N is at N / FrameRate, to place
+	 *                         the samples at. they follow the previous
+	 *                         samples if negative.
+	 * @return   whether all samples were added. false if the audio track is
+	 *           disabled, or samples were dropped because encoding fell
+	 *           behind by more than AudioBufferSeconds or they were late.
+	 */
+	bool AddAudio(TConstArrayView<float> InterleavedSamples,
+	              double                 CaptureSeconds = -1.0);
+
+	/**
+	 * @return   throughput and contention of encoding so far.
+	 */
+	FFFmpegEncoderStats GetStats();
+
+	/**
+	 * @return   setting passed to Open.
+	 */
+	const FFFmpegEncoderConfig& GetConfig() const;
+
+	/**
+	 * @return   whether Open succeeded and Close isn't called yet.
+	 */
+	bool IsOpen() const;
+
+	/**
+	 * Wait for the encode thread to write the remaining frames after Close,
+	 * such as on a task, so that destruction doesn't wait for it.
+	 */
+	void WaitForCompletion();
+
 public:
 	~FFFmpegEncodeThread();
 
@@ -139,6 +246,76 @@ public:
 	virtual uint32 Run() override;
 	virtual void   Stop() override;
 
+	// private types
+private:
+	/**
+	 * Item of the queue, either a frame or a batch of frames
+	 */
+	struct FQueuedFrames {
+		TTask_Frame  Frame;
+		TTask_Frames Frames;
+	};
+
+	// private functions
+private:
+	/**
+	 * Reserve indices of NumFrames frames, launch tasks to create them in
+	 * chunks, and enqueue the chunks with a single notification.
+	 * @param CreateFrame   create the frame at BatchIndex of the batch, with
+	 *                      FrameIndex. returns a null frame to skip it.
+	 * @param Prerequisites   tasks to finish before creating frames.
+	 */
+	void AddFrameBatch(
+	    int32 NumFrames,
+	    TFunction<FFFmpegFrameThreadSafeSharedPtr(int32   BatchIndex,
+	                                              int64_t FrameIndex)>
+	                             CreateFrame,
+	    TArray<UE::Tasks::FTask> Prerequisites,
+	    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Accumulate the image of ImageTask as the next sub-frame, and enqueue
+	 * the output frame once all its sub-frames are added.
+	 */
+	void AddSubFrame(const TTask_Image&           ImageTask,
+	                 FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Enqueue the mean of the sub-frames added so far as an output frame.
+	 */
+	void ResolveSubFrames(FFmpegEncoderAddFrameResult& Result,
+	                      FString&                     ErrorMessage);
+
+	/**
+	 * Enqueue the mosaic of the tiles added so far as an output frame, with
+	 * the other tiles filled as Config.MosaicSyncPolicy.
+	 */
+	void ResolveMosaic(FFmpegEncoderAddFrameResult& Result,
+	                   FString&                     ErrorMessage);
+
+	/**
+	 * @return   event of the next added image in the trace, at the current
+	 *           time. TraceRecorder must be valid.
+	 */
+	FFFmpegTraceEvent BeginTrace(int32 TileIndex = INDEX_NONE);
+
+	/**
+	 * Record the image of ImageTask into the trace once it is ready, if
+	 * Config.TraceFilePath is set.
+	 */
+	void TraceImage(const TTask_Image& ImageTask, int32 TileIndex = INDEX_NONE);
+
+	/**
+	 * Record an image of Size and Format into the trace, which isn't read as
+	 * a whole, if Config.TraceFilePath is set.
+	 */
+	void TraceImage(FIntPoint Size, ERawImageFormat::Type Format);
+
+	/**
+	 * Wake the encode thread after enqueueing to FrameTasks.
+	 */
+	void NotifyEnqueued();
+
 	// private constants
 private:
 	static constexpr const TCHAR checkfMesNotOpened_AddFrame[] =
@@ -146,22 +323,75 @@ private:
 	static constexpr const TCHAR checkfMesClosed_AddFrame[] = TEXT(
 	    "Once Close function is called, this function can no longer be called.");
 
+	// frames created by a task of AddFrameBatch
+	static constexpr int32 FramesPerBatchTask = 32;
+
+	// interval of the encode thread draining audio between frames
+	static constexpr int32 AudioPollMilliseconds = 10;
+
 	// private fields: no data race
 private:
 	bool                 bOpened = false;
 	bool                 bClosed = false;
-	FFFmpegEncoderConfig Config;
-	FString              VideoPath;
-	int64_t              FrameIndex = 0;
-	FRunnableThread*     Thread     = nullptr;
+	FFFmpegEncoderConfig          Config;
+	TSharedPtr<IFFmpegOutputSink> OutputSink;
+	FRunnableThread*              Thread = nullptr;
+
+	// opened by Open, and used by the encode thread after
+	AVCodecContext*                 CodecContext = nullptr;
+	TUniquePtr<FFFmpegFilterGraph>  FilterGraph;
+	TUniquePtr<FFFmpegAudioEncoder> AudioEncoder;
+
+	// memory of frames, conversion and audio of this encoder, counted by
+	// FFFmpegMemoryScope on conversion tasks
+	FFFmpegMemoryUsagePtr MemoryUsage = MakeShared<FFFmpegMemoryUsage>();
+
+	// startup cost of Open
+	uint64 OpenStartCycles = 0;
+	double OpenSeconds     = 0.0;
+	bool   bPrewarmed      = false;
+
+	// sub-frames of the output frame being added, accumulated in order by
+	// a chain of tasks
+	TSharedPtr<FFFmpegFrameAccumulator, ESPMode::ThreadSafe> Accumulator;
+	int32                                                    SubFrameIndex = 0;
+	UE::Tasks::FTask                                         AccumulateTask;
+
+	// regions of the tiles of the mosaic, the last image of each tile, and
+	// whether each tile is added to the output frame being added
+	TArray<FIntRect>    MosaicRects;
+	TArray<TTask_Image> MosaicImages;
+	TBitArray<>         MosaicTilesAdded;
+
+	// trace of the added images if configured, shared with the tasks
+	// recording them, and the source of the image being added
+	TSharedPtr<FFFmpegTraceRecorder, ESPMode::ThreadSafe> TraceRecorder;
+	int64                                                 TraceIndex = 0;
+	FFmpegTraceSource TraceSource = FFmpegTraceSource::Image;
 
 	// private fields: beware of data race
 private:
 	// single-producer, single-consumer
-	TQueue<TTask_Frame, EQueueMode::Spsc> FrameTasks;
-	std::atomic_bool                      bRunning = true;
-	std::mutex                            FrameTasks_mutex;
-	std::condition_variable               EncodeThread_cv;
+	TQueue<FQueuedFrames, EQueueMode::Spsc> FrameTasks;
+	std::atomic_bool                        bRunning = true;
+	std::mutex                              FrameTasks_mutex;
+	std::condition_variable                 EncodeThread_cv;
+	double                                  NotifiedSeconds = 0.0;
+
+	// index of the next frame added, read by GetStats on any thread
+	std::atomic<int64_t> FrameIndex = 0;
+
+	// stats of the encode thread, and whether Open has published the stats
+	// it sets, as GetStats may be called while Open runs on a task
+	std::mutex Stats_mutex;
+	bool       bStatsPublished = false;
+	int64      EncodedFrames         = 0;
+	int64      ProcessedFrames       = 0;
+	double     EncodeSeconds         = 0.0;
+	double     ConversionWaitSeconds = 0.0;
+	double     WakeLatencySeconds    = 0.0;
+	int64      NumWakes              = 0;
+	double     FirstPacketSeconds    = 0.0;
 };
 
 #pragma region definition of template functions
@@ -176,9 +406,53 @@ void FFFmpegEncodeThread::AddFrame(FTextureRHIRef_T&&           TextureRHI,
 	// and Close function must not be called.
 	checkf(!bClosed, checkfMesClosed_AddFrame);
 
-	// launch task to create image
-	auto ImageTask =
-	    CreateImageFromTextureRHIAsync(Forward<FTextureRHIRef_T>(TextureRHI));
+	// images are traced as read back
+	TGuardValue<FFmpegTraceSource> TraceSourceGuard(
+	    TraceSource, FFmpegTraceSource::RenderTarget);
+
+	// sub-frames outside the shutter are not read back
+	if (Accumulator && Config.GetShutterWeight(SubFrameIndex) <= 0.0f) {
+		return AddFrame(UE::Tasks::MakeCompletedTask<FImage>(), Result,
+		                ErrorMessage);
+	}
+
+	// read in bands if configured, when no scaling nor accumulation is needed
+	const auto& Extent = TextureRHI->GetDesc().Extent;
+	if (!Accumulator && Config.BandHeight > 0 && Extent.X == Config.Width &&
+	    Extent.Y == Config.Height) {
+		// traced as bands, which no whole image is made of
+		TGuardValue<FFmpegTraceSource> BandGuard(TraceSource,
+		                                         FFmpegTraceSource::Band);
+		TraceImage(Extent, Config.IsHighPrecision() ? ERawImageFormat::RGBA16F
+		                                            : ERawImageFormat::BGRA8);
+
+		// snapshot now, so that bands aren't torn by the next render
+		auto Snapshot_Future =
+		    SnapshotTextureRHIAsync(Forward<FTextureRHIRef_T>(TextureRHI));
+
+		// launch task to read and convert bands of the snapshot
+		auto FrameTask = UE::Tasks::Launch(
+		    UE_SOURCE_LOCATION,
+		    [Snapshot_Future = MoveTemp(Snapshot_Future),
+		     FrameIndex = FrameIndex.load(), Config = Config,
+		     MemoryUsage = MemoryUsage]() {
+			    FFFmpegMemoryScope MemoryScope(MemoryUsage);
+			    auto Snapshot = Snapshot_Future.Get();
+
+			    // bands are read back through a staging texture of a band
+			    auto Frame = UFFmpegUtils::CreateFrameInBandsFromTextureRHI(
+			        Snapshot, FrameIndex, Config);
+			    ReleaseTextureSnapshot(MoveTemp(Snapshot));
+			    return Frame;
+		    },
+		    Config.GetConversionTaskPriority());
+
+		return AddFrame(MoveTemp(FrameTask), Result, ErrorMessage);
+	}
+
+	// launch task to create image, in float if output media needs precision
+	auto ImageTask = CreateImageFromTextureRHIAsync(
+	    Forward<FTextureRHIRef_T>(TextureRHI), Config.IsHighPrecision());
 
 	return AddFrame(MoveTemp(ImageTask), Result, ErrorMessage);
 }
@@ -210,7 +484,7 @@ void FFFmpegEncodeThread::AddFrame(
 
 	// enqueue frame
 	const auto& SuccessToEnqueue = FrameTasks.Enqueue(
-	    Forward<TTaskFFFmpegFrameThreadSafeSharedPtr_T>(Frame));
+	    {Forward<TTaskFFFmpegFrameThreadSafeSharedPtr_T>(Frame), {}});
 
 	// if failed to enqueue
 	if (!SuccessToEnqueue) {
@@ -221,10 +495,7 @@ void FFFmpegEncodeThread::AddFrame(
 	++FrameIndex;
 
 	// notify that a task has been enqueued to FrameTasks
-	{
-		std::lock_guard lk(FrameTasks_mutex);
-		EncodeThread_cv.notify_one();
-	}
+	NotifyEnqueued();
 
 	return Success();
 }
@@ -4,6 +4,10 @@
 #include "CoreMinimal.h"
 #include "FFmpegEncodeThread.h"
 #include "FFmpegEncoderConfig.h"
+#include "FFmpegReplayOutputSink.h"
+#include "FFmpegRotatingOutputSink.h"
+#include "FFmpegStreamOutputSink.h"
+#include "FFmpegTranscodeJob.h"
 
 #include "FFmpegEncoder.generated.h"
 
@@ -14,7 +18,8 @@
  *   2. call Open function
  *   3. call AddFrame function for each frames you want to encode
  *   4. call Close function
- * then the video is output to the OutputFilePath specified in Open function.
+ * then the video is output to the OutputFilePath specified in Open function,
+ * or to the output sink passed to it.
  */
 UCLASS(Blueprintable, BlueprintType)
 class BLUEPRINTFFMPEG_API UFFmpegEncoder: public UObject {
@@ -28,7 +33,9 @@ public:
 	// blueprint functions
 public:
 	/**
-	 * Initialize and put into encoding standby status.
+	 * Initialize and put into encoding standby status. The encoder and
+	 * output are opened before returning, so that Result tells whether
+	 * encoding can start. See UFFmpegUtils::PrewarmEncoders to open faster.
 	 * @param FFmpegEncoderConfig   setting.
 	 * @param OutputFilePath   Output destination file path.
 	 *                         The output format is determined by the
@@ -40,6 +47,108 @@ public:
 	          const FString& OutputFilePath, FFmpegEncoderOpenResult& Result,
 	          FString& ErrorMessage);
 
+	/**
+	 * Initialize and put into replay mode, which keeps the latest encoded
+	 * frames in memory instead of writing to a file. Call SaveReplay to write
+	 * them.
+	 * @param FFmpegEncoderConfig   setting.
+	 * @param ReplaySeconds   duration kept in memory.
+	 * @param MaxReplayMegabytes   upper limit of memory, unlimited if 0.
+	 * @param[out] Result   result.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void OpenReplay(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                float ReplaySeconds, int32 MaxReplayMegabytes,
+	                FFmpegEncoderOpenResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Initialize and stream live to Url in MPEG-TS, which receivers can
+	 * watch while encoding, e.g. "udp://127.0.0.1:5000" for
+	 * "ffplay udp://127.0.0.1:5000". Use with bLowLatency of
+	 * FFmpegEncoderConfig.
+	 * @param FFmpegEncoderConfig   setting.
+	 * @param Url   destination over "udp://", "tcp://", or "rtp://" for
+	 *              MPEG-TS in RTP.
+	 * @param StreamConfig   pacing, queue and reconnection setting.
+	 * @param[out] Result   result.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void OpenStream(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                const FString& Url, const FFFmpegStreamConfig& StreamConfig,
+	                FFmpegEncoderOpenResult& Result, FString& ErrorMessage);
+
+	/**
+	 * @return   delivery and latency of streaming opened by OpenStream.
+	 */
+	UFUNCTION(BlueprintPure)
+	FFFmpegStreamStats GetStreamStats();
+
+	/**
+	 * Write the latest frames kept by replay mode to a file in the
+	 * background, without interrupting encoding. Can be called after Close.
+	 * @param OutputFilePath   Output destination file path.
+	 *                         The output format is determined by the
+	 *                         extension of this path.
+	 * @param Seconds   duration to save, starting at the nearest earlier
+	 *                  keyframe. everything kept is saved if 0.
+	 * @return   whether saving started.
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool SaveReplay(const FString& OutputFilePath, float Seconds = 0.0f);
+
+	/**
+	 * Finish the current output file and continue encoding into the next one,
+	 * which starts with a keyframe. Requires Open with OutputFilePath.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RotateOutput();
+
+	/**
+	 * Transcode a proxy recorded with ProxyCodec in the background, such as
+	 * one left unfinished by an earlier run, resuming after its finished
+	 * segments. Refused while a transcode of this encoder is in flight,
+	 * until it finishes or CancelTranscode is called.
+	 * @param ProxyFilePath   proxy to transcode.
+	 * @param OutputFilePath   Output destination file path.
+	 * @param FFmpegEncoderConfig   delivery setting.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void TranscodeProxy(const FString& ProxyFilePath,
+	                    const FString& OutputFilePath,
+	                    const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Start transcoding the proxy once it is closed, when bTranscodeOnClose
+	 * is false. Requires Open with ProxyCodec.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void StartTranscode();
+
+	/**
+	 * Stop transcoding. Finished segments are kept, so that TranscodeProxy
+	 * resumes from them.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void CancelTranscode();
+
+	/**
+	 * @return   transcoded fraction of the proxy, from 0 to 1.
+	 */
+	UFUNCTION(BlueprintPure)
+	float GetTranscodeProgress() const;
+
+	/**
+	 * @return   whether the transcoded output file is written.
+	 */
+	UFUNCTION(BlueprintPure)
+	bool IsTranscodeSucceeded() const;
+
+	/**
+	 * @return   throughput and contention of encoding so far.
+	 */
+	UFUNCTION(BlueprintPure)
+	FFFmpegEncoderStats GetStats();
+
 	/**
 	 * Terminate encoding. The encoding result is output to the file specified by
 	 * OutputFilePath of the Open function.
@@ -48,9 +157,9 @@ public:
 	void Close();
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
 	void AddFrameFromRenderTarget(
@@ -58,21 +167,61 @@ public:
 	    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
 	void AddFrameFromImagePath(const FString&               ImagePath,
 	                           FFmpegEncoderAddFrameResult& Result,
 	                           FString&                     ErrorMessage);
 
+	/**
+	 * Add frames at once. The frames are converted in parallel and appended
+	 * in order, which is faster than adding them one by one.
+	 * Images whose file fails to load are skipped.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void AddFramesFromImagePaths(const TArray<FString>&       ImagePaths,
+	                             FFmpegEncoderAddFrameResult& Result,
+	                             FString&                     ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic of MosaicTiles of
+	 * FFmpegEncoderConfig, such as of one of several cameras. The mosaic is
+	 * added as a frame once every tile is added, or as MosaicSyncPolicy when
+	 * a tile is added again before the others.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void AddMosaicTileFromRenderTarget(
+	    int32 TileIndex, const UTextureRenderTarget2D* TextureRenderTarget,
+	    FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic, loaded in the background.
+	 */
+	UFUNCTION(BlueprintCallable, meta = (ExpandEnumAsExecs = "Result"))
+	void AddMosaicTileFromImagePath(int32 TileIndex, const FString& ImagePath,
+	                                FFmpegEncoderAddFrameResult& Result,
+	                                FString&                     ErrorMessage);
+
 	// C++ functions
 public:
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Initialize and put into encoding standby status.
+	 * @param FFmpegEncoderConfig   setting.
+	 * @param OutputSink   destination of encoded packets, such as
+	 *                     FFFmpegMemoryOutputSink to encode into memory.
+	 * @param[out] Result   result.
+	 */
+	void Open(const FFFmpegEncoderConfig&   FFmpegEncoderConfig,
+	          TSharedRef<IFFmpegOutputSink> OutputSink,
+	          FFmpegEncoderOpenResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	template <typename FTextureRHIRef_T>
 	  requires std::is_same_v<FTextureRHIRef,
@@ -81,17 +230,17 @@ public:
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	void AddFrame(const TTask_Image&           ImageTask,
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
 	/**
-	 * Add a frame. The argument is converted to a YUV420P format image, added as
-	 * a frame, and appended to the file immediately after the frame data is
-	 * finalized.
+	 * Add a frame. The argument is converted to a YUV image of the configured
+	 * pixel format, added as a frame, and appended to the file immediately
+	 * after the frame data is finalized.
 	 */
 	template <typename TTaskFFFmpegFrameThreadSafeSharedPtr_T>
 	  requires std::is_same_v<
@@ -100,9 +249,93 @@ public:
 	void AddFrame(TTaskFFFmpegFrameThreadSafeSharedPtr_T&& Frame,
 	              FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
 
+	/**
+	 * Add frames at once. The frames are converted in parallel and appended
+	 * in order, which is faster than adding them one by one.
+	 */
+	void AddFrames(TArray<FImage>&& Images, FFmpegEncoderAddFrameResult& Result,
+	               FString& ErrorMessage);
+
+	/**
+	 * Add frames at once. The frames are converted in parallel and appended
+	 * in order, which is faster than adding them one by one.
+	 */
+	void AddFrames(TConstArrayView<TTask_Image> ImageTasks,
+	               FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add frames at once, appended in order.
+	 */
+	void AddFrames(TConstArrayView<TTask_Frame> Frames,
+	               FFmpegEncoderAddFrameResult& Result, FString& ErrorMessage);
+
+	/**
+	 * Add the image of TileIndex of the mosaic.
+	 */
+	void AddMosaicTile(int32 TileIndex, const TTask_Image& ImageTask,
+	                   FFmpegEncoderAddFrameResult& Result,
+	                   FString&                     ErrorMessage);
+
+	/**
+	 * Add interleaved audio samples in the sample rate and channels of the
+	 * config, such as from a submix listener on the audio render thread.
+	 * Can be called from one thread at a time besides the game thread, and
+	 * never allocates nor blocks.
+	 * @param CaptureSeconds   time of the first sample on the video clock,
+	 *                         where frame N is at N / FrameRate. they
+	 *                         follow the previous samples if negative.
+	 * @return   whether all samples were added.
+	 */
+	bool AddAudio(TConstArrayView<float> InterleavedSamples,
+	              double                 CaptureSeconds = -1.0);
+
+	/**
+	 * @return   setting passed to Open.
+	 */
+	const FFFmpegEncoderConfig& GetConfig() const;
+
+	/**
+	 * @return   whether Open succeeded and Close isn't called yet.
+	 */
+	bool IsOpen() const;
+
+	/**
+	 * Launch Body on a task after the previous Body launched by this
+	 * function, so that calls into the encoder are made in order off the
+	 * game thread, such as by UFFmpegEncoderAsyncAction. Call on the game
+	 * thread, and call nothing else on the encoder until the tasks finish.
+	 * @return   task of Body.
+	 */
+	UE::Tasks::FTask LaunchInOrder(TUniqueFunction<void()>&& Body);
+
+	/**
+	 * Wait for the encoding result to be written after Close, so that
+	 * destroying the encoder doesn't wait for it.
+	 */
+	void WaitForCompletion();
+
+	// UObject interfaces
+public:
+	virtual bool IsReadyForFinishDestroy() override;
+
+	// private constants
+private:
+	// sinks and the transcode job are set by Open, which runs on a task of
+	// UFFmpegEncoderAsyncAction, so they are read once its tasks finish
+	static constexpr const TCHAR checkfMesInFlight[] =
+	    TEXT("Async nodes of this encoder must finish before this function "
+	         "is called.");
+
 	// private fields
 private:
-	FFFmpegEncodeThread FFmpegEncodeThread;
+	FFFmpegEncodeThread                   FFmpegEncodeThread;
+	TSharedPtr<FFFmpegReplayOutputSink>   ReplaySink;
+	TSharedPtr<FFFmpegRotatingOutputSink> RotatingSink;
+	TSharedPtr<FFFmpegStreamOutputSink>   StreamSink;
+	TSharedPtr<FFFmpegTranscodeJob>       TranscodeJob;
+
+	// last task launched by LaunchInOrder
+	UE::Tasks::FTask OrderedTask;
 };
 
 #pragma region definition of template functions
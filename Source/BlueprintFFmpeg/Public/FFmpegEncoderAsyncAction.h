@@ -0,0 +1,131 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoder.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+
+#include "FFmpegEncoderAsyncAction.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FFFmpegEncoderAsyncDelegate,
+                                             const FString&, ErrorMessage,
+                                             float, GameThreadMicroseconds);
+
+/**
+ * Blueprint nodes calling UFFmpegEncoder without blocking the game thread.
+ * Loading, opening, closing and waiting for the file run on tasks, in the
+ * order the nodes are executed on the same encoder, and OnSuccess or
+ * OnFailure is executed on the game thread once the call is finished.
+ * GameThreadMicroseconds is the time the node took on the game thread.
+ * How to use:
+ *   1. call Open Async, and the other nodes after it without waiting
+ *   2. call Add Frame From ... Async for each frames you want to encode
+ *   3. call Close Async, whose OnSuccess tells the file is written
+ * Don't call functions of the encoder directly while nodes are running.
+ */
+UCLASS()
+class BLUEPRINTFFMPEG_API UFFmpegEncoderAsyncAction
+    : public UBlueprintAsyncActionBase {
+	GENERATED_BODY()
+
+	// blueprint functions
+public:
+	/**
+	 * Open Encoder in the background, as UFFmpegEncoder::Open.
+	 */
+	UFUNCTION(BlueprintCallable,
+	          meta = (BlueprintInternalUseOnly = "true",
+	                  WorldContext = "WorldContextObject"))
+	static UFFmpegEncoderAsyncAction*
+	    OpenAsync(UObject* WorldContextObject, UFFmpegEncoder* Encoder,
+	              const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	              const FString&              OutputFilePath);
+
+	/**
+	 * Add a frame loaded from ImagePath in the background.
+	 */
+	UFUNCTION(BlueprintCallable,
+	          meta = (BlueprintInternalUseOnly = "true",
+	                  WorldContext = "WorldContextObject"))
+	static UFFmpegEncoderAsyncAction*
+	    AddFrameFromImagePathAsync(UObject*        WorldContextObject,
+	                               UFFmpegEncoder* Encoder,
+	                               const FString&  ImagePath);
+
+	/**
+	 * Add a frame of TextureRenderTarget as rendered so far. It is copied on
+	 * the GPU right away, and read back in the background.
+	 */
+	UFUNCTION(BlueprintCallable,
+	          meta = (BlueprintInternalUseOnly = "true",
+	                  WorldContext = "WorldContextObject"))
+	static UFFmpegEncoderAsyncAction* AddFrameFromRenderTargetAsync(
+	    UObject* WorldContextObject, UFFmpegEncoder* Encoder,
+	    const UTextureRenderTarget2D* TextureRenderTarget);
+
+	/**
+	 * Close Encoder, and wait in the background for the encoding result to
+	 * be written.
+	 */
+	UFUNCTION(BlueprintCallable,
+	          meta = (BlueprintInternalUseOnly = "true",
+	                  WorldContext = "WorldContextObject"))
+	static UFFmpegEncoderAsyncAction* CloseAsync(UObject* WorldContextObject,
+	                                             UFFmpegEncoder* Encoder);
+
+	// delegates
+public:
+	UPROPERTY(BlueprintAssignable)
+	FFFmpegEncoderAsyncDelegate OnSuccess;
+
+	UPROPERTY(BlueprintAssignable)
+	FFFmpegEncoderAsyncDelegate OnFailure;
+
+	// UBlueprintAsyncActionBase interfaces
+public:
+	virtual void Activate() override;
+	virtual bool IsReadyForFinishDestroy() override;
+
+	// private types
+private:
+	/**
+	 * Part of the call on the game thread, which launches the rest with
+	 * UFFmpegEncoder::LaunchInOrder.
+	 * @return   task of the rest, which sets bSucceeded and ErrorMessage.
+	 */
+	using FStartFunction = TUniqueFunction<UE::Tasks::FTask(
+	    UFFmpegEncoderAsyncAction& Action, UFFmpegEncoder& Encoder)>;
+
+	// private functions
+private:
+	/**
+	 * @return   action to call InStart on Encoder once activated.
+	 */
+	static UFFmpegEncoderAsyncAction* Create(UObject*        WorldContextObject,
+	                                         UFFmpegEncoder* Encoder,
+	                                         FStartFunction  InStart);
+
+	/**
+	 * Finish as failure with Message, on any thread.
+	 */
+	void Fail(const FString& Message);
+
+	/**
+	 * Execute OnSuccess or OnFailure on the game thread.
+	 */
+	void Finish();
+
+	// private fields: no data race
+private:
+	UPROPERTY()
+	TObjectPtr<UFFmpegEncoder> TargetEncoder;
+
+	FStartFunction   Start;
+	UE::Tasks::FTask Task;
+	float            GameThreadMicroseconds = 0.0f;
+
+	// private fields: written by Task, and read after it on the game thread
+private:
+	bool    bSucceeded = false;
+	FString ErrorMessage;
+};
@@ -1,10 +1,148 @@
 
 #pragma once
 
+#include "Async/ParallelFor.h"
 #include "CoreMinimal.h"
+#include "HAL/PlatformAffinity.h"
+#include "Tasks/Task.h"
 
 #include "FFmpegEncoderConfig.generated.h"
 
+/**
+ * Video codec of output media
+ */
+UENUM(BlueprintType)
+enum class FFmpegVideoCodec : uint8 { H264, HEVC, AV1 };
+
+/**
+ * Pixel format of the encoded video.
+ * 10-bit formats require an encoder built with high bit depth support.
+ */
+UENUM(BlueprintType)
+enum class FFmpegPixelFormat : uint8 {
+	/** 8-bit planar YUV 4:2:0 */
+	YUV420P,
+	/** 10-bit planar YUV 4:2:0, for libx265, libx264 (10-bit) and AV1 */
+	YUV420P10,
+	/** 10-bit semi-planar YUV 4:2:0, for hardware encoders */
+	P010
+};
+
+/**
+ * Transfer function of output media.
+ * Float source images are treated as linear and encoded with it.
+ */
+UENUM(BlueprintType)
+enum class FFmpegColorTransfer : uint8 {
+	/** sRGB curve with BT.709 primaries (SDR) */
+	SRGB,
+	/** BT.709 curve with BT.709 primaries (SDR) */
+	BT709,
+	/** SMPTE ST 2084 curve with BT.2020 primaries (HDR10) */
+	PQ
+};
+
+/**
+ * Tone mapping applied to linear source images before an SDR transfer
+ */
+UENUM(BlueprintType)
+enum class FFmpegToneMapping : uint8 { None, Reinhard, ACES };
+
+/**
+ * Filter used to scale source images to the size of output media.
+ * Ordered from fastest to sharpest.
+ */
+UENUM(BlueprintType)
+enum class FFmpegScaleFilter : uint8 {
+	FastBilinear,
+	Bilinear,
+	Bicubic,
+	Area,
+	Lanczos
+};
+
+/**
+ * How source images of another aspect ratio are fitted to output media
+ */
+UENUM(BlueprintType)
+enum class FFmpegScaleMode : uint8 {
+	/** scale to fill output media, ignoring aspect ratio */
+	Stretch,
+	/** scale to fit inside output media, padding with black (letterbox) */
+	Fit,
+	/** scale to cover output media, cropping the overflow */
+	Fill
+};
+
+/**
+ * Cheap intermediate codec encoded during capture, which is transcoded to
+ * the delivery codec afterwards
+ */
+UENUM(BlueprintType)
+enum class FFmpegProxyCodec : uint8 {
+	/** encode the delivery codec directly */
+	None,
+	/** lossless FFV1 in Matroska, lowest CPU cost */
+	FFV1,
+	/** lossless all-intra libx264 ultrafast in Matroska */
+	X264Lossless
+};
+
+/**
+ * Audio codec of output media
+ */
+UENUM(BlueprintType)
+enum class FFmpegAudioCodec : uint8 {
+	/** no audio track */
+	None,
+	/** AAC-LC, for MP4 */
+	AAC,
+	/** Opus, for Matroska and WebM */
+	Opus,
+	/** 16-bit PCM, for Matroska and MOV */
+	PCM
+};
+
+/**
+ * How tiles of a mosaic are filled when their source is late, that is when
+ * another tile is added again before them
+ */
+UENUM(BlueprintType)
+enum class FFmpegMosaicSyncPolicy : uint8 {
+	/** add the frame, holding the last image of late tiles */
+	HoldLast,
+	/** add the frame, leaving late tiles black */
+	Black,
+	/** wait for all tiles, replacing the image of tiles added again */
+	WaitForAll
+};
+
+/**
+ * Priority of threads created for encoding
+ */
+UENUM(BlueprintType)
+enum class FFmpegThreadPriority : uint8 {
+	Lowest,
+	BelowNormal,
+	Normal,
+	AboveNormal
+};
+
+/**
+ * Priority of tasks converting frames for encoding
+ */
+UENUM(BlueprintType)
+enum class FFmpegTaskPriority : uint8 {
+	/** background workers, behind other background tasks */
+	BackgroundLow,
+	/** background workers */
+	BackgroundNormal,
+	/** background workers, ahead of other background tasks */
+	BackgroundHigh,
+	/** foreground workers, which the game and render threads also wait on */
+	Normal
+};
+
 /**
  * Structure for FFmpegEncoder settings
  */
@@ -30,9 +168,458 @@ struct BLUEPRINTFFMPEG_API FFFmpegEncoderConfig {
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float FrameRate = 30.0f;
 
+	/**
+	 * Sub-frames averaged into each output frame, for motion blur. Frames
+	 * are added at FrameRate times this, and only the averaged frames are
+	 * converted and encoded. Frames added already converted are encoded as
+	 * they are.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1"))
+	int32 SubFramesPerFrame = 1;
+
+	/**
+	 * Weight of each sub-frame of an output frame in order, such as 1 for
+	 * the first half and 0 for the rest for a 180 degree shutter.
+	 * Sub-frames of weight 0 are not read back nor accumulated.
+	 * Equal if the length differs from SubFramesPerFrame.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<float> ShutterWeights;
+
 	/**
 	 * BitRate of output media
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 BitRate = 5000000;
+
+	/**
+	 * Constant rate factor of the encoder. Lower is higher quality.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.0"))
+	float Crf = 18.0f;
+
+	/**
+	 * Speed preset of the encoder, such as "veryfast" for libx264 and
+	 * libx265, or "8" for libsvtav1. The encoder default if empty.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Preset;
+
+	/**
+	 * Maximum number of consecutive B-frames
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 MaxBFrames = 12;
+
+	/**
+	 * Whether to emit each frame as soon as it is encoded, without B-frames
+	 * or lookahead, and with a keyframe every 2 seconds, for live streaming
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bLowLatency = false;
+
+	/**
+	 * Number of threads of the encoder. Picked automatically if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 Threads = 0;
+
+	/**
+	 * Filter used when source images differ in size from output media.
+	 * Float source images are always scaled bilinearly.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegScaleFilter ScaleFilter = FFmpegScaleFilter::Bilinear;
+
+	/**
+	 * How source images of another aspect ratio are fitted to output media
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegScaleMode ScaleMode = FFmpegScaleMode::Stretch;
+
+	/**
+	 * Video codec of output media
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegVideoCodec Codec = FFmpegVideoCodec::H264;
+
+	/**
+	 * Pixel format of output media
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegPixelFormat PixelFormat = FFmpegPixelFormat::YUV420P;
+
+	/**
+	 * Transfer function of output media, tagged on the stream
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegColorTransfer ColorTransfer = FFmpegColorTransfer::SRGB;
+
+	/**
+	 * Tone mapping of linear source images. Ignored for PQ.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegToneMapping ToneMapping = FFmpegToneMapping::None;
+
+	/**
+	 * Luminance in nits of linear 1.0 when encoding PQ
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1.0"))
+	float PaperWhiteNits = 203.0f;
+
+	/**
+	 * libavfilter chain applied to frames between conversion and encoding,
+	 * in the syntax of ffmpeg -vf, such as drawtext for timecode, overlay
+	 * for watermarks or lut3d for LUTs. It must keep the size of output
+	 * media. No filtering if empty.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString FilterGraph;
+
+	/**
+	 * Threads of FilterGraph. Picked automatically if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 FilterThreads = 0;
+
+	/**
+	 * Codec of the audio track, submitted with AddAudio. No audio if None.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegAudioCodec AudioCodec = FFmpegAudioCodec::None;
+
+	/**
+	 * Sample rate of submitted and encoded audio
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "8000"))
+	int32 AudioSampleRate = 48000;
+
+	/**
+	 * Channels of submitted and encoded audio
+	 */
+	UPROPERTY(EditAnywhere,
+	          BlueprintReadWrite,
+	          meta = (ClampMin = "1", ClampMax = "8"))
+	int32 AudioChannels = 2;
+
+	/**
+	 * Target bit rate of the audio track, ignored by PCM
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 AudioBitRate = 192000;
+
+	/**
+	 * Seconds of audio buffered between submission and encoding. Samples
+	 * submitted beyond it are dropped.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.1"))
+	float AudioBufferSeconds = 2.0f;
+
+	/**
+	 * Rows read back and converted at a time from render targets of the
+	 * output size, so that whole source frames never reside in memory.
+	 * Whole frames are read if 0. Helps at 8K and above.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 BandHeight = 0;
+
+	/**
+	 * Sources composed into a grid of tiles of one output frame, added with
+	 * AddMosaicTile. Each source is converted straight into its tile, in
+	 * parallel, and mosaics are not accumulated as sub-frames. No mosaic
+	 * if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 MosaicTiles = 0;
+
+	/**
+	 * Columns of the grid of MosaicTiles. The nearest square if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 MosaicColumns = 0;
+
+	/**
+	 * How tiles whose source is late are filled
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegMosaicSyncPolicy MosaicSyncPolicy = FFmpegMosaicSyncPolicy::HoldLast;
+
+	/**
+	 * Duration of each output file. Output is split into files with suffix
+	 * "_001", "_002" and so on at keyframes. Not split by duration if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.0"))
+	float RotationSeconds = 0.0f;
+
+	/**
+	 * Size of each output file in megabytes. Not split by size if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 RotationMegabytes = 0;
+
+	/**
+	 * Whether to write a keyframe index next to each output file when it is
+	 * finished, which FFFmpegKeyframeIndex and UFFmpegThumbnails read to
+	 * extract frames without scanning the file.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bWriteKeyframeIndex = false;
+
+	/**
+	 * Intermediate codec encoded during capture into "<output>.proxy.mkv",
+	 * which is transcoded in the background to the codec and quality
+	 * settings above. Encoded directly if None. Open fails if AudioCodec is
+	 * also set, as the transcode keeps only the video.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegProxyCodec ProxyCodec = FFmpegProxyCodec::None;
+
+	/**
+	 * Threads used by the background transcode of the proxy
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1"))
+	int32 TranscodeThreads = 2;
+
+	/**
+	 * Whether to start transcoding the proxy as soon as it is finished,
+	 * instead of on demand by StartTranscode
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bTranscodeOnClose = true;
+
+	/**
+	 * Priority of the encode thread, and of the codec threads it creates on
+	 * platforms where threads inherit it
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegThreadPriority EncodeThreadPriority =
+	    FFmpegThreadPriority::BelowNormal;
+
+	/**
+	 * Cores the encode and transcode threads may run on, a bit per core.
+	 * Codec threads inherit it on platforms where threads inherit affinity.
+	 * If 0, cores of the game, render and RHI threads are left out.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int64 EncodeAffinityMask = 0;
+
+	/**
+	 * Priority of tasks converting images into frames
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FFmpegTaskPriority ConversionPriority =
+	    FFmpegTaskPriority::BackgroundNormal;
+
+	/**
+	 * File to record a trace of the added images into, with their timing,
+	 * source, size and format, which the FFmpegReplay commandlet replays
+	 * offline. Not recorded if empty.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString TraceFilePath;
+
+	/**
+	 * Whether to record the pixels of the added images into the trace too,
+	 * compressed. Otherwise synthetic images are replayed.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bTracePayload = false;
+
+public:
+	/**
+	 * @return   whether output media has more than 8 bits per component or HDR
+	 *           transfer, so that render targets must be read back in float.
+	 */
+	bool IsHighPrecision() const;
+
+	/**
+	 * @return   weight of the sub-frame at SubFrameIndex of an output frame.
+	 */
+	float GetShutterWeight(int32 SubFrameIndex) const;
+
+	/**
+	 * @return   region of each of MosaicTiles in output media, row by row,
+	 *           with even origins and sizes.
+	 */
+	TArray<FIntRect> GetMosaicTileRects() const;
+
+	/**
+	 * @return   EncodeThreadPriority for FRunnableThread.
+	 */
+	EThreadPriority GetEncodeThreadPriority() const;
+
+	/**
+	 * @return   EncodeAffinityMask, or the default mask if 0.
+	 */
+	uint64 GetEncodeAffinityMask() const;
+
+	/**
+	 * @return   ConversionPriority for UE::Tasks::Launch.
+	 */
+	LowLevelTasks::ETaskPriority GetConversionTaskPriority() const;
+
+	/**
+	 * @return   flags for ParallelFor within conversion tasks.
+	 */
+	EParallelForFlags GetConversionParallelForFlags() const;
+};
+
+/**
+ * Bytes of memory held by FFmpeg encoding, by category. Frames are
+ * allocated through the engine allocator by FFFmpegMemory, the others are
+ * buffers of the plugin around FFmpeg. Memory that libavcodec, libavformat
+ * and libswscale allocate internally is not included.
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegMemoryStats {
+	GENERATED_BODY()
+
+	/**
+	 * converted frames waiting for or being encoded
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 FrameBytes = 0;
+
+	/**
+	 * buffers of encoders, such as the audio sample ring
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 CodecBytes = 0;
+
+	/**
+	 * muxed output held in memory or queued for the network
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 MuxBytes = 0;
+
+	/**
+	 * intermediate images of scaling and conversion
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 ScalerBytes = 0;
+
+	/**
+	 * highest FrameBytes so far
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 PeakFrameBytes = 0;
+
+	/**
+	 * highest CodecBytes so far
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 PeakCodecBytes = 0;
+
+	/**
+	 * highest MuxBytes so far
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 PeakMuxBytes = 0;
+
+	/**
+	 * highest ScalerBytes so far
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 PeakScalerBytes = 0;
+};
+
+/**
+ * Throughput and contention of FFmpegEncoder
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegEncoderStats {
+	GENERATED_BODY()
+
+	/**
+	 * frames encoded since Open
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 EncodedFrames = 0;
+
+	/**
+	 * frames added but not encoded yet
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 PendingFrames = 0;
+
+	/**
+	 * frames encoded per second of encoding, excluding time waiting for
+	 * frames
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float EncodeFramesPerSecond = 0.0f;
+
+	/**
+	 * average time from adding frames to the idle encode thread running, in
+	 * milliseconds. grows when its cores are busy with other threads.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float WakeLatencyMilliseconds = 0.0f;
+
+	/**
+	 * average time the encode thread waited per frame for conversion tasks,
+	 * in milliseconds. grows when workers are busy with other tasks.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float ConversionWaitMilliseconds = 0.0f;
+
+	/**
+	 * cores the encode thread runs on, a bit per core
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 EncodeAffinityMask = 0;
+
+	/**
+	 * time Open took to open the encoder and output, in milliseconds
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float OpenMilliseconds = 0.0f;
+
+	/**
+	 * time from the start of Open to the first encoded packet, in
+	 * milliseconds. 0 until then.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float FirstPacketMilliseconds = 0.0f;
+
+	/**
+	 * whether the encoder was taken warm from FFFmpegEncoderPool
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	bool bPrewarmed = false;
+
+	/**
+	 * time of audio submitted so far minus time of video encoded so far, in
+	 * milliseconds. positive when audio leads.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float AudioDriftMilliseconds = 0.0f;
+
+	/**
+	 * times the audio track ran dry behind the video and was padded with
+	 * silence
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int32 AudioUnderruns = 0;
+
+	/**
+	 * sample frames of silence encoded to pad underruns, and gaps before
+	 * samples added with a later capture time
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 AudioSilentSamples = 0;
+
+	/**
+	 * submitted sample frames dropped because the buffer was full, or
+	 * because their capture time was already encoded, such as with silence
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 AudioDroppedSamples = 0;
+
+	/**
+	 * memory held for this encoder. mux bytes are only counted for the
+	 * process, by UFFmpegUtils::GetMemoryStats.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FFFmpegMemoryStats Memory;
 };
@@ -0,0 +1,107 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "Tasks/Task.h"
+
+#include <mutex>
+
+struct AVCodecContext;
+
+/**
+ * Encoders opened ahead of time for settings used often, so that starting
+ * a clip doesn't wait for codec initialization, such as the lookahead and
+ * worker threads of libx264.
+ * Each setting keeps the number of warm encoders it was prewarmed with: an
+ * acquired encoder is replaced in the background, and a finished one is
+ * reset and reused where the codec supports it.
+ * Can be called from any thread.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegEncoderPool {
+	// public functions
+public:
+	/**
+	 * @return   the pool of the process.
+	 */
+	static FFFmpegEncoderPool& Get();
+
+	/**
+	 * Open encoders of FFmpegEncoderConfig in the background, until
+	 * NumEncoders of them are warm. Releases them if 0.
+	 */
+	void Prewarm(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	             int32                       NumEncoders);
+
+	/**
+	 * Take a warm encoder of FFmpegEncoderConfig, or open one now if none
+	 * is warm.
+	 * @param[out] bPrewarmed   whether the encoder was warm.
+	 * @return   opened encoder. nullptr on failure.
+	 */
+	AVCodecContext* Acquire(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                        bool& bPrewarmed, FString& ErrorMessage);
+
+	/**
+	 * Give back an encoder acquired with FFmpegEncoderConfig, after draining
+	 * it. It is reset and kept if the codec supports it and the setting is
+	 * short of warm encoders, and freed otherwise.
+	 */
+	void Release(AVCodecContext*&            CodecContext,
+	             const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Free all warm encoders, after waiting for those being opened.
+	 * Called on ShutdownModule, as the pool is left as it is at static
+	 * destruction, when tasks can no longer be waited for.
+	 */
+	void Empty();
+
+	// private types
+private:
+	/**
+	 * Warm encoders of a setting
+	 */
+	struct FEntry {
+		FFFmpegEncoderConfig    Config;
+		int32                   NumEncoders = 0;
+		int32                   NumOpening  = 0;
+		TArray<AVCodecContext*> CodecContexts;
+	};
+
+	// private functions
+private:
+	/**
+	 * Launch tasks to open encoders that Entry is short of.
+	 * Entries_mutex must be locked.
+	 */
+	void Refill(const FString& Key, FEntry& Entry);
+
+	/**
+	 * @return   key of the settings that the encoder depends on.
+	 */
+	static FString KeyOf(const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Open an encoder of FFmpegEncoderConfig on a thread placed as its
+	 * encode thread.
+	 * @return   nullptr on failure.
+	 */
+	static AVCodecContext* Open(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                            FString&                    ErrorMessage);
+
+	/**
+	 * Open an encoder of FFmpegEncoderConfig, the proxy codec if set, on the
+	 * calling thread.
+	 * @return   nullptr on failure.
+	 */
+	static AVCodecContext*
+	    OpenOnThisThread(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                     FString&                    ErrorMessage);
+
+	// private fields: beware of data race
+private:
+	std::mutex               Entries_mutex;
+	TMap<FString, FEntry>    Entries;
+	TArray<UE::Tasks::FTask> OpenTasks;
+};
@@ -0,0 +1,105 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "FFmpegFrameSharedPtr.h"
+#include "ImageCore.h"
+
+#include "FFmpegEncoderSweep.generated.h"
+
+/**
+ * Speed, resources and quality of one encoder setting measured by
+ * FFFmpegEncoderSweep
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegSweepResult {
+	GENERATED_BODY()
+
+	/**
+	 * measured setting
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FFFmpegEncoderConfig Config;
+
+	/**
+	 * frames encoded per second of wall time
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float EncodeFramesPerSecond = 0.0f;
+
+	/**
+	 * CPU time of the process spent while encoding, in seconds
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float CpuSeconds = 0.0f;
+
+	/**
+	 * growth of used physical memory while encoding, in megabytes
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float PeakMemoryMegabytes = 0.0f;
+
+	/**
+	 * average bit rate of the encoded stream, in kilobits per second
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float KilobitsPerSecond = 0.0f;
+
+	/**
+	 * PSNR of luma against source frames, in dB
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float PsnrY = 0.0f;
+
+	/**
+	 * SSIM of luma against source frames, 1 is identical
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float SsimY = 0.0f;
+
+	/**
+	 * whether no other result is faster, better and smaller at once
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	bool bParetoOptimal = false;
+};
+
+/**
+ * Harness to sweep encoder settings over a reference clip and find the
+ * settings with the best trade-off of speed, quality and bit rate.
+ * UFFmpegSweepCommandlet runs it headless.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegEncoderSweep {
+	// public functions
+public:
+	/**
+	 * Encode SourceFrames with FFmpegEncoderConfig, then decode the output
+	 * and compare it with them.
+	 * @param SourceFrames   frames of the size and pixel format of
+	 *                       FFmpegEncoderConfig, with pts of their index.
+	 * @param[out] Result   measurements.
+	 * @return   whether encoding and decoding succeeded.
+	 */
+	static bool
+	    Measure(TConstArrayView<FFFmpegFrameThreadSafeSharedPtr> SourceFrames,
+	            const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	            FFFmpegSweepResult&         Result);
+
+	/**
+	 * Mark results that no other result beats in encode speed, SSIM and bit
+	 * rate together.
+	 */
+	static void MarkParetoFront(TArrayView<FFFmpegSweepResult> Results);
+
+	/**
+	 * @return   Results as CSV with a header row.
+	 */
+	static FString ToCsv(TConstArrayView<FFFmpegSweepResult> Results);
+
+	/**
+	 * Create a frame of a synthetic scene with motion, edges and noise, for
+	 * sweeping without a reference clip.
+	 */
+	static FImage CreateSyntheticImage(int32 Width, int32 Height, int32 Index);
+};
@@ -0,0 +1,65 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct AVCodecContext;
+struct AVFilterContext;
+struct AVFilterGraph;
+struct AVFrame;
+
+/**
+ * libavfilter graph that processes frames between conversion and encoding,
+ * such as burning in timecode, watermarks or LUTs. Filters run slices of
+ * each frame in parallel, and output frames come from the buffer pools of
+ * the graph. Frames leave in the order and with the timestamps they enter.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegFilterGraph {
+	// public functions
+public:
+	FFFmpegFilterGraph() = default;
+
+	FFFmpegFilterGraph(const FFFmpegFilterGraph&)            = delete;
+	FFFmpegFilterGraph& operator=(const FFFmpegFilterGraph&) = delete;
+
+	~FFFmpegFilterGraph();
+
+	/**
+	 * Build the graph of Filters for frames of CodecContext.
+	 * @param CodecContext   opened encoder. frames enter and leave in its
+	 *                       size, pixel format and time base.
+	 * @param Filters   filter chain in the syntax of ffmpeg -vf, such as
+	 *                  "drawtext=fontfile=font.ttf:text='%{pts\:hms}'".
+	 * @param Threads   threads of the graph. picked automatically if 0.
+	 * @return   whether the graph was built, keeping the size and time base
+	 *           of CodecContext.
+	 */
+	bool Open(const AVCodecContext& CodecContext, const FString& Filters,
+	          int32 Threads, FString& ErrorMessage);
+
+	/**
+	 * Feed Frame into the graph, which takes a new reference to it.
+	 * @param Frame   nullptr to mark the end and flush the graph.
+	 * @return   whether Frame was accepted.
+	 */
+	bool SendFrame(const AVFrame* Frame);
+
+	/**
+	 * Take the next filtered frame.
+	 * @param[out] Frame   unreferenced frame to receive it.
+	 * @return   whether a frame was taken. false until more frames are sent,
+	 *           or after the last one.
+	 */
+	bool ReceiveFrame(AVFrame& Frame);
+
+	/**
+	 * Free the graph.
+	 */
+	void Close();
+
+	// private fields
+private:
+	AVFilterGraph*   Graph  = nullptr;
+	AVFilterContext* Source = nullptr;
+	AVFilterContext* Sink   = nullptr;
+};
@@ -0,0 +1,63 @@
+
+#pragma once
+
+#include "Async/ParallelFor.h"
+#include "CoreMinimal.h"
+#include "ImageCore.h"
+
+/**
+ * Sums sub-frames rendered at a multiple of the output frame rate into a
+ * linear float accumulator, and resolves their weighted mean as one output
+ * frame, for motion blur. Only resolved frames need to be converted and
+ * encoded.
+ * Sub-frames of an output frame must be added in order and from one thread
+ * at a time.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegFrameAccumulator {
+	// public functions
+public:
+	/**
+	 * @param ParallelForFlags   flags for ParallelFor over rows.
+	 */
+	explicit FFFmpegFrameAccumulator(
+	    EParallelForFlags ParallelForFlags = EParallelForFlags::None);
+
+	/**
+	 * Add Image to the current output frame in parallel.
+	 * BGRA8, RGBA16F and RGBA32F are read directly, the others are
+	 * linearized first.
+	 * @param Image   sub-frame of the same size as the others of the frame.
+	 * @param Weight   shutter weight of the sub-frame.
+	 * @return   whether Image was added.
+	 */
+	bool Accumulate(const FImage& Image, float Weight);
+
+	/**
+	 * Resolve the weighted mean of the sub-frames added so far as linear
+	 * RGBA32F, and start the next output frame.
+	 * @param Width   width of the black image returned if nothing was added.
+	 * @param Height   height of the black image returned if nothing was
+	 *                 added.
+	 * @return   image owned by the accumulator, valid until the next call
+	 *           of Resolve.
+	 */
+	const FImage& Resolve(int32 Width, int32 Height);
+
+	// private constants
+private:
+	// rows accumulated or resolved by a task
+	static constexpr int32 RowsPerTask = 16;
+
+	// private fields
+private:
+	EParallelForFlags ParallelForFlags = EParallelForFlags::None;
+
+	// weighted sum of linear RGBA of each pixel
+	TArray<VectorRegister4Float> Sums;
+	int32                        SumWidth  = 0;
+	int32                        SumHeight = 0;
+	float                        WeightSum = 0.0f;
+
+	// resolved frame, reused for every output frame of the same size
+	FImage Resolved;
+};
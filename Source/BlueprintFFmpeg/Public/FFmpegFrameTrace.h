@@ -0,0 +1,165 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "ImageCore.h"
+
+#include <mutex>
+
+/**
+ * Source of an image added to the encoder, recorded in traces
+ */
+enum class FFmpegTraceSource : uint8 {
+	/** image or task of an image */
+	Image,
+	/** render target or texture, read back */
+	RenderTarget,
+	/** image file, loaded */
+	ImageFile,
+	/** render target read back in bands, without a whole image */
+	Band
+};
+
+/**
+ * An image added to FFFmpegEncodeThread, recorded by FFFmpegTraceRecorder
+ */
+struct BLUEPRINTFFMPEG_API FFFmpegTraceEvent {
+	/**
+	 * order of the image among the images added
+	 */
+	int64 Index = 0;
+
+	/**
+	 * seconds from Open to the call adding the image
+	 */
+	double Seconds = 0.0;
+
+	/**
+	 * seconds from Open to the image being ready to convert, after its
+	 * readback or loading
+	 */
+	double ReadySeconds = 0.0;
+
+	FFmpegTraceSource Source = FFmpegTraceSource::Image;
+
+	/**
+	 * tile of the mosaic, INDEX_NONE for a frame
+	 */
+	int32 TileIndex = INDEX_NONE;
+
+	/**
+	 * size and format of the image. the output size of the trace if 0.
+	 */
+	int32                 Width      = 0;
+	int32                 Height     = 0;
+	ERawImageFormat::Type Format     = ERawImageFormat::BGRA8;
+	EGammaSpace           GammaSpace = EGammaSpace::sRGB;
+
+	/**
+	 * LZ4 compressed pixels in the trace, at PayloadOffset when loaded.
+	 * none if 0.
+	 */
+	int64 PayloadSize   = 0;
+	int64 PayloadOffset = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FFFmpegTraceEvent& Event);
+};
+
+/**
+ * Record a compact trace of the images added to an encoder, with their
+ * timing, source, size and format, and optionally their pixels. Events
+ * can be recorded from any thread, and the file is finished once the
+ * recorder is destroyed.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegTraceRecorder {
+	// public functions
+public:
+	/**
+	 * Create Path and write FFmpegEncoderConfig to it.
+	 * @param bInRecordPayload   whether to record pixels of images too.
+	 * @return   whether Path was created.
+	 */
+	bool Open(const FString&              Path,
+	          const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	          bool                        bInRecordPayload);
+
+	/**
+	 * @return   seconds since Open.
+	 */
+	double Now() const;
+
+	/**
+	 * Write Event, with size, format and pixels of Image if not null.
+	 */
+	void Record(FFFmpegTraceEvent Event, const FImage* Image);
+
+	// private fields: beware of data race
+private:
+	std::mutex           Writer_mutex;
+	TUniquePtr<FArchive> Writer;
+
+	// private fields: no data race after Open
+private:
+	uint64 StartCycles    = 0;
+	bool   bRecordPayload = false;
+};
+
+/**
+ * Trace recorded by FFFmpegTraceRecorder, which can be replayed through a
+ * new encoder to reproduce the timing and data of a capture offline.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegTrace {
+	// public functions
+public:
+	/**
+	 * Read the config and events of the trace at InPath. Pixels are read
+	 * when replayed.
+	 * @return   whether Path is a trace.
+	 */
+	bool Load(const FString& InPath, FString& ErrorMessage);
+
+	/**
+	 * @return   setting of the recorded encoder.
+	 */
+	const FFFmpegEncoderConfig& GetConfig() const;
+
+	/**
+	 * @return   events in the order of the images added.
+	 */
+	TConstArrayView<FFFmpegTraceEvent> GetEvents() const;
+
+	/**
+	 * Read the recorded pixels of Event into Image, or create a synthetic
+	 * image of its size and format if they aren't recorded.
+	 * Can be called from any thread.
+	 * @return   whether the recorded pixels were read.
+	 */
+	bool ReadImage(const FFFmpegTraceEvent& Event, FImage& Image) const;
+
+	/**
+	 * Encode the events into OutputFilePath through a new encoder with the
+	 * recorded setting. Each image is added at its recorded time, and is
+	 * ready to convert after its recorded readback or loading delay.
+	 * @param TimeScale   scale of the recorded times. added as fast as
+	 *                    possible if 0.
+	 * @param[out] Stats   stats of the encoder after encoding all events.
+	 * @return   whether OutputFilePath was written.
+	 */
+	bool Replay(const FString& OutputFilePath, float TimeScale,
+	            FFFmpegEncoderStats& Stats, FString& ErrorMessage) const;
+
+	// private constants
+private:
+	// file identifier and version of the format
+	static constexpr uint32 Magic   = 0x52544646; // "FFTR"
+	static constexpr int32  Version = 1;
+
+	friend class FFFmpegTraceRecorder;
+
+	// private fields
+private:
+	FString                   Path;
+	FFFmpegEncoderConfig      Config;
+	TArray<FFFmpegTraceEvent> Events;
+};
@@ -0,0 +1,84 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A keyframe of the video stream indexed by FFFmpegKeyframeIndex
+ */
+struct BLUEPRINTFFMPEG_API FFFmpegKeyframe {
+	/**
+	 * timestamp to seek to, in the time base of the stream
+	 */
+	int64 Timestamp = 0;
+
+	/**
+	 * byte offset of the packet in the file, -1 if unknown
+	 */
+	int64 Position = -1;
+
+	/**
+	 * presentation time from the start of the stream
+	 */
+	double Seconds = 0.0;
+
+	friend FArchive& operator<<(FArchive& Ar, FFFmpegKeyframe& Keyframe);
+};
+
+/**
+ * Keyframes of the first video stream of a media file, so that frames can be
+ * extracted by decoding only from the nearest keyframe.
+ * Persisted as a sidecar file next to the media, which is rebuilt when the
+ * media changes.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegKeyframeIndex {
+	// public functions
+public:
+	/**
+	 * @return   path of the sidecar of MediaPath.
+	 */
+	static FString SidecarPathOf(const FString& MediaPath);
+
+	/**
+	 * Scan MediaPath for keyframes. The index of the container is read if it
+	 * has one, otherwise packets are read without decoding them.
+	 * @return   whether the media has a video stream.
+	 */
+	bool Build(const FString& MediaPath);
+
+	/**
+	 * Load the sidecar of MediaPath if it is up to date, otherwise build the
+	 * index and write the sidecar.
+	 * @return   whether the index is available.
+	 */
+	bool LoadOrBuild(const FString& MediaPath);
+
+	/**
+	 * Write the sidecar of the media this index was built from.
+	 */
+	bool Save() const;
+
+	/**
+	 * Read the sidecar of MediaPath.
+	 * @return   whether it exists and matches the size and timestamp of
+	 *           MediaPath.
+	 */
+	bool Load(const FString& MediaPath);
+
+	/**
+	 * @return   the last keyframe at or before Seconds, nullptr if empty.
+	 */
+	const FFFmpegKeyframe* FindKeyframeBefore(double Seconds) const;
+
+	/**
+	 * @return   keyframes in timestamp order.
+	 */
+	TConstArrayView<FFFmpegKeyframe> GetKeyframes() const;
+
+	// private fields
+private:
+	FString                 MediaPath;
+	int64                   MediaSize      = 0;
+	FDateTime               MediaTimestamp = FDateTime::MinValue();
+	TArray<FFFmpegKeyframe> Keyframes;
+};
@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "CoreMinimal.h"
+
+#include "FFmpegLoopbackCommandlet.generated.h"
+
+/**
+ * Stream synthetic frames to a local UDP port with OpenStream of
+ * UFFmpegEncoder, receive and decode them on another thread, and verify
+ * that they arrive intact and in order, reporting the glass-to-glass
+ * latency from adding each frame to decoding it.
+ * Usage:
+ *   UnrealEditor-Cmd <Project> -run=FFmpegLoopback [-Port=5000]
+ *     [-Frames=300] [-FrameRate=30] [-Width=640] [-Height=360]
+ *     [-MinReceived=0.9]
+ * Frames carry their index as black and white bars, so that lost frames
+ * are told from corrupted ones. Fails if a decoded frame is corrupted or
+ * out of order, or if fewer than MinReceived of the frames are decoded, as
+ * receivers join at the first keyframe.
+ */
+UCLASS()
+class BLUEPRINTFFMPEG_API UFFmpegLoopbackCommandlet: public UCommandlet {
+	GENERATED_BODY()
+
+public:
+	UFFmpegLoopbackCommandlet();
+
+	// UCommandlet interfaces
+public:
+	virtual int32 Main(const FString& Params) override;
+};
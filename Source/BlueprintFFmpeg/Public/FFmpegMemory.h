@@ -0,0 +1,110 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "HAL/LowLevelMemTracker.h"
+
+#include <atomic>
+
+struct AVFrame;
+
+// LLM tags of memory held by FFmpeg encoding, under BlueprintFFmpeg
+LLM_DECLARE_TAG_API(BlueprintFFmpeg_Frames, BLUEPRINTFFMPEG_API);
+LLM_DECLARE_TAG_API(BlueprintFFmpeg_Codec, BLUEPRINTFFMPEG_API);
+LLM_DECLARE_TAG_API(BlueprintFFmpeg_Mux, BLUEPRINTFFMPEG_API);
+LLM_DECLARE_TAG_API(BlueprintFFmpeg_Scaler, BLUEPRINTFFMPEG_API);
+
+/**
+ * Category of memory counted by FFFmpegMemory
+ */
+enum class FFmpegMemoryCategory : uint8 { Frames, Codec, Mux, Scaler, Num };
+
+/**
+ * Current and peak bytes of each category, of the process or of an
+ * encoder. Can be called from any thread.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegMemoryUsage {
+	// public functions
+public:
+	/**
+	 * Count Delta bytes more, or less if negative.
+	 */
+	void Add(FFmpegMemoryCategory Category, int64 Delta);
+
+	/**
+	 * @return   bytes counted so far.
+	 */
+	FFFmpegMemoryStats GetStats() const;
+
+	// private fields: beware of data race
+private:
+	static constexpr int32 NumCategories =
+	    static_cast<int32>(FFmpegMemoryCategory::Num);
+
+	std::atomic<int64> Bytes[NumCategories]     = {};
+	std::atomic<int64> PeakBytes[NumCategories] = {};
+};
+
+using FFFmpegMemoryUsagePtr =
+    TSharedPtr<FFFmpegMemoryUsage, ESPMode::ThreadSafe>;
+
+/**
+ * Memory accounting of the plugin. FFmpeg offers no hooks for its own
+ * allocations, so frames are allocated here through the engine allocator,
+ * and buffers of the plugin around FFmpeg are counted where they are held.
+ * Everything is counted for the process, and for the encoder of the
+ * FFFmpegMemoryScope of the allocating thread.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegMemory {
+	// public functions
+public:
+	/**
+	 * @return   usage of the process.
+	 */
+	static FFFmpegMemoryUsage& GetProcessUsage();
+
+	/**
+	 * @return   usage of the innermost FFFmpegMemoryScope of the calling
+	 *           thread. null outside of scopes.
+	 */
+	static const FFFmpegMemoryUsagePtr& GetScopeUsage();
+
+	/**
+	 * Count Bytes more, or less if negative, for the process and Usage.
+	 */
+	static void Track(FFmpegMemoryCategory         Category, int64 Bytes,
+	                  const FFFmpegMemoryUsagePtr& Usage = nullptr);
+
+	/**
+	 * Allocate buffers of a video frame through the engine allocator, in
+	 * place of av_frame_get_buffer. width, height and format of Frame must
+	 * be set. The buffers are counted for the scope of the calling thread
+	 * until the last reference is released, on any thread.
+	 * @return   whether the buffers were allocated.
+	 */
+	static bool GetFrameBuffer(AVFrame& Frame);
+
+	/**
+	 * Write current and peak bytes of the process to the log.
+	 */
+	static void LogReport();
+};
+
+/**
+ * Count memory allocated on the calling thread while alive for Usage,
+ * such as by conversion tasks of an encoder.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegMemoryScope {
+	// public functions
+public:
+	explicit FFFmpegMemoryScope(const FFFmpegMemoryUsagePtr& Usage);
+	~FFFmpegMemoryScope();
+
+	FFFmpegMemoryScope(const FFFmpegMemoryScope&)            = delete;
+	FFFmpegMemoryScope& operator=(const FFFmpegMemoryScope&) = delete;
+
+	// private fields
+private:
+	const FFFmpegMemoryUsagePtr* PreviousUsage;
+};
@@ -0,0 +1,184 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegOutputSink.h"
+
+/**
+ * Sink that muxes into a custom AVIOContext and hands the muxed bytes to
+ * Write instead of a file.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegCustomIOOutputSink
+    : public FFFmpegMuxerOutputSink {
+	// public functions
+public:
+	/**
+	 * @param FormatName   short name of the container such as "mp4", "matroska"
+	 *                     or "mpegts".
+	 */
+	explicit FFFmpegCustomIOOutputSink(const FString& FormatName);
+
+	virtual ~FFFmpegCustomIOOutputSink() override;
+
+	// protected functions
+protected:
+	/**
+	 * Receive muxed bytes.
+	 * @param Data   only valid during the call.
+	 * @return   whether Data was written.
+	 */
+	virtual bool Write(TArrayView<const uint8> Data) = 0;
+
+	/**
+	 * Move the write position, as fseek does.
+	 * @return   new position, or negative value if it can't seek.
+	 */
+	virtual int64 Seek(int64 Offset, int Whence);
+
+	/**
+	 * @return   size of the written output, or negative value if unknown.
+	 */
+	virtual int64 Size() const;
+
+	/**
+	 * @return   whether Seek is supported.
+	 */
+	virtual bool IsSeekable() const;
+
+	// FFFmpegMuxerOutputSink interfaces
+protected:
+	virtual AVIOContext* OpenIOContext() override;
+	virtual void         CloseIOContext(AVIOContext*& IOContext) override;
+
+	// private functions
+private:
+	static int WriteCallback(void* Opaque, const uint8* Buffer, int BufferSize);
+	static int64_t SeekCallback(void* Opaque, int64_t Offset, int Whence);
+
+	// private constants
+private:
+	// bytes muxed before they are handed to Write
+	static constexpr int IOBufferSize = 256 * 1024;
+};
+
+/**
+ * Sink that muxes into a buffer in memory.
+ * Buffers are pooled, so that sessions reuse allocations of earlier ones.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegMemoryOutputSink
+    : public FFFmpegCustomIOOutputSink {
+	// type aliases
+public:
+	using FClosedCallback = TFunction<void(TArray64<uint8>&& Data)>;
+
+	// public functions
+public:
+	/**
+	 * @param FormatName   short name of the container.
+	 * @param OnClosed   called on the encode thread with the muxed output
+	 *                   after the output is finalized. may be empty, then the
+	 *                   output is taken by MoveData.
+	 */
+	explicit FFFmpegMemoryOutputSink(const FString&  FormatName,
+	                                 FClosedCallback OnClosed = {});
+
+	virtual ~FFFmpegMemoryOutputSink() override;
+
+	/**
+	 * Take the muxed output. Call after the encoder finished.
+	 */
+	TArray64<uint8> MoveData();
+
+	/**
+	 * Return a buffer to the pool, so that later sinks reuse its allocation.
+	 */
+	static void ReleaseBuffer(TArray64<uint8>&& Buffer);
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool Close() override;
+
+	// FFFmpegCustomIOOutputSink interfaces
+protected:
+	virtual bool  Write(TArrayView<const uint8> Data) override;
+	virtual int64 Seek(int64 Offset, int Whence) override;
+	virtual int64 Size() const override;
+	virtual bool  IsSeekable() const override;
+
+	// private functions
+private:
+	static TArray64<uint8> AcquireBuffer();
+
+	// private fields
+private:
+	FClosedCallback OnClosed;
+	TArray64<uint8> Buffer;
+	int64           Position = 0;
+};
+
+/**
+ * Sink that hands muxed byte chunks to a callback without copying them.
+ * The output can't seek, so mp4 is written fragmented.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegCallbackOutputSink
+    : public FFFmpegCustomIOOutputSink {
+	// type aliases
+public:
+	using FChunkCallback = TFunction<bool(TArrayView<const uint8> Chunk)>;
+
+	// public functions
+public:
+	/**
+	 * @param FormatName   short name of the container.
+	 * @param OnChunk   called on the encode thread with each chunk in order.
+	 *                  the chunk is only valid during the call. returning
+	 *                  false fails encoding.
+	 */
+	FFFmpegCallbackOutputSink(const FString& FormatName, FChunkCallback OnChunk);
+
+	virtual ~FFFmpegCallbackOutputSink() override;
+
+	// FFFmpegCustomIOOutputSink interfaces
+protected:
+	virtual bool Write(TArrayView<const uint8> Data) override;
+
+	// private fields
+private:
+	FChunkCallback OnChunk;
+};
+
+/**
+ * Sink that hands encoded packets to a callback without muxing them.
+ * Packets are reference counted, so consumers keep them with av_packet_ref
+ * instead of copying.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegPacketCallbackOutputSink
+    : public IFFmpegOutputSink {
+	// type aliases
+public:
+	using FPacketCallback = TFunction<bool(
+	    const AVPacket& Packet, const AVCodecContext& CodecContext)>;
+
+	// public functions
+public:
+	/**
+	 * @param OnPacket   called on the encode thread with each packet in
+	 *                   decoding order and the codec context of its stream.
+	 *                   returning false fails encoding.
+	 */
+	explicit FFFmpegPacketCallbackOutputSink(FPacketCallback OnPacket);
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool WritePacket(const AVPacket& Packet) override;
+	virtual bool Close() override;
+
+	// private fields
+private:
+	FPacketCallback                OnPacket;
+	TArray<const AVCodecContext*> CodecContexts;
+};
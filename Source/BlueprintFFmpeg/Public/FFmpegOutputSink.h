@@ -0,0 +1,136 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+struct AVCodecContext;
+struct AVDictionary;
+struct AVFormatContext;
+struct AVIOContext;
+struct AVPacket;
+
+/**
+ * Destination of packets encoded by FFFmpegEncodeThread.
+ * Open is called by FFFmpegEncodeThread::Open, and the others on the encode
+ * thread.
+ */
+class BLUEPRINTFFMPEG_API IFFmpegOutputSink {
+public:
+	virtual ~IFFmpegOutputSink() = default;
+
+	/**
+	 * Prepare to receive packets.
+	 * @param CodecContexts   opened codec context of each stream. Packets refer
+	 *                        to them by stream_index.
+	 * @return   whether the sink is ready.
+	 */
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts) = 0;
+
+	/**
+	 * Receive an encoded packet, in decoding order.
+	 * @param Packet   timestamps are in the time base of its codec context.
+	 *                 only valid during the call, take a reference with
+	 *                 av_packet_ref to keep it.
+	 * @return   whether the packet was written.
+	 */
+	virtual bool WritePacket(const AVPacket& Packet) = 0;
+
+	/**
+	 * Finish output after the last packet.
+	 * @return   whether the output was finalized.
+	 */
+	virtual bool Close() = 0;
+
+	/**
+	 * Called before each frame is sent to the encoder.
+	 * @return   whether the frame must be encoded as a keyframe, e.g. to
+	 *           start a new file there. the request is cleared by the call.
+	 */
+	virtual bool TakeKeyframeRequest() { return false; }
+};
+
+/**
+ * Sink that muxes packets into a container written through an AVIOContext.
+ * Subclasses decide where the bytes go.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegMuxerOutputSink: public IFFmpegOutputSink {
+	// public functions
+public:
+	/**
+	 * @param FormatName   short name of the container such as "mp4" or
+	 *                     "matroska". guessed from FileName if empty.
+	 * @param FileName   name used to guess the container. may be empty.
+	 */
+	FFFmpegMuxerOutputSink(const FString& FormatName, const FString& FileName);
+
+	virtual ~FFFmpegMuxerOutputSink() override;
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool WritePacket(const AVPacket& Packet) override;
+	virtual bool Close() override;
+
+	// protected functions
+protected:
+	/**
+	 * Open the AVIOContext the muxer writes to.
+	 * Unseekable contexts get fragmented mp4/mov.
+	 * @return   nullptr on failure.
+	 */
+	virtual AVIOContext* OpenIOContext() = 0;
+
+	/**
+	 * Flush and release IOContext opened by OpenIOContext.
+	 */
+	virtual void CloseIOContext(AVIOContext*& IOContext) = 0;
+
+	/**
+	 * Add options of the muxer, passed to avformat_write_header.
+	 */
+	virtual void AddMuxerOptions(AVDictionary*& MuxerOptions) const {}
+
+	/**
+	 * Release the muxer without finalizing it, e.g. when encoding failed.
+	 * Subclasses call this in their destructor, because CloseIOContext can't
+	 * be called from the destructor of this class.
+	 */
+	void FreeFormatContext();
+
+	// private fields
+private:
+	FString            FormatName;
+	FString            FileName;
+	AVFormatContext*   FormatContext = nullptr;
+	AVPacket*          MuxPacket     = nullptr;
+	TArray<AVRational> CodecTimeBases;
+};
+
+/**
+ * Sink that muxes packets into a file.
+ * The container is determined by the extension of the file path.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegFileOutputSink: public FFFmpegMuxerOutputSink {
+	// public functions
+public:
+	/**
+	 * @param OutputFilePath   Output destination file path.
+	 */
+	explicit FFFmpegFileOutputSink(const FString& OutputFilePath);
+
+	virtual ~FFFmpegFileOutputSink() override;
+
+	// FFFmpegMuxerOutputSink interfaces
+protected:
+	virtual AVIOContext* OpenIOContext() override;
+	virtual void         CloseIOContext(AVIOContext*& IOContext) override;
+
+	// private fields
+private:
+	FString FilePath;
+};
@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "CoreMinimal.h"
+
+#include "FFmpegReplayCommandlet.generated.h"
+
+/**
+ * Replay a trace recorded with FFFmpegEncoderConfig::TraceFilePath through a
+ * new encoder with the recorded setting, and report its stats, so that a
+ * capture can be profiled and regressed offline without the game.
+ * Usage:
+ *   UnrealEditor-Cmd <Project> -run=FFmpegReplay -Trace=<path>
+ *     [-Output=<path>] [-TimeScale=1] [-Report=<path>]
+ * The output is written to Saved/FFmpegReplay/<Trace>.mkv by default.
+ * With -TimeScale=0, images are added as fast as possible. With -Report,
+ * a row of stats is appended to the CSV file.
+ */
+UCLASS()
+class BLUEPRINTFFMPEG_API UFFmpegReplayCommandlet: public UCommandlet {
+	GENERATED_BODY()
+
+public:
+	UFFmpegReplayCommandlet();
+
+	// UCommandlet interfaces
+public:
+	virtual int32 Main(const FString& Params) override;
+};
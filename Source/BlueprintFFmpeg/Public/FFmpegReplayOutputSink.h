@@ -0,0 +1,95 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Deque.h"
+#include "FFmpegOutputSink.h"
+#include "Tasks/Task.h"
+
+#include <mutex>
+
+/**
+ * Sink that keeps the latest encoded packets in memory for instant replay.
+ * Packets are grouped by keyframe of the first stream, and the oldest groups
+ * are dropped to keep the buffered duration and bytes bounded.
+ * Save muxes a window of the buffer into a file without re-encoding.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegReplayOutputSink: public IFFmpegOutputSink {
+	// public functions
+public:
+	/**
+	 * @param MaxSeconds   duration kept in the buffer. the buffer is longer by
+	 *                     up to one keyframe interval.
+	 * @param MaxBytes   upper limit of bytes kept in the buffer. the latest
+	 *                   keyframe interval is always kept.
+	 */
+	explicit FFFmpegReplayOutputSink(double MaxSeconds,
+	                                 int64  MaxBytes = MAX_int64);
+
+	/**
+	 * Mux the latest packets into a file on a background thread.
+	 * Can be called from any thread, also after encoding finished.
+	 * @param OutputFilePath   Output destination file path.
+	 *                         The output format is determined by the
+	 *                         extension of this path.
+	 * @param Seconds   duration to save. starts at the nearest earlier
+	 *                  keyframe. everything buffered is saved if not positive.
+	 * @return   task resulting in whether the file was written.
+	 */
+	UE::Tasks::TTask<bool> Save(const FString& OutputFilePath,
+	                            double         Seconds = 0.0) const;
+
+	/**
+	 * @return   duration currently buffered.
+	 */
+	double GetBufferedSeconds() const;
+
+	/**
+	 * @return   bytes of packets currently buffered.
+	 */
+	int64 GetBufferedBytes() const;
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool WritePacket(const AVPacket& Packet) override;
+	virtual bool Close() override;
+
+	// type aliases
+private:
+	using FPacketSharedPtr = TSharedPtr<AVPacket, ESPMode::ThreadSafe>;
+	using FCodecContextSharedPtr =
+	    TSharedPtr<AVCodecContext, ESPMode::ThreadSafe>;
+
+	/**
+	 * Packets from a keyframe of the first stream to the next one
+	 */
+	struct FKeyframeGroup {
+		TArray<FPacketSharedPtr> Packets;
+		int64                    KeyframePts = 0;
+		int64                    Bytes       = 0;
+	};
+
+	// private functions
+private:
+	/**
+	 * Drop the oldest groups exceeding the limits. Called with Mutex locked.
+	 */
+	void DropOldGroups();
+
+	/**
+	 * @return   Seconds in the time base of the first stream.
+	 */
+	int64 DurationOfFirstStream(double Seconds) const;
+
+	// private fields
+private:
+	double                         MaxSeconds;
+	int64                          MaxBytes;
+	TArray<FCodecContextSharedPtr> CodecContexts;
+	TDeque<FKeyframeGroup>         Groups;
+	int64                          BufferedBytes = 0;
+	int64                          LatestPts     = 0;
+	mutable std::mutex             Mutex;
+};
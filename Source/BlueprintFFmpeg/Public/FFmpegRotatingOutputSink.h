@@ -0,0 +1,82 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegOutputSink.h"
+
+#include <atomic>
+
+/**
+ * Sink that splits output into consecutive files at keyframes, while the
+ * encoder keeps running. Files are split by duration, size or Rotate.
+ * The first file is written to OutputFilePath, and the following ones
+ * to OutputFilePath with suffix "_001", "_002" and so on.
+ * Each file starts at time 0 and the files play back to back without gaps,
+ * no frames are dropped or duplicated.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegRotatingOutputSink: public IFFmpegOutputSink {
+	// type aliases
+public:
+	using FRotatedCallback = TFunction<void(const FString& FinishedFilePath)>;
+
+	// public functions
+public:
+	/**
+	 * @param OutputFilePath   Output destination file path of the first file.
+	 *                         The output format is determined by the
+	 *                         extension of this path.
+	 * @param MaxSeconds   duration of each file, unlimited if not positive.
+	 * @param MaxBytes   size of each file, unlimited if not positive.
+	 * @param OnRotated   called on the encode thread with each finished file.
+	 *                    may be empty.
+	 */
+	FFFmpegRotatingOutputSink(const FString& OutputFilePath, double MaxSeconds,
+	                          int64 MaxBytes, FRotatedCallback OnRotated = {});
+
+	virtual ~FFFmpegRotatingOutputSink() override;
+
+	/**
+	 * Start a new file at the next frame, which is encoded as a keyframe.
+	 * Can be called from any thread.
+	 */
+	void Rotate();
+
+	/**
+	 * @return   path of the file at Index.
+	 */
+	FString FilePathOf(int32 Index) const;
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool WritePacket(const AVPacket& Packet) override;
+	virtual bool Close() override;
+	virtual bool TakeKeyframeRequest() override;
+
+	// private functions
+private:
+	/**
+	 * Finalize the current file and start the next one.
+	 */
+	bool StartNextFile();
+
+	// private fields: accessed on the encode thread
+private:
+	FString                           OutputFilePath;
+	double                            MaxSeconds;
+	int64                             MaxBytes;
+	FRotatedCallback                  OnRotated;
+	TArray<const AVCodecContext*>     CodecContexts;
+	TUniquePtr<FFFmpegFileOutputSink> File;
+	int32                             FileIndex     = 0;
+	int64                             FileBytes     = 0;
+	int64                             FileStartPts  = 0;
+	bool                              bFileHasVideo = false;
+	AVPacket*                         RebasedPacket = nullptr;
+
+	// private fields: accessed from any thread
+private:
+	std::atomic_bool bRotationRequested = false;
+	std::atomic_bool bKeyframeRequested = false;
+};
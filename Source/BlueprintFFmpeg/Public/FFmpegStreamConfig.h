@@ -0,0 +1,86 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "FFmpegStreamConfig.generated.h"
+
+/**
+ * Structure for live streaming settings of FFmpegEncoder
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegStreamConfig {
+	GENERATED_BODY()
+
+	/**
+	 * Upper limit of the sending rate in bits per second, so that keyframes
+	 * don't burst into the network and receiver buffers. unpaced if 0.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 PacingBitRate = 20000000;
+
+	/**
+	 * Muxed bytes waiting to be sent at most. when more pile up, they are
+	 * dropped up to the next keyframe, which is requested from the encoder.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1"))
+	int32 MaxQueueKilobytes = 2048;
+
+	/**
+	 * Interval of reconnecting after the connection is lost
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.0"))
+	float ReconnectSeconds = 1.0f;
+};
+
+/**
+ * Delivery and latency of live streaming by FFmpegEncoder
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegStreamStats {
+	GENERATED_BODY()
+
+	/**
+	 * whether the destination is connected
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	bool bConnected = false;
+
+	/**
+	 * times the connection was established again after it was lost
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int32 Reconnects = 0;
+
+	/**
+	 * muxed bytes sent since Open
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 SentBytes = 0;
+
+	/**
+	 * muxed bytes dropped while disconnected or when the queue overflowed
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 DroppedBytes = 0;
+
+	/**
+	 * muxed bytes waiting to be sent
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int64 QueuedBytes = 0;
+
+	/**
+	 * average time muxed bytes waited in the queue and for pacing, in
+	 * milliseconds
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float SendLatencyMilliseconds = 0.0f;
+
+	/**
+	 * average time from frames being sent to the encoder to their bytes being
+	 * sent, in milliseconds. 0 where FFmpeg doesn't pass the time to packets.
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float EncodeToSendMilliseconds = 0.0f;
+};
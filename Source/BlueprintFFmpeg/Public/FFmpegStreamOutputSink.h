@@ -0,0 +1,144 @@
+
+#pragma once
+
+#include "Containers/Deque.h"
+#include "CoreMinimal.h"
+#include "FFmpegMemoryOutputSink.h"
+#include "FFmpegStreamConfig.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Sink that muxes into MPEG-TS and sends it live over the network, such as
+ * "udp://127.0.0.1:5000", "tcp://127.0.0.1:5000" or "rtp://127.0.0.1:5000"
+ * (MPEG-TS in RTP). Bytes are sent on a sender thread from a bounded queue
+ * at a paced rate, so that the encode thread never waits for the network.
+ * While disconnected or when the queue overflows, bytes are dropped up to
+ * the next keyframe, which is requested from the encoder so that receivers
+ * resume immediately.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegStreamOutputSink
+    : public FFFmpegCustomIOOutputSink,
+      public FRunnable {
+	// public functions
+public:
+	/**
+	 * @param Url   destination. the protocol decides the transport.
+	 * @param StreamConfig   setting.
+	 */
+	FFFmpegStreamOutputSink(const FString&             Url,
+	                        const FFFmpegStreamConfig& StreamConfig);
+
+	virtual ~FFFmpegStreamOutputSink() override;
+
+	/**
+	 * @return   delivery and latency so far. can be called from any thread.
+	 */
+	FFFmpegStreamStats GetStats();
+
+	// IFFmpegOutputSink interfaces
+public:
+	virtual bool Open(TConstArrayView<const AVCodecContext*> CodecContexts)
+	    override;
+	virtual bool WritePacket(const AVPacket& Packet) override;
+	virtual bool Close() override;
+	virtual bool TakeKeyframeRequest() override;
+
+	// FRunnable interfaces
+public:
+	virtual uint32 Run() override;
+	virtual void   Stop() override;
+
+	// FFFmpegCustomIOOutputSink interfaces
+protected:
+	virtual bool         Write(TArrayView<const uint8> Data) override;
+	virtual AVIOContext* OpenIOContext() override;
+	virtual void         AddMuxerOptions(AVDictionary*& MuxerOptions) const
+	    override;
+
+	// private types
+private:
+	/**
+	 * Muxed bytes waiting to be sent
+	 */
+	struct FChunk {
+		TArray<uint8> Bytes;
+		uint64        QueuedCycles = 0;
+		uint64        FrameCycles  = 0;
+	};
+
+	// private functions
+private:
+	/**
+	 * @return   short name of the container carried by Url.
+	 */
+	static FString FormatNameOf(const FString& Url);
+
+	/**
+	 * Open the connection to Url on the sender thread.
+	 */
+	bool Connect();
+
+	/**
+	 * Interrupt callback of FFmpeg, so that Close doesn't wait for
+	 * connecting once stopped.
+	 * @param Opaque   the sink.
+	 * @return   whether connecting is abandoned.
+	 */
+	static int IsInterrupted(void* Opaque);
+
+	/**
+	 * Close the connection, and drop bytes up to the next keyframe.
+	 */
+	void Disconnect();
+
+	/**
+	 * Send Chunk in paced pieces on the sender thread.
+	 * @return   whether all bytes were sent.
+	 */
+	bool Send(const FChunk& Chunk);
+
+	// private constants
+private:
+	// bytes of 7 MPEG-TS packets, which fit in a datagram of common networks
+	static constexpr int32 DatagramBytes = 7 * 188;
+
+	// timeout of connecting and sending, in microseconds
+	static constexpr const char* IOTimeout = "2000000";
+
+	// private fields: no data race
+private:
+	FString             Url;
+	FFFmpegStreamConfig StreamConfig;
+	bool                bRtp   = false;
+	FRunnableThread*    Thread = nullptr;
+
+	// used by the sender thread only
+	AVIOContext* UrlContext      = nullptr;
+	bool         bEverConnected  = false;
+	double       NextSendSeconds = 0.0;
+
+	// used by the encode thread only
+	uint64 CurrentFrameCycles = 0;
+
+	// private fields: beware of data race
+private:
+	std::mutex              Queue_mutex;
+	std::condition_variable Queue_cv;
+	TDeque<FChunk>          Queue;
+	int64                   QueuedBytes         = 0;
+	bool                    bDropping           = true;
+	int64                   SentBytes           = 0;
+	int64                   DroppedBytes        = 0;
+	int32                   Reconnects          = 0;
+	int64                   SentChunks          = 0;
+	double                  SendLatencySeconds  = 0.0;
+	int64                   TimedChunks         = 0;
+	double                  EncodeToSendSeconds = 0.0;
+	std::atomic_bool        bRunning            = true;
+	std::atomic_bool        bConnected          = false;
+	std::atomic_bool        bKeyframeRequested  = false;
+};
@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "CoreMinimal.h"
+
+#include "FFmpegSweepCommandlet.generated.h"
+
+/**
+ * Sweep encoder settings over a reference clip and write a report per
+ * resolution, marking the Pareto front of speed, SSIM and bit rate.
+ * Usage:
+ *   UnrealEditor-Cmd <Project> -run=FFmpegSweep [-Images=<directory>]
+ *     [-Content=<label>] [-Frames=120] [-FrameRate=30]
+ *     [-Resolutions=1920x1080,3840x2160] [-Codecs=H264,HEVC]
+ *     [-Presets=ultrafast,veryfast,medium] [-Crfs=18,23,28]
+ *     [-BFrames=0,3] [-Threads=0] [-Report=<directory>]
+ * Without -Images, a synthetic scene is encoded. Reports are written to
+ * <Report>/<Content>_<Width>x<Height>.csv, Saved/FFmpegSweep by default.
+ */
+UCLASS()
+class BLUEPRINTFFMPEG_API UFFmpegSweepCommandlet: public UCommandlet {
+	GENERATED_BODY()
+
+public:
+	UFFmpegSweepCommandlet();
+
+	// UCommandlet interfaces
+public:
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,102 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ImageCore.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+
+#include "FFmpegThumbnails.generated.h"
+
+/**
+ * Frames to extract from one media file
+ */
+struct BLUEPRINTFFMPEG_API FFFmpegThumbnailRequest {
+	/**
+	 * media to extract from
+	 */
+	FString MediaPath;
+
+	/**
+	 * times of frames to extract
+	 */
+	TArray<double> Seconds;
+
+	/**
+	 * interval of frames to extract over the whole media, in addition to
+	 * Seconds. none if not positive.
+	 */
+	double IntervalSeconds = 0.0;
+};
+
+/**
+ * A frame extracted by UFFmpegThumbnails
+ */
+struct BLUEPRINTFFMPEG_API FFFmpegThumbnail {
+	/**
+	 * requested time
+	 */
+	double RequestedSeconds = 0.0;
+
+	/**
+	 * presentation time of the extracted frame, the first at or after
+	 * RequestedSeconds
+	 */
+	double Seconds = 0.0;
+
+	/**
+	 * BGRA8 image of the frame, empty if no frame was found
+	 */
+	FImage Image;
+};
+
+/**
+ * Extract frames from many media files. Each file is decoded only from the
+ * keyframe nearest to each requested time, found in its keyframe index, and
+ * files are processed in parallel on worker tasks.
+ */
+UCLASS()
+class BLUEPRINTFFMPEG_API UFFmpegThumbnails: public UBlueprintFunctionLibrary {
+	GENERATED_BODY()
+
+	// type aliases
+public:
+	using FExtractedCallback = TFunction<void(
+	    int32 RequestIndex, TArray<FFFmpegThumbnail>&& Thumbnails)>;
+
+	// blueprint functions
+public:
+	/**
+	 * Extract a frame every IntervalSeconds from each of MediaPaths, and
+	 * save them as "<media name>_<path hash>_<index>.jpg" in OutputDirectory,
+	 * so that media of the same name in other directories don't collide.
+	 * @param Width   width of the images, keeping the aspect ratio. the width
+	 *                of the media if 0.
+	 * @return   paths of saved images.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static TArray<FString>
+	    ExtractThumbnailsToFiles(const TArray<FString>& MediaPaths,
+	                             float IntervalSeconds, int32 Width,
+	                             const FString& OutputDirectory);
+
+	// C++ functions
+public:
+	/**
+	 * Extract frames of Requests on worker tasks, waiting for all of them.
+	 * @param Width   width of the images, keeping the aspect ratio. the width
+	 *                of the media if 0.
+	 * @param OnExtracted   called on worker tasks with the frames of each
+	 *                      request, in the order of time.
+	 */
+	static void
+	    ExtractThumbnails(TConstArrayView<FFFmpegThumbnailRequest> Requests,
+	                      int32 Width, const FExtractedCallback& OnExtracted);
+
+	/**
+	 * Extract frames of Request on the calling thread.
+	 * @return   frames in the order of time. empty if the media can't be read.
+	 */
+	static TArray<FFFmpegThumbnail>
+	    ExtractThumbnailsOfFile(const FFFmpegThumbnailRequest& Request,
+	                            int32                          Width);
+};
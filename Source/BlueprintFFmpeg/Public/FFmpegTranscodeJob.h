@@ -0,0 +1,117 @@
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegEncoderConfig.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Background job that transcodes a proxy recorded with
+ * FFFmpegEncoderConfig::ProxyCodec to the delivery codec and quality
+ * settings, on a low priority thread limited to TranscodeThreads threads.
+ * Output is encoded in segments, which are kept when the job is canceled
+ * or the process exits, so that a later job with the same paths resumes
+ * after the last finished segment. The segments are joined into the output
+ * file and the proxy is deleted once all frames are transcoded.
+ */
+class BLUEPRINTFFMPEG_API FFFmpegTranscodeJob: public FRunnable {
+	// public functions
+public:
+	/**
+	 * @param ProxyFilePath   proxy to transcode.
+	 * @param OutputFilePath   Output destination file path.
+	 *                         The output format is determined by the
+	 *                         extension of this path.
+	 * @param FFmpegEncoderConfig   delivery setting.
+	 */
+	FFFmpegTranscodeJob(const FString&              ProxyFilePath,
+	                    const FString&              OutputFilePath,
+	                    const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	~FFFmpegTranscodeJob();
+
+	/**
+	 * @return   path of the proxy recorded for OutputFilePath.
+	 */
+	static FString ProxyFilePathOf(const FString& OutputFilePath);
+
+	/**
+	 * Start transcoding on a background thread once the proxy is finished.
+	 * Does nothing if already started. Can be called from any thread.
+	 */
+	void Start();
+
+	/**
+	 * Mark the proxy as finished, so that transcoding can begin.
+	 * Can be called from any thread.
+	 */
+	void MarkProxyFinished();
+
+	/**
+	 * Stop after the segment being encoded is discarded. Finished segments
+	 * are kept for resuming.
+	 */
+	void Cancel();
+
+	/**
+	 * @return   whether the output file is written.
+	 */
+	bool IsSucceeded() const;
+
+	/**
+	 * @return   whether transcoding has ended in success, failure or
+	 *           cancel. Jobs canceled before starting are finished.
+	 */
+	bool IsFinished() const;
+
+	/**
+	 * @return   transcoded fraction of the proxy, from 0 to 1.
+	 */
+	float GetProgress() const;
+
+	// FRunnable interfaces
+public:
+	virtual uint32 Run() override;
+	virtual void   Stop() override;
+	virtual void   Exit() override;
+
+	// private functions
+private:
+	/**
+	 * @return   path of the finished segment at Index.
+	 */
+	FString SegmentPathOf(int32 Index) const;
+
+	/**
+	 * Transcode the proxy into segments after the finished ones.
+	 * @return   number of segments, or INDEX_NONE on failure or cancel.
+	 */
+	int32 TranscodeSegments();
+
+	// private constants
+private:
+	// duration of each segment
+	static constexpr double SegmentSeconds = 10.0;
+
+	// private fields: no data race
+private:
+	FString              ProxyFilePath;
+	FString              OutputFilePath;
+	FFFmpegEncoderConfig Config;
+	FRunnableThread*     Thread = nullptr;
+
+	// private fields: beware of data race
+private:
+	std::mutex              Start_mutex;
+	std::condition_variable ProxyFinished_cv;
+	bool                    bProxyFinished = false;
+	std::atomic_bool        bStarted       = false;
+	std::atomic_bool        bCanceled      = false;
+	std::atomic_bool        bSucceeded     = false;
+	std::atomic_bool        bExited        = false;
+	std::atomic<float>      Progress       = 0.0f;
+};
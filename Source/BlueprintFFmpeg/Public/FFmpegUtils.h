@@ -2,19 +2,81 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "CreateImageFromTextureRHI.h"
+#include "FFmpegColorConversion.h"
+#include "FFmpegEncoderConfig.h"
 #include "FFmpegFrameSharedPtr.h"
+#include "FFmpegMemory.h"
 #include "ImageCore.h"
 #include "ImageUtils.h"
+#include "LogFFmpegEncoder.h"
 
 #include <optional>
 
 extern "C" {
 #include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 }
 
 #include "FFmpegUtils.generated.h"
 
+struct AVCodec;
+struct AVCodecContext;
+struct AVStream;
+
+/**
+ * Throughput of one scale filter measured by MeasureScaleThroughput
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegScaleThroughput {
+	GENERATED_BODY()
+
+	/**
+	 * measured filter
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	FFmpegScaleFilter ScaleFilter = FFmpegScaleFilter::Bilinear;
+
+	/**
+	 * average time to scale and convert one frame
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float MillisecondsPerFrame = 0.0f;
+
+	/**
+	 * source pixels scaled and converted per second, in millions
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float MegapixelsPerSecond = 0.0f;
+};
+
+/**
+ * Peak memory of frame creation measured by MeasureBandMemory
+ */
+USTRUCT(BlueprintType)
+struct BLUEPRINTFFMPEG_API FFFmpegBandMemory {
+	GENERATED_BODY()
+
+	/**
+	 * rows converted at a time, 0 for whole frames
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	int32 BandHeight = 0;
+
+	/**
+	 * growth of used physical memory at the peak of creating one frame
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float PeakMegabytes = 0.0f;
+
+	/**
+	 * time to create one frame
+	 */
+	UPROPERTY(BlueprintReadOnly)
+	float MillisecondsPerFrame = 0.0f;
+};
+
 /**
  *
  */
@@ -28,10 +90,229 @@ public:
 	    const FString& OutputFilePath, const TArray<FString>& InputImagePaths,
 	    const FFFmpegEncoderConfig& FFmpegEncoderConfig);
 
+	/**
+	 * Same as GenerateVideoFromImageFiles, reusing GOPs encoded by earlier
+	 * runs. Images are encoded in GOPs of FramesPerGop frames, cached in
+	 * CacheDirectory under a hash of their contents and FFmpegEncoderConfig,
+	 * and the GOPs are joined by stream copy. Only GOPs with changed images
+	 * are encoded again, several at once. FilterGraph is not supported, and
+	 * no audio or trace is recorded.
+	 * @param[out] ReusedGops   GOPs taken from the cache.
+	 * @param[out] EncodedGops   GOPs encoded and added to the cache.
+	 * @return   whether OutputFilePath was written.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static bool GenerateVideoFromImageFilesCached(
+	    const FString& OutputFilePath, const TArray<FString>& InputImagePaths,
+	    const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	    const FString& CacheDirectory, int32& ReusedGops, int32& EncodedGops,
+	    FString& ErrorMessage, int32 FramesPerGop = 300);
+
+	/**
+	 * Measure how fast a source image is scaled and converted to the output
+	 * media of FFmpegEncoderConfig with each scale filter.
+	 * @param SourceWidth   width of the synthetic BGRA8 source image.
+	 * @param SourceHeight   height of the synthetic BGRA8 source image.
+	 * @param NumFrames   frames converted per filter.
+	 * @return   results of each filter. empty unless NumFrames and the size
+	 *           are positive.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static TArray<FFFmpegScaleThroughput>
+	    MeasureScaleThroughput(int32 SourceWidth, int32 SourceHeight,
+	                           const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                           int32                       NumFrames = 30);
+
+	/**
+	 * Measure peak memory of creating a frame of FFmpegEncoderConfig from a
+	 * render target of the output size, read back as AddFrame of a texture
+	 * does, as whole frames and in bands of BandHeight rows.
+	 * Must not be called on the render thread.
+	 * @return   results of whole frames and bands.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static TArray<FFFmpegBandMemory>
+	    MeasureBandMemory(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                      int32                       BandHeight = 64);
+
+	/**
+	 * Open NumEncoders encoders of FFmpegEncoderConfig in the background, so
+	 * that FFmpegEncoder opened with the same codec, size, rate and quality
+	 * settings starts without waiting for codec initialization. Each one
+	 * taken is replaced in the background. Releases them if NumEncoders is
+	 * 0.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static void PrewarmEncoders(const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	                            int32                       NumEncoders = 1);
+
+	/**
+	 * Release all encoders opened by PrewarmEncoders.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static void ReleasePrewarmedEncoders();
+
+	/**
+	 * @return   memory held by FFmpeg encoding in the process, by category.
+	 *           also written to the log by the console command
+	 *           FFmpeg.MemReport, which memreport can be configured to run.
+	 */
+	UFUNCTION(BlueprintPure)
+	static FFFmpegMemoryStats GetMemoryStats();
+
+	/**
+	 * Join videos into OutputFilePath by copying their packets, without
+	 * decoding or re-encoding them. Inputs must have the same streams with
+	 * the same codec parameters, such as outputs of FFmpegEncoder with the
+	 * same setting. Timestamps of each input continue from the end of the
+	 * previous one.
+	 * @return   whether OutputFilePath was written.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static bool ConcatVideosByStreamCopy(const TArray<FString>& InputFilePaths,
+	                                     const FString&         OutputFilePath,
+	                                     FString&               ErrorMessage);
+
+	/**
+	 * Cut a range of InputFilePath into OutputFilePath by copying packets,
+	 * without decoding or re-encoding them. The range is widened to
+	 * keyframes, starting at the keyframe at or before StartSeconds and
+	 * ending before the first keyframe at or after EndSeconds. Timestamps of
+	 * the output start at 0.
+	 * @param EndSeconds   end of the range. the end of the input if not
+	 *                     positive.
+	 * @param[out] TrimmedStartSeconds   start of the copied range.
+	 * @param[out] TrimmedEndSeconds   end of the copied range.
+	 * @return   whether OutputFilePath was written.
+	 */
+	UFUNCTION(BlueprintCallable)
+	static bool TrimVideoByStreamCopy(const FString& InputFilePath,
+	                                  const FString& OutputFilePath,
+	                                  float          StartSeconds,
+	                                  float          EndSeconds,
+	                                  float&         TrimmedStartSeconds,
+	                                  float&         TrimmedEndSeconds,
+	                                  FString&       ErrorMessage);
+
 public:
 	static constexpr AVPixelFormat
 	    FFmpegFrameFormatOf(ERawImageFormat::Type UEImageFormat) noexcept;
 
+	/**
+	 * @return   encoder of Codec, nullptr if FFmpeg is built without it.
+	 */
+	static const AVCodec* FindVideoEncoder(FFmpegVideoCodec Codec);
+
+	/**
+	 * Allocate and open a context of Codec with the size, rate, pixel format
+	 * and quality settings of FFmpegEncoderConfig.
+	 * @return   nullptr on failure. free with avcodec_free_context.
+	 */
+	static AVCodecContext*
+	    OpenVideoEncoder(const AVCodec&              Codec,
+	                     const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Allocate and open an intra-only lossless encoder of the proxy codec of
+	 * FFmpegEncoderConfig, with its size, rate and pixel format.
+	 * @return   nullptr on failure. free with avcodec_free_context.
+	 */
+	static AVCodecContext*
+	    OpenProxyEncoder(const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Allocate and open a decoder of Stream, which decodes frames and slices
+	 * in parallel with Threads threads, picked automatically if 0.
+	 * @return   nullptr on failure. free with avcodec_free_context.
+	 */
+	static AVCodecContext* OpenVideoDecoder(const AVStream& Stream,
+	                                        int32           Threads = 0);
+
+	/**
+	 * @return   swscale flags of ScaleFilter
+	 */
+	static int SwsFlagsOf(FFmpegScaleFilter ScaleFilter) noexcept;
+
+	/**
+	 * Scale and convert Image into DstRect of an allocated Frame in one pass.
+	 * Pixels of DstRect that ScaleMode leaves uncovered are not written.
+	 * @param DstRect   region of Frame. its origin must be even.
+	 * @return   whether Image was converted.
+	 */
+	static bool ConvertImageIntoFrame(
+	    const FImage& Image, AVFrame& Frame, const FIntRect& DstRect,
+	    const FFFmpegColorConversion& ColorConversion,
+	    FFmpegScaleFilter             ScaleFilter = FFmpegScaleFilter::Bilinear,
+	    FFmpegScaleMode               ScaleMode   = FFmpegScaleMode::Stretch);
+
+	/**
+	 * Scale and convert a decoded Frame into BGRA8 Image of its size, through
+	 * the scaler of the calling thread. Untagged frames are taken as BT.709.
+	 * @return   whether Frame was converted.
+	 */
+	static bool ConvertFrameIntoImage(
+	    const AVFrame& Frame, FImage& Image,
+	    FFmpegScaleFilter ScaleFilter = FFmpegScaleFilter::Bilinear);
+
+	/**
+	 * Convert the source into Frame band by band. The band image passed to
+	 * ReadBand is recycled between bands and frames of the calling thread.
+	 * @param BandHeight   rows per band. rounded up to even.
+	 * @param ReadBand   fill Band with rows of BandRect of a source of the
+	 *                   size of Frame. returns whether it succeeded.
+	 * @return   whether all bands were converted.
+	 */
+	static bool ConvertBandsIntoFrame(
+	    AVFrame& Frame, int32 BandHeight,
+	    const FFFmpegColorConversion&                              ColorConversion,
+	    TFunctionRef<bool(const FIntRect& BandRect, FImage& Band)> ReadBand);
+
+	/**
+	 * Create a frame with CreateFrameInBands, reading bands back from
+	 * TextureRHI through a pooled staging texture of a band, or through
+	 * ReadTextureRHIIntoImage for formats the staging copy can't read.
+	 * @return   a null frame if any band failed to be read.
+	 */
+	template <ESPMode InMode = ESPMode::ThreadSafe>
+	static TFFmpegFrameSharedPtr<InMode> CreateFrameInBandsFromTextureRHI(
+	    FTextureRHIRef TextureRHI, int FrameIndex,
+	    const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
+	/**
+	 * Scale and convert each of Images into the region of Frame at the same
+	 * index of Tiles, in parallel. Null and empty images are skipped.
+	 * @param Tiles   regions of Frame, which must not share chroma samples.
+	 * @return   whether all images were converted.
+	 */
+	static bool ConvertImagesIntoTiles(
+	    TConstArrayView<const FImage*> Images, TConstArrayView<FIntRect> Tiles,
+	    AVFrame& Frame, const FFFmpegColorConversion& ColorConversion,
+	    FFmpegScaleFilter ScaleFilter = FFmpegScaleFilter::Bilinear,
+	    FFmpegScaleMode   ScaleMode   = FFmpegScaleMode::Stretch,
+	    EParallelForFlags Flags       = EParallelForFlags::None);
+
+	/**
+	 * Create a frame of size, pixel format and color of FFmpegEncoderConfig
+	 * from a source of the same size, converted in bands of
+	 * FFmpegEncoderConfig.BandHeight rows.
+	 */
+	template <ESPMode InMode = ESPMode::ThreadSafe>
+	static TFFmpegFrameSharedPtr<InMode> CreateFrameInBands(
+	    int FrameIndex, const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+	    TFunctionRef<bool(const FIntRect& BandRect, FImage& Band)> ReadBand);
+
+	/**
+	 * Create a frame of size, pixel format and color of FFmpegEncoderConfig
+	 * composed of Images in the regions of Tiles at the same indices, each
+	 * scaled as configured. Regions without images are left black.
+	 * @return   a null frame if the frame failed to be allocated or any
+	 *           image failed to convert.
+	 */
+	template <ESPMode InMode = ESPMode::ThreadSafe>
+	static TFFmpegFrameSharedPtr<InMode> CreateMosaicFrame(
+	    TConstArrayView<const FImage*> Images, TConstArrayView<FIntRect> Tiles,
+	    int FrameIndex, const FFFmpegEncoderConfig& FFmpegEncoderConfig);
+
 	template <ESPMode InMode = ESPMode::ThreadSafe>
 	static TFFmpegFrameSharedPtr<InMode> CreateFrame(
 	    const FString& ImagePath, int FrameIndex,
@@ -42,7 +323,19 @@ public:
 	static TFFmpegFrameSharedPtr<InMode> CreateFrame(
 	    const FImage& Image, int FrameIndex, std::optional<int> FrameWidth = {},
 	    std::optional<int> FrameHeight = {},
-	    AVPixelFormat      PixelFormat = AVPixelFormat::AV_PIX_FMT_YUV420P);
+	    AVPixelFormat      PixelFormat = AVPixelFormat::AV_PIX_FMT_YUV420P,
+	    const FFFmpegColorConversion& ColorConversion = {},
+	    FFmpegScaleFilter             ScaleFilter = FFmpegScaleFilter::Bilinear,
+	    FFmpegScaleMode               ScaleMode   = FFmpegScaleMode::Stretch);
+
+	/**
+	 * Create a frame of size, pixel format and color of FFmpegEncoderConfig,
+	 * scaling Image as configured.
+	 */
+	template <ESPMode InMode = ESPMode::ThreadSafe>
+	static TFFmpegFrameSharedPtr<InMode>
+	    CreateFrame(const FImage& Image, int FrameIndex,
+	                const FFFmpegEncoderConfig& FFmpegEncoderConfig);
 };
 
 #pragma region          definition of inline functions
@@ -60,16 +353,16 @@ constexpr AVPixelFormat UFFmpegUtils::FFmpegFrameFormatOf(
 	case UEFormat::RGBA16:
 		return AV_PIX_FMT_RGBA64; // 16-bit RGBA
 	case UEFormat::RGBA16F:
-		return AV_PIX_FMT_RGBA64; // No direct 16F in FFmpeg, using 64-bit RGBA as
-		                          // closest
+		return AV_PIX_FMT_NONE; // swscale can't read half floats, converted by
+		                        // FFFmpegColorConversion
 	case UEFormat::RGBA32F:
-		return AV_PIX_FMT_RGBA; // No direct 32F, using 8-bit RGBA as an
-		                        // approximation
+		return AV_PIX_FMT_NONE; // swscale can't read float RGBA, converted by
+		                        // FFFmpegColorConversion
 	case UEFormat::G16:
 		return AV_PIX_FMT_GRAY16; // 16-bit grayscale
 	case UEFormat::R16F:
-		return AV_PIX_FMT_GRAY16; // No direct support, using 16-bit grayscale as
-		                          // closest
+		return AV_PIX_FMT_NONE; // swscale can't read half floats, converted by
+		                        // FFFmpegColorConversion
 	case UEFormat::R32F:
 		return AV_PIX_FMT_GRAYF32; // 32-bit float grayscale, FFmpeg uses
 		                           // AV_PIX_FMT_GRAYF32 for float grayscale
@@ -96,50 +389,163 @@ TFFmpegFrameSharedPtr<InMode>
 template <ESPMode InMode>
 TFFmpegFrameSharedPtr<InMode> UFFmpegUtils::CreateFrame(
     const FImage& Image, const int FrameIndex, std::optional<int> FrameWidth,
-    std::optional<int> FrameHeight, AVPixelFormat PixelFormat) {
+    std::optional<int> FrameHeight, AVPixelFormat PixelFormat,
+    const FFFmpegColorConversion& ColorConversion,
+    FFmpegScaleFilter ScaleFilter, FFmpegScaleMode ScaleMode) {
 	TFFmpegFrameSharedPtr<InMode> FFmpegFrame;
 
-	const auto& SrcFormat = UFFmpegUtils::FFmpegFrameFormatOf(Image.Format);
-	const auto& SrcWidth  = Image.GetWidth();
-	const auto& SrcHeight = Image.GetHeight();
-
 	const auto& RawFrame = FFmpegFrame.Get();
 
 	RawFrame->pts    = FrameIndex;
 	RawFrame->format = PixelFormat;
-	RawFrame->width  = FrameWidth.value_or(SrcWidth);
-	RawFrame->height = FrameHeight.value_or(SrcHeight);
+	RawFrame->width  = FrameWidth.value_or(Image.GetWidth());
+	RawFrame->height = FrameHeight.value_or(Image.GetHeight());
 
-	// initialize frame buffer
-	if (av_frame_get_buffer(RawFrame, 0) < 0) {
+	// tag color properties of the conversion below
+	ColorConversion.SetColorProperties(*RawFrame);
+
+	// initialize frame buffer through the engine allocator
+	if (!FFFmpegMemory::GetFrameBuffer(*RawFrame)) {
 		UE_LOG(LogTemp, Error, TEXT("Failed to allocate AVFrame buffer"));
 		return FFmpegFrame;
 	}
 
-	SwsContext* SwsConvertFormatContext =
-	    sws_getContext(SrcWidth, SrcHeight, SrcFormat, SrcWidth, SrcHeight,
-	                   PixelFormat, SWS_BILINEAR, nullptr, nullptr, nullptr);
-	if (nullptr == SwsConvertFormatContext) {
-		UE_LOG(LogTemp, Error, TEXT("Failed to create SwsContext."));
-		return FFmpegFrame;
+	// letterbox is left black
+	if (FFmpegScaleMode::Fit == ScaleMode) {
+		const ptrdiff_t LineSizes[4] = {RawFrame->linesize[0],
+		                                RawFrame->linesize[1],
+		                                RawFrame->linesize[2],
+		                                RawFrame->linesize[3]};
+		av_image_fill_black(RawFrame->data, LineSizes, PixelFormat,
+		                    RawFrame->color_range, RawFrame->width,
+		                    RawFrame->height);
+	}
+
+	// scale and convert in one pass
+	ConvertImageIntoFrame(Image, *RawFrame,
+	                      FIntRect(0, 0, RawFrame->width, RawFrame->height),
+	                      ColorConversion, ScaleFilter, ScaleMode);
+
+	return FFmpegFrame;
+}
+
+template <ESPMode InMode>
+TFFmpegFrameSharedPtr<InMode>
+    UFFmpegUtils::CreateFrame(const FImage& Image, const int FrameIndex,
+                              const FFFmpegEncoderConfig& FFmpegEncoderConfig) {
+	return CreateFrame<InMode>(
+	    Image, FrameIndex, FFmpegEncoderConfig.Width, FFmpegEncoderConfig.Height,
+	    FFFmpegColorConversion::PixelFormatOf(FFmpegEncoderConfig.PixelFormat),
+	    FFFmpegColorConversion(FFmpegEncoderConfig),
+	    FFmpegEncoderConfig.ScaleFilter, FFmpegEncoderConfig.ScaleMode);
+}
+
+template <ESPMode InMode>
+TFFmpegFrameSharedPtr<InMode> UFFmpegUtils::CreateFrameInBands(
+    const int FrameIndex, const FFFmpegEncoderConfig& FFmpegEncoderConfig,
+    TFunctionRef<bool(const FIntRect& BandRect, FImage& Band)> ReadBand) {
+	TFFmpegFrameSharedPtr<InMode> FFmpegFrame;
+
+	const auto&                  RawFrame = FFmpegFrame.Get();
+	const FFFmpegColorConversion ColorConversion(FFmpegEncoderConfig);
+
+	RawFrame->pts    = FrameIndex;
+	RawFrame->format =
+	    FFFmpegColorConversion::PixelFormatOf(FFmpegEncoderConfig.PixelFormat);
+	RawFrame->width  = FFmpegEncoderConfig.Width;
+	RawFrame->height = FFmpegEncoderConfig.Height;
+
+	// tag color properties of the conversion below
+	ColorConversion.SetColorProperties(*RawFrame);
+
+	// initialize frame buffer through the engine allocator
+	if (!FFFmpegMemory::GetFrameBuffer(*RawFrame)) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to allocate AVFrame buffer of frame %d."),
+		       FrameIndex);
+		return TFFmpegFrameSharedPtr<InMode>(nullptr);
+	}
+
+	// read and convert band by band, skipping the frame if a band fails
+	if (!ConvertBandsIntoFrame(*RawFrame, FFmpegEncoderConfig.BandHeight,
+	                           ColorConversion, ReadBand)) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to read or convert bands of frame %d."),
+		       FrameIndex);
+		return TFFmpegFrameSharedPtr<InMode>(nullptr);
+	}
+
+	return FFmpegFrame;
+}
+
+template <ESPMode InMode>
+TFFmpegFrameSharedPtr<InMode> UFFmpegUtils::CreateFrameInBandsFromTextureRHI(
+    FTextureRHIRef TextureRHI, const int FrameIndex,
+    const FFFmpegEncoderConfig& FFmpegEncoderConfig) {
+	const auto& bReadFloat = FFmpegEncoderConfig.IsHighPrecision();
+
+	// the staging texture is recycled across the bands of the frame
+	if (const auto& Reader =
+	        FTextureBandReader::Create(TextureRHI, bReadFloat)) {
+		return CreateFrameInBands<InMode>(
+		    FrameIndex, FFmpegEncoderConfig,
+		    [&](const FIntRect& BandRect, FImage& Band) {
+			    return Reader->ReadIntoImage(BandRect, Band);
+		    });
 	}
+	return CreateFrameInBands<InMode>(
+	    FrameIndex, FFmpegEncoderConfig,
+	    [&](const FIntRect& BandRect, FImage& Band) {
+		    return ReadTextureRHIIntoImage(TextureRHI, BandRect, bReadFloat,
+		                                   Band);
+	    });
+}
 
-	const auto&    RawImageData  = Image.RawData;
-	const auto&    BytesPerPixel = Image.GetBytesPerPixel();
-	const auto&    DestImageData = RawFrame->data[0];
-	const uint8_t* SrcData[8]    = {RawImageData.GetData(),
-	                                nullptr,
-	                                nullptr,
-	                                nullptr,
-	                                nullptr,
-	                                nullptr,
-	                                nullptr,
-	                                nullptr};
-	const int SrcLineSize[8] = {SrcWidth * BytesPerPixel, 0, 0, 0, 0, 0, 0, 0};
-	sws_scale(SwsConvertFormatContext, SrcData, SrcLineSize, 0, SrcHeight,
-	          RawFrame->data, RawFrame->linesize);
-
-	sws_freeContext(SwsConvertFormatContext);
+template <ESPMode InMode>
+TFFmpegFrameSharedPtr<InMode> UFFmpegUtils::CreateMosaicFrame(
+    TConstArrayView<const FImage*> Images, TConstArrayView<FIntRect> Tiles,
+    const int FrameIndex, const FFFmpegEncoderConfig& FFmpegEncoderConfig) {
+	TFFmpegFrameSharedPtr<InMode> FFmpegFrame;
+
+	const auto&                  RawFrame = FFmpegFrame.Get();
+	const FFFmpegColorConversion ColorConversion(FFmpegEncoderConfig);
+
+	RawFrame->pts    = FrameIndex;
+	RawFrame->format =
+	    FFFmpegColorConversion::PixelFormatOf(FFmpegEncoderConfig.PixelFormat);
+	RawFrame->width  = FFmpegEncoderConfig.Width;
+	RawFrame->height = FFmpegEncoderConfig.Height;
+
+	// tag color properties of the conversion below
+	ColorConversion.SetColorProperties(*RawFrame);
+
+	// initialize frame buffer through the engine allocator
+	if (!FFFmpegMemory::GetFrameBuffer(*RawFrame)) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to allocate AVFrame buffer of mosaic frame %d."),
+		       FrameIndex);
+		return TFFmpegFrameSharedPtr<InMode>(nullptr);
+	}
+
+	// late tiles, letterbox and the remainder of the grid are left black
+	const ptrdiff_t LineSizes[4] = {RawFrame->linesize[0],
+	                                RawFrame->linesize[1],
+	                                RawFrame->linesize[2],
+	                                RawFrame->linesize[3]};
+	av_image_fill_black(RawFrame->data, LineSizes,
+	                    static_cast<AVPixelFormat>(RawFrame->format),
+	                    RawFrame->color_range, RawFrame->width,
+	                    RawFrame->height);
+
+	// each image straight into its tile, skipping the frame if a tile fails
+	if (!ConvertImagesIntoTiles(
+	        Images, Tiles, *RawFrame, ColorConversion,
+	        FFmpegEncoderConfig.ScaleFilter, FFmpegEncoderConfig.ScaleMode,
+	        FFmpegEncoderConfig.GetConversionParallelForFlags())) {
+		UE_LOG(LogFFmpegEncoder, Error,
+		       TEXT("Failed to convert tiles of mosaic frame %d."), FrameIndex);
+		return TFFmpegFrameSharedPtr<InMode>(nullptr);
+	}
 
 	return FFmpegFrame;
 }
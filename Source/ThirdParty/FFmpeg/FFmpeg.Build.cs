@@ -29,6 +29,7 @@ public class FFmpeg : ModuleRules
             // Add the import library
             PublicAdditionalLibraries.Add(Path.Combine(FFmpegLibDirectoryPath, "avcodec.lib"));
             PublicAdditionalLibraries.Add(Path.Combine(FFmpegLibDirectoryPath, "avformat.lib"));
+            PublicAdditionalLibraries.Add(Path.Combine(FFmpegLibDirectoryPath, "avfilter.lib"));
             PublicAdditionalLibraries.Add(Path.Combine(FFmpegLibDirectoryPath, "swscale.lib"));
             PublicAdditionalLibraries.Add(Path.Combine(FFmpegLibDirectoryPath, "avutil.lib"));
 